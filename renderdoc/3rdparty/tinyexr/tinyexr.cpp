@@ -6,6 +6,7 @@
 
 #include <stdio.h>
 #include <time.h>
+#include "common/threading.h"
 #include "miniz/miniz.h"
 
 // local variable is initialized but not referenced
@@ -14,5 +15,10 @@
 #pragma warning(disable : 4018)
 #pragma warning(disable : 4389)
 
+// decode blocks of scanlines or tiles in parallel on the job system, rather than letting tinyexr
+// spawn its own threads for every image
+#define TINYEXR_PARALLEL_FOR(count, func) \
+  Threading::JobSystem::ParallelFor(uint32_t(count), func)
+
 #define TINYEXR_IMPLEMENTATION
 #include "tinyexr.h"
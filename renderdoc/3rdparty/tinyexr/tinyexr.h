@@ -109,6 +109,10 @@ extern "C" {
 // http://computation.llnl.gov/projects/floating-point-compression
 #endif
 
+// RenderDoc: TINYEXR_PARALLEL_FOR(count, func) can be defined to call func(i) for each i in
+// [0, count) on an existing thread pool, instead of spawning threads for every image. It takes
+// priority over TINYEXR_USE_THREAD and TINYEXR_USE_OPENMP.
+
 #ifndef TINYEXR_USE_OPENMP
 #ifdef _OPENMP
 #define TINYEXR_USE_OPENMP (1)
@@ -11027,7 +11031,12 @@ static int DecodeChunk(EXRImage *exr_image, const EXRHeader *exr_header,
 
     int err_code = TINYEXR_SUCCESS;
 
-#if (__cplusplus > 199711L) && (TINYEXR_USE_THREAD > 0)
+#if defined(TINYEXR_PARALLEL_FOR)
+    // each tile is decoded in a do-while so that a break stops just that tile, like a break in the
+    // thread loop below stops that worker
+    TINYEXR_PARALLEL_FOR(num_tiles, [&](size_t tile_idx) {
+      do {
+#elif (__cplusplus > 199711L) && (TINYEXR_USE_THREAD > 0)
 
     std::vector<std::thread> workers;
     std::atomic<size_t> tile_count(0);
@@ -11129,7 +11138,10 @@ static int DecodeChunk(EXRImage *exr_image, const EXRHeader *exr_header,
           exr_image->tiles[tile_idx].level_x = tile_coordinates[2];
           exr_image->tiles[tile_idx].level_y = tile_coordinates[3];
 
-#if (__cplusplus > 199711L) && (TINYEXR_USE_THREAD > 0)
+#if defined(TINYEXR_PARALLEL_FOR)
+      } while (0);
+    });
+#elif (__cplusplus > 199711L) && (TINYEXR_USE_THREAD > 0)
         }
       }));
     }  // num_thread loop
@@ -11170,7 +11182,11 @@ static int DecodeChunk(EXRImage *exr_image, const EXRHeader *exr_header,
         num_channels, exr_header->channels, exr_header->requested_pixel_types,
         data_width, data_height);
 
-#if (__cplusplus > 199711L) && (TINYEXR_USE_THREAD > 0)
+#if defined(TINYEXR_PARALLEL_FOR)
+    TINYEXR_PARALLEL_FOR(num_blocks, [&](size_t block) {
+      int y = int(block);
+      do {
+#elif (__cplusplus > 199711L) && (TINYEXR_USE_THREAD > 0)
     std::vector<std::thread> workers;
     std::atomic<int> y_count(0);
 
@@ -11271,7 +11287,10 @@ static int DecodeChunk(EXRImage *exr_image, const EXRHeader *exr_header,
             }
           }
 
-#if (__cplusplus > 199711L) && (TINYEXR_USE_THREAD > 0)
+#if defined(TINYEXR_PARALLEL_FOR)
+      } while (0);
+    });
+#elif (__cplusplus > 199711L) && (TINYEXR_USE_THREAD > 0)
         }
       }));
     }
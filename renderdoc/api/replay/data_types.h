@@ -1502,6 +1502,124 @@ this counts the frame number when the capture was made.
 
 DECLARE_REFLECTION_STRUCT(FrameDescription);
 
+DOCUMENT(R"(The CPU cost of processing every chunk of one type, either while the capture was opened
+or while the frame was replayed.
+)");
+struct ChunkProfile
+{
+  DOCUMENT("");
+  ChunkProfile() = default;
+  ChunkProfile(const ChunkProfile &) = default;
+  ChunkProfile &operator=(const ChunkProfile &) = default;
+
+  bool operator==(const ChunkProfile &o) const
+  {
+    return chunkID == o.chunkID && name == o.name && count == o.count &&
+           byteSize == o.byteSize && duration == o.duration;
+  }
+  bool operator<(const ChunkProfile &o) const
+  {
+    if(!(chunkID == o.chunkID))
+      return chunkID < o.chunkID;
+    return name < o.name;
+  }
+
+  DOCUMENT("The name of the chunk type.");
+  rdcstr name;
+
+  DOCUMENT("The chunk ID, as in :data:`SDChunkMetaData.chunkID`.");
+  uint32_t chunkID = 0;
+
+  DOCUMENT("How many chunks of this type were processed.");
+  uint32_t count = 0;
+
+  DOCUMENT("The total size in bytes of the serialised chunks.");
+  uint64_t byteSize = 0;
+
+  DOCUMENT(R"(The total CPU time in milliseconds spent processing the chunks.
+
+When loading, the chunk that begins the frame includes the time taken to first replay the frame.
+)");
+  double duration = 0.0;
+};
+
+DECLARE_REFLECTION_STRUCT(ChunkProfile);
+
+DOCUMENT(R"(The CPU cost of replaying to a particular event, accumulated over every time it was
+selected with :meth:`ReplayController.SetFrameEvent`.
+)");
+struct EventReplayProfile
+{
+  DOCUMENT("");
+  EventReplayProfile() = default;
+  EventReplayProfile(const EventReplayProfile &) = default;
+  EventReplayProfile &operator=(const EventReplayProfile &) = default;
+
+  bool operator==(const EventReplayProfile &o) const
+  {
+    return eventId == o.eventId && count == o.count && duration == o.duration &&
+           maxDuration == o.maxDuration;
+  }
+  bool operator<(const EventReplayProfile &o) const { return eventId < o.eventId; }
+
+  DOCUMENT("The :data:`eventId <APIEvent.eventId>` that was replayed to.");
+  uint32_t eventId = 0;
+
+  DOCUMENT("How many times the frame was replayed to this event.");
+  uint32_t count = 0;
+
+  DOCUMENT("The total CPU time in milliseconds spent replaying to this event.");
+  double duration = 0.0;
+
+  DOCUMENT("The longest CPU time in milliseconds taken by a single replay to this event.");
+  double maxDuration = 0.0;
+};
+
+DECLARE_REFLECTION_STRUCT(EventReplayProfile);
+
+DOCUMENT(R"(CPU profiling information gathered while loading and replaying a capture.
+
+This is always collected, and can be used to find which captures or which API calls are expensive
+to load or replay.
+)");
+struct ReplayProfile
+{
+  DOCUMENT("");
+  ReplayProfile() = default;
+  ReplayProfile(const ReplayProfile &) = default;
+  ReplayProfile &operator=(const ReplayProfile &) = default;
+
+  DOCUMENT(R"(The load cost of each type of chunk in the capture.
+
+:type: List[ChunkProfile]
+)");
+  rdcarray<ChunkProfile> chunks;
+
+  DOCUMENT(R"(The cost of each type of chunk replayed since the capture was opened, sorted by chunk
+ID.
+
+This includes every replay, whether from :meth:`ReplayController.SetFrameEvent` or done internally
+for analysis. Chunks that a replay skips over without processing are not counted.
+
+:type: List[ChunkProfile]
+)");
+  rdcarray<ChunkProfile> replayChunks;
+
+  DOCUMENT("How many times the frame's initial contents were applied, including while loading.");
+  uint32_t initialContentsCount = 0;
+
+  DOCUMENT("The total CPU time in milliseconds spent applying the frame's initial contents.");
+  double initialContentsDuration = 0.0;
+
+  DOCUMENT(R"(The replay cost of each event that has been selected, sorted by event ID.
+
+:type: List[EventReplayProfile]
+)");
+  rdcarray<EventReplayProfile> events;
+};
+
+DECLARE_REFLECTION_STRUCT(ReplayProfile);
+
 DOCUMENT(
     "Describes a particular use of a resource at a specific :data:`eventId <APIEvent.eventId>`.");
 struct EventUsage
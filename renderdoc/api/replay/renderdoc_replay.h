@@ -721,6 +721,27 @@ See :meth:`BuildTargetShader`.
 )");
   virtual const SDFile &GetStructuredFile() = 0;
 
+  DOCUMENT(R"(Retrieve the CPU profiling information gathered so far while loading and replaying the
+capture.
+
+:return: The profiling information.
+:rtype: ReplayProfile
+)");
+  virtual ReplayProfile GetReplayProfile() = 0;
+
+  DOCUMENT(R"(Export the CPU profiling information gathered so far with the ``chrome.json`` capture
+exporter, so it can be loaded by chrome's profiler at chrome://tracing.
+
+The profile doesn't contain a timeline, so each chunk type loaded, the initial contents, each chunk
+type replayed and each replayed event are laid out one after another on separate tracks, with a
+duration equal to their total time.
+
+:param str filename: The filename to save to.
+:return: The result of the operation.
+:rtype: ResultDetails
+)");
+  virtual ResultDetails ExportReplayProfile(const rdcstr &filename) = 0;
+
   DOCUMENT(R"(Add fake marker regions to the list of actions in the capture, based on which
 textures are bound as outputs. Will not do anything if the capture already contains user marker
 regions.
@@ -1617,6 +1638,14 @@ by the :class:`ReplayController`.
 The lifetime of this data is scoped to the lifetime of the capture handle, so it cannot be used
 after the handle is destroyed.
 
+By default the whole capture is decoded before this returns, and the data can then be read from
+any number of threads at once.
+
+If the ``Replay.LazyStructuredData`` setting is enabled only the list of chunks is read up front,
+and the contents of every chunk are decoded the first time any of them is accessed. The buffers in
+:data:`SDFile.buffers` are only available after that. Even read-only access can trigger the decode,
+so until it has happened the data must not be accessed from more than one thread at once.
+
 :return: The structured data representing the file.
 :rtype: SDFile
 )");
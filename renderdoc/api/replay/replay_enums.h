@@ -110,6 +110,14 @@ version of RenderDoc that addes a new section type. They should be considered eq
   This section contains an internal copy of D3D12SDKLayers for replaying.
 
   The name for this section will be "renderdoc/internal/d3d12sdklayers".
+
+.. data:: BlockIndex
+
+  This section contains an index of the compressed blocks in other sections, allowing them to be
+  read starting from any point without decompressing everything before it. It is regenerated
+  whenever an indexed section is written, so it doesn't need to be copied between captures.
+
+  The name for this section will be "renderdoc/internal/blockindex".
 )");
 enum class SectionType : uint32_t
 {
@@ -126,6 +134,7 @@ enum class SectionType : uint32_t
   EditedShaders,
   D3D12Core,
   D3D12SDKLayers,
+  BlockIndex,
   Count,
 };
 
@@ -4185,6 +4194,19 @@ DOCUMENT(R"(A set of flags describing the properties of a section in a renderdoc
 .. data:: ZstdCompressed
 
   This section is compressed with Zstd on disk.
+
+.. data:: LZ4IndependentBlocks
+
+  This section is compressed with LZ4 on disk, and each compressed block is independent of the
+  blocks before it so they can be compressed and decompressed in parallel. Only valid together
+  with :data:`LZ4Compressed`.
+
+.. data:: ZstdArchive
+
+  This section is compressed with Zstd on disk as a single frame with long distance matching,
+  instead of as independent blocks. It can only be decompressed in order from the start, so it
+  can't be read from an arbitrary point using a block index. Only valid together with
+  :data:`ZstdCompressed`.
 )");
 enum class SectionFlags : uint32_t
 {
@@ -4192,6 +4214,8 @@ enum class SectionFlags : uint32_t
   ASCIIStored = 0x1,
   LZ4Compressed = 0x2,
   ZstdCompressed = 0x4,
+  LZ4IndependentBlocks = 0x8,
+  ZstdArchive = 0x10,
 };
 
 BITMASK_OPERATORS(SectionFlags);
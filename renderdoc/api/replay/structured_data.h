@@ -415,12 +415,102 @@ DECLARE_REFLECTION_STRUCT(SDObjectData);
 
 #if !defined(SWIG)
 using LazyGenerator = std::function<SDObject *(const void *)>;
+using LazyContentsGenerator = std::function<void(SDObject *)>;
 
 struct LazyArrayData
 {
   byte *data;
   size_t elemSize;
   LazyGenerator generator;
+  // if set, the number of children isn't known yet and they are all added in one go by calling this
+  // on first access. Used for chunks whose contents are decoded on demand.
+  LazyContentsGenerator contents;
+};
+
+// A bump allocator that structured objects can be allocated from, owned by an SDFile. This avoids
+// an individual heap allocation per object when decoding a whole capture. Objects can still be
+// deleted individually as normal, but the memory is only reclaimed when the arena is destroyed.
+struct SDObjectArena
+{
+  /////////////////////////////////////////////////////////////////
+  // memory management, in a dll safe way
+  void *operator new(size_t sz) { return alloc(sz); }
+  void operator delete(void *p) { dealloc(p); }
+  void *operator new[](size_t count) = delete;
+  void operator delete[](void *p) = delete;
+
+  SDObjectArena() = default;
+  ~SDObjectArena()
+  {
+    for(byte *block : m_Blocks)
+      dealloc(block);
+  }
+
+  void *Allocate(size_t sz)
+  {
+    // keep everything pointer aligned
+    sz = (sz + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+
+    if(sz > size_t(m_End - m_Cur))
+    {
+      // allocations that don't fit comfortably in a block get a block of their own, so that we
+      // don't waste the remainder of the current block
+      if(sz > BlockSize / 4)
+      {
+        byte *block = (byte *)alloc(sz);
+        m_Blocks.push_back(block);
+        return block;
+      }
+
+      m_Cur = (byte *)alloc(BlockSize);
+      m_End = m_Cur + BlockSize;
+      m_Blocks.push_back(m_Cur);
+    }
+
+    void *ret = m_Cur;
+    m_Cur += sz;
+    return ret;
+  }
+
+  // take ownership of all the memory in another arena, e.g. when objects allocated from it are
+  // moved across to a file that owns this arena.
+  void Append(SDObjectArena &other)
+  {
+    m_Blocks.append(other.m_Blocks);
+    other.m_Blocks.clear();
+    other.m_Cur = other.m_End = NULL;
+  }
+
+private:
+  SDObjectArena(const SDObjectArena &) = delete;
+  SDObjectArena &operator=(const SDObjectArena &) = delete;
+
+  static const size_t BlockSize = 1024 * 1024;
+
+  static void *alloc(size_t sz)
+  {
+    void *ret = NULL;
+#ifdef RENDERDOC_EXPORTS
+    ret = malloc(sz);
+    if(ret == NULL)
+      RENDERDOC_OutOfMemory(sz);
+#else
+    ret = RENDERDOC_AllocArrayMem(sz);
+#endif
+    return ret;
+  }
+  static void dealloc(void *p)
+  {
+#ifdef RENDERDOC_EXPORTS
+    free(p);
+#else
+    RENDERDOC_FreeArrayMem(p);
+#endif
+  }
+
+  rdcarray<byte *> m_Blocks;
+  byte *m_Cur = NULL;
+  byte *m_End = NULL;
 };
 #endif
 
@@ -495,8 +585,13 @@ struct SDObject
 
   /////////////////////////////////////////////////////////////////
   // memory management, in a dll safe way
-  void *operator new(size_t sz) { return SDObject::alloc(sz); }
-  void operator delete(void *p) { SDObject::dealloc(p); }
+  void *operator new(size_t sz) { return SDObject::allocObject(sz, NULL); }
+  void operator delete(void *p) { SDObject::deallocObject(p); }
+#if !defined(SWIG)
+  // allocate from an arena instead of the heap. A NULL arena allocates from the heap as normal
+  void *operator new(size_t sz, SDObjectArena *arena) { return SDObject::allocObject(sz, arena); }
+  void operator delete(void *p, SDObjectArena *) { SDObject::deallocObject(p); }
+#endif
   void *operator new[](size_t count) = delete;
   void operator delete[](void *p) = delete;
 
@@ -578,7 +673,7 @@ recursively through children.
     {
       ret = false;
     }
-    else if(data.children.size() != obj->data.children.size())
+    else if(NumChildren() != obj->NumChildren())
     {
       ret = false;
     }
@@ -618,7 +713,7 @@ returned.
 )");
   inline SDObject *FindChild(const rdcstr &childName)
   {
-    for(size_t i = 0; i < data.children.size(); i++)
+    for(size_t i = 0; i < NumChildren(); i++)
       if(GetChild(i)->name == childName)
         return GetChild(i);
     return NULL;
@@ -658,7 +753,7 @@ returned.
 )");
   inline SDObject *GetChild(size_t index)
   {
-    if(index < data.children.size())
+    if(index < NumChildren())
     {
       PopulateChild(index);
       return data.children[index];
@@ -678,7 +773,7 @@ returned.
   // const versions of FindChild/GetChild
   inline const SDObject *FindChild(const rdcstr &childName) const
   {
-    for(size_t i = 0; i < data.children.size(); i++)
+    for(size_t i = 0; i < NumChildren(); i++)
       if(GetChild(i)->name == childName)
         return GetChild(i);
     return NULL;
@@ -700,7 +795,7 @@ returned.
   }
   inline const SDObject *GetChild(size_t index) const
   {
-    if(index < data.children.size())
+    if(index < NumChildren())
     {
       PopulateChild(index);
       return data.children[index];
@@ -741,16 +836,20 @@ returned.
 :return: The number of children this object contains.
 :rtype: int
 )");
-  inline size_t NumChildren() const { return data.children.size(); }
+  inline size_t NumChildren() const
+  {
+    PopulateContents();
+    return data.children.size();
+  }
 #if !defined(SWIG)
   // these are for C++ iteration so not defined when SWIG is generating interfaces
   inline SDObjectIt<const SDObject> begin() const { return SDObjectIt<const SDObject>(this, 0); }
   inline SDObjectIt<const SDObject> end() const
   {
-    return SDObjectIt<const SDObject>(this, data.children.size());
+    return SDObjectIt<const SDObject>(this, NumChildren());
   }
   inline SDObjectIt<SDObject> begin() { return SDObjectIt<SDObject>(this, 0); }
-  inline SDObjectIt<SDObject> end() { return SDObjectIt<SDObject>(this, data.children.size()); }
+  inline SDObjectIt<SDObject> end() { return SDObjectIt<SDObject>(this, NumChildren()); }
 #endif
 
 #if !defined(SWIG)
@@ -800,6 +899,23 @@ returned.
     memcpy(m_Lazy->data, arrayData, sz);
     data.children.resize((size_t)arrayCount);
   }
+
+  // set the children to be generated all at once on first access, for when even the number of
+  // children is expensive to determine up front. The generator is called with this object and
+  // should add the children with AddAndOwnChild. Like lazy arrays this isn't thread-safe: even
+  // const accessors generate the children, so the object must not be accessed from several threads
+  // at once until they have been generated.
+  void SetLazyContents(LazyContentsGenerator generator)
+  {
+    DeleteChildren();
+
+    void *lazyAlloc = alloc(sizeof(LazyArrayData));
+
+    m_Lazy = new(lazyAlloc) LazyArrayData;
+    m_Lazy->data = NULL;
+    m_Lazy->elemSize = 0;
+    m_Lazy->contents = generator;
+  }
 #endif
 
 // C++ gets more extensive typecasts. We'll add a couple for python in the interface file
@@ -947,7 +1063,7 @@ protected:
   // It's ugly, but necessary
   inline void PopulateChild(size_t idx) const
   {
-    if(m_Lazy)
+    if(m_Lazy && !m_Lazy->contents)
     {
       if(data.children[idx] == NULL)
       {
@@ -961,6 +1077,12 @@ protected:
   {
     if(m_Lazy)
     {
+      if(m_Lazy->contents)
+      {
+        PopulateContents();
+        return;
+      }
+
       for(size_t i = 0; i < data.children.size(); i++)
         PopulateChild(i);
 
@@ -968,6 +1090,17 @@ protected:
     }
   }
 
+  inline void PopulateContents() const
+  {
+    if(m_Lazy && m_Lazy->contents)
+    {
+      // remove the generator before calling it, so that it can add children normally
+      LazyContentsGenerator contents = std::move(m_Lazy->contents);
+      DeleteLazyGenerator();
+      contents((SDObject *)this);
+    }
+  }
+
   static void *alloc(size_t sz)
   {
     void *ret = NULL;
@@ -989,6 +1122,29 @@ protected:
 #endif
   }
 
+#if !defined(SWIG)
+  // every object is prefixed with the arena it was allocated from, or NULL if it came from the
+  // heap, so that objects can be deleted the same way wherever they came from.
+  static void *allocObject(size_t sz, SDObjectArena *arena)
+  {
+    const size_t prefix = sizeof(SDObjectArena *);
+    byte *ret = arena ? (byte *)arena->Allocate(sz + prefix) : (byte *)alloc(sz + prefix);
+    *(SDObjectArena **)ret = arena;
+    return ret + prefix;
+  }
+  static void deallocObject(void *p)
+  {
+    if(p == NULL)
+      return;
+
+    byte *base = (byte *)p - sizeof(SDObjectArena *);
+
+    // arena memory is freed all at once when the arena is destroyed
+    if(*(SDObjectArena **)base == NULL)
+      dealloc(base);
+  }
+#endif
+
 private:
   SDObject *m_Parent = NULL;
   mutable LazyArrayData *m_Lazy = NULL;
@@ -1006,6 +1162,7 @@ private:
     if(m_Lazy)
     {
       dealloc(m_Lazy->data);
+      m_Lazy->~LazyArrayData();
       dealloc(m_Lazy);
       m_Lazy = NULL;
     }
@@ -1358,26 +1515,12 @@ struct SDChunk : public SDObject
 {
   /////////////////////////////////////////////////////////////////
   // memory management, in a dll safe way
-  void *operator new(size_t sz)
-  {
-    void *ret = NULL;
-#ifdef RENDERDOC_EXPORTS
-    ret = malloc(sz);
-    if(ret == NULL)
-      RENDERDOC_OutOfMemory(sz);
-#else
-    ret = RENDERDOC_AllocArrayMem(sz);
-#endif
-    return ret;
-  }
-  void operator delete(void *p)
-  {
-#ifdef RENDERDOC_EXPORTS
-    free(p);
-#else
-    RENDERDOC_FreeArrayMem(p);
+  void *operator new(size_t sz) { return SDObject::allocObject(sz, NULL); }
+  void operator delete(void *p) { SDObject::deallocObject(p); }
+#if !defined(SWIG)
+  void *operator new(size_t sz, SDObjectArena *arena) { return SDObject::allocObject(sz, arena); }
+  void operator delete(void *p, SDObjectArena *) { SDObject::deallocObject(p); }
 #endif
-  }
   void *operator new[](size_t count) = delete;
   void operator delete[](void *p) = delete;
 
@@ -1401,10 +1544,10 @@ struct SDChunk : public SDObject
     ret->data.basic = data.basic;
     ret->data.str = data.str;
 
-    ret->data.children.resize(data.children.size());
-
     PopulateAllChildren();
 
+    ret->data.children.resize(data.children.size());
+
     for(size_t i = 0; i < data.children.size(); i++)
       ret->data.children[i] = data.children[i]->Duplicate();
 
@@ -1533,6 +1676,11 @@ public:
 
     for(bytebuf *buf : buffers)
       delete buf;
+
+#if !defined(SWIG)
+    // this must be freed after the chunks, since they may be allocated from it
+    delete m_Arena;
+#endif
   }
 
   DOCUMENT(R"(The chunks in the file in order.
@@ -1559,9 +1707,44 @@ public:
     chunks.swap(other.chunks);
     buffers.swap(other.buffers);
     std::swap(version, other.version);
+#if !defined(SWIG)
+    std::swap(m_Arena, other.m_Arena);
+#endif
   }
 
+#if !defined(SWIG)
+  // the arena to allocate objects for this file from, if arena allocation is enabled. Otherwise
+  // NULL, which allocates objects from the heap.
+  SDObjectArena *GetArena() { return m_Arena; }
+  void EnableArena()
+  {
+    if(!m_Arena)
+      m_Arena = new SDObjectArena;
+  }
+  // take ownership of another file's arena, needed before moving any objects from that file to
+  // this one.
+  void TakeArena(SDFile &other)
+  {
+    if(!other.m_Arena)
+      return;
+
+    if(m_Arena)
+    {
+      m_Arena->Append(*other.m_Arena);
+    }
+    else
+    {
+      m_Arena = other.m_Arena;
+      other.m_Arena = NULL;
+    }
+  }
+#endif
+
 protected:
   SDFile(const SDFile &) = delete;
   SDFile &operator=(const SDFile &) = delete;
+
+#if !defined(SWIG)
+  SDObjectArena *m_Arena = NULL;
+#endif
 };
@@ -26,6 +26,14 @@
 #include "common.h"
 #include <stdarg.h>
 #include <string.h>
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+#include "api/replay/rdcarray.h"
+#include "api/replay/rdcpair.h"
 #include "common/threading.h"
 #include "os/os_specific.h"
 #include "strings/string_utils.h"
@@ -178,6 +186,317 @@ bool FindDiffRange(void *a, void *b, size_t bufSize, size_t &diffStart, size_t &
   return diffStart < bufSize;
 }
 
+// the diff kernels below each scan 64-byte blocks from offs until the first one that differs, and
+// return its offset with one bit set in mask per differing byte. If no whole block before end
+// differs they return the offset of the first incomplete block with mask set to 0.
+typedef size_t (*DiffBlockKernel)(const byte *a, const byte *b, size_t offs, size_t end,
+                                  uint64_t &mask);
+
+static const size_t DiffBlockSize = 64;
+
+#if !(defined(__x86_64__) || defined(_M_X64)) || ENABLED(ENABLE_UNIT_TESTS)
+// portable fallback, which on x86-64 is only used to check the vector kernels against in tests
+static size_t NextDiffBlockScalar(const byte *a, const byte *b, size_t offs, size_t end,
+                                  uint64_t &mask)
+{
+  for(; offs + DiffBlockSize <= end; offs += DiffBlockSize)
+  {
+    uint64_t a64[8], b64[8];
+    memcpy(a64, a + offs, sizeof(a64));
+    memcpy(b64, b + offs, sizeof(b64));
+
+    uint64_t any = 0;
+    for(int i = 0; i < 8; i++)
+      any |= a64[i] ^ b64[i];
+
+    if(any == 0)
+      continue;
+
+    mask = 0;
+    for(int i = 0; i < 8; i++)
+    {
+      uint64_t x = a64[i] ^ b64[i];
+      for(int by = 0; x && by < 8; by++, x >>= 8)
+      {
+        if(x & 0xff)
+          mask |= 1ULL << (i * 8 + by);
+      }
+    }
+    return offs;
+  }
+
+  mask = 0;
+  return offs;
+}
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+#if defined(_MSC_VER)
+#define DIFF_TARGET_AVX2
+#define DIFF_TARGET_AVX512
+#else
+#define DIFF_TARGET_AVX2 __attribute__((target("avx2")))
+#define DIFF_TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+#endif
+
+// SSE2 is always available on x86-64
+static size_t NextDiffBlockSSE2(const byte *a, const byte *b, size_t offs, size_t end,
+                                uint64_t &mask)
+{
+  for(; offs + DiffBlockSize <= end; offs += DiffBlockSize)
+  {
+    uint32_t eq0 = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(
+        _mm_loadu_si128((const __m128i *)(a + offs)), _mm_loadu_si128((const __m128i *)(b + offs))));
+    uint32_t eq1 = (uint32_t)_mm_movemask_epi8(
+        _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + offs + 16)),
+                       _mm_loadu_si128((const __m128i *)(b + offs + 16))));
+    uint32_t eq2 = (uint32_t)_mm_movemask_epi8(
+        _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + offs + 32)),
+                       _mm_loadu_si128((const __m128i *)(b + offs + 32))));
+    uint32_t eq3 = (uint32_t)_mm_movemask_epi8(
+        _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + offs + 48)),
+                       _mm_loadu_si128((const __m128i *)(b + offs + 48))));
+
+    if((eq0 & eq1 & eq2 & eq3) == 0xffff)
+      continue;
+
+    mask = ~(uint64_t(eq0) | (uint64_t(eq1) << 16) | (uint64_t(eq2) << 32) | (uint64_t(eq3) << 48));
+    return offs;
+  }
+
+  mask = 0;
+  return offs;
+}
+
+DIFF_TARGET_AVX2 static size_t NextDiffBlockAVX2(const byte *a, const byte *b, size_t offs,
+                                                 size_t end, uint64_t &mask)
+{
+  for(; offs + DiffBlockSize <= end; offs += DiffBlockSize)
+  {
+    __m256i eq0 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(a + offs)),
+                                    _mm256_loadu_si256((const __m256i *)(b + offs)));
+    __m256i eq1 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(a + offs + 32)),
+                                    _mm256_loadu_si256((const __m256i *)(b + offs + 32)));
+
+    if((uint32_t)_mm256_movemask_epi8(_mm256_and_si256(eq0, eq1)) == 0xffffffffU)
+      continue;
+
+    mask = ~(uint64_t((uint32_t)_mm256_movemask_epi8(eq0)) |
+             (uint64_t((uint32_t)_mm256_movemask_epi8(eq1)) << 32));
+    return offs;
+  }
+
+  mask = 0;
+  return offs;
+}
+
+DIFF_TARGET_AVX512 static size_t NextDiffBlockAVX512(const byte *a, const byte *b, size_t offs,
+                                                     size_t end, uint64_t &mask)
+{
+  for(; offs + DiffBlockSize <= end; offs += DiffBlockSize)
+  {
+    __mmask64 ne = _mm512_cmpneq_epi8_mask(_mm512_loadu_si512((const void *)(a + offs)),
+                                           _mm512_loadu_si512((const void *)(b + offs)));
+
+    if(ne == 0)
+      continue;
+
+    mask = (uint64_t)ne;
+    return offs;
+  }
+
+  mask = 0;
+  return offs;
+}
+
+static bool CPUSupportsAVX2()
+{
+#if defined(_MSC_VER)
+  int regs[4] = {};
+  __cpuid(regs, 0);
+  if(regs[0] < 7)
+    return false;
+
+  // the OS must save the AVX registers
+  __cpuid(regs, 1);
+  if((regs[2] & (1 << 27)) == 0 || (_xgetbv(0) & 0x6) != 0x6)
+    return false;
+
+  __cpuidex(regs, 7, 0);
+  return (regs[1] & (1 << 5)) != 0;
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+
+static bool CPUSupportsAVX512()
+{
+#if defined(_MSC_VER)
+  if(!CPUSupportsAVX2())
+    return false;
+
+  // the OS must also save the opmask and upper ZMM registers
+  if((_xgetbv(0) & 0xe6) != 0xe6)
+    return false;
+
+  int regs[4] = {};
+  __cpuidex(regs, 7, 0);
+  return (regs[1] & (1 << 16)) != 0 && (regs[1] & (1 << 30)) != 0;
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+#endif
+}
+
+#endif
+
+static DiffBlockKernel ChooseDiffBlockKernel()
+{
+#if defined(__x86_64__) || defined(_M_X64)
+  if(CPUSupportsAVX512())
+    return &NextDiffBlockAVX512;
+  if(CPUSupportsAVX2())
+    return &NextDiffBlockAVX2;
+  return &NextDiffBlockSSE2;
+#else
+  return &NextDiffBlockScalar;
+#endif
+}
+
+static uint32_t DiffTrailingZeroes(uint64_t value)
+{
+  uint32_t lo = uint32_t(value & 0xffffffffU);
+  if(lo)
+    return Bits::CountTrailingZeroes(lo);
+  return 32 + Bits::CountTrailingZeroes(uint32_t(value >> 32));
+}
+
+// diff [begin, end) appending {offset, length} ranges with gaps of up to mergeGap merged
+static void DiffRangesSegment(DiffBlockKernel kernel, const byte *a, const byte *b, size_t begin,
+                              size_t end, size_t mergeGap, rdcarray<rdcpair<size_t, size_t>> &ranges)
+{
+  // the range currently being built, which later differences may still extend
+  bool open = false;
+  size_t rangeStart = 0, rangeEnd = 0;
+
+  size_t offs = begin;
+  while(offs < end)
+  {
+    uint64_t mask = 0;
+    offs = kernel(a, b, offs, end, mask);
+
+    // the kernel only handles whole blocks, check any trailing bytes individually
+    bool tail = false;
+    if(mask == 0)
+    {
+      for(size_t i = 0; offs + i < end; i++)
+        if(a[offs + i] != b[offs + i])
+          mask |= 1ULL << i;
+
+      if(mask == 0)
+        break;
+
+      tail = true;
+    }
+
+    // walk each run of differing bytes in the block
+    while(mask)
+    {
+      uint32_t first = DiffTrailingZeroes(mask);
+      uint64_t rest = mask >> first;
+      uint32_t len = (~rest == 0) ? 64 - first : DiffTrailingZeroes(~rest);
+
+      size_t runStart = offs + first;
+      size_t runEnd = runStart + len;
+
+      if(open && runStart - rangeEnd <= mergeGap)
+      {
+        rangeEnd = runEnd;
+      }
+      else
+      {
+        if(open)
+          ranges.push_back({rangeStart, rangeEnd - rangeStart});
+        rangeStart = runStart;
+        rangeEnd = runEnd;
+        open = true;
+      }
+
+      mask = (first + len >= 64) ? 0 : mask & ~((1ULL << (first + len)) - 1);
+    }
+
+    if(tail)
+      break;
+
+    offs += DiffBlockSize;
+  }
+
+  if(open)
+    ranges.push_back({rangeStart, rangeEnd - rangeStart});
+}
+
+// buffers larger than this are split into segments and diffed in parallel.
+static const size_t DiffParallelSegmentSize = 4 * 1024 * 1024;
+
+static void FindDiffRanges(DiffBlockKernel kernel, const byte *a, const byte *b, size_t bufSize,
+                           size_t mergeGap, rdcarray<rdcpair<size_t, size_t>> &ranges)
+{
+  ranges.clear();
+
+  if(bufSize <= DiffParallelSegmentSize)
+  {
+    DiffRangesSegment(kernel, a, b, 0, bufSize, mergeGap, ranges);
+    return;
+  }
+
+  const uint32_t numSegments =
+      uint32_t((bufSize + DiffParallelSegmentSize - 1) / DiffParallelSegmentSize);
+
+  rdcarray<rdcarray<rdcpair<size_t, size_t>>> segmentRanges;
+  segmentRanges.resize(numSegments);
+
+  Threading::JobSystem::ParallelFor(numSegments, [&](uint32_t s) {
+    size_t begin = s * DiffParallelSegmentSize;
+    size_t end = RDCMIN(begin + DiffParallelSegmentSize, bufSize);
+    DiffRangesSegment(kernel, a, b, begin, end, mergeGap, segmentRanges[s]);
+  });
+
+  size_t total = 0;
+  for(const rdcarray<rdcpair<size_t, size_t>> &seg : segmentRanges)
+    total += seg.size();
+
+  ranges.reserve(total);
+
+  // concatenate, merging ranges across segment boundaries the same as within a segment
+  for(const rdcarray<rdcpair<size_t, size_t>> &seg : segmentRanges)
+  {
+    for(const rdcpair<size_t, size_t> &r : seg)
+    {
+      if(!ranges.empty())
+      {
+        rdcpair<size_t, size_t> &prev = ranges.back();
+        if(r.first - (prev.first + prev.second) <= mergeGap)
+        {
+          prev.second = r.first + r.second - prev.first;
+          continue;
+        }
+      }
+
+      ranges.push_back(r);
+    }
+  }
+}
+
+void FindDiffRanges(const void *a, const void *b, size_t bufSize, size_t mergeGap,
+                    rdcarray<rdcpair<size_t, size_t>> &ranges)
+{
+  static DiffBlockKernel kernel = ChooseDiffBlockKernel();
+
+  FindDiffRanges(kernel, (const byte *)a, (const byte *)b, bufSize, mergeGap, ranges);
+}
+
 uint32_t CalcNumMips(int w, int h, int d)
 {
   int mipLevels = 1;
@@ -527,3 +846,216 @@ void rdclog_direct(time_t utcTime, uint32_t pid, LogType type, const char *proje
 
   SAFE_DELETE_ARRAY(oversizedBuffer);
 }
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "common/formatting.h"
+#include "common/timing.h"
+#include "catch/catch.hpp"
+
+static rdcarray<rdcpair<const char *, DiffBlockKernel>> GetSupportedDiffKernels()
+{
+  rdcarray<rdcpair<const char *, DiffBlockKernel>> ret;
+  ret.push_back({"scalar", &NextDiffBlockScalar});
+#if defined(__x86_64__) || defined(_M_X64)
+  ret.push_back({"SSE2", &NextDiffBlockSSE2});
+  if(CPUSupportsAVX2())
+    ret.push_back({"AVX2", &NextDiffBlockAVX2});
+  if(CPUSupportsAVX512())
+    ret.push_back({"AVX-512", &NextDiffBlockAVX512});
+#endif
+  return ret;
+}
+
+// straightforward byte-at-a-time version to check against
+static rdcarray<rdcpair<size_t, size_t>> ReferenceDiffRanges(const byte *a, const byte *b,
+                                                             size_t bufSize, size_t mergeGap)
+{
+  rdcarray<rdcpair<size_t, size_t>> ret;
+  for(size_t i = 0; i < bufSize; i++)
+  {
+    if(a[i] == b[i])
+      continue;
+
+    if(!ret.empty() && i - (ret.back().first + ret.back().second) <= mergeGap)
+      ret.back().second = i + 1 - ret.back().first;
+    else
+      ret.push_back({i, 1});
+  }
+  return ret;
+}
+
+TEST_CASE("Test finding multiple diff ranges", "[diff]")
+{
+  const size_t size = 16 * 1024;
+
+  // allocate with some slack so we can test unaligned pointers
+  bytebuf a, b;
+  a.resize(size + 64);
+  b.resize(size + 64);
+
+  for(size_t i = 0; i < a.size(); i++)
+    a[i] = byte(i * 7);
+
+  rdcarray<rdcpair<size_t, size_t>> ranges, expected;
+
+  for(const rdcpair<const char *, DiffBlockKernel> &k : GetSupportedDiffKernels())
+  {
+    INFO("Kernel " << k.first);
+
+    // identical data has no ranges
+    {
+      b = a;
+      FindDiffRanges(k.second, a.data(), b.data(), size, 0, ranges);
+      CHECK(ranges.empty());
+
+      FindDiffRanges(k.second, a.data(), b.data(), 0, 0, ranges);
+      CHECK(ranges.empty());
+    }
+
+    // ranges are byte accurate at any alignment and size
+    {
+      for(size_t offs : {0, 1, 3, 16, 33})
+      {
+        for(size_t len : {size, size - 1, size_t(63), size_t(65), size_t(1)})
+        {
+          b = a;
+
+          // the first and last byte, a run across a block boundary, and some isolated bytes
+          b[offs]++;
+          b[offs + len - 1]++;
+          for(size_t i = 60; i < 70 && i < len; i++)
+            b[offs + i]++;
+          for(size_t i = 200; i < len; i += 257)
+            b[offs + i]++;
+
+          for(size_t gap : {size_t(0), size_t(1), size_t(63), size_t(64), size_t(1000), ~size_t(0)})
+          {
+            INFO("offset " << offs << " length " << len << " gap " << gap);
+
+            FindDiffRanges(k.second, a.data() + offs, b.data() + offs, len, gap, ranges);
+            expected = ReferenceDiffRanges(a.data() + offs, b.data() + offs, len, gap);
+
+            CHECK(ranges.size() == expected.size());
+            bool same = (ranges == expected);
+            CHECK(same);
+          }
+        }
+      }
+    }
+
+    // fully changed data is one range
+    {
+      for(size_t i = 0; i < b.size(); i++)
+        b[i] = a[i] ^ 0x80;
+
+      FindDiffRanges(k.second, a.data(), b.data(), size, 0, ranges);
+      REQUIRE(ranges.size() == 1);
+      CHECK(ranges[0].first == 0);
+      CHECK(ranges[0].second == size);
+    }
+  }
+}
+
+TEST_CASE("Test finding diff ranges in parallel", "[diff]")
+{
+  const size_t size = DiffParallelSegmentSize * 3 + 100;
+
+  bytebuf a, b;
+  a.resize(size);
+  for(size_t i = 0; i < a.size(); i++)
+    a[i] = byte(i * 13);
+  b = a;
+
+  // runs crossing the segment boundaries, and runs either side of them
+  for(size_t i = DiffParallelSegmentSize - 8; i < DiffParallelSegmentSize + 8; i++)
+    b[i]++;
+  b[DiffParallelSegmentSize * 2 - 20]++;
+  b[DiffParallelSegmentSize * 2 + 20]++;
+  b[DiffParallelSegmentSize * 3 - 1]++;
+  b[DiffParallelSegmentSize * 3]++;
+  b[size - 1]++;
+
+  rdcarray<rdcpair<size_t, size_t>> ranges, expected;
+
+  for(size_t gap : {size_t(0), size_t(39), size_t(40), ~size_t(0)})
+  {
+    INFO("gap " << gap);
+
+    FindDiffRanges(a.data(), b.data(), size, gap, ranges);
+    expected = ReferenceDiffRanges(a.data(), b.data(), size, gap);
+
+    CHECK(ranges.size() == expected.size());
+    bool same = (ranges == expected);
+    CHECK(same);
+  }
+
+  // with an unlimited gap the single range matches FindDiffRange
+  size_t diffStart = 0, diffEnd = 0;
+  CHECK(FindDiffRange(a.data(), b.data(), size, diffStart, diffEnd));
+  FindDiffRanges(a.data(), b.data(), size, ~size_t(0), ranges);
+  REQUIRE(ranges.size() == 1);
+  CHECK(ranges[0].first == diffStart);
+  CHECK(ranges[0].first + ranges[0].second == diffEnd);
+}
+
+TEST_CASE("Benchmark finding diff ranges", "[.][benchmark][diff]")
+{
+  const size_t size = 128 * 1024 * 1024;
+
+  bytebuf ref, data;
+  ref.resize(size);
+  for(size_t i = 0; i < size; i += sizeof(uint32_t))
+  {
+    uint32_t val = uint32_t(i * 2654435761U);
+    memcpy(ref.data() + i, &val, sizeof(val));
+  }
+
+  struct Pattern
+  {
+    const char *name;
+    size_t stride;
+    size_t width;
+  };
+
+  // sparse: a few bytes in every 64kB, as when patching a handful of constants in a big map.
+  // strided: one 16 byte attribute of every 64 byte vertex. dense: everything rewritten
+  for(Pattern p : {Pattern{"sparse", 64 * 1024, 4}, Pattern{"strided", 64, 16}, Pattern{"dense", 1, 1}})
+  {
+    data = ref;
+    for(size_t i = 0; i < size; i += p.stride)
+      for(size_t w = 0; w < p.width; w++)
+        data[i + w]++;
+
+    rdcarray<rdcpair<size_t, size_t>> ranges;
+
+    for(const rdcpair<const char *, DiffBlockKernel> &k : GetSupportedDiffKernels())
+    {
+      PerformanceTimer timer;
+      FindDiffRanges(k.second, data.data(), ref.data(), size, MapDiffMergeGap, ranges);
+      double ms = timer.GetMilliseconds();
+
+      size_t rangeBytes = 0;
+      for(const rdcpair<size_t, size_t> &r : ranges)
+        rangeBytes += r.second;
+
+      WARN(StringFormat::Fmt("%s %s: %llu MB/s, %llu ranges covering %llu MB", p.name, k.first,
+                             uint64_t(double(size) / (1024 * 1024) / (ms / 1000.0)),
+                             (uint64_t)ranges.size(), uint64_t(rangeBytes / (1024 * 1024)))
+               .c_str());
+    }
+
+    // the single range search, for comparison
+    PerformanceTimer timer;
+    size_t diffStart = 0, diffEnd = 0;
+    FindDiffRange(data.data(), ref.data(), size, diffStart, diffEnd);
+    double ms = timer.GetMilliseconds();
+
+    WARN(StringFormat::Fmt("%s FindDiffRange: %llu MB/s, one range covering %llu MB", p.name,
+                           uint64_t(double(size) / (1024 * 1024) / (ms / 1000.0)),
+                           uint64_t((diffEnd - diffStart) / (1024 * 1024)))
+             .c_str());
+  }
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
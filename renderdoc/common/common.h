@@ -297,7 +297,22 @@ inline T AlignUpPtr(T x, A a)
 #define MAKE_FOURCC(a, b, c, d) \
   (((uint32_t)(d) << 24) | ((uint32_t)(c) << 16) | ((uint32_t)(b) << 8) | (uint32_t)(a))
 
+template <typename T>
+struct rdcarray;
+template <typename A, typename B>
+struct rdcpair;
+
 bool FindDiffRange(void *a, void *b, size_t bufSize, size_t &diffStart, size_t &diffEnd);
+
+// finds every range of bytes that differ between a and b, as {offset, length} pairs in ascending
+// order. Ranges separated by no more than mergeGap identical bytes are merged together, so a larger
+// gap gives fewer but larger ranges. Unlike FindDiffRange there are no alignment requirements.
+void FindDiffRanges(const void *a, const void *b, size_t bufSize, size_t mergeGap,
+                    rdcarray<rdcpair<size_t, size_t>> &ranges);
+
+// the merge gap used when diffing mapped memory while capturing. Each range is serialised as its own
+// chunk, so small gaps are cheaper to serialise than to split around.
+static const size_t MapDiffMergeGap = 1024;
 uint32_t CalcNumMips(int Width, int Height, int Depth);
 
 typedef uint8_t byte;
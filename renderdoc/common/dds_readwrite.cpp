@@ -27,6 +27,7 @@
 #include "common/common.h"
 #include "common/formatting.h"
 #include "common/result.h"
+#include "common/threading.h"
 #include "os/os_specific.h"
 #include "serialise/streamio.h"
 
@@ -903,50 +904,74 @@ RDResult write_dds_to_file(FILE *f, const write_dds_data &data)
     header.ddspf.dwFourCC = MAKE_FOURCC('D', 'X', '1', '0');
   }
 
-  {
-    FileIO::fwrite(&magic, sizeof(magic), 1, f);
-    FileIO::fwrite(&header, sizeof(header), 1, f);
-    if(dx10Header)
-      FileIO::fwrite(&headerDXT10, sizeof(headerDXT10), 1, f);
+  FileIO::fwrite(&magic, sizeof(magic), 1, f);
+  FileIO::fwrite(&header, sizeof(header), 1, f);
+  if(dx10Header)
+    FileIO::fwrite(&headerDXT10, sizeof(headerDXT10), 1, f);
+
+  const uint64_t dataStart = FileIO::ftell64(f);
+
+  // calculate where each subresource goes up front. Each depth slice is a separate subresource in
+  // the incoming data, but they're tightly packed rows of the same pitch as we write.
+  rdcarray<rdcpair<uint64_t, uint64_t>> subresources;
+  uint64_t dataSize = 0;
 
-    int i = 0;
-    for(uint32_t slice = 0; slice < RDCMAX(1U, data.slices); slice++)
+  for(uint32_t slice = 0; slice < RDCMAX(1U, data.slices); slice++)
+  {
+    for(uint32_t mip = 0; mip < RDCMAX(1U, data.mips); mip++)
     {
-      for(uint32_t mip = 0; mip < RDCMAX(1U, data.mips); mip++)
+      uint32_t numdepths = RDCMAX(1U, data.depth >> mip);
+      for(uint32_t d = 0; d < numdepths; d++)
       {
-        uint32_t numdepths = RDCMAX(1U, data.depth >> mip);
-        for(uint32_t d = 0; d < numdepths; d++)
+        uint32_t rowlen = RDCMAX(1U, data.width >> mip);
+        uint32_t numRows = RDCMAX(1U, data.height >> mip);
+        uint32_t pitch = RDCMAX(1U, rowlen * bytesPerPixel);
+
+        // pitch/rows are in blocks, not pixels, for block formats.
+        if(blockFormat)
         {
-          byte *bytedata = data.subresources[i];
+          numRows = RDCMAX(1U, (numRows + 3) / 4);
 
-          uint32_t rowlen = RDCMAX(1U, data.width >> mip);
-          uint32_t numRows = RDCMAX(1U, data.height >> mip);
-          uint32_t pitch = RDCMAX(1U, rowlen * bytesPerPixel);
+          uint32_t blockSize = (data.format.type == ResourceFormatType::BC1 ||
+                                data.format.type == ResourceFormatType::BC4)
+                                   ? 8
+                                   : 16;
 
-          // pitch/rows are in blocks, not pixels, for block formats.
-          if(blockFormat)
-          {
-            numRows = RDCMAX(1U, (numRows + 3) / 4);
+          pitch = RDCMAX(blockSize, (((rowlen + 3) / 4)) * blockSize);
+        }
 
-            uint32_t blockSize = (data.format.type == ResourceFormatType::BC1 ||
-                                  data.format.type == ResourceFormatType::BC4)
-                                     ? 8
-                                     : 16;
+        subresources.push_back({dataStart + dataSize, uint64_t(numRows) * pitch});
+        dataSize += uint64_t(numRows) * pitch;
+      }
+    }
+  }
 
-            pitch = RDCMAX(blockSize, (((rowlen + 3) / 4)) * blockSize);
-          }
+  if(subresources.size() > data.subresources.size())
+  {
+    RETURN_ERROR_RESULT(ResultCode::InvalidParameter,
+                        "Writing DDS file needs %zu subresources but only %zu were provided",
+                        subresources.size(), data.subresources.size());
+  }
 
-          for(uint32_t row = 0; row < numRows; row++)
-          {
-            FileIO::fwrite(bytedata, 1, pitch, f);
+  // make sure the headers are on disk before writing around them, and size the file once
+  FileIO::fflush(f);
+  FileIO::ftruncateat(f, dataStart + dataSize);
 
-            bytedata += pitch;
-          }
+  // then write each subresource to its place in the file in parallel
+  int32_t writeFailed = 0;
 
-          i++;
-        }
-      }
-    }
+  Threading::JobSystem::ParallelFor((uint32_t)subresources.size(), [&](uint32_t i) {
+    if(!FileIO::fpwrite(f, data.subresources[i], (size_t)subresources[i].second,
+                        subresources[i].first))
+      Atomic::Inc32(&writeFailed);
+  });
+
+  FileIO::fseek64(f, dataStart + dataSize, SEEK_SET);
+
+  if(writeFailed)
+  {
+    RETURN_ERROR_RESULT(ResultCode::FileIOFailed, "Failed to write %d subresources to DDS file: %s",
+                        writeFailed, FileIO::ErrorString().c_str());
   }
 
   return RDResult();
@@ -961,7 +986,22 @@ bool is_dds_file(byte *headerBuffer, size_t size)
   return memcmp(headerBuffer, &dds_fourcc, 4) == 0;
 }
 
-RDResult load_dds_from_file(StreamReader *reader, read_dds_data &ret)
+static void SwapDDSRedBlue(byte *data, size_t size, uint32_t bytesPerPixel)
+{
+  // rows are tightly packed so we can walk the whole subresource as one run of pixels
+  if(bytesPerPixel >= 3)
+  {
+    for(size_t p = 0; p + bytesPerPixel <= size; p += bytesPerPixel)
+      std::swap(data[p + 0], data[p + 2]);
+  }
+  else
+  {
+    for(size_t p = 0; p + bytesPerPixel <= size; p += bytesPerPixel)
+      std::swap(data[p + 0], data[p + 1]);
+  }
+}
+
+static RDResult load_dds(StreamReader *reader, read_dds_data &ret, bool layoutOnly)
 {
   uint64_t fileSize = reader->GetSize();
 
@@ -1001,6 +1041,8 @@ RDResult load_dds_from_file(StreamReader *reader, read_dds_data &ret)
 
   uint32_t cubeFlags = DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_ALLFACES;
 
+  ret.cubemap = false;
+
   if((header.dwCaps2 & cubeFlags) == cubeFlags && header.dwCaps & DDSCAPS_COMPLEX)
     ret.cubemap = true;
 
@@ -1215,30 +1257,14 @@ RDResult load_dds_from_file(StreamReader *reader, read_dds_data &ret)
                         ret.slices, ret.mips, fileSize);
   }
 
-  // we reserve space for a full mip-chain (twice the size of the top mip) just to be conservative
-  {
-    uint32_t rowlen = AlignUp(ret.width, subsamplePacking);
-    uint32_t numRows = ret.height;
-    uint32_t pitch = RDCMAX(1U, rowlen * bytesPerPixel);
-
-    // pitch/rows are in blocks, not pixels, for block formats.
-    if(blockFormat)
-    {
-      numRows = RDCMAX(1U, (numRows + 3) / 4);
-
-      uint32_t blockSize =
-          (ret.format.type == ResourceFormatType::BC1 || ret.format.type == ResourceFormatType::BC4)
-              ? 8
-              : 16;
+  // calculate where each subresource is up front. They're tightly packed in the file in the same
+  // layout as we return them, so the offsets within the file data and the buffer are the same.
+  const uint64_t dataStart = reader->GetOffset();
+  uint64_t dataSize = 0;
 
-      pitch = RDCMAX(blockSize, (((rowlen + 3) / 4)) * blockSize);
-    }
-
-    ret.buffer.reserve(ret.slices * 2 * ret.depth * numRows * pitch);
-  }
+  ret.subresources.clear();
   ret.subresources.reserve(ret.slices * ret.mips);
 
-  int i = 0;
   for(uint32_t slice = 0; slice < ret.slices; slice++)
   {
     for(uint32_t mip = 0; mip < ret.mips; mip++)
@@ -1262,50 +1288,196 @@ RDResult load_dds_from_file(StreamReader *reader, read_dds_data &ret)
         pitch = RDCMAX(blockSize, (((rowlen + 3) / 4)) * blockSize);
       }
 
-      size_t subOffs = ret.buffer.size();
-      size_t subSize = numdepths * numRows * pitch;
+      uint64_t subSize = uint64_t(numdepths) * numRows * pitch;
 
-      ret.subresources.push_back({subOffs, subSize});
+      if(dataStart + dataSize + subSize > fileSize)
+      {
+        RETURN_ERROR_RESULT(ResultCode::ImageUnsupported,
+                            "DDS file of size %llu is truncated, subresource %d needs %llu bytes",
+                            fileSize, ret.subresources.count(), dataStart + dataSize + subSize);
+      }
 
-      ret.buffer.resize(ret.buffer.size() + subSize);
+      ret.subresources.push_back({(size_t)dataSize, (size_t)subSize});
+      dataSize += subSize;
+    }
+  }
 
-      byte *bytedata = ret.buffer.data() + subOffs;
+  // if the contents can be used as-is, just return where each subresource is in the file
+  if(layoutOnly && !bgrSwap)
+  {
+    ret.buffer.clear();
 
-      for(uint32_t d = 0; d < numdepths; d++)
-      {
-        for(uint32_t row = 0; row < numRows; row++)
-        {
-          reader->Read(bytedata, pitch);
+    for(rdcpair<size_t, size_t> &sub : ret.subresources)
+      sub.first += (size_t)dataStart;
 
-          if(bgrSwap)
-          {
-            byte *rgba = bytedata;
-
-            if(bytesPerPixel >= 3)
-            {
-              for(uint32_t p = 0; p < rowlen; p++)
-              {
-                std::swap(rgba[0], rgba[2]);
-                rgba += bytesPerPixel;
-              }
-            }
-            else
-            {
-              for(uint32_t p = 0; p < rowlen; p++)
-              {
-                std::swap(rgba[0], rgba[1]);
-                rgba += bytesPerPixel;
-              }
-            }
-          }
+    reader->SkipBytes(dataSize);
 
-          bytedata += pitch;
-        }
-      }
+    return RDResult();
+  }
+
+  ret.buffer.resize((size_t)dataSize);
+
+  // read each subresource in parallel where the reader supports it, and do any conversion on the
+  // worker thread while the data is still in cache. If any read fails, fall back to one serial read
+  // which will set the reader's error state if it fails too.
+  int32_t readFailed = 0;
+
+  Threading::JobSystem::ParallelFor((uint32_t)ret.subresources.size(), [&](uint32_t i) {
+    const rdcpair<size_t, size_t> &sub = ret.subresources[i];
+    byte *bytedata = ret.buffer.data() + sub.first;
+
+    if(!reader->ReadAt(dataStart + sub.first, bytedata, sub.second))
+    {
+      Atomic::Inc32(&readFailed);
+      return;
+    }
 
-      i++;
+    if(bgrSwap)
+      SwapDDSRedBlue(bytedata, sub.second, bytesPerPixel);
+  });
+
+  if(readFailed)
+  {
+    if(!reader->Read(ret.buffer.data(), dataSize))
+      return reader->GetError();
+
+    if(bgrSwap)
+    {
+      Threading::JobSystem::ParallelFor((uint32_t)ret.subresources.size(), [&](uint32_t i) {
+        const rdcpair<size_t, size_t> &sub = ret.subresources[i];
+        SwapDDSRedBlue(ret.buffer.data() + sub.first, sub.second, bytesPerPixel);
+      });
     }
   }
+  else
+  {
+    // seek absolutely rather than skipping, so the position doesn't depend on anything the
+    // parallel reads did underneath the reader
+    reader->SetOffset(dataStart + dataSize);
+  }
 
   return RDResult();
 }
+
+RDResult load_dds_from_file(StreamReader *reader, read_dds_data &ret)
+{
+  return load_dds(reader, ret, false);
+}
+
+RDResult load_dds_layout_from_file(StreamReader *reader, read_dds_data &ret)
+{
+  return load_dds(reader, ret, true);
+}
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+
+TEST_CASE("Check DDS layout loading matches full loading", "[dds]")
+{
+  rdcstr filename = FileIO::GetTempFolderFilename() + "/dds_layout_test.dds";
+
+  for(ResourceFormatType type : {ResourceFormatType::Regular, ResourceFormatType::BC3})
+  {
+    write_dds_data write = {};
+    write.width = 37;
+    write.height = 21;
+    write.depth = 1;
+    write.mips = 4;
+    write.slices = 3;
+    write.cubemap = false;
+    write.format.type = type;
+    write.format.compType = CompType::UNorm;
+    write.format.compCount = 4;
+    write.format.compByteWidth = 1;
+
+    // write each subresource with distinct contents, oversized to fit any mip
+    rdcarray<bytebuf> contents;
+    contents.resize(write.slices * write.mips);
+    for(size_t i = 0; i < contents.size(); i++)
+    {
+      contents[i].resize(write.width * write.height * 4);
+      for(size_t b = 0; b < contents[i].size(); b++)
+        contents[i][b] = byte(i * 31 + b * 7);
+      write.subresources.push_back(contents[i].data());
+    }
+
+    FILE *f = FileIO::fopen(filename, FileIO::WriteBinary);
+    REQUIRE(f);
+    RDResult res = write_dds_to_file(f, write);
+    FileIO::fclose(f);
+    REQUIRE(res.code == ResultCode::Succeeded);
+
+    bytebuf file;
+    FileIO::ReadAll(filename, file);
+
+    read_dds_data full, layout;
+
+    {
+      StreamReader reader(file);
+      REQUIRE(load_dds_from_file(&reader, full).code == ResultCode::Succeeded);
+      CHECK(reader.GetOffset() == file.size());
+    }
+
+    {
+      StreamReader reader(file);
+      REQUIRE(load_dds_layout_from_file(&reader, layout).code == ResultCode::Succeeded);
+      CHECK(reader.GetOffset() == file.size());
+    }
+
+    // reading from a file goes through positional reads instead of memory copies. Anything after
+    // the DDS data must still be read from the right place afterwards
+    {
+      const uint64_t trailer = 0x0123456789abcdefULL;
+
+      bytebuf withTrailer = file;
+      withTrailer.append((const byte *)&trailer, sizeof(trailer));
+      REQUIRE(FileIO::WriteAll(filename, withTrailer));
+
+      f = FileIO::fopen(filename, FileIO::ReadBinary);
+      REQUIRE(f);
+      StreamReader reader(f, withTrailer.size(), Ownership::Stream);
+      read_dds_data fromFile;
+      REQUIRE(load_dds_from_file(&reader, fromFile).code == ResultCode::Succeeded);
+      CHECK(reader.GetOffset() == file.size());
+      bool sameLayout = (fromFile.subresources == full.subresources);
+      CHECK(sameLayout);
+      CHECK(fromFile.buffer == full.buffer);
+
+      uint64_t readTrailer = 0;
+      reader.Read(readTrailer);
+      CHECK(readTrailer == trailer);
+      CHECK_FALSE(reader.IsErrored());
+    }
+
+    CHECK(layout.buffer.empty());
+    CHECK(layout.width == full.width);
+    CHECK(layout.height == full.height);
+    CHECK(layout.mips == full.mips);
+    CHECK(layout.slices == full.slices);
+    CHECK(layout.format.Name() == full.format.Name());
+    REQUIRE(layout.subresources.size() == full.subresources.size());
+
+    for(size_t i = 0; i < full.subresources.size(); i++)
+    {
+      REQUIRE(layout.subresources[i].second == full.subresources[i].second);
+      REQUIRE(layout.subresources[i].first + layout.subresources[i].second <= file.size());
+
+      CHECK(memcmp(file.data() + layout.subresources[i].first,
+                   full.buffer.data() + full.subresources[i].first, full.subresources[i].second) == 0);
+      CHECK(memcmp(contents[i].data(), full.buffer.data() + full.subresources[i].first,
+                   full.subresources[i].second) == 0);
+    }
+
+    // a truncated file fails instead of returning offsets past the end
+    {
+      StreamReader reader(file.data(), file.size() - 1);
+      read_dds_data truncated;
+      CHECK(load_dds_layout_from_file(&reader, truncated).code != ResultCode::Succeeded);
+    }
+  }
+
+  FileIO::Delete(filename);
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
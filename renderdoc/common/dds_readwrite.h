@@ -57,4 +57,8 @@ struct write_dds_data : public dds_data
 
 extern bool is_dds_file(byte *headerBuffer, size_t size);
 extern RDResult load_dds_from_file(StreamReader *reader, read_dds_data &data);
+// as load_dds_from_file, but if the file contents can be used as-is then only the headers are read.
+// buffer is left empty and the subresources are {offset, size} pairs into the file itself, e.g. for
+// use with a memory mapping so that subresources are only paged in when they're needed.
+extern RDResult load_dds_layout_from_file(StreamReader *reader, read_dds_data &data);
 extern RDResult write_dds_to_file(FILE *f, const write_dds_data &data);
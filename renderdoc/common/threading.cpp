@@ -0,0 +1,253 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019-2022 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "threading.h"
+
+namespace Threading
+{
+namespace JobSystem
+{
+struct Job
+{
+  std::function<void()> callback;
+  Semaphore *complete = NULL;
+};
+
+// keep the number of workers sane on very wide machines, past this point we're more likely to be
+// bound by memory bandwidth or I/O than by CPU.
+static const uint32_t MaxWorkers = 64;
+
+// the job system is shut down from RenderDoc's destructor, which can run after this file's
+// statics have been destroyed depending on initialisation order. To avoid that the state is
+// allocated on first use and deliberately never freed.
+struct JobSystemState
+{
+  CriticalSection jobLock;
+  rdcarray<Job *> pendingJobs;
+  rdcarray<ThreadHandle> workerThreads;
+  Semaphore *workerWake = NULL;
+  bool initialised = false;
+  bool shutdown = false;
+};
+
+static JobSystemState &GetState()
+{
+  static JobSystemState *state = new JobSystemState;
+  return *state;
+}
+
+static void RunJob(Job *job)
+{
+  job->callback();
+  job->callback = std::function<void()>();
+}
+
+static void WorkerThread()
+{
+  JobSystemState &st = GetState();
+
+  SetCurrentThreadName("RenderDoc Job Worker");
+
+  for(;;)
+  {
+    st.workerWake->WaitForWake();
+
+    Job *job = NULL;
+    {
+      SCOPED_LOCK(st.jobLock);
+
+      if(st.pendingJobs.empty())
+      {
+        // woken with nothing to do - either the job was stolen by SyncJob, or we're shutting down
+        if(st.shutdown)
+          return;
+        continue;
+      }
+
+      job = st.pendingJobs[0];
+      st.pendingJobs.erase(0);
+    }
+
+    RunJob(job);
+    job->complete->Wake(1);
+  }
+}
+
+// must be called with the job lock held. Returns false if we're not able to run jobs on workers
+static bool EnsureWorkers()
+{
+  JobSystemState &st = GetState();
+
+  if(st.shutdown)
+    return false;
+
+  if(st.initialised)
+    return !st.workerThreads.empty();
+
+  st.initialised = true;
+
+  uint32_t numWorkers = RDCCLAMP(GetCPUCount(), 2U, MaxWorkers + 1) - 1;
+
+  st.workerWake = Semaphore::Create();
+
+  for(uint32_t i = 0; i < numWorkers; i++)
+  {
+    ThreadHandle thread = CreateThread(&WorkerThread);
+    if(thread)
+      st.workerThreads.push_back(thread);
+  }
+
+  return !st.workerThreads.empty();
+}
+
+Job *AddJob(std::function<void()> callback)
+{
+  JobSystemState &st = GetState();
+
+  Job *job = new Job;
+  job->callback = callback;
+
+  {
+    SCOPED_LOCK(st.jobLock);
+
+    if(EnsureWorkers())
+    {
+      job->complete = Semaphore::Create();
+      st.pendingJobs.push_back(job);
+      st.workerWake->Wake(1);
+      return job;
+    }
+  }
+
+  // no workers available, run the job immediately
+  RunJob(job);
+  return job;
+}
+
+void SyncJob(Job *job)
+{
+  JobSystemState &st = GetState();
+
+  if(!job)
+    return;
+
+  // jobs that ran inline have no semaphore and are already complete
+  if(job->complete)
+  {
+    bool stolen = false;
+
+    {
+      SCOPED_LOCK(st.jobLock);
+
+      int32_t idx = st.pendingJobs.indexOf(job);
+      if(idx >= 0)
+      {
+        st.pendingJobs.erase(idx);
+        stolen = true;
+      }
+    }
+
+    // if nothing has picked up the job yet, run it here rather than waiting for a worker
+    if(stolen)
+      RunJob(job);
+    else
+      job->complete->WaitForWake();
+
+    job->complete->Destroy();
+  }
+
+  delete job;
+}
+
+void ParallelFor(uint32_t count, std::function<void(uint32_t)> callback)
+{
+  if(count == 0)
+    return;
+
+  int32_t next = 0;
+
+  auto loop = [&next, count, &callback]() {
+    for(;;)
+    {
+      uint32_t i = (uint32_t)Atomic::Inc32(&next) - 1;
+      if(i >= count)
+        break;
+      callback(i);
+    }
+  };
+
+  if(count == 1)
+  {
+    loop();
+    return;
+  }
+
+  rdcarray<Job *> jobs;
+  jobs.resize(RDCMIN(count - 1, GetWorkerCount()));
+
+  for(Job *&job : jobs)
+    job = AddJob(loop);
+
+  loop();
+
+  for(Job *job : jobs)
+    SyncJob(job);
+}
+
+uint32_t GetWorkerCount()
+{
+  JobSystemState &st = GetState();
+
+  SCOPED_LOCK(st.jobLock);
+  EnsureWorkers();
+  return (uint32_t)st.workerThreads.size();
+}
+
+void Shutdown()
+{
+  JobSystemState &st = GetState();
+
+  rdcarray<ThreadHandle> threads;
+
+  {
+    SCOPED_LOCK(st.jobLock);
+    st.shutdown = true;
+    threads.swap(st.workerThreads);
+
+    if(st.workerWake)
+      st.workerWake->Wake((uint32_t)threads.size());
+  }
+
+  for(ThreadHandle t : threads)
+  {
+    JoinThread(t);
+    CloseThread(t);
+  }
+
+  if(st.workerWake)
+    st.workerWake->Destroy();
+  st.workerWake = NULL;
+}
+};
+};
@@ -110,6 +110,33 @@ public:
 private:
   SpinLock *m_Spin = NULL;
 };
+
+// A simple global pool of worker threads for splitting up CPU-heavy work like compression. The
+// worker threads are created the first time a job is added, so processes which never use it don't
+// pay for idle threads.
+namespace JobSystem
+{
+struct Job;
+
+// queue a job to be run on a worker thread. Every job returned must be passed to SyncJob exactly
+// once, which waits for it to complete and frees it.
+Job *AddJob(std::function<void()> callback);
+
+// wait for a job to complete. If it hasn't started yet it is run on the calling thread instead, so
+// it's safe to sync a job from within another job.
+void SyncJob(Job *job);
+
+// run callback(i) for each i in [0, count) across the worker threads as well as the calling thread.
+// Returns once every iteration has completed.
+void ParallelFor(uint32_t count, std::function<void(uint32_t)> callback);
+
+// the number of worker threads that jobs may run on (not including any thread syncing jobs).
+uint32_t GetWorkerCount();
+
+// shut down and join the worker threads. Any jobs added after this point run immediately on the
+// calling thread.
+void Shutdown();
+};
 };
 
 #define SCOPED_LOCK(cs) Threading::ScopedLock CONCAT(scopedlock, __LINE__)(&cs);
@@ -71,4 +71,36 @@ TEST_CASE("Test spin lock", "[threading]")
   CHECK(finalValue == value);
 }
 
+TEST_CASE("Test job system", "[threading]")
+{
+  SECTION("Jobs all run and can be synced out of order")
+  {
+    int32_t results[64] = {};
+
+    rdcarray<Threading::JobSystem::Job *> jobs;
+    for(int32_t i = 0; i < 64; i++)
+      jobs.push_back(Threading::JobSystem::AddJob([&results, i]() { results[i] = i * 3; }));
+
+    for(size_t i = 0; i < jobs.size(); i++)
+      Threading::JobSystem::SyncJob(jobs[jobs.size() - 1 - i]);
+
+    for(int32_t i = 0; i < 64; i++)
+      CHECK(results[i] == i * 3);
+  };
+
+  SECTION("Parallel for covers every index once, including when nested")
+  {
+    rdcarray<int32_t> counts;
+    counts.resize(1000);
+
+    Threading::JobSystem::ParallelFor(10, [&counts](uint32_t outer) {
+      Threading::JobSystem::ParallelFor(
+          100, [&counts, outer](uint32_t inner) { Atomic::Inc32(&counts[outer * 100 + inner]); });
+    });
+
+    for(int32_t c : counts)
+      CHECK(c == 1);
+  };
+}
+
 #endif    // ENABLED(ENABLE_UNIT_TESTS)
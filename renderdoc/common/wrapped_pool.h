@@ -39,49 +39,64 @@ public:
 };
 
 // allocate each class in its own pool so we can identify the type by the pointer
+//
+// Allocation, deallocation and IsAlloc are all lock-free. Each pool keeps a lock-free stack of free
+// items, and additional pools are only ever appended to a fixed directory so it can be walked
+// without locking. The lock is only taken to add a new pool when all existing pools are full.
 template <typename WrapType, bool DebugClear = true>
 class WrappingPool
 {
 public:
   void *Allocate()
   {
-    SCOPED_LOCK(m_Lock);
-
     // try and allocate from immediate pool
     void *ret = m_ImmediatePool.Allocate();
     if(ret != NULL)
       return ret;
 
-    // fall back to additional pools, if there are any
-    for(size_t i = 0; i < m_AdditionalPools.size(); i++)
+    size_t i = 0;
+
+    for(;;)
     {
-      ret = m_AdditionalPools[i]->Allocate();
-      if(ret != NULL)
-        return ret;
-    }
+      // fall back to additional pools, if there are any
+      for(; i < MaxAdditionalPools && m_AdditionalPools[i]; i++)
+      {
+        ret = m_AdditionalPools[i]->Allocate();
+        if(ret != NULL)
+          return ret;
+      }
+
+      if(i == MaxAdditionalPools)
+      {
+        RDCFATAL("Wrapped pool for %zu-byte objects exhausted", sizeof(WrapType));
+        return NULL;
+      }
+
+      // allocate a new additional pool and use that to allocate from. If another thread added a
+      // pool while we were waiting on the lock we'll try that one first
+      SCOPED_LOCK(m_Lock);
+
+      if(m_AdditionalPools[i] == NULL)
+      {
+        ItemPool *pool = new ItemPool(i + 1);
+        ret = pool->Allocate();
 
-    // allocate a new additional pool and use that to allocate from
-    m_AdditionalPools.push_back(new ItemPool(m_AdditionalPools.size() + 1));
+        // the pool must be fully constructed before it's visible to other threads
+        Atomic::CmpExchPtr((void **)&m_AdditionalPools[i], NULL, pool);
 
-    return m_AdditionalPools.back()->Allocate();
+        return ret;
+      }
+    }
   }
 
   bool IsAlloc(const void *p)
   {
-    // we can check the immediate pool without locking
     if(m_ImmediatePool.IsAlloc(p))
       return true;
 
-    // if we have additional pools, lock and check them.
-    // TODO: Check for additional pools in a lock-free manner,
-    // to prevent the cost of locking if there are no more pools.
-    {
-      SCOPED_LOCK(m_Lock);
-
-      for(size_t i = 0; i < m_AdditionalPools.size(); i++)
-        if(m_AdditionalPools[i]->IsAlloc(p))
-          return true;
-    }
+    for(size_t i = 0; i < MaxAdditionalPools && m_AdditionalPools[i]; i++)
+      if(m_AdditionalPools[i]->IsAlloc(p))
+        return true;
 
     return false;
   }
@@ -91,24 +106,20 @@ public:
     if(p == NULL)
       return;
 
-    SCOPED_LOCK(m_Lock);
-
     // try immediate pool
     if(m_ImmediatePool.IsAlloc(p))
     {
       m_ImmediatePool.Deallocate(p);
       return;
     }
-    else if(!m_AdditionalPools.empty())
+
+    // fall back and try additional pools
+    for(size_t i = 0; i < MaxAdditionalPools && m_AdditionalPools[i]; i++)
     {
-      // fall back and try additional pools
-      for(size_t i = 0; i < m_AdditionalPools.size(); i++)
+      if(m_AdditionalPools[i]->IsAlloc(p))
       {
-        if(m_AdditionalPools[i]->IsAlloc(p))
-        {
-          m_AdditionalPools[i]->Deallocate(p);
-          return;
-        }
+        m_AdditionalPools[i]->Deallocate(p);
+        return;
       }
     }
 
@@ -122,12 +133,14 @@ private:
   WrappingPool() : m_ImmediatePool(0) {}
   ~WrappingPool()
   {
-    for(size_t i = 0; i < m_AdditionalPools.size(); i++)
+    for(size_t i = 0; i < MaxAdditionalPools; i++)
+    {
       delete m_AdditionalPools[i];
-
-    m_AdditionalPools.clear();
+      m_AdditionalPools[i] = NULL;
+    }
   }
 
+  // only used when adding a new additional pool
   Threading::CriticalSection m_Lock;
 
   struct ItemPool
@@ -158,58 +171,90 @@ private:
       count = size / itemSize;
 
       items = (WrapType *)(new uint8_t[count * itemSize]);
-      freeStack = new int[count];
-      for(int i = 0; i < (int)count; ++i)
-      {
-        freeStack[i] = i;
-      }
-      freeStackHead = count;
+
+      // initially every item is free, linked in order
+      nextFree = new uint32_t[count];
+      for(uint32_t i = 0; i < (uint32_t)count; ++i)
+        nextFree[i] = i + 2 <= (uint32_t)count ? i + 2 : 0;
+      freeHead = 1;
     }
     ~ItemPool()
     {
       delete[](uint8_t *) items;
-      delete[] freeStack;
+      delete[] nextFree;
     }
     void *Allocate()
     {
-      if(freeStackHead == 0)
+      int64_t head = Atomic::CmpExch64(&freeHead, 0, 0);
+      for(;;)
       {
-        return NULL;
-      }
-      --freeStackHead;
-      void *ret = items + freeStack[freeStackHead];
+        uint32_t top = uint32_t(head & 0xffffffff);
+        if(top == 0)
+          return NULL;
+
+        // if the item is allocated and freed again by another thread before we swap, its next
+        // index could be stale. The modification count in the high bits will differ though so the
+        // swap fails and we try again.
+        int64_t prev = Atomic::CmpExch64(&freeHead, head, NextHead(head, nextFree[top - 1]));
+        if(prev == head)
+        {
+          void *ret = items + (top - 1);
 
 #if ENABLED(RDOC_DEVEL)
-      const size_t itemSize = sizeof(WrapType);
-      memset(ret, 0xb0, itemSize);
+          const size_t itemSize = sizeof(WrapType);
+          memset(ret, 0xb0, itemSize);
 #endif
 
-      return ret;
+          return ret;
+        }
+
+        head = prev;
+      }
     }
 
     void Deallocate(void *p)
     {
-      int idx = (int)((WrapType *)p - &items[0]);
-
-      freeStack[freeStackHead] = idx;
-      ++freeStackHead;
+      uint32_t idx = (uint32_t)((WrapType *)p - &items[0]);
 
+      // clear before the item is back in the free list, after that it could be allocated again
 #if ENABLED(RDOC_DEVEL)
       const size_t itemSize = sizeof(WrapType);
       if(DebugClear)
         memset(p, 0xfe, itemSize);
 #endif
+
+      int64_t head = Atomic::CmpExch64(&freeHead, 0, 0);
+      for(;;)
+      {
+        nextFree[idx] = uint32_t(head & 0xffffffff);
+
+        int64_t prev = Atomic::CmpExch64(&freeHead, head, NextHead(head, idx + 1));
+        if(prev == head)
+          return;
+
+        head = prev;
+      }
     }
 
     bool IsAlloc(const void *p) const { return p >= &items[0] && p < &items[count]; }
+    // the low 32 bits of the free list head are the index + 1 of the first free item, or 0 if there
+    // are none. The high 32 bits count modifications to avoid ABA problems.
+    static int64_t NextHead(int64_t head, uint32_t top)
+    {
+      return int64_t(((uint64_t(head) >> 32) + 1) << 32) | int64_t(top);
+    }
+
     WrapType *items;
     size_t count;
-    int *freeStack;
-    size_t freeStackHead;
+    uint32_t *nextFree;
+    int64_t freeHead;
   };
 
+  // enough for 2GB of objects of any type with 512kB pools
+  static const size_t MaxAdditionalPools = 4096;
+
   ItemPool m_ImmediatePool;
-  rdcarray<ItemPool *> m_AdditionalPools;
+  ItemPool *m_AdditionalPools[MaxAdditionalPools] = {};
 
   friend typename FriendMaker<WrapType>::Type;
 };
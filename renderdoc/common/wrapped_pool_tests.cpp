@@ -0,0 +1,171 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019-2022 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include <set>
+#include "common/formatting.h"
+#include "common/timing.h"
+#include "common/wrapped_pool.h"
+#include "os/os_specific.h"
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+
+struct PooledTestObject
+{
+  uint64_t value;
+  byte padding[56];
+
+  ALLOCATE_WITH_WRAPPED_POOL(PooledTestObject);
+};
+
+WRAPPED_POOL_INST(PooledTestObject);
+
+TEST_CASE("Wrapped pool allocation and identification", "[wrappedpool]")
+{
+  // enough objects to spill over into several additional pools
+  rdcarray<PooledTestObject *> objs;
+  for(uint64_t i = 0; i < 20000; i++)
+  {
+    objs.push_back(new PooledTestObject);
+    objs.back()->value = i;
+  }
+
+  for(uint64_t i = 0; i < objs.size(); i++)
+  {
+    CHECK(PooledTestObject::IsAlloc(objs[i]));
+    CHECK(objs[i]->value == i);
+  }
+
+  PooledTestObject local;
+  CHECK_FALSE(PooledTestObject::IsAlloc(&local));
+
+  // free every other object, then allocate again and we should get the same items back
+  std::set<PooledTestObject *> freed;
+  for(size_t i = 0; i < objs.size(); i += 2)
+  {
+    freed.insert(objs[i]);
+    delete objs[i];
+  }
+
+  for(size_t i = 0; i < objs.size(); i += 2)
+  {
+    objs[i] = new PooledTestObject;
+    CHECK(freed.count(objs[i]) == 1);
+  }
+
+  for(PooledTestObject *o : objs)
+    delete o;
+}
+
+TEST_CASE("Wrapped pool used from multiple threads", "[wrappedpool]")
+{
+  const uint32_t numThreads = 4;
+  int32_t failures = 0;
+
+  rdcarray<Threading::ThreadHandle> threads;
+  for(uint32_t t = 0; t < numThreads; t++)
+  {
+    threads.push_back(Threading::CreateThread([&failures, t]() {
+      for(uint32_t iter = 0; iter < 20; iter++)
+      {
+        rdcarray<PooledTestObject *> objs;
+
+        for(uint32_t i = 0; i < 1000; i++)
+        {
+          PooledTestObject *o = new PooledTestObject;
+          o->value = (uint64_t(t) << 32) | i;
+          objs.push_back(o);
+        }
+
+        // if any item was handed out twice its value will have been overwritten
+        for(uint32_t i = 0; i < (uint32_t)objs.size(); i++)
+        {
+          if(!PooledTestObject::IsAlloc(objs[i]) || objs[i]->value != ((uint64_t(t) << 32) | i))
+            Atomic::Inc32(&failures);
+        }
+
+        for(PooledTestObject *o : objs)
+          delete o;
+      }
+    }));
+  }
+
+  for(Threading::ThreadHandle th : threads)
+  {
+    Threading::JoinThread(th);
+    Threading::CloseThread(th);
+  }
+
+  CHECK(failures == 0);
+}
+
+TEST_CASE("Benchmark wrapped pool contention", "[.][benchmark][wrappedpool]")
+{
+  const uint32_t opsPerThread = 1000000;
+  const uint32_t batchSize = 256;
+
+  for(uint32_t numThreads : {1, 2, 4, 8, 16})
+  {
+    rdcarray<Threading::ThreadHandle> threads;
+
+    PerformanceTimer timer;
+
+    for(uint32_t t = 0; t < numThreads; t++)
+    {
+      threads.push_back(Threading::CreateThread([]() {
+        PooledTestObject *objs[batchSize];
+
+        // allocate a batch, identify each one, then free them all - as with objects created and
+        // destroyed every frame
+        for(uint32_t i = 0; i < opsPerThread; i += batchSize)
+        {
+          for(uint32_t b = 0; b < batchSize; b++)
+            objs[b] = new PooledTestObject;
+
+          for(uint32_t b = 0; b < batchSize; b++)
+            if(!PooledTestObject::IsAlloc(objs[b]))
+              RDCERR("Pooled object not identified");
+
+          for(uint32_t b = 0; b < batchSize; b++)
+            delete objs[b];
+        }
+      }));
+    }
+
+    for(Threading::ThreadHandle th : threads)
+    {
+      Threading::JoinThread(th);
+      Threading::CloseThread(th);
+    }
+
+    double ms = timer.GetMilliseconds();
+
+    WARN(StringFormat::Fmt("%u threads: %llu alloc/identify/free per sec", numThreads,
+                           uint64_t(double(numThreads) * opsPerThread / (ms / 1000.0)))
+             .c_str());
+  }
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -0,0 +1,552 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019-2022 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "block_transfer.h"
+#include "common/formatting.h"
+#include "common/timing.h"
+#include "core/settings.h"
+#include "lz4/lz4.h"
+#include "zstd/xxhash.h"
+
+RDOC_CONFIG(bool, RemoteServer_CompressTransfers, true,
+            "Compress blocks of captures copied over the network, where that makes them smaller.");
+
+// the granularity at which blocks can be skipped. Small enough that an interrupted transfer loses
+// little, large enough that the hash list for a multi-gigabyte capture stays small.
+static const uint64_t TransferBlockSize = 1024 * 1024;
+
+// most of a capture is normally already compressed, so only send a block compressed if that saves
+// at least this fraction of it - otherwise decompressing is wasted time on the receiving side.
+static const uint64_t TransferMinCompressionSaving = 8;
+
+template <typename SerialiserType>
+void DoSerialise(SerialiserType &ser, TransferBlockHashes &el)
+{
+  SERIALISE_MEMBER(blockSize);
+  SERIALISE_MEMBER(hashes);
+}
+
+INSTANTIATE_SERIALISE_TYPE(TransferBlockHashes);
+
+static uint64_t HashBlock(const byte *data, uint64_t size)
+{
+  return XXH64(data, (size_t)size, 0);
+}
+
+TransferBlockHashes HashTransferBlocks(const rdcstr &filename)
+{
+  TransferBlockHashes ret;
+  ret.blockSize = TransferBlockSize;
+
+  FILE *f = FileIO::fopen(filename, FileIO::ReadBinary);
+
+  if(!f)
+    return ret;
+
+  bytebuf buf;
+  buf.resize((size_t)TransferBlockSize);
+
+  for(;;)
+  {
+    size_t read = FileIO::fread(buf.data(), 1, buf.size(), f);
+
+    if(read == 0)
+      break;
+
+    ret.hashes.push_back(HashBlock(buf.data(), read));
+
+    if(read < buf.size())
+      break;
+  }
+
+  FileIO::fclose(f);
+
+  return ret;
+}
+
+TransferStats SendTransferBlocks(WriteSerialiser &ser, const rdcstr &filename,
+                                 const TransferBlockHashes &receiverHashes,
+                                 RENDERDOC_ProgressCallback progress)
+{
+  TransferStats stats;
+  PerformanceTimer timer;
+
+  FILE *f = FileIO::fopen(filename, FileIO::ReadBinary);
+
+  if(!f)
+    RDCERR("Can't open '%s' to send", filename.c_str());
+
+  // this takes ownership of the file, and sends an empty file if it couldn't be opened
+  StreamReader fileStream(f);
+
+  uint64_t fileSize = fileStream.GetSize();
+  uint64_t blockSize = TransferBlockSize;
+
+  ser.Serialise("fileSize"_lit, fileSize);
+  ser.Serialise("blockSize"_lit, blockSize);
+
+  // only compare against the receiver's hashes if they were made with the same block size
+  const bool useHashes = receiverHashes.blockSize == blockSize;
+
+  const bool compress = RemoteServer_CompressTransfers();
+
+  bytebuf compressed;
+  if(compress)
+    compressed.resize(LZ4_compressBound((int)RDCMIN(blockSize, fileSize)));
+
+  if(progress)
+    progress(0.0001f);
+
+  // the next blocks are read from disk while each one is hashed, compressed and sent. Once the
+  // connection fails the remaining blocks are still read but nothing more is sent.
+  uint64_t offs = 0, block = 0;
+  StreamReadAhead(&fileStream, fileSize, blockSize, [&](const byte *data, uint64_t size) {
+    if(!ser.IsErrored())
+    {
+      uint64_t hash = HashBlock(data, size);
+
+      bool skip = useHashes && block < receiverHashes.hashes.size() &&
+                  receiverHashes.hashes[(size_t)block] == hash;
+
+      ser.Serialise("hash"_lit, hash);
+      ser.Serialise("skip"_lit, skip);
+
+      if(skip)
+      {
+        stats.skippedBytes += size;
+      }
+      else
+      {
+        uint64_t compSize = 0;
+        if(compress)
+        {
+          int ret = LZ4_compress_default((const char *)data, (char *)compressed.data(), (int)size,
+                                         (int)compressed.size());
+          if(ret > 0 && uint64_t(ret) < size - size / TransferMinCompressionSaving)
+            compSize = uint64_t(ret);
+        }
+
+        bool isCompressed = compSize > 0;
+        ser.Serialise("compressed"_lit, isCompressed);
+
+        if(isCompressed)
+        {
+          byte *comp = compressed.data();
+          ser.Serialise("data"_lit, comp, compSize);
+          stats.sentBytes += compSize;
+        }
+        else
+        {
+          byte *raw = (byte *)data;
+          ser.Serialise("data"_lit, raw, size);
+          stats.sentBytes += size;
+        }
+      }
+    }
+
+    offs += size;
+    block++;
+
+    if(progress)
+      progress(float(offs) / float(fileSize));
+  });
+
+  if(fileStream.IsErrored())
+    RDCERR("Failed reading '%s' to send: %s", filename.c_str(),
+           fileStream.GetError().message.c_str());
+
+  if(progress)
+    progress(1.0f);
+
+  stats.totalBytes = fileSize;
+  stats.milliseconds = timer.GetMilliseconds();
+
+  return stats;
+}
+
+RDResult ReceiveTransferBlocks(ReadSerialiser &ser, const rdcstr &basis, const rdcstr &filename,
+                               RENDERDOC_ProgressCallback progress, TransferStats &stats)
+{
+  RDResult ret;
+  PerformanceTimer timer;
+
+  uint64_t fileSize = 0, blockSize = 0;
+
+  ser.Serialise("fileSize"_lit, fileSize);
+  ser.Serialise("blockSize"_lit, blockSize);
+
+  if(ser.IsErrored())
+    RETURN_ERROR_RESULT(ResultCode::NetworkIOFailed, "Network error receiving '%s'",
+                        filename.c_str());
+
+  if(fileSize > 0 && (blockSize == 0 || blockSize > TransferBlockSize * 64))
+    RETURN_ERROR_RESULT(ResultCode::NetworkIOFailed, "Invalid block size %llu receiving '%s'",
+                        blockSize, filename.c_str());
+
+  const bool inPlace = (basis == filename);
+
+  FileIO::CreateParentDirectory(filename);
+
+  // updating in place keeps the existing contents so that skipped blocks can be left alone
+  FILE *out = NULL;
+  if(inPlace && FileIO::exists(filename))
+    out = FileIO::fopen(filename, FileIO::UpdateBinary);
+  else
+    out = FileIO::fopen(filename, FileIO::WriteBinary);
+
+  FILE *in = NULL;
+  if(!inPlace && !basis.empty())
+    in = FileIO::fopen(basis, FileIO::ReadBinary);
+
+  if(!out)
+    SET_ERROR_RESULT(ret, ResultCode::FileIOFailed, "Can't open '%s' to receive into: %s",
+                     filename.c_str(), FileIO::ErrorString().c_str());
+
+  bytebuf buf, compressed;
+  buf.resize((size_t)RDCMIN(blockSize, fileSize));
+
+  if(progress)
+    progress(0.0001f);
+
+  // we always read every block even after an error, to leave the stream in a consistent state
+  for(uint64_t offs = 0; offs < fileSize && !ser.IsErrored(); offs += blockSize)
+  {
+    uint64_t size = RDCMIN(blockSize, fileSize - offs);
+
+    uint64_t hash = 0;
+    bool skip = false;
+
+    ser.Serialise("hash"_lit, hash);
+    ser.Serialise("skip"_lit, skip);
+
+    if(skip)
+    {
+      stats.skippedBytes += size;
+
+      // if we're updating in place the block is already there, otherwise copy it across
+      if(!inPlace && out && ret == ResultCode::Succeeded)
+      {
+        bool success = false;
+
+        if(in)
+        {
+          buf.resize((size_t)size);
+          FileIO::fseek64(in, offs, SEEK_SET);
+          success = FileIO::fread(buf.data(), 1, (size_t)size, in) == size &&
+                    HashBlock(buf.data(), size) == hash;
+        }
+
+        if(success)
+        {
+          FileIO::fseek64(out, offs, SEEK_SET);
+          success = FileIO::fwrite(buf.data(), 1, (size_t)size, out) == size;
+        }
+
+        if(!success)
+          SET_ERROR_RESULT(ret, ResultCode::FileIOFailed,
+                           "Couldn't copy existing block at %llu from '%s' to '%s'", offs,
+                           basis.c_str(), filename.c_str());
+      }
+    }
+    else
+    {
+      bool isCompressed = false;
+      ser.Serialise("compressed"_lit, isCompressed);
+
+      if(isCompressed)
+      {
+        ser.Serialise("data"_lit, compressed);
+
+        stats.sentBytes += compressed.size();
+
+        buf.resize((size_t)size);
+
+        int decompSize =
+            LZ4_decompress_safe((const char *)compressed.data(), (char *)buf.data(),
+                                (int)compressed.size(), (int)size);
+
+        // a bad size is caught below
+        buf.resize(decompSize < 0 ? 0 : (size_t)decompSize);
+      }
+      else
+      {
+        ser.Serialise("data"_lit, buf);
+
+        stats.sentBytes += buf.size();
+      }
+
+      // if the connection failed there's nothing valid left to read, and the loop ends here
+      bool valid = !ser.IsErrored() && buf.size() == size;
+
+      // a block of the wrong size is still fully read, so carry on with the following ones
+      if(!ser.IsErrored() && buf.size() != size && ret == ResultCode::Succeeded)
+        SET_ERROR_RESULT(ret, ResultCode::NetworkIOFailed,
+                         "Block at %llu of '%s' has unexpected size %llu", offs, filename.c_str(),
+                         (uint64_t)buf.size());
+
+      if(valid && ret == ResultCode::Succeeded && HashBlock(buf.data(), size) != hash)
+        SET_ERROR_RESULT(ret, ResultCode::NetworkIOFailed,
+                         "Block at %llu of '%s' failed verification", offs, filename.c_str());
+
+      // keep writing blocks even if one failed verification, so that a retry can resume from
+      // whatever did arrive intact
+      if(out && valid)
+      {
+        FileIO::fseek64(out, offs, SEEK_SET);
+        if(FileIO::fwrite(buf.data(), 1, (size_t)size, out) != size &&
+           ret == ResultCode::Succeeded)
+          SET_ERROR_RESULT(ret, ResultCode::FileIOFailed, "Error writing to '%s': %s",
+                           filename.c_str(), FileIO::ErrorString().c_str());
+      }
+    }
+
+    if(progress)
+      progress(float(offs + size) / float(fileSize));
+  }
+
+  if(ser.IsErrored() && ret == ResultCode::Succeeded)
+    SET_ERROR_RESULT(ret, ResultCode::NetworkIOFailed,
+                     "Network error receiving '%s', partial transfer kept to resume",
+                     filename.c_str());
+
+  if(out)
+  {
+    // only drop any stale tail once everything arrived, otherwise keep it for resuming
+    if(ret == ResultCode::Succeeded)
+      FileIO::ftruncateat(out, fileSize);
+    FileIO::fclose(out);
+  }
+
+  if(in)
+    FileIO::fclose(in);
+
+  if(progress)
+    progress(1.0f);
+
+  stats.totalBytes = fileSize;
+  stats.milliseconds = timer.GetMilliseconds();
+
+  return ret;
+}
+
+void LogTransferStats(const char *direction, const rdcstr &filename, const TransferStats &stats)
+{
+  const double MB = 1024.0 * 1024.0;
+  double seconds = RDCMAX(stats.milliseconds, 1.0) / 1000.0;
+
+  RDCLOG("%s '%s': %.1f MB total, %.1f MB transferred, %.1f MB already present. %.1f MB/s "
+         "(%.1f MB/s effective)",
+         direction, filename.c_str(), stats.totalBytes / MB, stats.sentBytes / MB,
+         stats.skippedBytes / MB, stats.sentBytes / MB / seconds, stats.totalBytes / MB / seconds);
+}
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+
+static void TransferFile(const rdcstr &source, const rdcstr &basis, const rdcstr &dest,
+                         TransferStats &sendStats, TransferStats &recvStats, RDResult &result)
+{
+  StreamWriter *buf = new StreamWriter(StreamWriter::DefaultScratchSize);
+
+  TransferBlockHashes hashes = HashTransferBlocks(basis);
+
+  {
+    WriteSerialiser ser(buf, Ownership::Nothing);
+    sendStats = SendTransferBlocks(ser, source, hashes, RENDERDOC_ProgressCallback());
+  }
+
+  {
+    ReadSerialiser ser(new StreamReader(buf->GetData(), buf->GetOffset()), Ownership::Stream);
+    recvStats = TransferStats();
+    result = ReceiveTransferBlocks(ser, basis, dest, RENDERDOC_ProgressCallback(), recvStats);
+  }
+
+  delete buf;
+}
+
+static bytebuf ReadWholeFile(const rdcstr &filename)
+{
+  bytebuf ret;
+  FileIO::ReadAll(filename, ret);
+  return ret;
+}
+
+TEST_CASE("Test block-hashed file transfer", "[transfer]")
+{
+  rdcstr source = FileIO::GetTempFolderFilename() + "block_transfer_source.bin";
+  rdcstr dest = FileIO::GetTempFolderFilename() + "block_transfer_dest.bin";
+  rdcstr dest2 = FileIO::GetTempFolderFilename() + "block_transfer_dest2.bin";
+
+  FileIO::Delete(dest);
+  FileIO::Delete(dest2);
+
+  // a few blocks plus a partial block at the end. The contents are incompressible so that the
+  // number of bytes sent is exact
+  bytebuf contents;
+  contents.resize(size_t(TransferBlockSize * 5 + 1234));
+  for(size_t i = 0; i < contents.size(); i++)
+    contents[i] = byte(XXH64(&i, sizeof(i), 0));
+
+  FileIO::WriteAll(source, contents.data(), contents.size());
+
+  TransferStats sendStats, recvStats;
+  RDResult result;
+
+  SECTION("Fresh, repeated and resumed transfers")
+  {
+    // nothing at the destination, everything is sent
+    TransferFile(source, dest, dest, sendStats, recvStats, result);
+
+    CHECK(result.code == ResultCode::Succeeded);
+    CHECK(sendStats.sentBytes == contents.size());
+    CHECK(recvStats.sentBytes == contents.size());
+    CHECK(sendStats.skippedBytes == 0);
+    CHECK((ReadWholeFile(dest) == contents));
+
+    // the same file again, nothing needs to be sent
+    TransferFile(source, dest, dest, sendStats, recvStats, result);
+
+    CHECK(result.code == ResultCode::Succeeded);
+    CHECK(sendStats.sentBytes == 0);
+    CHECK(recvStats.skippedBytes == contents.size());
+    CHECK((ReadWholeFile(dest) == contents));
+
+    // simulate an interrupted transfer, which stopped part way through the third block
+    {
+      FILE *f = FileIO::fopen(dest, FileIO::UpdateBinary);
+      FileIO::ftruncateat(f, TransferBlockSize * 2 + 100);
+      FileIO::fclose(f);
+    }
+
+    TransferFile(source, dest, dest, sendStats, recvStats, result);
+
+    CHECK(result.code == ResultCode::Succeeded);
+    CHECK(sendStats.skippedBytes == TransferBlockSize * 2);
+    CHECK(sendStats.sentBytes == contents.size() - TransferBlockSize * 2);
+    CHECK((ReadWholeFile(dest) == contents));
+
+    // modify one block in the source, only it is sent
+    contents[size_t(TransferBlockSize * 3 + 17)]++;
+    FileIO::WriteAll(source, contents.data(), contents.size());
+
+    TransferFile(source, dest, dest, sendStats, recvStats, result);
+
+    CHECK(result.code == ResultCode::Succeeded);
+    CHECK(sendStats.sentBytes == TransferBlockSize);
+    CHECK((ReadWholeFile(dest) == contents));
+
+    // receiving into a different file, taking unchanged blocks from an existing copy
+    TransferFile(source, dest, dest2, sendStats, recvStats, result);
+
+    CHECK(result.code == ResultCode::Succeeded);
+    CHECK(sendStats.sentBytes == 0);
+    CHECK((ReadWholeFile(dest2) == contents));
+  }
+
+  SECTION("Compressible blocks are sent compressed")
+  {
+    for(size_t i = 0; i < contents.size(); i++)
+      contents[i] = byte((i / 64) & 0x7);
+    FileIO::WriteAll(source, contents.data(), contents.size());
+
+    TransferFile(source, dest, dest, sendStats, recvStats, result);
+
+    CHECK(result.code == ResultCode::Succeeded);
+    CHECK(sendStats.skippedBytes == 0);
+    CHECK(sendStats.sentBytes < contents.size() / 10);
+    CHECK(recvStats.sentBytes == sendStats.sentBytes);
+    CHECK((ReadWholeFile(dest) == contents));
+  }
+
+  SECTION("Destination larger than the source is truncated")
+  {
+    bytebuf larger = contents;
+    larger.resize(larger.size() + TransferBlockSize * 3);
+    FileIO::WriteAll(dest, larger.data(), larger.size());
+
+    TransferFile(source, dest, dest, sendStats, recvStats, result);
+
+    CHECK(result.code == ResultCode::Succeeded);
+    CHECK(sendStats.skippedBytes == TransferBlockSize * 5);
+    CHECK((ReadWholeFile(dest) == contents));
+  }
+
+  SECTION("Blocks after a malformed block are still read")
+  {
+    StreamWriter *buf = new StreamWriter(StreamWriter::DefaultScratchSize);
+
+    // the first block is too short, the two after it are fine
+    {
+      WriteSerialiser ser(buf, Ownership::Nothing);
+
+      uint64_t fileSize = TransferBlockSize * 3, blockSize = TransferBlockSize;
+      ser.Serialise("fileSize"_lit, fileSize);
+      ser.Serialise("blockSize"_lit, blockSize);
+
+      for(uint64_t block = 0; block < 3; block++)
+      {
+        byte *data = contents.data() + block * TransferBlockSize;
+        uint64_t size = block == 0 ? 100 : TransferBlockSize;
+        uint64_t hash = HashBlock(data, size);
+        bool skip = false, isCompressed = false;
+
+        ser.Serialise("hash"_lit, hash);
+        ser.Serialise("skip"_lit, skip);
+        ser.Serialise("compressed"_lit, isCompressed);
+        ser.Serialise("data"_lit, data, size);
+      }
+
+      uint32_t marker = 0xf00dcafe;
+      ser.Serialise("marker"_lit, marker);
+    }
+
+    {
+      ReadSerialiser ser(new StreamReader(buf->GetData(), buf->GetOffset()), Ownership::Stream);
+      result = ReceiveTransferBlocks(ser, dest, dest, RENDERDOC_ProgressCallback(), recvStats);
+
+      CHECK(result.code == ResultCode::NetworkIOFailed);
+      CHECK(!ser.IsErrored());
+
+      // the stream is left just after the last block
+      uint32_t marker = 0;
+      ser.Serialise("marker"_lit, marker);
+      CHECK(marker == 0xf00dcafe);
+    }
+
+    delete buf;
+
+    // the intact blocks were kept so a retry only needs the bad one
+    bytebuf received = ReadWholeFile(dest);
+    REQUIRE(received.size() == TransferBlockSize * 3);
+    CHECK(memcmp(received.data() + TransferBlockSize, contents.data() + TransferBlockSize,
+                 size_t(TransferBlockSize * 2)) == 0);
+  }
+
+  FileIO::Delete(source);
+  FileIO::Delete(dest);
+  FileIO::Delete(dest2);
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -0,0 +1,67 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019-2022 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include "serialise/serialiser.h"
+
+// Files such as captures are copied between machines in fixed size blocks. Before anything is sent
+// the receiving side hashes the blocks of any file it already has at the destination - an earlier
+// copy of the same capture, or what was written before a transfer was interrupted - and the sender
+// skips every block that matches. Each block that is sent carries its hash so it can be verified.
+//
+// The protocol is:
+//   receiver -> sender: TransferBlockHashes from HashTransferBlocks() on its existing file
+//   sender -> receiver: SendTransferBlocks() / ReceiveTransferBlocks() within a single chunk
+
+struct TransferBlockHashes
+{
+  uint64_t blockSize = 0;
+  rdcarray<uint64_t> hashes;
+};
+
+DECLARE_REFLECTION_STRUCT(TransferBlockHashes);
+
+struct TransferStats
+{
+  uint64_t totalBytes = 0;
+  uint64_t sentBytes = 0;
+  uint64_t skippedBytes = 0;
+  double milliseconds = 0.0;
+};
+
+// hash the blocks of a file on the receiving side. Returns no hashes if the file doesn't exist.
+TransferBlockHashes HashTransferBlocks(const rdcstr &filename);
+
+// send the blocks of filename that the receiver doesn't already have, according to its hashes.
+TransferStats SendTransferBlocks(WriteSerialiser &ser, const rdcstr &filename,
+                                 const TransferBlockHashes &receiverHashes,
+                                 RENDERDOC_ProgressCallback progress);
+
+// receive blocks into filename. Any skipped blocks are read from basis, which is the file the
+// hashes were calculated from and may be the same as filename to update it in place.
+RDResult ReceiveTransferBlocks(ReadSerialiser &ser, const rdcstr &basis, const rdcstr &filename,
+                               RENDERDOC_ProgressCallback progress, TransferStats &stats);
+
+void LogTransferStats(const char *direction, const rdcstr &filename, const TransferStats &stats);
@@ -576,6 +576,8 @@ RenderDoc::~RenderDoc()
 
   Network::Shutdown();
 
+  Threading::JobSystem::Shutdown();
+
   Threading::Shutdown();
 
   StringFormat::Shutdown();
@@ -1411,11 +1413,15 @@ void RenderDoc::RegisterRemoteProvider(RDCDriver driver, RemoteDriverProvider pr
   m_RemoteDriverProviders[driver] = provider;
 }
 
-void RenderDoc::RegisterStructuredProcessor(RDCDriver driver, StructuredProcessor provider)
+void RenderDoc::RegisterStructuredProcessor(RDCDriver driver, StructuredProcessor provider,
+                                            StructuredChunkLookup lookup)
 {
   RDCASSERT(m_StructProcesssors.find(driver) == m_StructProcesssors.end());
 
   m_StructProcesssors[driver] = provider;
+
+  if(lookup)
+    m_StructChunkLookups[driver] = lookup;
 }
 
 void RenderDoc::RegisterCaptureExporter(CaptureExporter exporter, CaptureFileFormat description)
@@ -1482,6 +1488,16 @@ StructuredProcessor RenderDoc::GetStructuredProcessor(RDCDriver driver)
   return it->second;
 }
 
+StructuredChunkLookup RenderDoc::GetStructuredChunkLookup(RDCDriver driver)
+{
+  auto it = m_StructChunkLookups.find(driver);
+
+  if(it == m_StructChunkLookups.end())
+    return NULL;
+
+  return it->second;
+}
+
 CaptureExporter RenderDoc::GetCaptureExporter(const rdcstr &filetype)
 {
   auto it = m_Exporters.find(filetype);
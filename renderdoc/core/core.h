@@ -372,6 +372,7 @@ typedef RDResult (*ReplayDriverProvider)(RDCFile *rdc, const ReplayOptions &opts
                                          IReplayDriver **driver);
 
 typedef RDResult (*StructuredProcessor)(RDCFile *rdc, SDFile &structData);
+typedef rdcstr (*StructuredChunkLookup)(uint32_t chunkType);
 
 typedef RDResult (*CaptureImporter)(const rdcstr &filename, StreamReader &reader, RDCFile *rdc,
                                     SDFile &structData, RENDERDOC_ProgressCallback progress);
@@ -501,7 +502,8 @@ public:
   void RegisterReplayProvider(RDCDriver driver, ReplayDriverProvider provider);
   void RegisterRemoteProvider(RDCDriver driver, RemoteDriverProvider provider);
 
-  void RegisterStructuredProcessor(RDCDriver driver, StructuredProcessor provider);
+  void RegisterStructuredProcessor(RDCDriver driver, StructuredProcessor provider,
+                                   StructuredChunkLookup lookup);
 
   void RegisterCaptureExporter(CaptureExporter exporter, CaptureFileFormat description);
   void RegisterCaptureImportExporter(CaptureImporter importer, CaptureExporter exporter,
@@ -509,6 +511,7 @@ public:
   void RegisterDeviceProtocol(const rdcstr &protocol, ProtocolHandler handler);
 
   StructuredProcessor GetStructuredProcessor(RDCDriver driver);
+  StructuredChunkLookup GetStructuredChunkLookup(RDCDriver driver);
 
   CaptureExporter GetCaptureExporter(const rdcstr &filetype);
   CaptureImporter GetCaptureImporter(const rdcstr &filetype);
@@ -675,6 +678,7 @@ private:
   std::map<RDCDriver, RemoteDriverProvider> m_RemoteDriverProviders;
 
   std::map<RDCDriver, StructuredProcessor> m_StructProcesssors;
+  std::map<RDCDriver, StructuredChunkLookup> m_StructChunkLookups;
 
   rdcarray<CaptureFileFormat> m_ImportExportFormats;
   std::map<rdcstr, CaptureImporter> m_Importers;
@@ -744,9 +748,12 @@ struct DriverRegistration
 
 struct StructuredProcessRegistration
 {
-  StructuredProcessRegistration(RDCDriver driver, StructuredProcessor provider)
+  // the chunk lookup is optional, if provided the chunk list can be indexed without running the
+  // processor and the chunk contents decoded lazily.
+  StructuredProcessRegistration(RDCDriver driver, StructuredProcessor provider,
+                                StructuredChunkLookup lookup = NULL)
   {
-    RenderDoc::Inst().RegisterStructuredProcessor(driver, provider);
+    RenderDoc::Inst().RegisterStructuredProcessor(driver, provider, lookup);
   }
 };
 
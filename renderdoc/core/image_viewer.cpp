@@ -24,15 +24,29 @@
 
 #include "common/dds_readwrite.h"
 #include "common/formatting.h"
+#include "common/threading.h"
 #include "core/core.h"
+#include "core/settings.h"
 #include "maths/formatpacking.h"
+#include "replay/block_compression.h"
 #include "replay/dummy_driver.h"
 #include "replay/replay_driver.h"
+#include "replay/texture_stats.h"
 #include "serialise/rdcfile.h"
 #include "stb/stb_image.h"
 #include "strings/string_utils.h"
 #include "tinyexr/tinyexr.h"
 
+// this is off by default: images opened here are typically outputs of other tools which get
+// regenerated while the viewer is open (which is why the file is watched and refreshed), and a
+// mapping gives no protection against that - a truncated file faults on access instead of failing a
+// read. Only large DDS files with many mips/slices benefit, so users can opt in for those.
+RDOC_CONFIG(bool, ImageViewer_MapFiles, false,
+            "Memory-map image files opened in the image viewer instead of reading them, so that "
+            "only the mips and slices of DDS files which are viewed are read from disk. Mapping "
+            "does not stop other programs modifying the file: if it is truncated or rewritten in "
+            "place while mapped, RenderDoc may crash with a bus error or display torn data.");
+
 class ImageViewer : public IReplayDriver
 {
 public:
@@ -74,6 +88,7 @@ public:
 
   virtual ~ImageViewer()
   {
+    FileIO::funmap(m_FileMapping);
     SAFE_DELETE(m_File);
     if(m_Proxy)
     {
@@ -152,17 +167,41 @@ public:
       y = (mipHeight - 1) - y;
     }
 
+    EnsureUploaded(sub);
+
     m_Proxy->PickPixel(texture, x, y, sub, typeCast, pixel);
   }
   bool GetMinMax(ResourceId texid, const Subresource &sub, CompType typeCast, float *minval,
                  float *maxval)
   {
+    ResourceFormat fmt;
+    uint32_t width = 0, height = 0;
+    size_t size = 0;
+    const byte *slice = GetCPUSlice(sub, typeCast, fmt, width, height, size);
+
+    if(slice)
+      return CalculateTextureMinMax(fmt, typeCast, width, height, slice, size,
+                                    minval, maxval);
+
+    EnsureUploaded(sub);
+
     return m_Proxy->GetMinMax(m_TextureID, sub, typeCast, minval, maxval);
   }
   bool GetHistogram(ResourceId texid, const Subresource &sub, CompType typeCast, float minval,
                     float maxval, const rdcfixedarray<bool, 4> &channels,
                     rdcarray<uint32_t> &histogram)
   {
+    ResourceFormat fmt;
+    uint32_t width = 0, height = 0;
+    size_t size = 0;
+    const byte *slice = GetCPUSlice(sub, typeCast, fmt, width, height, size);
+
+    if(slice)
+      return CalculateTextureHistogram(fmt, typeCast, width, height, slice, size,
+                                       minval, maxval, channels, histogram);
+
+    EnsureUploaded(sub);
+
     return m_Proxy->GetHistogram(m_TextureID, sub, typeCast, minval, maxval, channels, histogram);
   }
   bool RenderTexture(TextureDisplay cfg)
@@ -170,6 +209,9 @@ public:
     if(cfg.resourceId != m_TextureID && cfg.resourceId != m_CustomTexID)
       cfg.resourceId = m_TextureID;
 
+    if(cfg.resourceId == m_TextureID)
+      EnsureUploaded(cfg.subresource);
+
     if(m_Props.localRenderer == GraphicsAPI::OpenGL)
       cfg.flipY = !cfg.flipY;
 
@@ -205,6 +247,11 @@ public:
   void FreeCustomShader(ResourceId id) { m_Proxy->FreeTargetResource(id); }
   ResourceId ApplyCustomShader(TextureDisplay &display)
   {
+    // custom shaders can sample from any subresource
+    for(uint32_t i = 0; i < m_Uploaded.size(); i++)
+      if(!m_Uploaded[i])
+        UploadSubresource(i);
+
     m_CustomTexID = m_Proxy->ApplyCustomShader(display);
     return m_CustomTexID;
   }
@@ -217,22 +264,27 @@ public:
     if(tex != m_TextureID && tex != m_CustomTexID)
       tex = m_TextureID;
 
-    if(tex == m_TextureID && !m_RealTexData.empty() && params.remap == RemapTexture::NoRemap)
+    if(tex == m_TextureID && m_ReturnRealData && params.remap == RemapTexture::NoRemap)
     {
       RDCASSERT(sub.sample == 0);
       uint32_t idx = sub.slice * m_TexDetails.mips + sub.mip;
-      RDCASSERT(idx < m_RealTexData.size(), idx, m_RealTexData.size(), m_TexDetails.mips, sub.slice,
-                sub.mip);
-      data = m_RealTexData[idx];
+      RDCASSERT(idx < m_SubresourceData.size(), idx, m_SubresourceData.size(), m_TexDetails.mips,
+                sub.slice, sub.mip);
+      if(idx < m_SubresourceData.size())
+        data.assign(m_SubresourceData[idx].first, m_SubresourceData[idx].second);
       return;
     }
 
+    if(tex == m_TextureID)
+      EnsureUploaded(sub);
+
     m_Proxy->GetTextureData(tex, sub, params, data);
   }
 
   // handle a couple of operations ourselves to return a simple fake log
   APIProperties GetAPIProperties() { return m_Props; }
   FrameRecord GetFrameRecord() { return m_FrameRecord; }
+  ReplayProfile GetReplayProfile() { return {}; }
   void SetPipelineStates(D3D11Pipe::State *d3d11, D3D12Pipe::State *d3d12, GLPipe::State *gl,
                          VKPipe::State *vk)
   {
@@ -366,7 +418,69 @@ public:
   void FileChanged() { RefreshFile(); }
 private:
   void RefreshFile();
-  void CreateProxyTexture(TextureDescription &texDetails, read_dds_data &read_data);
+  void CreateProxyTexture(TextureDescription &texDetails, bool dds);
+
+  // subresources are only uploaded to the proxy the first time something needs them, so that large
+  // arrays and mip chains aren't all read and converted up front.
+  void EnsureUploaded(const Subresource &sub)
+  {
+    if(m_Uploaded.empty())
+      return;
+
+    uint32_t idx = RDCMIN(sub.mip, m_ProxyDetails.mips - 1);
+    if(m_ProxyDetails.type != TextureType::Texture3D)
+      idx += RDCMIN(sub.slice, m_ProxyDetails.arraysize - 1) * m_ProxyDetails.mips;
+
+    if(idx < m_Uploaded.size() && !m_Uploaded[idx])
+      UploadSubresource(idx);
+  }
+  void UploadSubresource(uint32_t idx);
+
+  // returns the contents of a 2D slice of the texture in fmt, if we have them and min/max and
+  // histograms can be calculated from them on the CPU without going to the proxy. Block compressed
+  // slices are decoded first.
+  const byte *GetCPUSlice(const Subresource &sub, CompType typeCast, ResourceFormat &fmt,
+                          uint32_t &width, uint32_t &height, size_t &size)
+  {
+    const bool decodeBlocks = IsBlockCompressionSupported(m_TexDetails.format);
+
+    fmt = decodeBlocks ? GetBlockUncompressedFormat(m_TexDetails.format) : m_TexDetails.format;
+
+    if(m_SubresourceData.empty() || !CanCalculateTextureStats(fmt, typeCast) ||
+       sub.mip >= m_TexDetails.mips)
+      return NULL;
+
+    width = RDCMAX(1U, m_TexDetails.width >> sub.mip);
+    height = RDCMAX(1U, m_TexDetails.height >> sub.mip);
+    size = size_t(width) * height * fmt.ElementSize();
+
+    const size_t srcSize =
+        decodeBlocks ? GetBlockCompressedSize(m_TexDetails.format, width, height) : size;
+
+    // 3D textures have all depth slices of a mip in one subresource
+    uint32_t idx = sub.mip, z = 0;
+    if(m_TexDetails.type == TextureType::Texture3D)
+      z = RDCMIN(sub.slice, RDCMAX(1U, m_TexDetails.depth >> sub.mip) - 1);
+    else
+      idx = RDCMIN(sub.slice, m_TexDetails.arraysize - 1) * m_TexDetails.mips + sub.mip;
+
+    if(idx >= m_SubresourceData.size() || (z + 1) * srcSize > m_SubresourceData[idx].second)
+      return NULL;
+
+    const byte *src = m_SubresourceData[idx].first + z * srcSize;
+
+    if(!decodeBlocks)
+      return src;
+
+    // min/max and the histogram are usually fetched one after the other, so keep the last decode
+    if(m_DecodedSliceSource != src)
+    {
+      m_DecodedSlice = DecodeBlocks(m_TexDetails.format, width, height, src);
+      m_DecodedSliceSource = src;
+    }
+
+    return m_DecodedSlice.size() >= size ? m_DecodedSlice.data() : NULL;
+  }
 
   APIProperties m_Props;
   FrameRecord m_FrameRecord;
@@ -380,11 +494,222 @@ private:
 
   RDResult m_Error;
 
-  // if we remapped the texture for display, this contains the real data to return from
-  // GetTextureData()
-  rdcarray<bytebuf> m_RealTexData;
+  // the proxy texture, which may differ from m_TexDetails if the format or type had to be changed
+  TextureDescription m_ProxyDetails;
+  // how each subresource must be converted to upload it to the proxy
+  bool m_ProxyArrayFrom3D = false;
+  bool m_ProxyDecodeBlocks = false;
+  bool m_ProxyConvertFloat = false;
+  // whether each subresource of the proxy texture has been uploaded yet
+  rdcarray<bool> m_Uploaded;
+
+  // the contents of the file - a mapping of DDS files if enabled and possible, otherwise a copy
+  // read into memory or the decoded image
+  FileIO::FileMapping *m_FileMapping = NULL;
+  bytebuf m_FileData;
+
+  // {data, size} of each subresource in its original format, pointing into the above
+  rdcarray<rdcpair<const byte *, size_t>> m_SubresourceData;
+  // if we remapped the texture for display, or if we can calculate min/max and histograms on the CPU,
+  // GetTextureData() returns the original data instead of reading back from the proxy
+  bool m_ReturnRealData = false;
+
+  // the last block compressed slice decoded for min/max and histograms, and where it came from
+  const byte *m_DecodedSliceSource = NULL;
+  bytebuf m_DecodedSlice;
 };
 
+// returns the whole contents of a file, mapped if enabled and possible, otherwise read into buffer
+static const byte *MapOrReadFile(FILE *f, uint64_t fileSize, FileIO::FileMapping *&mapping,
+                                 bytebuf &buffer)
+{
+  const byte *ret = NULL;
+
+  mapping = ImageViewer_MapFiles() ? FileIO::fmap(f, 0, fileSize, &ret) : NULL;
+
+  if(mapping)
+    return ret;
+
+  buffer.resize((size_t)fileSize);
+
+  FileIO::fseek64(f, 0, SEEK_SET);
+  FileIO::fread(buffer.data(), 1, buffer.size(), f);
+
+  return buffer.data();
+}
+
+static RDResult ParseEXRHeader(const byte *file, size_t fileSize, EXRHeader &exrHeader)
+{
+  EXRVersion exrVersion;
+  int ret = ParseEXRVersionFromMemory(&exrVersion, file, fileSize);
+
+  if(ret != 0)
+  {
+    RETURN_ERROR_RESULT(ResultCode::ImageUnsupported,
+                        "EXR file detected, but couldn't load with ParseEXRVersionFromMemory: %d",
+                        ret);
+  }
+
+  if(exrVersion.multipart)
+  {
+    RETURN_ERROR_RESULT(ResultCode::ImageUnsupported,
+                        "Unsupported EXR file detected - multipart EXR.");
+  }
+
+  if(exrVersion.non_image)
+  {
+    RETURN_ERROR_RESULT(ResultCode::ImageUnsupported,
+                        "Unsupported EXR file detected - deep image EXR.");
+  }
+
+  rdcstr errString;
+
+  {
+    const char *err = NULL;
+
+    ret = ParseEXRHeaderFromMemory(&exrHeader, &exrVersion, file, fileSize, &err);
+
+    if(err)
+    {
+      errString = err;
+      free((void *)err);
+    }
+  }
+
+  if(ret != 0)
+  {
+    RETURN_ERROR_RESULT(
+        ResultCode::ImageUnsupported,
+        "EXR file detected, but couldn't load with ParseEXRHeaderFromMemory %d: '%s'", ret,
+        errString.c_str());
+  }
+
+  // only the top level of tiled images would be loaded
+  if(exrVersion.tiled && exrHeader.tile_level_mode != TINYEXR_TILE_ONE_LEVEL)
+  {
+    FreeEXRHeader(&exrHeader);
+    RETURN_ERROR_RESULT(ResultCode::ImageUnsupported,
+                        "Unsupported EXR file detected - mipmapped tiled EXR.");
+  }
+
+  return ResultCode::Succeeded;
+}
+
+// decodes an EXR file to tightly packed RGBA32 float texels. tinyexr decodes the blocks of scanlines
+// or tiles in parallel, then they're interleaved into RGBA in parallel here.
+static RDResult LoadEXRImage(const byte *file, size_t fileSize, uint32_t &width, uint32_t &height,
+                             bytebuf &rgbaData)
+{
+  EXRHeader exrHeader;
+  InitEXRHeader(&exrHeader);
+
+  RDResult res = ParseEXRHeader(file, fileSize, exrHeader);
+  if(res != ResultCode::Succeeded)
+    return res;
+
+  for(int i = 0; i < exrHeader.num_channels; i++)
+    exrHeader.requested_pixel_types[i] = TINYEXR_PIXELTYPE_FLOAT;
+
+  EXRImage exrImage;
+  InitEXRImage(&exrImage);
+
+  rdcstr errString;
+  int ret = 0;
+
+  {
+    const char *err = NULL;
+
+    ret = LoadEXRImageFromMemory(&exrImage, &exrHeader, file, fileSize, &err);
+
+    if(err)
+    {
+      errString = err;
+      free((void *)err);
+    }
+  }
+
+  if(ret != 0)
+  {
+    FreeEXRHeader(&exrHeader);
+    RETURN_ERROR_RESULT(ResultCode::ImageUnsupported,
+                        "EXR file detected, but couldn't load with LoadEXRImageFromMemory %d: '%s'",
+                        ret, errString.c_str());
+  }
+
+  width = exrImage.width;
+  height = exrImage.height;
+
+  rgbaData.resize(size_t(width) * height * 4 * sizeof(float));
+
+  int channels[4] = {-1, -1, -1, -1};
+  for(int i = 0; i < exrImage.num_channels; i++)
+  {
+    switch(exrHeader.channels[i].name[0])
+    {
+      case 'R': channels[0] = i; break;
+      case 'G': channels[1] = i; break;
+      case 'B': channels[2] = i; break;
+      case 'A': channels[3] = i; break;
+    }
+  }
+
+  float *rgba = (float *)rgbaData.data();
+
+  // copy a row of texels from one channel plane
+  auto copyRow = [&channels, rgba](float **src, size_t srcOffs, size_t dstOffs, uint32_t count) {
+    for(int c = 0; c < 4; c++)
+    {
+      float *dst = rgba + dstOffs * 4 + c;
+
+      if(channels[c] >= 0)
+      {
+        const float *srcRow = src[channels[c]] + srcOffs;
+        for(uint32_t x = 0; x < count; x++)
+          dst[x * 4] = srcRow[x];
+      }
+      else
+      {
+        // RGB channels default to 0, alpha defaults to 1
+        const float def = c < 3 ? 0.0f : 1.0f;
+        for(uint32_t x = 0; x < count; x++)
+          dst[x * 4] = def;
+      }
+    }
+  };
+
+  if(exrImage.tiles)
+  {
+    const uint32_t tileWidth = exrHeader.tile_size_x;
+    const uint32_t tileHeight = exrHeader.tile_size_y;
+
+    Threading::JobSystem::ParallelFor((uint32_t)exrImage.num_tiles, [&](uint32_t t) {
+      const EXRTile &tile = exrImage.tiles[t];
+
+      const uint32_t x = tile.offset_x * tileWidth;
+      const uint32_t y = tile.offset_y * tileHeight;
+
+      for(uint32_t row = 0; row < (uint32_t)tile.height && y + row < height; row++)
+        copyRow((float **)tile.images, row * tileWidth, size_t(y + row) * width + x,
+                RDCMIN((uint32_t)tile.width, width - x));
+    });
+  }
+  else
+  {
+    Threading::JobSystem::ParallelFor(height, [&](uint32_t y) {
+      copyRow((float **)exrImage.images, size_t(y) * width, size_t(y) * width, width);
+    });
+  }
+
+  ret = FreeEXRImage(&exrImage);
+  FreeEXRHeader(&exrHeader);
+
+  // shouldn't get here but let's be safe
+  if(ret != 0)
+    RETURN_ERROR_RESULT(ResultCode::ImageUnsupported, "EXR file detected, but failed during parsing");
+
+  return ResultCode::Succeeded;
+}
+
 RDResult IMG_CreateReplayDevice(RDCFile *rdc, IReplayDriver **driver)
 {
   if(!rdc)
@@ -410,68 +735,24 @@ RDResult IMG_CreateReplayDevice(RDCFile *rdc, IReplayDriver **driver)
     uint64_t size = FileIO::ftell64(f);
     FileIO::fseek64(f, 0, SEEK_SET);
 
+    FileIO::FileMapping *mapping = NULL;
     bytebuf buffer;
-    buffer.resize((size_t)size);
-
-    FileIO::fread(&buffer[0], 1, buffer.size(), f);
-
-    EXRVersion exrVersion;
-    int ret = ParseEXRVersionFromMemory(&exrVersion, buffer.data(), buffer.size());
-
-    if(ret != 0)
-    {
-      FileIO::fclose(f);
-      RETURN_ERROR_RESULT(ResultCode::ImageUnsupported,
-                          "EXR file detected, but couldn't load with ParseEXRVersionFromMemory: %d",
-                          ret);
-    }
-
-    if(exrVersion.multipart)
-    {
-      FileIO::fclose(f);
-      RETURN_ERROR_RESULT(ResultCode::ImageUnsupported,
-                          "Unsupported EXR file detected - multipart EXR.");
-    }
-
-    if(exrVersion.non_image)
-    {
-      FileIO::fclose(f);
-      RETURN_ERROR_RESULT(ResultCode::ImageUnsupported,
-                          "Unsupported EXR file detected - deep image EXR.");
-    }
-
-    if(exrVersion.tiled)
-    {
-      FileIO::fclose(f);
-      RETURN_ERROR_RESULT(ResultCode::ImageUnsupported,
-                          "Unsupported EXR file detected - tiled EXR.");
-    }
+    const byte *data = MapOrReadFile(f, size, mapping, buffer);
 
     EXRHeader exrHeader;
     InitEXRHeader(&exrHeader);
 
-    rdcstr errString;
+    RDResult res = ParseEXRHeader(data, (size_t)size, exrHeader);
 
-    {
-      const char *err = NULL;
-
-      ret = ParseEXRHeaderFromMemory(&exrHeader, &exrVersion, buffer.data(), buffer.size(), &err);
-
-      if(err)
-      {
-        errString = err;
-        free((void *)err);
-      }
-    }
+    FileIO::funmap(mapping);
 
-    if(ret != 0)
+    if(res != ResultCode::Succeeded)
     {
       FileIO::fclose(f);
-      RETURN_ERROR_RESULT(
-          ResultCode::ImageUnsupported,
-          "EXR file detected, but couldn't load with ParseEXRHeaderFromMemory %d: '%s'", ret,
-          errString.c_str());
+      return res;
     }
+
+    FreeEXRHeader(&exrHeader);
   }
   else if(stbi_is_hdr_from_file(f))
   {
@@ -494,7 +775,7 @@ RDResult IMG_CreateReplayDevice(RDCFile *rdc, IReplayDriver **driver)
     FileIO::fseek64(f, 0, SEEK_SET);
     StreamReader reader(f);
     read_dds_data read_data;
-    RDResult res = load_dds_from_file(&reader, read_data);
+    RDResult res = load_dds_layout_from_file(&reader, read_data);
     f = NULL;
 
     if(res != ResultCode::Succeeded)
@@ -582,6 +863,15 @@ void ImageViewer::RefreshFile()
     return;
   }
 
+  // release the previous contents
+  FileIO::funmap(m_FileMapping);
+  m_FileMapping = NULL;
+  m_FileData.clear();
+  m_SubresourceData.clear();
+  m_Uploaded.clear();
+  m_DecodedSliceSource = NULL;
+  m_DecodedSlice.clear();
+
   TextureDescription texDetails;
 
   ResourceFormat rgba8_unorm;
@@ -626,155 +916,23 @@ void ImageViewer::RefreshFile()
   {
     texDetails.format = rgba32_float;
 
-    FileIO::fseek64(f, 0, SEEK_SET);
-
+    FileIO::FileMapping *mapping = NULL;
     bytebuf buffer;
-    buffer.resize((size_t)fileSize);
-
-    FileIO::fread(buffer.data(), 1, buffer.size(), f);
-
-    EXRVersion exrVersion;
-    int ret = ParseEXRVersionFromMemory(&exrVersion, buffer.data(), buffer.size());
-
-    if(ret != 0)
-    {
-      SET_ERROR_RESULT(m_Error, ResultCode::ImageUnsupported,
-                       "EXR file detected, but couldn't load with ParseEXRVersionFromMemory: %d",
-                       ret);
-      FileIO::fclose(f);
-      return;
-    }
-
-    if(exrVersion.multipart)
-    {
-      SET_ERROR_RESULT(m_Error, ResultCode::ImageUnsupported,
-                       "Unsupported EXR file detected - multipart EXR.");
-      FileIO::fclose(f);
-      return;
-    }
-
-    if(exrVersion.non_image)
-    {
-      SET_ERROR_RESULT(m_Error, ResultCode::ImageUnsupported,
-                       "Unsupported EXR file detected - deep image EXR.");
-      FileIO::fclose(f);
-      return;
-    }
-
-    if(exrVersion.tiled)
-    {
-      SET_ERROR_RESULT(m_Error, ResultCode::ImageUnsupported,
-                       "Unsupported EXR file detected - tiled EXR.");
-      FileIO::fclose(f);
-      return;
-    }
-
-    EXRHeader exrHeader;
-    InitEXRHeader(&exrHeader);
-
-    rdcstr errString;
+    const byte *file = MapOrReadFile(f, fileSize, mapping, buffer);
 
-    {
-      const char *err = NULL;
-
-      ret = ParseEXRHeaderFromMemory(&exrHeader, &exrVersion, buffer.data(), buffer.size(), &err);
+    RDResult res =
+        LoadEXRImage(file, (size_t)fileSize, texDetails.width, texDetails.height, m_FileData);
 
-      if(err)
-      {
-        errString = err;
-        free((void *)err);
-      }
-    }
+    FileIO::funmap(mapping);
 
-    if(ret != 0)
-    {
-      SET_ERROR_RESULT(
-          m_Error, ResultCode::ImageUnsupported,
-          "EXR file detected, but couldn't load with ParseEXRHeaderFromMemory %d: '%s'", ret,
-          errString.c_str());
-      FileIO::fclose(f);
-      return;
-    }
-
-    for(int i = 0; i < exrHeader.num_channels; i++)
-      exrHeader.requested_pixel_types[i] = TINYEXR_PIXELTYPE_FLOAT;
-
-    EXRImage exrImage;
-    InitEXRImage(&exrImage);
-
-    {
-      const char *err = NULL;
-
-      ret = LoadEXRImageFromMemory(&exrImage, &exrHeader, buffer.data(), buffer.size(), &err);
-
-      if(err)
-      {
-        errString = err;
-        free((void *)err);
-      }
-    }
-
-    if(ret != 0)
+    if(res != ResultCode::Succeeded)
     {
-      SET_ERROR_RESULT(m_Error, ResultCode::ImageUnsupported,
-                       "EXR file detected, but couldn't load with LoadEXRImageFromMemory %d: '%s'",
-                       ret, errString.c_str());
+      m_Error = res;
       FileIO::fclose(f);
       return;
     }
 
-    texDetails.width = exrImage.width;
-    texDetails.height = exrImage.height;
-
-    datasize = texDetails.width * texDetails.height * 4 * sizeof(float);
-    data = (byte *)malloc(datasize);
-
-    if(!data)
-    {
-      SET_ERROR_RESULT(m_Error, ResultCode::ReplayOutOfMemory,
-                       "Allocation for %zu bytes failed for EXR data", datasize);
-      return;
-    }
-
-    int channels[4] = {-1, -1, -1, -1};
-    for(int i = 0; i < exrImage.num_channels; i++)
-    {
-      switch(exrHeader.channels[i].name[0])
-      {
-        case 'R': channels[0] = i; break;
-        case 'G': channels[1] = i; break;
-        case 'B': channels[2] = i; break;
-        case 'A': channels[3] = i; break;
-      }
-    }
-
-    float *rgba = (float *)data;
-    float **src = (float **)exrImage.images;
-
-    for(uint32_t i = 0; i < texDetails.width * texDetails.height; i++)
-    {
-      for(int c = 0; c < 4; c++)
-      {
-        if(channels[c] >= 0)
-          rgba[i * 4 + c] = src[channels[c]][i];
-        else if(c < 3)    // RGB channels default to 0
-          rgba[i * 4 + c] = 0.0f;
-        else    // alpha defaults to 1
-          rgba[i * 4 + c] = 1.0f;
-      }
-    }
-
-    ret = FreeEXRImage(&exrImage);
-
-    // shouldn't get here but let's be safe
-    if(ret != 0)
-    {
-      free(data);
-      SET_ERROR_RESULT(m_Error, ResultCode::ImageUnsupported,
-                       "EXR file detected, but failed during parsing");
-      FileIO::fclose(f);
-      return;
-    }
+    datasize = m_FileData.size();
   }
   else if(stbi_is_hdr_from_file(f))
   {
@@ -823,9 +981,16 @@ void ImageViewer::RefreshFile()
     datasize = texDetails.width * texDetails.height * 4 * sizeof(byte);
   }
 
+  // stb allocates its own memory, take a copy so that all the formats are stored the same way
+  if(data)
+  {
+    m_FileData.assign(data, datasize);
+    free(data);
+  }
+
   // if we don't have data at this point (and we're not a dds file) then the
   // file was corrupted and we failed to load it
-  if(!dds && data == NULL)
+  if(!dds && m_FileData.empty())
   {
     SET_ERROR_RESULT(m_Error, ResultCode::ImageUnsupported, "Image failed to load");
     FileIO::fclose(f);
@@ -836,13 +1001,38 @@ void ImageViewer::RefreshFile()
   m_FrameRecord.frameInfo.persistentSize = 0;
   m_FrameRecord.frameInfo.uncompressedFileSize = datasize;
 
-  read_dds_data read_data = {};
-
   if(dds)
   {
-    FileIO::fseek64(f, 0, SEEK_SET);
-    StreamReader reader(f);
-    RDResult res = load_dds_from_file(&reader, read_data);
+    read_dds_data read_data = {};
+
+    RDResult res;
+    const byte *ddsData = NULL;
+
+    // if the subresources can be used straight from the file, map it so that only what is viewed
+    // needs to be read from disk
+    if(ImageViewer_MapFiles())
+    {
+      FileIO::fseek64(f, 0, SEEK_SET);
+      StreamReader reader(f, fileSize, Ownership::Nothing);
+      res = load_dds_layout_from_file(&reader, read_data);
+
+      if(res == ResultCode::Succeeded && read_data.buffer.empty())
+      {
+        m_FileMapping = FileIO::fmap(f, 0, fileSize, &ddsData);
+
+        if(!m_FileMapping)
+          read_data = read_dds_data();
+      }
+    }
+
+    if(!ImageViewer_MapFiles() || (res == ResultCode::Succeeded && read_data.subresources.empty()))
+    {
+      FileIO::fseek64(f, 0, SEEK_SET);
+      StreamReader reader(f, fileSize, Ownership::Nothing);
+      res = load_dds_from_file(&reader, read_data);
+    }
+
+    FileIO::fclose(f);
     f = NULL;
 
     if(res != ResultCode::Succeeded)
@@ -851,6 +1041,15 @@ void ImageViewer::RefreshFile()
       return;
     }
 
+    if(!m_FileMapping)
+    {
+      m_FileData.swap(read_data.buffer);
+      ddsData = m_FileData.data();
+    }
+
+    for(const rdcpair<size_t, size_t> &sub : read_data.subresources)
+      m_SubresourceData.push_back({ddsData + sub.first, sub.second});
+
     texDetails.cubemap = read_data.cubemap;
     texDetails.arraysize = read_data.slices;
     texDetails.width = read_data.width;
@@ -884,7 +1083,11 @@ void ImageViewer::RefreshFile()
 
     m_FrameRecord.frameInfo.uncompressedFileSize = 0;
     for(uint32_t i = 0; i < texDetails.arraysize * texDetails.mips; i++)
-      m_FrameRecord.frameInfo.uncompressedFileSize += read_data.subresources[i].second;
+      m_FrameRecord.frameInfo.uncompressedFileSize += m_SubresourceData[i].second;
+  }
+  else
+  {
+    m_SubresourceData.push_back({m_FileData.data(), m_FileData.size()});
   }
 
   m_FrameRecord.frameInfo.compressedFileSize = m_FrameRecord.frameInfo.uncompressedFileSize;
@@ -906,38 +1109,36 @@ void ImageViewer::RefreshFile()
   m_TexDetails = texDetails;
 
   if(m_TextureID == ResourceId())
-    CreateProxyTexture(texDetails, read_data);
+  {
+    m_ProxyDetails = texDetails;
+    CreateProxyTexture(m_ProxyDetails, dds);
+  }
 
   if(m_TextureID == ResourceId())
   {
     SET_ERROR_RESULT(m_Error, ResultCode::APIInitFailed,
                      "Couldn't create proxy texture for image file");
   }
+  else
+  {
+    // nothing is uploaded until it's first needed
+    m_Uploaded.fill(m_ProxyDetails.arraysize * m_ProxyDetails.mips, false);
+  }
 
   m_TexDetails.resourceId = m_TextureID;
   m_TexDetails.byteSize = fileSize;
 
-  if(!dds)
-  {
-    m_Proxy->SetProxyTextureData(m_TextureID, Subresource(), data, datasize);
-    free(data);
-  }
-  else
-  {
-    for(uint32_t i = 0; i < texDetails.arraysize * texDetails.mips; i++)
-    {
-      m_Proxy->SetProxyTextureData(m_TextureID, {i % texDetails.mips, i / texDetails.mips},
-                                   read_data.buffer.data() + read_data.subresources[i].first,
-                                   read_data.subresources[i].second);
-    }
-  }
+  m_ReturnRealData = m_ProxyDecodeBlocks || m_ProxyConvertFloat ||
+                     CanCalculateTextureStats(m_TexDetails.format, CompType::Typeless);
 
   if(f != NULL)
     FileIO::fclose(f);
 }
 
-void ImageViewer::CreateProxyTexture(TextureDescription &texDetails, read_dds_data &read_data)
+void ImageViewer::CreateProxyTexture(TextureDescription &texDetails, bool dds)
 {
+  m_ProxyArrayFrom3D = m_ProxyDecodeBlocks = m_ProxyConvertFloat = false;
+
   if(m_Proxy->IsTextureSupported(texDetails))
   {
     m_TextureID = m_Proxy->CreateProxyTexture(texDetails);
@@ -958,30 +1159,26 @@ void ImageViewer::CreateProxyTexture(TextureDescription &texDetails, read_dds_da
       {
         texDetails = arrayDetails;
         m_TextureID = m_Proxy->CreateProxyTexture(arrayDetails);
+        m_ProxyArrayFrom3D = true;
+        return;
+      }
+    }
 
-        rdcarray<rdcpair<size_t, size_t>> oldSubs;
-        oldSubs.swap(read_data.subresources);
-
-        // reformat the subresources. The data doesn't change we just add new offsets/sizes
-        for(uint32_t i = 0; i < texDetails.arraysize * texDetails.mips; i++)
-        {
-          const uint32_t mip = i % texDetails.mips;
-          const uint32_t slice = i / texDetails.mips;
-
-          // size of each subresource is 1/Nth for an N-sized array
-          size_t size = oldSubs[mip].second / texDetails.arraysize;
-
-          // and the offset is slice steps further on
-          size_t offset = oldSubs[mip].first + size * slice;
-
-          read_data.subresources.push_back({offset, size});
-        }
+    // block compressed formats can be decoded on the CPU, then displayed directly if possible or
+    // converted further below.
+    if(dds && IsBlockCompressionSupported(texDetails.format))
+    {
+      texDetails.format = GetBlockUncompressedFormat(texDetails.format);
+      m_ProxyDecodeBlocks = true;
 
+      if(m_Proxy->IsTextureSupported(texDetails))
+      {
+        m_TextureID = m_Proxy->CreateProxyTexture(texDetails);
         return;
       }
     }
 
-    if(read_data.width != 0)
+    if(dds)
     {
       // see if we can convert this format on the CPU for proxying
       bool convertSupported = false;
@@ -989,52 +1186,6 @@ void ImageViewer::CreateProxyTexture(TextureDescription &texDetails, read_dds_da
 
       if(convertSupported)
       {
-        uint32_t srcStride = texDetails.format.ElementSize();
-
-        if(texDetails.format.type == ResourceFormatType::D16S8)
-          srcStride = 4;
-        else if(texDetails.format.type == ResourceFormatType::D32S8)
-          srcStride = 8;
-
-        m_RealTexData.resize(texDetails.arraysize * texDetails.mips);
-
-        bytebuf convertedData;
-
-        for(uint32_t i = 0; i < texDetails.arraysize * texDetails.mips; i++)
-        {
-          const uint32_t mip = i % texDetails.mips;
-
-          const uint32_t mipwidth = RDCMAX(1U, texDetails.width >> mip);
-          const uint32_t mipheight = RDCMAX(1U, texDetails.height >> mip);
-          const uint32_t mipdepth = RDCMAX(1U, texDetails.depth >> mip);
-
-          byte *old = read_data.buffer.data() + read_data.subresources[i].first;
-          m_RealTexData[i].assign(old, read_data.subresources[i].second);
-
-          read_data.subresources[i].first = convertedData.size();
-          read_data.subresources[i].second = sizeof(FloatVector) * mipwidth * mipheight * mipdepth;
-          convertedData.resize(convertedData.size() + read_data.subresources[i].second);
-          byte *converted = convertedData.data() + read_data.subresources[i].first;
-
-          byte *src = old;
-          FloatVector *dst = (FloatVector *)converted;
-
-          for(uint32_t z = 0; z < mipdepth; z++)
-          {
-            for(uint32_t y = 0; y < mipheight; y++)
-            {
-              for(uint32_t x = 0; x < mipwidth; x++)
-              {
-                *dst = DecodeFormattedComponents(texDetails.format, src);
-                dst++;
-                src += srcStride;
-              }
-            }
-          }
-        }
-
-        read_data.buffer.swap(convertedData);
-
         ResourceFormat rgba32_float;
         rgba32_float.type = ResourceFormatType::Regular;
         rgba32_float.compByteWidth = 4;
@@ -1043,6 +1194,7 @@ void ImageViewer::CreateProxyTexture(TextureDescription &texDetails, read_dds_da
 
         texDetails.format = rgba32_float;
         m_TextureID = m_Proxy->CreateProxyTexture(texDetails);
+        m_ProxyConvertFloat = true;
       }
       else
       {
@@ -1057,3 +1209,167 @@ void ImageViewer::CreateProxyTexture(TextureDescription &texDetails, read_dds_da
     }
   }
 }
+
+void ImageViewer::UploadSubresource(uint32_t idx)
+{
+  const uint32_t mip = idx % m_ProxyDetails.mips;
+  const uint32_t slice = idx / m_ProxyDetails.mips;
+
+  m_Uploaded[idx] = true;
+
+  const byte *data = NULL;
+  size_t size = 0;
+
+  bytebuf decoded, converted;
+
+  if(m_ProxyArrayFrom3D)
+  {
+    // each mip of the 3D texture is split evenly between the array slices
+    if(mip >= m_SubresourceData.size())
+      return;
+
+    size = m_SubresourceData[mip].second / m_ProxyDetails.arraysize;
+    data = m_SubresourceData[mip].first + size * slice;
+  }
+  else
+  {
+    if(idx >= m_SubresourceData.size())
+      return;
+
+    data = m_SubresourceData[idx].first;
+    size = m_SubresourceData[idx].second;
+  }
+
+  const uint32_t mipwidth = RDCMAX(1U, m_ProxyDetails.width >> mip);
+  const uint32_t mipheight = RDCMAX(1U, m_ProxyDetails.height >> mip);
+  const uint32_t mipdepth = RDCMAX(1U, m_ProxyDetails.depth >> mip);
+
+  ResourceFormat fmt = m_TexDetails.format;
+
+  if(m_ProxyDecodeBlocks)
+  {
+    const size_t sliceSize = GetBlockCompressedSize(fmt, mipwidth, mipheight);
+
+    for(uint32_t z = 0; z < mipdepth && (z + 1) * sliceSize <= size; z++)
+      decoded.append(DecodeBlocks(fmt, mipwidth, mipheight, data + z * sliceSize));
+
+    fmt = GetBlockUncompressedFormat(fmt);
+    data = decoded.data();
+    size = decoded.size();
+  }
+
+  if(m_ProxyConvertFloat)
+  {
+    size_t srcStride = fmt.ElementSize();
+
+    if(fmt.type == ResourceFormatType::D16S8)
+      srcStride = 4;
+    else if(fmt.type == ResourceFormatType::D32S8)
+      srcStride = 8;
+
+    const size_t count = RDCMIN(size_t(mipwidth) * mipheight * mipdepth, size / srcStride);
+
+    converted.resize(sizeof(FloatVector) * mipwidth * mipheight * mipdepth);
+
+    // convert in batches spread across the job system
+    const size_t batchSize = 64 * 1024;
+    const uint32_t numBatches = uint32_t((count + batchSize - 1) / batchSize);
+    const byte *src = data;
+    FloatVector *dst = (FloatVector *)converted.data();
+
+    Threading::JobSystem::ParallelFor(numBatches, [&](uint32_t batch) {
+      const size_t first = batch * batchSize;
+      DecodeFormattedComponents(fmt, src + first * srcStride, srcStride, dst + first,
+                                RDCMIN(batchSize, count - first));
+    });
+
+    data = converted.data();
+    size = converted.size();
+  }
+
+  m_Proxy->SetProxyTextureData(m_TextureID, {mip, slice}, (byte *)data, size);
+}
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+
+TEST_CASE("Check EXR files decode in parallel", "[image]")
+{
+  // enough rows for many blocks of scanlines, with a partial block at the end
+  const uint32_t width = 67, height = 203;
+
+  // no alpha channel, to check it's filled in
+  float *planes[3] = {};
+  rdcarray<float> bgr[3];
+  for(int c = 0; c < 3; c++)
+  {
+    bgr[c].resize(width * height);
+    for(uint32_t i = 0; i < width * height; i++)
+      bgr[c][i] = float(i % 1013) * 0.25f - float(c) * 100.0f;
+    planes[c] = bgr[c].data();
+  }
+
+  const int compressionTypes[] = {
+      TINYEXR_COMPRESSIONTYPE_NONE,
+      TINYEXR_COMPRESSIONTYPE_ZIP,
+      TINYEXR_COMPRESSIONTYPE_PIZ,
+  };
+
+  for(int compression : compressionTypes)
+  {
+    INFO("Compression type: " << compression);
+
+    EXRHeader exrHeader;
+    InitEXRHeader(&exrHeader);
+
+    EXRImage exrImage;
+    InitEXRImage(&exrImage);
+
+    int pixTypes[3] = {TINYEXR_PIXELTYPE_FLOAT, TINYEXR_PIXELTYPE_FLOAT, TINYEXR_PIXELTYPE_FLOAT};
+    EXRChannelInfo bgrChannels[3] = {{"B"}, {"G"}, {"R"}};
+
+    exrHeader.num_channels = 3;
+    exrHeader.channels = bgrChannels;
+    exrHeader.pixel_types = pixTypes;
+    exrHeader.requested_pixel_types = pixTypes;
+    exrHeader.compression_type = compression;
+    exrImage.images = (unsigned char **)planes;
+    exrImage.width = width;
+    exrImage.height = height;
+
+    unsigned char *mem = NULL;
+    const char *err = NULL;
+    size_t size = SaveEXRImageToMemory(&exrImage, &exrHeader, &mem, &err);
+    REQUIRE(size > 0);
+
+    uint32_t w = 0, h = 0;
+    bytebuf rgba;
+    RDResult res = LoadEXRImage(mem, size, w, h, rgba);
+
+    CHECK(res.code == ResultCode::Succeeded);
+    CHECK(w == width);
+    CHECK(h == height);
+    REQUIRE(rgba.size() == size_t(width) * height * 4 * sizeof(float));
+
+    const float *texels = (const float *)rgba.data();
+
+    uint32_t mismatches = 0;
+    for(uint32_t i = 0; i < width * height; i++)
+    {
+      if(texels[i * 4 + 0] != bgr[2][i] || texels[i * 4 + 1] != bgr[1][i] ||
+         texels[i * 4 + 2] != bgr[0][i] || texels[i * 4 + 3] != 1.0f)
+        mismatches++;
+    }
+
+    CHECK(mismatches == 0);
+
+    // a file cut off part way through the blocks fails cleanly
+    res = LoadEXRImage(mem, size / 2, w, h, rgba);
+    CHECK(res.code != ResultCode::Succeeded);
+
+    free(mem);
+  }
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -0,0 +1,522 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019-2022 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "remote_resource_cache.h"
+#include <algorithm>
+#include "common/formatting.h"
+#include "common/timing.h"
+#include "core/settings.h"
+#include "serialise/lz4io.h"
+#include "serialise/rdcfile.h"
+#include "serialise/serialiser.h"
+#include "serialise/streamio.h"
+#include "zstd/xxhash.h"
+
+RDOC_CONFIG(uint32_t, RemoteServer_ResourceCacheSizeMB, 4096,
+            "The maximum size in megabytes of resource contents from remote servers kept on disk "
+            "between sessions.");
+
+static const uint32_t RemoteCacheContentsMagic = MAKE_FOURCC('R', 'D', '$', 'C');
+static const uint32_t RemoteCacheIndexMagic = MAKE_FOURCC('R', 'D', '$', 'I');
+static const uint32_t RemoteCacheVersion = 1;
+
+template <typename SerialiserType>
+void DoSerialise(SerialiserType &ser, RemoteContentHash &el)
+{
+  SERIALISE_MEMBER(hash);
+  SERIALISE_MEMBER(size);
+}
+
+INSTANTIATE_SERIALISE_TYPE(RemoteContentHash);
+
+RemoteContentHash HashRemoteContents(const bytebuf &data)
+{
+  RemoteContentHash ret;
+  ret.hash = XXH64(data.data(), data.size(), 0);
+  ret.size = data.size();
+  return ret;
+}
+
+uint64_t HashRemoteCacheKey(uint64_t seed, const void *data, size_t size)
+{
+  return XXH64(data, size, seed);
+}
+
+uint64_t HashCaptureIdentity(const RDCFile *rdc)
+{
+  // hash everything cheaply available that identifies when and where the capture was made, and the
+  // shape of its contents. This avoids reading through what could be gigabytes of capture data.
+  const rdcstr &driverName = rdc->GetDriverName();
+  uint64_t ret = HashRemoteCacheKey(0, driverName.c_str(), driverName.size());
+  ret = HashRemoteCacheKey(ret, rdc->GetMachineIdent());
+  ret = HashRemoteCacheKey(ret, rdc->GetTimestampBase());
+  ret = HashRemoteCacheKey(ret, rdc->GetTimestampFrequency());
+
+  const RDCThumb &thumb = rdc->GetThumbnail();
+  ret = HashRemoteCacheKey(ret, thumb.pixels.data(), thumb.pixels.size());
+
+  for(int i = 0; i < rdc->NumSections(); i++)
+  {
+    const SectionProperties &props = rdc->GetSectionProperties(i);
+    ret = HashRemoteCacheKey(ret, props.name.c_str(), props.name.size());
+    ret = HashRemoteCacheKey(ret, props.type);
+    ret = HashRemoteCacheKey(ret, props.version);
+    ret = HashRemoteCacheKey(ret, props.uncompressedSize);
+    ret = HashRemoteCacheKey(ret, props.compressedSize);
+  }
+
+  return ret;
+}
+
+RemoteResourceCache::RemoteResourceCache(uint64_t captureHash, const rdcstr &root)
+{
+  m_Root = root.empty() ? FileIO::GetAppFolderFilename("remote_cache/") : root;
+  m_IndexFilename = m_Root + StringFormat::Fmt("%016llx.idx", captureHash);
+
+  LoadIndex();
+}
+
+RemoteResourceCache::~RemoteResourceCache()
+{
+  for(Threading::JobSystem::Job *job : m_PendingWrites)
+    Threading::JobSystem::SyncJob(job);
+  m_PendingWrites.clear();
+
+  SaveIndex();
+  TrimContents();
+}
+
+rdcstr RemoteResourceCache::GetContentsFilename(const RemoteContentHash &hash)
+{
+  return m_Root + StringFormat::Fmt("%016llx_%llx.bin", hash.hash, hash.size);
+}
+
+RemoteContentHash RemoteResourceCache::Lookup(uint64_t key)
+{
+  SCOPED_LOCK(m_Lock);
+
+  auto it = m_Index.find(key);
+  if(it == m_Index.end())
+    return RemoteContentHash();
+
+  // the contents may have been trimmed since the index was written, possibly by another capture
+  if(!FileIO::exists(GetContentsFilename(it->second)))
+  {
+    m_Index.erase(it);
+    m_IndexDirty = true;
+    return RemoteContentHash();
+  }
+
+  return it->second;
+}
+
+bool RemoteResourceCache::Load(const RemoteContentHash &hash, bytebuf &contents)
+{
+  if(ReadContents(hash, contents))
+    return true;
+
+  // whatever the reason the contents couldn't be used, make sure they're never offered again.
+  // Otherwise the remote server would keep reporting a hit for contents we can't load.
+  RDCWARN("Cached remote contents %s are unusable", GetContentsFilename(hash).c_str());
+
+  contents.clear();
+  Discard(hash);
+
+  return false;
+}
+
+bool RemoteResourceCache::ReadContents(const RemoteContentHash &hash, bytebuf &contents)
+{
+  StreamReader fileReader(FileIO::fopen(GetContentsFilename(hash), FileIO::ReadBinary));
+
+  uint32_t magic = 0, version = 0;
+  uint64_t size = 0;
+  fileReader.Read(magic);
+  fileReader.Read(version);
+  fileReader.Read(size);
+
+  if(fileReader.IsErrored() || magic != RemoteCacheContentsMagic ||
+     version != RemoteCacheVersion || size != hash.size)
+    return false;
+
+  {
+    StreamReader compressedReader(new LZ4Decompressor(&fileReader, Ownership::Nothing), size,
+                                  Ownership::Stream);
+
+    contents.resize((size_t)size);
+    compressedReader.Read(contents.data(), size);
+
+    if(compressedReader.IsErrored())
+      return false;
+  }
+
+  // a corrupted or truncated file must never be used in place of the real contents
+  return HashRemoteContents(contents) == hash;
+}
+
+void RemoteResourceCache::Discard(const RemoteContentHash &hash)
+{
+  FileIO::Delete(GetContentsFilename(hash));
+
+  SCOPED_LOCK(m_Lock);
+
+  // contents are shared between keys, so drop every entry that refers to them
+  for(auto it = m_Index.begin(); it != m_Index.end();)
+  {
+    if(it->second == hash)
+    {
+      it = m_Index.erase(it);
+      m_IndexDirty = true;
+    }
+    else
+    {
+      ++it;
+    }
+  }
+}
+
+void RemoteResourceCache::Store(uint64_t key, const bytebuf &contents)
+{
+  // take a copy now, the caller's data will continue to be modified by later fetches
+  bytebuf *data = new bytebuf(contents);
+
+  m_PendingWrites.push_back(Threading::JobSystem::AddJob([this, key, data]() {
+    RemoteContentHash hash = HashRemoteContents(*data);
+
+    {
+      SCOPED_LOCK(m_Lock);
+      auto it = m_Index.find(key);
+      if(it != m_Index.end() && it->second == hash)
+      {
+        delete data;
+        return;
+      }
+    }
+
+    rdcstr filename = GetContentsFilename(hash);
+
+    // contents are shared between keys and captures, so they may already be on disk
+    if(!FileIO::exists(filename))
+    {
+      // write to a temporary file first so a partially written file is never found
+      rdcstr tmpFilename = filename + StringFormat::Fmt(".%llx.tmp", key);
+
+      FileIO::CreateParentDirectory(tmpFilename);
+      FILE *f = FileIO::fopen(tmpFilename, FileIO::WriteBinary);
+
+      bool success = false;
+
+      if(f)
+      {
+        StreamWriter fileWriter(f, Ownership::Stream);
+
+        fileWriter.Write(RemoteCacheContentsMagic);
+        fileWriter.Write(RemoteCacheVersion);
+        fileWriter.Write(hash.size);
+
+        {
+          StreamWriter compressedWriter(new LZ4Compressor(&fileWriter, Ownership::Nothing),
+                                        Ownership::Stream);
+          compressedWriter.Write(data->data(), data->size());
+          compressedWriter.Finish();
+
+          success = !compressedWriter.IsErrored();
+        }
+
+        success = success && !fileWriter.IsErrored();
+      }
+
+      if(success)
+        success = FileIO::Move(tmpFilename, filename, true);
+
+      if(!success)
+      {
+        RDCWARN("Couldn't write cached remote contents to %s", filename.c_str());
+        FileIO::Delete(tmpFilename);
+        delete data;
+        return;
+      }
+    }
+
+    delete data;
+
+    {
+      SCOPED_LOCK(m_Lock);
+      m_Index[key] = hash;
+      m_IndexDirty = true;
+    }
+  }));
+}
+
+void RemoteResourceCache::LoadIndex()
+{
+  StreamReader fileReader(FileIO::fopen(m_IndexFilename, FileIO::ReadBinary));
+
+  uint32_t magic = 0, version = 0, numEntries = 0;
+  fileReader.Read(magic);
+  fileReader.Read(version);
+  fileReader.Read(numEntries);
+
+  if(fileReader.IsErrored() || magic != RemoteCacheIndexMagic || version != RemoteCacheVersion)
+    return;
+
+  for(uint32_t i = 0; i < numEntries; i++)
+  {
+    uint64_t key = 0;
+    RemoteContentHash hash;
+    fileReader.Read(key);
+    fileReader.Read(hash.hash);
+    fileReader.Read(hash.size);
+
+    if(fileReader.IsErrored())
+    {
+      m_Index.clear();
+      return;
+    }
+
+    m_Index[key] = hash;
+  }
+
+  RDCDEBUG("Loaded %u cached remote resource entries", numEntries);
+}
+
+void RemoteResourceCache::SaveIndex()
+{
+  if(!m_IndexDirty)
+    return;
+
+  FileIO::CreateParentDirectory(m_IndexFilename);
+  FILE *f = FileIO::fopen(m_IndexFilename, FileIO::WriteBinary);
+
+  if(!f)
+  {
+    RDCERR("Error opening remote resource cache index for write");
+    return;
+  }
+
+  StreamWriter fileWriter(f, Ownership::Stream);
+
+  uint32_t numEntries = (uint32_t)m_Index.size();
+
+  fileWriter.Write(RemoteCacheIndexMagic);
+  fileWriter.Write(RemoteCacheVersion);
+  fileWriter.Write(numEntries);
+
+  for(auto it = m_Index.begin(); it != m_Index.end(); ++it)
+  {
+    fileWriter.Write(it->first);
+    fileWriter.Write(it->second.hash);
+    fileWriter.Write(it->second.size);
+  }
+
+  m_IndexDirty = false;
+}
+
+void RemoteResourceCache::TrimContents()
+{
+  rdcarray<PathEntry> entries;
+  FileIO::GetFilesInDirectory(m_Root, entries);
+
+  rdcarray<PathEntry> contents;
+  uint64_t totalSize = 0;
+
+  for(const PathEntry &entry : entries)
+  {
+    if(entry.filename.endsWith(".bin"))
+    {
+      contents.push_back(entry);
+      totalSize += entry.size;
+    }
+  }
+
+  const uint64_t maxSize = uint64_t(RemoteServer_ResourceCacheSizeMB()) * 1024 * 1024;
+
+  if(totalSize <= maxSize)
+    return;
+
+  // remove the oldest contents first. Any index entries referring to them are dropped on lookup
+  std::sort(contents.begin(), contents.end(),
+            [](const PathEntry &a, const PathEntry &b) { return a.lastmod < b.lastmod; });
+
+  for(const PathEntry &entry : contents)
+  {
+    if(totalSize <= maxSize)
+      break;
+
+    FileIO::Delete(m_Root + entry.filename);
+    totalSize -= entry.size;
+  }
+}
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+
+TEST_CASE("Test remote resource cache", "[remotecache]")
+{
+  // use a directory of our own so the real cache is never touched, and a random capture hash so
+  // that we don't see anything from previous runs
+  const uint64_t captureHash = HashRemoteCacheKey(0, Timing::GetTick());
+  const rdcstr root = FileIO::GetTempFolderFilename() + "renderdoc_remote_cache_test/";
+
+  bytebuf a, b;
+  a.resize(100000);
+  b.resize(100000);
+  for(size_t i = 0; i < a.size(); i++)
+  {
+    a[i] = byte(i * 3);
+    b[i] = byte(i * 5);
+  }
+
+  RemoteContentHash hashA = HashRemoteContents(a);
+  RemoteContentHash hashB = HashRemoteContents(b);
+
+  CHECK(hashA.IsValid());
+  CHECK((hashA != hashB));
+
+  rdcstr indexFilename;
+
+  {
+    RemoteResourceCache cache(captureHash, root);
+
+    CHECK_FALSE(cache.Lookup(1).IsValid());
+
+    cache.Store(1, a);
+    cache.Store(2, b);
+    // identical contents under another key are only stored once
+    cache.Store(3, a);
+  }
+
+  {
+    RemoteResourceCache cache(captureHash, root);
+
+    CHECK((cache.Lookup(1) == hashA));
+    CHECK((cache.Lookup(2) == hashB));
+    CHECK((cache.Lookup(3) == hashA));
+    CHECK_FALSE(cache.Lookup(4).IsValid());
+
+    bytebuf data;
+    CHECK(cache.Load(hashA, data));
+    CHECK(data == a);
+    CHECK(cache.Load(hashB, data));
+    CHECK(data == b);
+
+    // contents with a different hash aren't returned
+    RemoteContentHash wrong = hashA;
+    wrong.hash ^= 1;
+    CHECK_FALSE(cache.Load(wrong, data));
+  }
+
+  // a different capture doesn't see these entries
+  {
+    RemoteResourceCache cache(captureHash + 1, root);
+    CHECK_FALSE(cache.Lookup(1).IsValid());
+  }
+
+  // unusable contents are removed along with every key referring to them, so they're never offered
+  // again. This covers files truncated by a crash, and files from an older version of the cache
+  // which share the same name
+  bytebuf c, d;
+  c.resize(50000);
+  d.resize(50000);
+  for(size_t i = 0; i < c.size(); i++)
+  {
+    c[i] = byte(i * 7);
+    d[i] = byte(i * 11);
+  }
+
+  RemoteContentHash hashC = HashRemoteContents(c);
+  RemoteContentHash hashD = HashRemoteContents(d);
+
+  const rdcstr filenameC = root + StringFormat::Fmt("%016llx_%llx.bin", hashC.hash, hashC.size);
+  const rdcstr filenameD = root + StringFormat::Fmt("%016llx_%llx.bin", hashD.hash, hashD.size);
+
+  {
+    RemoteResourceCache cache(captureHash, root);
+    cache.Store(10, c);
+    cache.Store(11, c);
+    cache.Store(12, d);
+  }
+
+  bytebuf fileData;
+
+  SECTION("Truncated contents")
+  {
+    REQUIRE(FileIO::ReadAll(filenameC, fileData));
+    fileData.resize(fileData.size() / 2);
+    REQUIRE(FileIO::WriteAll(filenameC, fileData));
+
+    RemoteResourceCache cache(captureHash, root);
+
+    REQUIRE((cache.Lookup(10) == hashC));
+
+    bytebuf data;
+    CHECK_FALSE(cache.Load(hashC, data));
+    CHECK(data.empty());
+
+    CHECK_FALSE(FileIO::exists(filenameC));
+    CHECK_FALSE(cache.Lookup(10).IsValid());
+    CHECK_FALSE(cache.Lookup(11).IsValid());
+
+    // other contents are unaffected
+    CHECK((cache.Lookup(12) == hashD));
+    CHECK(cache.Load(hashD, data));
+    CHECK(data == d);
+  }
+
+  SECTION("Contents from a different cache version")
+  {
+    REQUIRE(FileIO::ReadAll(filenameD, fileData));
+    REQUIRE(fileData.size() > 8);
+    // the version follows the magic
+    uint32_t version = RemoteCacheVersion + 1;
+    memcpy(fileData.data() + sizeof(uint32_t), &version, sizeof(version));
+    REQUIRE(FileIO::WriteAll(filenameD, fileData));
+
+    {
+      RemoteResourceCache cache(captureHash, root);
+
+      REQUIRE((cache.Lookup(12) == hashD));
+
+      bytebuf data;
+      CHECK_FALSE(cache.Load(hashD, data));
+
+      CHECK_FALSE(FileIO::exists(filenameD));
+      CHECK_FALSE(cache.Lookup(12).IsValid());
+      CHECK((cache.Lookup(10) == hashC));
+    }
+
+    // the removal is persisted in the index
+    RemoteResourceCache cache(captureHash, root);
+    CHECK_FALSE(cache.Lookup(12).IsValid());
+    CHECK((cache.Lookup(10) == hashC));
+  }
+
+  rdcarray<PathEntry> entries;
+  FileIO::GetFilesInDirectory(root, entries);
+  for(const PathEntry &entry : entries)
+    FileIO::Delete(root + entry.filename);
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -0,0 +1,104 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019-2022 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include <map>
+#include "common/common.h"
+#include "common/threading.h"
+
+class RDCFile;
+
+// identifies the contents of a resource fetched from a remote server. Two fetches with the same
+// hash are assumed to have identical contents, so the data only needs to be stored once.
+struct RemoteContentHash
+{
+  uint64_t hash = 0;
+  uint64_t size = 0;
+
+  bool IsValid() const { return hash != 0 || size != 0; }
+  bool operator==(const RemoteContentHash &o) const { return hash == o.hash && size == o.size; }
+  bool operator!=(const RemoteContentHash &o) const { return !(*this == o); }
+};
+
+DECLARE_REFLECTION_STRUCT(RemoteContentHash);
+
+RemoteContentHash HashRemoteContents(const bytebuf &data);
+
+// build a key for the cache from the parameters of a fetch. Chain calls together with the
+// previous result as the seed.
+uint64_t HashRemoteCacheKey(uint64_t seed, const void *data, size_t size);
+
+template <typename T>
+uint64_t HashRemoteCacheKey(uint64_t seed, const T &el)
+{
+  return HashRemoteCacheKey(seed, &el, sizeof(T));
+}
+
+// identifies a capture across connections, so that cached contents for a capture can be found
+// again the next time it's opened remotely.
+uint64_t HashCaptureIdentity(const RDCFile *rdc);
+
+// this cache only exists on the client side of a remote replay. It persists resource contents
+// that were fetched from the remote server to disk, so that when the same capture is opened again
+// we can tell the remote server what we already have and skip transferring it.
+//
+// The contents are stored once per content hash, shared between all captures. Each capture has
+// its own index mapping fetch keys (resource, event, subresource etc) to the content hash that was
+// last fetched for it.
+class RemoteResourceCache
+{
+public:
+  // the cache is stored under root, which defaults to remote_cache/ in the application folder
+  RemoteResourceCache(uint64_t captureHash, const rdcstr &root = rdcstr());
+  ~RemoteResourceCache();
+
+  // returns the content hash last stored for this key, if its contents are still available
+  RemoteContentHash Lookup(uint64_t key);
+
+  // load the contents for a hash. Fails if the contents are missing, unreadable or don't match
+  // the hash, in which case they are removed from the cache along with every key referring to them
+  bool Load(const RemoteContentHash &hash, bytebuf &contents);
+
+  // record the contents for a key. The contents are written to disk in the background
+  void Store(uint64_t key, const bytebuf &contents);
+
+private:
+  rdcstr GetContentsFilename(const RemoteContentHash &hash);
+  bool ReadContents(const RemoteContentHash &hash, bytebuf &contents);
+  void Discard(const RemoteContentHash &hash);
+
+  void LoadIndex();
+  void SaveIndex();
+  void TrimContents();
+
+  rdcstr m_Root;
+  rdcstr m_IndexFilename;
+
+  Threading::CriticalSection m_Lock;
+  std::map<uint64_t, RemoteContentHash> m_Index;
+  bool m_IndexDirty = false;
+
+  rdcarray<Threading::JobSystem::Job *> m_PendingWrites;
+};
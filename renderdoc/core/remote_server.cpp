@@ -24,12 +24,15 @@
  ******************************************************************************/
 
 #include "remote_server.h"
+#include <algorithm>
 #include <utility>
 #include "android/android.h"
 #include "api/replay/renderdoc_replay.h"
 #include "api/replay/version.h"
 #include "common/threading.h"
+#include "core/block_transfer.h"
 #include "core/core.h"
+#include "core/remote_resource_cache.h"
 #include "core/settings.h"
 #include "os/os_specific.h"
 #include "replay/replay_controller.h"
@@ -45,6 +48,11 @@ RDOC_CONFIG(bool, RemoteServer_DebugLogging, false,
             "Output a verbose logging file in the system's temporary folder containing the "
             "traffic to and from the remote server.");
 
+RDOC_CONFIG(uint32_t, RemoteServer_TransferCacheSizeMB, 8192,
+            "The maximum size in megabytes of captures copied to the remote server that are kept "
+            "after the connection closes, so that copying the same capture again only transfers "
+            "what has changed.");
+
 #define MAKE_REMOTE_SERVER_VERSION(maj, min) uint32_t((maj)*1000) + (min)
 
 static const uint32_t RemoteServerProtocolVersion =
@@ -261,6 +269,49 @@ static bool HandleHandshakeClient(ActiveClient &activeClient, ClientThread *thre
   return activeConnectionEstablished;
 }
 
+static rdcstr GetTransferFolder()
+{
+  rdcstr path, dummy, dummy2;
+  FileIO::GetDefaultFiles("remotecopy", path, dummy, dummy2);
+
+  return get_dirname(path) + "/remote_transfers/";
+}
+
+static void TrimTransferFolder()
+{
+  rdcstr folder = GetTransferFolder();
+
+  rdcarray<PathEntry> files;
+  FileIO::GetFilesInDirectory(folder, files);
+
+  uint64_t totalSize = 0;
+  for(const PathEntry &f : files)
+    totalSize += f.size;
+
+  const uint64_t maxSize = uint64_t(RemoteServer_TransferCacheSizeMB()) * 1024 * 1024;
+
+  if(totalSize <= maxSize)
+    return;
+
+  // remove the least recently written copies first
+  std::sort(files.begin(), files.end(),
+            [](const PathEntry &a, const PathEntry &b) { return a.lastmod < b.lastmod; });
+
+  for(const PathEntry &f : files)
+  {
+    if(totalSize <= maxSize)
+      break;
+
+    if(f.flags & PathProperty::Directory)
+      continue;
+
+    RDCLOG("Removing old transferred capture '%s'", f.filename.c_str());
+
+    FileIO::Delete(folder + f.filename);
+    totalSize -= f.size;
+  }
+}
+
 static void ActiveRemoteClientThread(ClientThread *threadData,
                                      RENDERDOC_PreviewWindowCallback previewWindow)
 {
@@ -305,8 +356,6 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
   writer.SetStreamingMode(true);
   reader.SetStreamingMode(true);
 
-  uint32_t captureNum = 0;
-
   while(client)
   {
     if(client && !client->Connected())
@@ -392,10 +441,12 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
     else if(type == eRemoteServer_CopyCaptureFromRemote)
     {
       rdcstr path;
+      TransferBlockHashes hashes;
 
       {
         READ_DATA_SCOPE();
         SERIALISE_ELEMENT(path);
+        SERIALISE_ELEMENT(hashes);
       }
 
       reader.EndChunk();
@@ -404,48 +455,67 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
         WRITE_DATA_SCOPE();
         SCOPED_SERIALISE_CHUNK(eRemoteServer_CopyCaptureFromRemote);
 
-        StreamReader fileStream(FileIO::fopen(path, FileIO::ReadBinary));
-        ser.SerialiseStream(path, fileStream);
+        TransferStats stats = SendTransferBlocks(ser, path, hashes, NULL);
+        LogTransferStats("Sent", path, stats);
       }
     }
     else if(type == eRemoteServer_CopyCaptureToRemote)
     {
-      rdcstr path;
-      rdcstr dummy, dummy2;
-      FileIO::GetDefaultFiles("remotecopy", path, dummy, dummy2);
+      uint64_t key = 0;
 
-      // remove the .rdc
-      path.erase(path.size() - 4, 4);
+      {
+        READ_DATA_SCOPE();
+        SERIALISE_ELEMENT(key);
+      }
+
+      reader.EndChunk();
 
-      // append a process- and capture- specific suffix to avoid clashes
-      path += StringFormat::Fmt("_remotecopy_%u_%u.rdc", Process::GetCurrentPID(), captureNum);
-      captureNum++;
+      // copies are kept under a name derived from the client's path, so that copying the same
+      // capture again - or resuming an interrupted copy - only needs to send what's changed.
+      rdcstr path = GetTransferFolder() + StringFormat::Fmt("%016llx.rdc", key);
+      rdcstr partial = GetTransferFolder() + StringFormat::Fmt("%016llx.partial", key);
+
+      // an interrupted copy is always newer than the last completed one, so prefer it
+      rdcstr basis = FileIO::exists(partial) ? partial : path;
 
       RDCLOG("Copying file to local path '%s'.", path.c_str());
 
       FileIO::CreateParentDirectory(path);
 
       {
-        READ_DATA_SCOPE();
+        WRITE_DATA_SCOPE();
+        SCOPED_SERIALISE_CHUNK(eRemoteServer_CopyCaptureToRemote);
+        SERIALISE_ELEMENT_LOCAL(hashes, HashTransferBlocks(basis));
+      }
+
+      TransferStats stats;
+      RDResult result;
 
-        StreamWriter streamWriter(FileIO::fopen(path, FileIO::WriteBinary), Ownership::Stream);
+      {
+        READ_DATA_SCOPE();
+        RemoteServerPacket packet = ser.ReadChunk<RemoteServerPacket>();
 
-        ser.SerialiseStream(path, streamWriter, NULL);
+        if(packet == eRemoteServer_CopyCaptureToRemote)
+          result = ReceiveTransferBlocks(ser, basis, partial, NULL, stats);
+        else
+          SET_ERROR_RESULT(result, ResultCode::NetworkIOFailed,
+                           "Unexpected packet receiving capture copy");
       }
 
       reader.EndChunk();
 
-      if(reader.IsErrored())
+      // leave the partial file behind so that a retry can pick up where this left off
+      if(reader.IsErrored() || result != ResultCode::Succeeded)
       {
-        FileIO::Delete(path);
-
-        RDCERR("Network error receiving file");
+        RDCERR("Error receiving file: %s", result.message.c_str());
         break;
       }
 
-      RDCLOG("File received.");
+      LogTransferStats("Received", path, stats);
 
-      tempFiles.push_back(path);
+      // if the previous copy can't be replaced (e.g. it's still open) use the new one where it is
+      if(!FileIO::Move(partial, path, true))
+        path = partial;
 
       {
         WRITE_DATA_SCOPE();
@@ -583,10 +653,17 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
         }
       }
 
+      // lets the client find its cached resource contents from any previous time this capture
+      // was opened
+      uint64_t captureHash = 0;
+      if(result == ResultCode::Succeeded)
+        captureHash = HashCaptureIdentity(rdc);
+
       {
         WRITE_DATA_SCOPE();
         SCOPED_SERIALISE_CHUNK(eRemoteServer_LogOpened);
         SERIALISE_ELEMENT(result);
+        SERIALISE_ELEMENT(captureHash);
       }
     }
     else if(type == eRemoteServer_HasCallstacks)
@@ -922,6 +999,8 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
     FileIO::Delete(tempFiles[i]);
   }
 
+  TrimTransferFolder();
+
   RDCLOG("Closing active connection from %u.%u.%u.%u.", Network::GetIPOctet(ip, 0),
          Network::GetIPOctet(ip, 1), Network::GetIPOctet(ip, 2), Network::GetIPOctet(ip, 3));
 
@@ -1530,10 +1609,18 @@ ExecuteResult RemoteServer::ExecuteAndInject(const rdcstr &app, const rdcstr &wo
 void RemoteServer::CopyCaptureFromRemote(const rdcstr &remotepath, const rdcstr &localpath,
                                          RENDERDOC_ProgressCallback progress)
 {
+  // the copy is received into a separate file and only moved over localpath once it's complete, so
+  // a failed copy never leaves a corrupted file there. An interrupted copy is newer than whatever
+  // is at localpath, so if there is one it's what the sender compares against.
+  rdcstr partial = localpath + ".partial";
+  rdcstr basis = FileIO::exists(partial) ? partial : localpath;
+
   {
     WRITE_DATA_SCOPE();
     SCOPED_SERIALISE_CHUNK(eRemoteServer_CopyCaptureFromRemote);
     SERIALISE_ELEMENT(remotepath);
+    // anything we already have, e.g. from an earlier copy, doesn't need to be sent again
+    SERIALISE_ELEMENT_LOCAL(hashes, HashTransferBlocks(basis));
   }
 
   {
@@ -1542,15 +1629,17 @@ void RemoteServer::CopyCaptureFromRemote(const rdcstr &remotepath, const rdcstr
 
     if(type == eRemoteServer_CopyCaptureFromRemote)
     {
-      StreamWriter streamWriter(FileIO::fopen(localpath, FileIO::WriteBinary), Ownership::Stream);
-
-      ser.SerialiseStream(localpath, streamWriter, progress);
+      TransferStats stats;
+      RDResult result = ReceiveTransferBlocks(ser, basis, partial, progress, stats);
 
-      if(ser.IsErrored())
-      {
-        RDCERR("Network error receiving file");
-        return;
-      }
+      // leave the partial file behind so that a retry can pick up where this left off
+      if(ser.IsErrored() || result != ResultCode::Succeeded)
+        RDCERR("Error receiving file: %s", result.message.c_str());
+      else if(!FileIO::Move(partial, localpath, true))
+        RDCERR("Couldn't move received file to '%s': %s", localpath.c_str(),
+               FileIO::ErrorString().c_str());
+      else
+        LogTransferStats("Received", localpath, stats);
     }
     else
     {
@@ -1563,9 +1652,7 @@ void RemoteServer::CopyCaptureFromRemote(const rdcstr &remotepath, const rdcstr
 
 rdcstr RemoteServer::CopyCaptureToRemote(const rdcstr &filename, RENDERDOC_ProgressCallback progress)
 {
-  FILE *fileHandle = FileIO::fopen(filename, FileIO::ReadBinary);
-
-  if(!fileHandle)
+  if(!FileIO::exists(filename))
   {
     RDCERR("Can't open file '%s'", filename.c_str());
     return "";
@@ -1574,10 +1661,34 @@ rdcstr RemoteServer::CopyCaptureToRemote(const rdcstr &filename, RENDERDOC_Progr
   {
     WRITE_DATA_SCOPE();
     SCOPED_SERIALISE_CHUNK(eRemoteServer_CopyCaptureToRemote);
+    // the server keeps copies by this key, so the same local file maps to the same remote copy
+    SERIALISE_ELEMENT_LOCAL(key, HashRemoteCacheKey(0, filename.c_str(), filename.size()));
+  }
+
+  TransferBlockHashes hashes;
+
+  {
+    READ_DATA_SCOPE();
+    RemoteServerPacket type = ser.ReadChunk<RemoteServerPacket>();
 
-    // this will take ownership of and close the file
-    StreamReader fileStream(fileHandle);
-    ser.SerialiseStream(filename, fileStream, progress);
+    if(type == eRemoteServer_CopyCaptureToRemote)
+    {
+      SERIALISE_ELEMENT(hashes);
+    }
+    else
+    {
+      RDCERR("Unexpected response to capture copy request");
+    }
+
+    ser.EndChunk();
+  }
+
+  {
+    WRITE_DATA_SCOPE();
+    SCOPED_SERIALISE_CHUNK(eRemoteServer_CopyCaptureToRemote);
+
+    TransferStats stats = SendTransferBlocks(ser, filename, hashes, progress);
+    LogTransferStats("Sent", filename, stats);
   }
 
   rdcstr path;
@@ -1668,9 +1779,11 @@ rdcpair<ResultDetails, IReplayController *> RemoteServer::OpenCapture(
   }
 
   RDResult result = ResultCode::Succeeded;
+  uint64_t captureHash = 0;
   {
     READ_DATA_SCOPE();
     SERIALISE_ELEMENT(result);
+    SERIALISE_ELEMENT(captureHash);
     ser.EndChunk();
   }
 
@@ -1700,7 +1813,7 @@ rdcpair<ResultDetails, IReplayController *> RemoteServer::OpenCapture(
 
   ReplayController *rend = new ReplayController();
 
-  ReplayProxy *proxy = new ReplayProxy(*reader, *writer, proxyDriver);
+  ReplayProxy *proxy = new ReplayProxy(*reader, *writer, proxyDriver, captureHash);
   result = rend->SetDevice(proxy);
 
   if(result != ResultCode::Succeeded)
@@ -2099,3 +2212,83 @@ rdcarray<rdcstr> RemoteServer::GetResolve(const rdcarray<uint64_t> &callstack)
 
   return StackFrames;
 }
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+
+TEST_CASE("Copy captures to and from a loopback remote server", "[remoteserver]")
+{
+  const uint16_t port = uint16_t(39000 + (Timing::GetTick() % 1000));
+
+  int32_t stopServer = 0;
+  Threading::ThreadHandle serverThread = Threading::CreateThread([port, &stopServer]() {
+    RenderDoc::Inst().BecomeRemoteServer(
+        "127.0.0.1", port, [&stopServer]() { return Atomic::CmpExch32(&stopServer, 1, 1) == 1; },
+        NULL);
+  });
+
+  // the server may take a moment to start listening
+  IRemoteServer *remote = NULL;
+  rdcstr url = StringFormat::Fmt("127.0.0.1:%u", port);
+  for(int i = 0; i < 200 && remote == NULL; i++)
+  {
+    if(RENDERDOC_CreateRemoteServerConnection(url, &remote).code != ResultCode::Succeeded)
+    {
+      remote = NULL;
+      Threading::Sleep(10);
+    }
+  }
+
+  CHECK(remote != NULL);
+
+  rdcstr source = FileIO::GetTempFolderFilename() + "renderdoc_remote_copy_source.rdc";
+  rdcstr dest = FileIO::GetTempFolderFilename() + "renderdoc_remote_copy_dest.rdc";
+
+  if(remote)
+  {
+    // several transfer blocks, with a partial one at the end
+    bytebuf contents;
+    contents.resize(3 * 1024 * 1024 + 1234);
+    for(size_t i = 0; i < contents.size(); i++)
+      contents[i] = byte((i * 7) ^ (i >> 12));
+
+    FileIO::WriteAll(source, contents);
+
+    rdcstr remotePath = remote->CopyCaptureToRemote(source, NULL);
+    CHECK_FALSE(remotePath.empty());
+
+    // a fresh copy back
+    FileIO::Delete(dest);
+    remote->CopyCaptureFromRemote(remotePath, dest, NULL);
+
+    bytebuf copied;
+    CHECK(FileIO::ReadAll(dest, copied));
+    CHECK((copied == contents));
+    CHECK_FALSE(FileIO::exists(dest + ".partial"));
+
+    // a copy over an out of date file, with one changed block and a different size
+    copied[1024 * 1024 + 5] ^= 0xff;
+    copied.resize(copied.size() + 4096);
+    FileIO::WriteAll(dest, copied);
+
+    remote->CopyCaptureFromRemote(remotePath, dest, NULL);
+
+    CHECK(FileIO::ReadAll(dest, copied));
+    CHECK((copied == contents));
+    CHECK_FALSE(FileIO::exists(dest + ".partial"));
+
+    remote->ShutdownServerAndConnection();
+
+    FileIO::Delete(remotePath);
+  }
+
+  Atomic::Inc32(&stopServer);
+  Threading::JoinThread(serverThread);
+  Threading::CloseThread(serverThread);
+
+  FileIO::Delete(source);
+  FileIO::Delete(dest);
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -24,11 +24,19 @@
  ******************************************************************************/
 
 #include "replay_proxy.h"
-#include <list>
+#if defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+#include "common/threading.h"
+#include "core/settings.h"
 #include "lz4/lz4.h"
 #include "replay/dummy_driver.h"
 #include "serialise/lz4io.h"
 
+RDOC_CONFIG(bool, RemoteServer_ResourceCache, true,
+            "Keep resource contents fetched from remote servers on disk, so that they don't need "
+            "to be transferred again when the same capture is opened later.");
+
 template <>
 rdcstr DoStringise(const ReplayProxyPacket &el)
 {
@@ -97,6 +105,8 @@ rdcstr DoStringise(const ReplayProxyPacket &el)
 
     STRINGISE_ENUM_NAMED(eReplayProxy_ContinueDebug, "ContinueDebug");
     STRINGISE_ENUM_NAMED(eReplayProxy_FreeDebugger, "FreeDebugger");
+
+    STRINGISE_ENUM_NAMED(eReplayProxy_GetReplayProfile, "GetReplayProfile");
   }
   END_ENUM_STRINGISE();
 }
@@ -234,7 +244,8 @@ ReplayProxy::ReplayProxy(ReadSerialiser &reader, WriteSerialiser &writer, IRemot
                               m_VulkanPipelineState);
 }
 
-ReplayProxy::ReplayProxy(ReadSerialiser &reader, WriteSerialiser &writer, IReplayDriver *proxy)
+ReplayProxy::ReplayProxy(ReadSerialiser &reader, WriteSerialiser &writer, IReplayDriver *proxy,
+                         uint64_t captureHash)
     : m_Reader(reader),
       m_Writer(writer),
       m_Proxy(proxy),
@@ -244,6 +255,9 @@ ReplayProxy::ReplayProxy(ReadSerialiser &reader, WriteSerialiser &writer, IRepla
 {
   m_StructuredFile = new SDFile;
 
+  if(RemoteServer_ResourceCache() && captureHash != 0)
+    m_ResourceCache = new RemoteResourceCache(captureHash);
+
   ReplayProxy::GetAPIProperties();
   ReplayProxy::FetchStructuredFile();
 }
@@ -251,6 +265,7 @@ ReplayProxy::ReplayProxy(ReadSerialiser &reader, WriteSerialiser &writer, IRepla
 ReplayProxy::~ReplayProxy()
 {
   SAFE_DELETE(m_StructuredFile);
+  SAFE_DELETE(m_ResourceCache);
   if(m_Remote)
   {
     SAFE_DELETE(m_D3D11PipelineState);
@@ -707,6 +722,35 @@ FrameRecord ReplayProxy::GetFrameRecord()
   PROXY_FUNCTION(GetFrameRecord);
 }
 
+template <typename ParamSerialiser, typename ReturnSerialiser>
+ReplayProfile ReplayProxy::Proxied_GetReplayProfile(ParamSerialiser &paramser,
+                                                    ReturnSerialiser &retser)
+{
+  const ReplayProxyPacket expectedPacket = eReplayProxy_GetReplayProfile;
+  ReplayProxyPacket packet = eReplayProxy_GetReplayProfile;
+  ReplayProfile ret;
+
+  {
+    BEGIN_PARAMS();
+    END_PARAMS();
+  }
+
+  {
+    REMOTE_EXECUTION();
+    if(paramser.IsReading() && !paramser.IsErrored() && !m_IsErrored)
+      ret = m_Remote->GetReplayProfile();
+  }
+
+  SERIALISE_RETURN(ret);
+
+  return ret;
+}
+
+ReplayProfile ReplayProxy::GetReplayProfile()
+{
+  PROXY_FUNCTION(GetReplayProfile);
+}
+
 template <typename ParamSerialiser, typename ReturnSerialiser>
 ResourceId ReplayProxy::Proxied_GetLiveID(ParamSerialiser &paramser, ReturnSerialiser &retser,
                                           ResourceId id)
@@ -888,11 +932,22 @@ void ReplayProxy::Proxied_GetBufferData(ParamSerialiser &paramser, ReturnSeriali
   const ReplayProxyPacket expectedPacket = eReplayProxy_GetBufferData;
   ReplayProxyPacket packet = eReplayProxy_GetBufferData;
 
+  uint64_t cacheKey = 0;
+  RemoteContentHash cachedHash;
+
+  if(m_ResourceCache && paramser.IsWriting())
+  {
+    cacheKey = GetBufferCacheKey(buff, offset, len);
+    if(!m_BypassResourceCache)
+      cachedHash = m_ResourceCache->Lookup(cacheKey);
+  }
+
   {
     BEGIN_PARAMS();
     SERIALISE_ELEMENT(buff);
     SERIALISE_ELEMENT(offset);
     SERIALISE_ELEMENT(len);
+    SERIALISE_ELEMENT(cachedHash);
     END_PARAMS();
   }
 
@@ -902,55 +957,76 @@ void ReplayProxy::Proxied_GetBufferData(ParamSerialiser &paramser, ReturnSeriali
       m_Remote->GetBufferData(buff, offset, len, retData);
   }
 
-  // over-estimate of total uncompressed data written. Since the decompression chain needs to know
-  // the exact uncompressed size, we over-estimate (to allow for length/padding/etc) and then pad
-  // to this amount.
-  uint64_t dataSize = retData.size() + 2 * retser.GetChunkAlignment();
-
   {
     ReturnSerialiser &ser = retser;
     PACKET_HEADER(packet);
     SERIALISE_ELEMENT(packet);
-    SERIALISE_ELEMENT(dataSize);
   }
 
-  char empty[128] = {};
+  bool loadFailed = false;
+  bool cacheHit = CachedContentsTransfer(retser, cachedHash, retData, loadFailed);
 
-  // lz4 compress
-  if(retser.IsReading())
+  if(!cacheHit)
   {
-    ReadSerialiser ser(new StreamReader(new LZ4Decompressor(retser.GetReader(), Ownership::Nothing),
-                                        dataSize, Ownership::Stream),
-                       Ownership::Stream);
+    // over-estimate of total uncompressed data written. Since the decompression chain needs to
+    // know the exact uncompressed size, we over-estimate (to allow for length/padding/etc) and then
+    // pad to this amount.
+    uint64_t dataSize = retData.size() + 2 * retser.GetChunkAlignment();
 
-    SERIALISE_ELEMENT(retData);
+    retser.Serialise("dataSize"_lit, dataSize);
 
-    uint64_t offs = ser.GetReader()->GetOffset();
-    RDCASSERT(offs <= dataSize, offs, dataSize);
-    RDCASSERT(dataSize - offs < sizeof(empty), offs, dataSize);
+    char empty[128] = {};
 
-    if(offs < dataSize)
-      ser.GetReader()->Read(empty, dataSize - offs);
-  }
-  else
-  {
-    WriteSerialiser ser(new StreamWriter(new LZ4Compressor(retser.GetWriter(), Ownership::Nothing),
-                                         Ownership::Stream),
-                        Ownership::Stream);
+    // lz4 compress
+    if(retser.IsReading())
+    {
+      ReadSerialiser ser(
+          new StreamReader(new LZ4Decompressor(retser.GetReader(), Ownership::Nothing), dataSize,
+                           Ownership::Stream),
+          Ownership::Stream);
+
+      SERIALISE_ELEMENT(retData);
 
-    SERIALISE_ELEMENT(retData);
+      uint64_t offs = ser.GetReader()->GetOffset();
+      RDCASSERT(offs <= dataSize, offs, dataSize);
+      RDCASSERT(dataSize - offs < sizeof(empty), offs, dataSize);
+
+      if(offs < dataSize)
+        ser.GetReader()->Read(empty, dataSize - offs);
+    }
+    else
+    {
+      WriteSerialiser ser(
+          new StreamWriter(new LZ4Compressor(retser.GetWriter(), Ownership::Nothing),
+                           Ownership::Stream),
+          Ownership::Stream);
 
-    uint64_t offs = ser.GetWriter()->GetOffset();
-    RDCASSERT(offs <= dataSize, offs, dataSize);
-    RDCASSERT(dataSize - offs < sizeof(empty), offs, dataSize);
+      SERIALISE_ELEMENT(retData);
 
-    if(offs < dataSize)
-      ser.GetWriter()->Write(empty, dataSize - offs);
+      uint64_t offs = ser.GetWriter()->GetOffset();
+      RDCASSERT(offs <= dataSize, offs, dataSize);
+      RDCASSERT(dataSize - offs < sizeof(empty), offs, dataSize);
+
+      if(offs < dataSize)
+        ser.GetWriter()->Write(empty, dataSize - offs);
+    }
   }
 
   retser.EndChunk();
 
   CheckError(packet, expectedPacket);
+
+  if(m_ResourceCache && retser.IsReading() && !m_IsErrored && !cacheHit)
+    m_ResourceCache->Store(cacheKey, retData);
+
+  // the unusable contents have been removed from the cache, and none are offered for the refetch
+  // so this time they'll be transferred
+  if(loadFailed)
+  {
+    m_BypassResourceCache = true;
+    GetBufferData(buff, offset, len, retData);
+    m_BypassResourceCache = false;
+  }
 }
 
 void ReplayProxy::GetBufferData(ResourceId buff, uint64_t offset, uint64_t len, bytebuf &retData)
@@ -966,11 +1042,22 @@ void ReplayProxy::Proxied_GetTextureData(ParamSerialiser &paramser, ReturnSerial
   const ReplayProxyPacket expectedPacket = eReplayProxy_GetTextureData;
   ReplayProxyPacket packet = eReplayProxy_GetTextureData;
 
+  uint64_t cacheKey = 0;
+  RemoteContentHash cachedHash;
+
+  if(m_ResourceCache && paramser.IsWriting())
+  {
+    cacheKey = GetTextureCacheKey(tex, sub, params);
+    if(!m_BypassResourceCache)
+      cachedHash = m_ResourceCache->Lookup(cacheKey);
+  }
+
   {
     BEGIN_PARAMS();
     SERIALISE_ELEMENT(tex);
     SERIALISE_ELEMENT(sub);
     SERIALISE_ELEMENT(params);
+    SERIALISE_ELEMENT(cachedHash);
     END_PARAMS();
   }
 
@@ -980,55 +1067,76 @@ void ReplayProxy::Proxied_GetTextureData(ParamSerialiser &paramser, ReturnSerial
       m_Remote->GetTextureData(tex, sub, params, data);
   }
 
-  // over-estimate of total uncompressed data written. Since the decompression chain needs to know
-  // the exact uncompressed size, we over-estimate (to allow for length/padding/etc) and then pad
-  // to this amount.
-  uint64_t dataSize = data.size() + 2 * retser.GetChunkAlignment();
-
   {
     ReturnSerialiser &ser = retser;
     PACKET_HEADER(packet);
     SERIALISE_ELEMENT(packet);
-    SERIALISE_ELEMENT(dataSize);
   }
 
-  char empty[128] = {};
+  bool loadFailed = false;
+  bool cacheHit = CachedContentsTransfer(retser, cachedHash, data, loadFailed);
 
-  // lz4 compress
-  if(retser.IsReading())
+  if(!cacheHit)
   {
-    ReadSerialiser ser(new StreamReader(new LZ4Decompressor(retser.GetReader(), Ownership::Nothing),
-                                        dataSize, Ownership::Stream),
-                       Ownership::Stream);
+    // over-estimate of total uncompressed data written. Since the decompression chain needs to
+    // know the exact uncompressed size, we over-estimate (to allow for length/padding/etc) and then
+    // pad to this amount.
+    uint64_t dataSize = data.size() + 2 * retser.GetChunkAlignment();
 
-    SERIALISE_ELEMENT(data);
+    retser.Serialise("dataSize"_lit, dataSize);
 
-    uint64_t offs = ser.GetReader()->GetOffset();
-    RDCASSERT(offs <= dataSize, offs, dataSize);
-    RDCASSERT(dataSize - offs < sizeof(empty), offs, dataSize);
+    char empty[128] = {};
 
-    if(offs < dataSize)
-      ser.GetReader()->Read(empty, dataSize - offs);
-  }
-  else
-  {
-    WriteSerialiser ser(new StreamWriter(new LZ4Compressor(retser.GetWriter(), Ownership::Nothing),
-                                         Ownership::Stream),
-                        Ownership::Stream);
+    // lz4 compress
+    if(retser.IsReading())
+    {
+      ReadSerialiser ser(
+          new StreamReader(new LZ4Decompressor(retser.GetReader(), Ownership::Nothing), dataSize,
+                           Ownership::Stream),
+          Ownership::Stream);
 
-    SERIALISE_ELEMENT(data);
+      SERIALISE_ELEMENT(data);
 
-    uint64_t offs = ser.GetWriter()->GetOffset();
-    RDCASSERT(offs <= dataSize, offs, dataSize);
-    RDCASSERT(dataSize - offs < sizeof(empty), offs, dataSize);
+      uint64_t offs = ser.GetReader()->GetOffset();
+      RDCASSERT(offs <= dataSize, offs, dataSize);
+      RDCASSERT(dataSize - offs < sizeof(empty), offs, dataSize);
 
-    if(offs < dataSize)
-      ser.GetWriter()->Write(empty, dataSize - offs);
+      if(offs < dataSize)
+        ser.GetReader()->Read(empty, dataSize - offs);
+    }
+    else
+    {
+      WriteSerialiser ser(
+          new StreamWriter(new LZ4Compressor(retser.GetWriter(), Ownership::Nothing),
+                           Ownership::Stream),
+          Ownership::Stream);
+
+      SERIALISE_ELEMENT(data);
+
+      uint64_t offs = ser.GetWriter()->GetOffset();
+      RDCASSERT(offs <= dataSize, offs, dataSize);
+      RDCASSERT(dataSize - offs < sizeof(empty), offs, dataSize);
+
+      if(offs < dataSize)
+        ser.GetWriter()->Write(empty, dataSize - offs);
+    }
   }
 
   retser.EndChunk();
 
   CheckError(packet, expectedPacket);
+
+  if(m_ResourceCache && retser.IsReading() && !m_IsErrored && !cacheHit)
+    m_ResourceCache->Store(cacheKey, data);
+
+  // the unusable contents have been removed from the cache, and none are offered for the refetch
+  // so this time they'll be transferred
+  if(loadFailed)
+  {
+    m_BypassResourceCache = true;
+    GetTextureData(tex, sub, params, data);
+    m_BypassResourceCache = false;
+  }
 }
 
 void ReplayProxy::GetTextureData(ResourceId tex, const Subresource &sub,
@@ -1955,6 +2063,160 @@ void DoSerialise(SerialiserType &ser, DeltaSection &el)
   SERIALISE_MEMBER(contents);
 }
 
+// write-side equivalent of DeltaSection which points into the new data instead of owning a copy
+// of it. It serialises to exactly the same bytes as a DeltaSection so the reading side is unchanged.
+struct DeltaRange
+{
+  uint64_t offs;
+  byte *data;
+  uint64_t size;
+};
+
+DECLARE_REFLECTION_STRUCT(DeltaRange);
+
+template <typename SerialiserType>
+void DoSerialise(SerialiserType &ser, DeltaRange &el)
+{
+  SERIALISE_MEMBER(offs);
+  ser.Serialise("contents"_lit, el.data, el.size);
+}
+
+// we only care about large-ish chunks at a time. This prevents us generating lots of tiny
+// deltas where we could batch changes together. This is tuned to not be too large (and
+// thus causing us to miss too many sections we could skip) and not too small (causing us
+// to devolve into lots of byte-wise deltas). The minimum value as of this comment of 128
+// is definitely on the small end of the range, but consider e.g. an android image of
+// 1440x2560 and a pixel-wide line that goes vertically from top to bottom. Reading
+// horizontally that will mean 2560 different diffs, and only actually one pixel changed.
+// The larger this value gets, the more redundant data we'll send along with.
+static const size_t MinDeltaChunkSize = 128;
+
+// for very large resources we grow the chunk size (in powers of two) so that the worst case
+// number of deltas stays bounded, instead of describing e.g. a 1GB buffer in 128 byte pieces.
+static const size_t MaxDeltaChunks = 256 * 1024;
+
+// resources larger than this are split into segments and diffed in parallel.
+static const size_t DeltaParallelSegmentSize = 4 * 1024 * 1024;
+
+static size_t GetDeltaChunkSize(size_t byteSize)
+{
+  size_t chunkSize = MinDeltaChunkSize;
+  while(byteSize / chunkSize > MaxDeltaChunks)
+    chunkSize *= 2;
+  return chunkSize;
+}
+
+static bool DeltaChunkDiffers(const byte *a, const byte *b, size_t size)
+{
+  size_t i = 0;
+
+#if defined(__x86_64__) || defined(_M_X64)
+  // SSE2 is always available on x86-64. Compare 64 bytes per iteration and only look at the
+  // combined result, since all we need to know is whether anything differs.
+  for(; i + 64 <= size; i += 64)
+  {
+    __m128i eq0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i + 0)),
+                                 _mm_loadu_si128((const __m128i *)(b + i + 0)));
+    __m128i eq1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i + 16)),
+                                 _mm_loadu_si128((const __m128i *)(b + i + 16)));
+    __m128i eq2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i + 32)),
+                                 _mm_loadu_si128((const __m128i *)(b + i + 32)));
+    __m128i eq3 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i + 48)),
+                                 _mm_loadu_si128((const __m128i *)(b + i + 48)));
+
+    __m128i eq = _mm_and_si128(_mm_and_si128(eq0, eq1), _mm_and_si128(eq2, eq3));
+
+    if(_mm_movemask_epi8(eq) != 0xffff)
+      return true;
+  }
+#else
+  // portable fallback, OR together 64-bit XORs across 32 bytes at a time
+  for(; i + 32 <= size; i += 32)
+  {
+    uint64_t a64[4], b64[4];
+    memcpy(a64, a + i, sizeof(a64));
+    memcpy(b64, b + i, sizeof(b64));
+
+    if(((a64[0] ^ b64[0]) | (a64[1] ^ b64[1]) | (a64[2] ^ b64[2]) | (a64[3] ^ b64[3])) != 0)
+      return true;
+  }
+#endif
+
+  // any remaining tail smaller than the vector width
+  return i < size && memcmp(a + i, b + i, size - i) != 0;
+}
+
+// diff [begin, end) of the data in chunkSize pieces, appending a delta for each run of differing
+// chunks. The final chunk may be smaller than chunkSize if end isn't a multiple of it.
+static void DiffDeltaSegment(byte *newData, const byte *refData, size_t begin, size_t end,
+                             size_t chunkSize, rdcarray<DeltaRange> &deltas)
+{
+  // whether the last delta is still 'active' and should be extended by the next differing chunk
+  bool active = false;
+
+  for(size_t offs = begin; offs < end; offs += chunkSize)
+  {
+    size_t size = RDCMIN(chunkSize, end - offs);
+
+    if(DeltaChunkDiffers(newData + offs, refData + offs, size))
+    {
+      if(active)
+        deltas.back().size += size;
+      else
+        deltas.push_back({offs, newData + offs, size});
+
+      active = true;
+    }
+    else
+    {
+      active = false;
+    }
+  }
+}
+
+static void CalculateDeltaRanges(byte *newData, const byte *refData, size_t byteSize,
+                                 rdcarray<DeltaRange> &deltas)
+{
+  const size_t chunkSize = GetDeltaChunkSize(byteSize);
+
+  if(byteSize <= DeltaParallelSegmentSize)
+  {
+    DiffDeltaSegment(newData, refData, 0, byteSize, chunkSize, deltas);
+    return;
+  }
+
+  // segments are whole multiples of the chunk size, so chunks are the same as for a serial diff
+  const size_t segmentSize = AlignUp(DeltaParallelSegmentSize, chunkSize);
+  const uint32_t numSegments = uint32_t((byteSize + segmentSize - 1) / segmentSize);
+
+  rdcarray<rdcarray<DeltaRange>> segmentDeltas;
+  segmentDeltas.resize(numSegments);
+
+  Threading::JobSystem::ParallelFor(numSegments, [&](uint32_t s) {
+    size_t begin = s * segmentSize;
+    size_t end = RDCMIN(begin + segmentSize, byteSize);
+    DiffDeltaSegment(newData, refData, begin, end, chunkSize, segmentDeltas[s]);
+  });
+
+  size_t total = 0;
+  for(const rdcarray<DeltaRange> &seg : segmentDeltas)
+    total += seg.size();
+
+  deltas.reserve(deltas.size() + total);
+
+  // concatenate, joining any delta that ran across a segment boundary back together
+  for(const rdcarray<DeltaRange> &seg : segmentDeltas)
+  {
+    for(const DeltaRange &d : seg)
+    {
+      if(!deltas.empty() && deltas.back().offs + deltas.back().size == d.offs)
+        deltas.back().size += d.size;
+      else
+        deltas.push_back(d);
+    }
+  }
+}
+
 template <typename SerialiserType>
 void ReplayProxy::DeltaTransferBytes(SerialiserType &xferser, bytebuf &referenceData, bytebuf &newData)
 {
@@ -2005,7 +2267,7 @@ void ReplayProxy::DeltaTransferBytes(SerialiserType &xferser, bytebuf &reference
         if(deltas.size() != 1)
           RDCERR("Got more than one delta with no reference data - taking first delta.");
 
-        referenceData = deltas.front().contents;
+        referenceData.swap(deltas.front().contents);
         RDCDEBUG("Creating new reference data, %llu bytes", (uint64_t)referenceData.size());
       }
       else
@@ -2040,129 +2302,26 @@ void ReplayProxy::DeltaTransferBytes(SerialiserType &xferser, bytebuf &reference
   {
     uint64_t uncompSize = 0;
 
-    // we use a list so that we don't have to reserve and pushing new sections will never cause
-    // previous ones to be reallocated and move around lots of data.
-    std::list<DeltaSection> deltasList;
+    // the deltas point directly into newData, which stays alive until we've finished serialising
+    rdcarray<DeltaRange> deltas;
 
     if(referenceData.empty())
     {
       // no previous reference data, need to transfer the whole object.
-      deltasList.resize(1);
-      deltasList.back().contents = newData;
+      deltas.push_back({0, newData.data(), (uint64_t)newData.size()});
     }
-    else
+    else if(referenceData.size() != newData.size())
     {
-      if(referenceData.size() != newData.size())
-      {
-        RDCERR("Reference data existed at %llu bytes, but new data is now %llu bytes",
-               referenceData.size(), newData.size());
+      RDCERR("Reference data existed at %llu bytes, but new data is now %llu bytes",
+             referenceData.size(), newData.size());
 
-        // re-transfer the whole block, something went seriously wrong if the resource changed size.
-        deltasList.resize(1);
-        deltasList.back().contents = newData;
-      }
-      else
-      {
-        // do actual diff.
-        const byte *srcBegin = newData.data();
-        const byte *src = srcBegin;
-        const byte *dst = referenceData.data();
-        size_t bytesRemain = newData.size();
-
-        // we only care about large-ish chunks at a time. This prevents us generating lots of tiny
-        // deltas where we could batch changes together. This is tuned to not be too large (and
-        // thus causing us to miss too many sections we could skip) and not too small (causing us
-        // to devolve into lots of byte-wise deltas). The current value as of this comment of 128
-        // is definitely on the small end of the range, but consider e.g. an android image of
-        // 1440x2560 and a pixel-wide line that goes vertically from top to bottom. Reading
-        // horizontally that will mean 2560 different diffs, and only actually one pixel changed.
-        // The larger this value gets, the more redundant data we'll send along with.
-        const size_t chunkSize = 128;
-
-        // we use a simple state machine. Start in state 1
-        //
-        // State 1: No active delta. Look at the current chunk, if there's no difference move to the
-        //          next chunk and stay in this state. If there is a difference, push a delta onto
-        //          the list at the current offset. Copy the current chunk into the contents of the
-        //          delta. Move to state 2.
-        // State 2. Active delta. Look at the current chunk, if there is a difference then append
-        //          the current chunk to the last delta's contents, move to the next chunk, and stay
-        //          in this state. If there isn't a difference, move back to state 1 (the delta is
-        //          already 'finished' so we have no need to do anything more on it).
-        //
-        // At any point we can end the loop, both states are 'complete' at all points.
-
-        enum DeltaState
-        {
-          None,
-          Active
-        };
-        DeltaState state = DeltaState::None;
-
-        // loop over whole chunks
-        while(bytesRemain > chunkSize)
-        {
-          // check if there's a difference in this chunk.
-          bool chunkDiff = memcmp(src, dst, chunkSize) != 0;
-
-          // if we're in state 1
-          if(state == DeltaState::None)
-          {
-            // if there's a difference, append a new delta with the current offset and chunk
-            // contents and move to state 2
-            if(chunkDiff)
-            {
-              deltasList.push_back(DeltaSection());
-              deltasList.back().offs = src - srcBegin;
-              deltasList.back().contents.append(src, chunkSize);
-
-              state = DeltaState::Active;
-            }
-          }
-          // if we're in state 2
-          else if(state == DeltaState::Active)
-          {
-            // continue to append to the delta if there's another difference in this chunk.
-            if(chunkDiff)
-            {
-              deltasList.back().contents.append(src, chunkSize);
-            }
-            else
-            {
-              state = DeltaState::None;
-            }
-          }
-
-          // move to the next chunk
-          bytesRemain -= chunkSize;
-          src += chunkSize;
-          dst += chunkSize;
-        }
-
-        // if there are still some bytes remaining at the end of the image, smaller than the chunk
-        // size, just diff directly and send if needed. We could combine this with the last delta if
-        // we ended in the active state.
-        if(bytesRemain > 0 && memcmp(src, dst, bytesRemain) != 0)
-        {
-          deltasList.push_back(DeltaSection());
-          deltasList.back().offs = src - srcBegin;
-          deltasList.back().contents.append(src, bytesRemain);
-        }
-      }
+      // re-transfer the whole block, something went seriously wrong if the resource changed size.
+      deltas.push_back({0, newData.data(), (uint64_t)newData.size()});
     }
-
-    // serialise as an array, move the storage from the list into here
-    rdcarray<DeltaSection> deltas;
-    deltas.resize(deltasList.size());
-
+    else
     {
-      // swap between the list and array, so all the buffers just move storage
-      size_t i = 0;
-      for(auto it = deltasList.begin(); it != deltasList.end(); it++)
-      {
-        deltas[i].swap(*it);
-        i++;
-      }
+      // do actual diff.
+      CalculateDeltaRanges(newData.data(), referenceData.data(), newData.size(), deltas);
     }
 
     // fast path - no changes.
@@ -2184,6 +2343,7 @@ void ReplayProxy::DeltaTransferBytes(SerialiserType &xferser, bytebuf &reference
 
     if(uncompSize > 0)
     {
+      // the delta contents are compressed straight out of newData, there's no intermediate copy
       WriteSerialiser ser(new StreamWriter(new LZ4Compressor(xferser.GetWriter(), Ownership::Nothing),
                                            Ownership::Stream),
                           Ownership::Stream);
@@ -2207,6 +2367,62 @@ void ReplayProxy::DeltaTransferBytes(SerialiserType &xferser, bytebuf &reference
   }
 }
 
+template <typename SerialiserType>
+bool ReplayProxy::CachedContentsTransfer(SerialiserType &xferser, const RemoteContentHash &cachedHash,
+                                         bytebuf &data, bool &loadFailed)
+{
+  bool cacheHit = false;
+
+  // the client only offers a hash if it has the contents, so we just need to check they're right
+  if(xferser.IsWriting() && cachedHash.IsValid())
+    cacheHit = HashRemoteContents(data) == cachedHash;
+
+  xferser.Serialise("cacheHit"_lit, cacheHit);
+
+  if(cacheHit && xferser.IsReading())
+  {
+    if(m_ResourceCache && m_ResourceCache->Load(cachedHash, data))
+    {
+      RDCDEBUG("Loaded %llu bytes from the remote resource cache", cachedHash.size);
+    }
+    else
+    {
+      RDCWARN("Couldn't load cached remote contents, refetching");
+      data.clear();
+      loadFailed = true;
+    }
+  }
+
+  return cacheHit;
+}
+
+uint64_t ReplayProxy::GetBufferCacheKey(ResourceId buff, uint64_t offset, uint64_t len)
+{
+  uint64_t key = HashRemoteCacheKey(0, m_EventID);
+  key = HashRemoteCacheKey(key, buff);
+  key = HashRemoteCacheKey(key, offset);
+  key = HashRemoteCacheKey(key, len);
+  return key;
+}
+
+uint64_t ReplayProxy::GetTextureCacheKey(ResourceId tex, const Subresource &sub,
+                                         const GetTextureDataParams &params)
+{
+  uint64_t key = HashRemoteCacheKey(0, m_EventID);
+  key = HashRemoteCacheKey(key, tex);
+  key = HashRemoteCacheKey(key, sub.mip);
+  key = HashRemoteCacheKey(key, sub.slice);
+  key = HashRemoteCacheKey(key, sub.sample);
+  key = HashRemoteCacheKey(key, params.forDiskSave);
+  key = HashRemoteCacheKey(key, params.standardLayout);
+  key = HashRemoteCacheKey(key, params.typeCast);
+  key = HashRemoteCacheKey(key, params.resolve);
+  key = HashRemoteCacheKey(key, params.remap);
+  key = HashRemoteCacheKey(key, params.blackPoint);
+  key = HashRemoteCacheKey(key, params.whitePoint);
+  return key;
+}
+
 template <typename ParamSerialiser, typename ReturnSerialiser>
 void ReplayProxy::Proxied_CacheBufferData(ParamSerialiser &paramser, ReturnSerialiser &retser,
                                           ResourceId buff)
@@ -2214,9 +2430,23 @@ void ReplayProxy::Proxied_CacheBufferData(ParamSerialiser &paramser, ReturnSeria
   const ReplayProxyPacket expectedPacket = eReplayProxy_CacheBufferData;
   ReplayProxyPacket packet = eReplayProxy_CacheBufferData;
 
+  bytebuf &referenceData = m_ProxyBufferData[buff];
+
+  uint64_t cacheKey = 0;
+  RemoteContentHash cachedHash;
+
+  // only offer cached contents the first time, afterwards a delta against the reference is cheaper
+  if(m_ResourceCache && paramser.IsWriting())
+  {
+    cacheKey = GetBufferCacheKey(buff, 0, 0);
+    if(referenceData.empty() && !m_BypassResourceCache)
+      cachedHash = m_ResourceCache->Lookup(cacheKey);
+  }
+
   {
     BEGIN_PARAMS();
     SERIALISE_ELEMENT(buff);
+    SERIALISE_ELEMENT(cachedHash);
     END_PARAMS();
   }
 
@@ -2234,11 +2464,28 @@ void ReplayProxy::Proxied_CacheBufferData(ParamSerialiser &paramser, ReturnSeria
     SERIALISE_ELEMENT(packet);
   }
 
-  DeltaTransferBytes(retser, m_ProxyBufferData[buff], data);
+  bool loadFailed = false;
+  bool cacheHit = CachedContentsTransfer(retser, cachedHash, data, loadFailed);
+
+  if(cacheHit)
+    referenceData.swap(data);
+  else
+    DeltaTransferBytes(retser, referenceData, data);
 
   retser.EndChunk();
 
   CheckError(packet, expectedPacket);
+
+  if(m_ResourceCache && retser.IsReading() && !m_IsErrored && !cacheHit)
+    m_ResourceCache->Store(cacheKey, referenceData);
+
+  // the remote server now has this data as its reference, fetch it in full to match
+  if(loadFailed)
+  {
+    m_BypassResourceCache = true;
+    GetBufferData(buff, 0, 0, referenceData);
+    m_BypassResourceCache = false;
+  }
 }
 
 void ReplayProxy::CacheBufferData(ResourceId buff)
@@ -2254,11 +2501,26 @@ void ReplayProxy::Proxied_CacheTextureData(ParamSerialiser &paramser, ReturnSeri
   const ReplayProxyPacket expectedPacket = eReplayProxy_CacheTextureData;
   ReplayProxyPacket packet = eReplayProxy_CacheTextureData;
 
+  TextureCacheEntry entry = {tex, sub};
+  bytebuf &referenceData = m_ProxyTextureData[entry];
+
+  uint64_t cacheKey = 0;
+  RemoteContentHash cachedHash;
+
+  // only offer cached contents the first time, afterwards a delta against the reference is cheaper
+  if(m_ResourceCache && paramser.IsWriting())
+  {
+    cacheKey = GetTextureCacheKey(tex, sub, params);
+    if(referenceData.empty() && !m_BypassResourceCache)
+      cachedHash = m_ResourceCache->Lookup(cacheKey);
+  }
+
   {
     BEGIN_PARAMS();
     SERIALISE_ELEMENT(tex);
     SERIALISE_ELEMENT(sub);
     SERIALISE_ELEMENT(params);
+    SERIALISE_ELEMENT(cachedHash);
     END_PARAMS();
   }
 
@@ -2276,12 +2538,28 @@ void ReplayProxy::Proxied_CacheTextureData(ParamSerialiser &paramser, ReturnSeri
     SERIALISE_ELEMENT(packet);
   }
 
-  TextureCacheEntry entry = {tex, sub};
-  DeltaTransferBytes(retser, m_ProxyTextureData[entry], data);
+  bool loadFailed = false;
+  bool cacheHit = CachedContentsTransfer(retser, cachedHash, data, loadFailed);
+
+  if(cacheHit)
+    referenceData.swap(data);
+  else
+    DeltaTransferBytes(retser, referenceData, data);
 
   retser.EndChunk();
 
   CheckError(packet, expectedPacket);
+
+  if(m_ResourceCache && retser.IsReading() && !m_IsErrored && !cacheHit)
+    m_ResourceCache->Store(cacheKey, referenceData);
+
+  // the remote server now has this data as its reference, fetch it in full to match
+  if(loadFailed)
+  {
+    m_BypassResourceCache = true;
+    GetTextureData(tex, sub, params, referenceData);
+    m_BypassResourceCache = false;
+  }
 }
 
 void ReplayProxy::CacheTextureData(ResourceId tex, const Subresource &sub,
@@ -2954,6 +3232,7 @@ bool ReplayProxy::Tick(int type)
     case eReplayProxy_GetTargetShaderEncodings: GetTargetShaderEncodings(); break;
     case eReplayProxy_GetDriverInfo: GetDriverInfo(); break;
     case eReplayProxy_GetAvailableGPUs: GetAvailableGPUs(); break;
+    case eReplayProxy_GetReplayProfile: GetReplayProfile(); break;
     default: RDCERR("Unexpected command %u", type); return false;
   }
 
@@ -2967,3 +3246,163 @@ bool ReplayProxy::Tick(int type)
 
   return true;
 }
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+#include "common/formatting.h"
+#include "common/timing.h"
+
+// apply deltas the same way the reading side does, by round-tripping them through the serialiser
+// as DeltaRange and reading them back as DeltaSection.
+static void ApplyDeltaRanges(rdcarray<DeltaRange> &ranges, bytebuf &referenceData)
+{
+  StreamWriter *buf = new StreamWriter(StreamWriter::DefaultScratchSize);
+
+  {
+    WriteSerialiser ser(buf, Ownership::Nothing);
+    ser.Serialise("deltas"_lit, ranges);
+  }
+
+  rdcarray<DeltaSection> deltas;
+
+  {
+    ReadSerialiser ser(new StreamReader(buf->GetData(), buf->GetOffset()), Ownership::Stream);
+    ser.Serialise("deltas"_lit, deltas);
+  }
+
+  delete buf;
+
+  for(const DeltaSection &delta : deltas)
+    memcpy(referenceData.data() + delta.offs, delta.contents.data(), delta.contents.size());
+}
+
+TEST_CASE("Test delta transfer range calculation", "[replayproxy]")
+{
+  SECTION("Chunk size adapts to resource size")
+  {
+    CHECK(GetDeltaChunkSize(0) == MinDeltaChunkSize);
+    CHECK(GetDeltaChunkSize(64 * 1024 * 1024) == 256);
+    CHECK(GetDeltaChunkSize(1024ULL * 1024 * 1024) == 4096);
+  }
+
+  SECTION("Identical data produces no deltas")
+  {
+    bytebuf a, b;
+    a.resize(10000);
+    for(size_t i = 0; i < a.size(); i++)
+      a[i] = byte(i * 7);
+    b = a;
+
+    rdcarray<DeltaRange> ranges;
+    CalculateDeltaRanges(b.data(), a.data(), b.size(), ranges);
+    CHECK(ranges.empty());
+  }
+
+  SECTION("Adjacent changed chunks are merged and trailing bytes are diffed")
+  {
+    bytebuf a, b;
+    a.resize(1000);
+    b = a;
+
+    b[130] = 1;
+    b[300] = 1;
+    b[999] = 1;
+
+    rdcarray<DeltaRange> ranges;
+    CalculateDeltaRanges(b.data(), a.data(), b.size(), ranges);
+
+    REQUIRE(ranges.size() == 2);
+    CHECK(ranges[0].offs == 128);
+    CHECK(ranges[0].size == 256);
+    CHECK(ranges[1].offs == 896);
+    CHECK(ranges[1].size == 104);
+
+    ApplyDeltaRanges(ranges, a);
+    CHECK(a == b);
+  }
+
+  SECTION("Large resources are diffed in parallel segments")
+  {
+    const size_t size = DeltaParallelSegmentSize * 3 + 12345;
+
+    bytebuf a, b;
+    a.resize(size);
+    for(size_t i = 0; i < a.size(); i++)
+      a[i] = byte(i ^ (i >> 8));
+    b = a;
+
+    // a run straddling the first segment boundary, which must come back as a single delta
+    for(size_t i = DeltaParallelSegmentSize - 1000; i < DeltaParallelSegmentSize + 1000; i++)
+      b[i]++;
+
+    // isolated changes, including one in the final partial chunk
+    b[DeltaParallelSegmentSize * 2 + 77]++;
+    b[size - 1]++;
+
+    rdcarray<DeltaRange> ranges;
+    CalculateDeltaRanges(b.data(), a.data(), b.size(), ranges);
+
+    REQUIRE(ranges.size() == 3);
+    CHECK(ranges[0].offs <= DeltaParallelSegmentSize - 1000);
+    CHECK(ranges[0].offs + ranges[0].size >= DeltaParallelSegmentSize + 1000);
+    CHECK(ranges[2].offs + ranges[2].size == size);
+
+    for(size_t i = 1; i < ranges.size(); i++)
+      CHECK(ranges[i - 1].offs + ranges[i - 1].size < ranges[i].offs);
+
+    ApplyDeltaRanges(ranges, a);
+    CHECK(a == b);
+  }
+}
+
+TEST_CASE("Benchmark delta transfer range calculation", "[.][benchmark][replayproxy]")
+{
+  const size_t size = 256 * 1024 * 1024;
+
+  bytebuf ref, data;
+  ref.resize(size);
+  for(size_t i = 0; i < size; i += sizeof(uint32_t))
+  {
+    uint32_t val = uint32_t(i * 2654435761U);
+    memcpy(ref.data() + i, &val, sizeof(val));
+  }
+
+  struct Pattern
+  {
+    const char *name;
+    size_t stride;
+  };
+
+  // synthetic resource pairs: unchanged, a sparse vertical line, and a dense overwrite
+  for(Pattern p : {Pattern{"unchanged", 0}, Pattern{"sparse", 1440 * 4}, Pattern{"dense", 64}})
+  {
+    data = ref;
+    if(p.stride)
+    {
+      for(size_t i = 0; i < size; i += p.stride)
+        data[i]++;
+    }
+
+    rdcarray<DeltaRange> ranges;
+
+    PerformanceTimer timer;
+    CalculateDeltaRanges(data.data(), ref.data(), size, ranges);
+    double ms = timer.GetMilliseconds();
+
+    // the previous scalar approach, for comparison
+    timer.Restart();
+    uint64_t scalarDiffs = 0;
+    for(size_t offs = 0; offs < size; offs += MinDeltaChunkSize)
+      scalarDiffs += memcmp(data.data() + offs, ref.data() + offs, MinDeltaChunkSize) != 0 ? 1 : 0;
+    double scalarMs = timer.GetMilliseconds();
+
+    WARN(StringFormat::Fmt("%s: %llu MB/s (%llu deltas), scalar memcmp %llu MB/s (%llu chunks)",
+                           p.name, uint64_t(double(size) / (1024 * 1024) / (ms / 1000.0)),
+                           (uint64_t)ranges.size(),
+                           uint64_t(double(size) / (1024 * 1024) / (scalarMs / 1000.0)), scalarDiffs)
+             .c_str());
+  }
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -25,6 +25,7 @@
 
 #pragma once
 
+#include "core/remote_resource_cache.h"
 #include "os/os_specific.h"
 #include "replay/replay_driver.h"
 #include "serialise/serialiser.h"
@@ -105,6 +106,8 @@ enum ReplayProxyPacket
   eReplayProxy_FreeDebugger,
 
   eReplayProxy_FatalErrorCheck,
+
+  eReplayProxy_GetReplayProfile,
 };
 
 DECLARE_REFLECTION_ENUM(ReplayProxyPacket);
@@ -124,7 +127,8 @@ DECLARE_REFLECTION_ENUM(ReplayProxyPacket);
 class ReplayProxy : public IReplayDriver
 {
 public:
-  ReplayProxy(ReadSerialiser &reader, WriteSerialiser &writer, IReplayDriver *proxy);
+  ReplayProxy(ReadSerialiser &reader, WriteSerialiser &writer, IReplayDriver *proxy,
+              uint64_t captureHash);
 
   ReplayProxy(ReadSerialiser &reader, WriteSerialiser &writer, IRemoteDriver *remoteDriver,
               IReplayDriver *replayDriver, RENDERDOC_PreviewWindowCallback previewWindow);
@@ -483,6 +487,7 @@ public:
 
   IMPLEMENT_FUNCTION_PROXIED(rdcarray<EventUsage>, GetUsage, ResourceId id);
   IMPLEMENT_FUNCTION_PROXIED(FrameRecord, GetFrameRecord);
+  IMPLEMENT_FUNCTION_PROXIED(ReplayProfile, GetReplayProfile);
 
   IMPLEMENT_FUNCTION_PROXIED(bool, IsRenderOutput, ResourceId id);
 
@@ -554,6 +559,18 @@ public:
   template <typename SerialiserType>
   void DeltaTransferBytes(SerialiserType &xferser, bytebuf &referenceData, bytebuf &newData);
 
+  // utility function to check if the contents the client offered from its persistent cache match
+  // the data on the remote server. If so the transfer is skipped and data is loaded from the cache
+  // on the client side. loadFailed is set if the client couldn't load its cached contents after
+  // all, in which case they must be fetched again.
+  template <typename SerialiserType>
+  bool CachedContentsTransfer(SerialiserType &xferser, const RemoteContentHash &cachedHash,
+                              bytebuf &data, bool &loadFailed);
+
+  uint64_t GetBufferCacheKey(ResourceId buff, uint64_t offset, uint64_t len);
+  uint64_t GetTextureCacheKey(ResourceId tex, const Subresource &sub,
+                              const GetTextureDataParams &params);
+
   void FileChanged() {}
   // will never be used
   ResourceId CreateProxyTexture(const TextureDescription &templateTex)
@@ -630,6 +647,13 @@ private:
   std::map<TextureCacheEntry, bytebuf> m_ProxyTextureData;
   std::map<ResourceId, bytebuf> m_ProxyBufferData;
 
+  // this cache only exists on the client side, and persists fetched resource contents on disk
+  // between connections. It's NULL if disabled or on the remote server.
+  RemoteResourceCache *m_ResourceCache = NULL;
+  // set while refetching contents that failed to load from the cache, so nothing is offered from
+  // it and the refetch can't be answered with another cache hit
+  bool m_BypassResourceCache = false;
+
   // this lists any textures which are only created locally (e.g. custom visualisation shaders) and
   // should not be treated as proxied.
   std::set<ResourceId> m_LocalTextures;
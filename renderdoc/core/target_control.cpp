@@ -26,13 +26,14 @@
 #include "android/android.h"
 #include "api/replay/renderdoc_replay.h"
 #include "common/threading.h"
+#include "core/block_transfer.h"
 #include "core/core.h"
 #include "jpeg-compressor/jpgd.h"
 #include "os/os_specific.h"
 #include "replay/replay_driver.h"
 #include "serialise/serialiser.h"
 
-static const uint32_t TargetControlProtocolVersion = 9;
+static const uint32_t TargetControlProtocolVersion = 10;
 
 static bool IsProtocolVersionSupported(const uint32_t protocolVersion)
 {
@@ -64,6 +65,10 @@ static bool IsProtocolVersionSupported(const uint32_t protocolVersion)
   if(protocolVersion == 8)
     return true;
 
+  // 9 -> 10 copy captures in hashed blocks, skipping any the client already has
+  if(protocolVersion == 9)
+    return true;
+
   if(protocolVersion == TargetControlProtocolVersion)
     return true;
 
@@ -383,10 +388,16 @@ void RenderDoc::TargetControlClientThread(uint32_t version, Network::Socket *cli
         caps = RenderDoc::Inst().GetCaptures();
 
         uint32_t id;
+        TransferBlockHashes hashes;
 
         {
           READ_DATA_SCOPE();
           SERIALISE_ELEMENT(id);
+
+          if(version >= 10)
+          {
+            SERIALISE_ELEMENT(hashes);
+          }
         }
 
         if(id < caps.size())
@@ -397,10 +408,22 @@ void RenderDoc::TargetControlClientThread(uint32_t version, Network::Socket *cli
 
           rdcstr filename = caps[id].path;
 
-          StreamReader fileStream(FileIO::fopen(filename, FileIO::ReadBinary));
-          ser.SerialiseStream(filename, fileStream);
+          bool errored = false;
+
+          if(version >= 10)
+          {
+            TransferStats stats = SendTransferBlocks(ser, filename, hashes, NULL);
+            LogTransferStats("Sent", filename, stats);
+          }
+          else
+          {
+            StreamReader fileStream(FileIO::fopen(filename, FileIO::ReadBinary));
+            ser.SerialiseStream(filename, fileStream);
+
+            errored = fileStream.IsErrored();
+          }
 
-          if(fileStream.IsErrored() || ser.IsErrored())
+          if(errored || ser.IsErrored())
             SAFE_DELETE(client);
           else
             RenderDoc::Inst().MarkCaptureRetrieved(id);
@@ -673,13 +696,26 @@ public:
 
     SERIALISE_ELEMENT(remoteID);
 
+    // the copy is received into a separate file and only moved over localpath once it's complete.
+    // Anything we already have, from an earlier copy or an interrupted one, doesn't need to be sent
+    // again - an interrupted copy is newer, so it's what the sender compares against if it exists.
+    CaptureCopy copy;
+    copy.path = localpath;
+    copy.partial = localpath + ".partial";
+    copy.basis = FileIO::exists(copy.partial) ? copy.partial : localpath;
+
+    if(m_Version >= 10)
+    {
+      SERIALISE_ELEMENT_LOCAL(hashes, HashTransferBlocks(copy.basis));
+    }
+
     if(ser.IsErrored())
     {
       SAFE_DELETE(m_Socket);
       return;
     }
 
-    m_CaptureCopies[remoteID] = localpath;
+    m_CaptureCopies[remoteID] = copy;
   }
 
   void DeleteCapture(uint32_t remoteID)
@@ -897,14 +933,37 @@ public:
       READ_DATA_SCOPE();
       SERIALISE_ELEMENT(msg.newCapture.captureId).Named("Capture ID"_lit);
 
-      msg.newCapture.path = m_CaptureCopies[msg.newCapture.captureId];
+      const CaptureCopy &copy = m_CaptureCopies[msg.newCapture.captureId];
 
-      StreamWriter streamWriter(FileIO::fopen(msg.newCapture.path, FileIO::WriteBinary),
-                                Ownership::Stream);
+      msg.newCapture.path = copy.path;
 
-      ser.SerialiseStream(msg.newCapture.path, streamWriter, progress);
+      RDResult result;
 
-      if(reader.IsErrored())
+      if(m_Version >= 10)
+      {
+        // leave the partial file behind on failure so that a retry can pick up where this left off
+        TransferStats stats;
+        result = ReceiveTransferBlocks(ser, copy.basis, copy.partial, progress, stats);
+
+        if(result == ResultCode::Succeeded && !FileIO::Move(copy.partial, copy.path, true))
+          SET_ERROR_RESULT(result, ResultCode::FileIOFailed,
+                           "Couldn't move received capture to '%s': %s", copy.path.c_str(),
+                           FileIO::ErrorString().c_str());
+
+        if(result == ResultCode::Succeeded)
+          LogTransferStats("Received", copy.path, stats);
+        else
+          RDCERR("Error receiving capture: %s", result.message.c_str());
+      }
+      else
+      {
+        StreamWriter streamWriter(FileIO::fopen(msg.newCapture.path, FileIO::WriteBinary),
+                                  Ownership::Stream);
+
+        ser.SerialiseStream(msg.newCapture.path, streamWriter, progress);
+      }
+
+      if(reader.IsErrored() || result != ResultCode::Succeeded)
       {
         SAFE_DELETE(m_Socket);
 
@@ -950,7 +1009,14 @@ private:
   rdcstr m_Target, m_API, m_BusyClient;
   uint32_t m_Version, m_PID;
 
-  std::map<uint32_t, rdcstr> m_CaptureCopies;
+  struct CaptureCopy
+  {
+    rdcstr path;
+    rdcstr partial;
+    rdcstr basis;
+  };
+
+  std::map<uint32_t, CaptureCopy> m_CaptureCopies;
 };
 
 extern "C" RENDERDOC_API ITargetControl *RENDERDOC_CC RENDERDOC_CreateTargetControl(
@@ -1296,6 +1296,8 @@ RDResult WrappedID3D11DeviceContext::ReplayLog(CaptureState readType, uint32_t s
 
     m_CurChunkOffset = ser.GetReader()->GetOffset();
 
+    PerformanceTimer chunkTimer;
+
     D3D11Chunk chunktype = ser.ReadChunk<D3D11Chunk>();
 
     if(ser.IsErrored())
@@ -1355,6 +1357,11 @@ RDResult WrappedID3D11DeviceContext::ReplayLog(CaptureState readType, uint32_t s
       return m_FailedReplayResult;
     }
 
+    if(IsActiveReplaying(m_State))
+      m_pDevice->AddChunkReplayProfile((uint32_t)chunktype,
+                                       ser.GetReader()->GetOffset() - m_CurChunkOffset,
+                                       chunkTimer.GetMilliseconds());
+
     RenderDoc::Inst().SetProgress(
         LoadProgress::FrameEventsRead,
         float(m_CurChunkOffset - startOffset) / float(ser.GetReader()->GetSize()));
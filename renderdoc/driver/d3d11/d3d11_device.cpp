@@ -865,6 +865,12 @@ rdcstr WrappedID3D11Device::GetChunkName(uint32_t idx)
   return ToStr((D3D11Chunk)idx);
 }
 
+void WrappedID3D11Device::AddChunkReplayProfile(uint32_t chunkID, uint64_t byteSize,
+                                                double duration)
+{
+  ::AddChunkReplayProfile(m_ReplayProfile, chunkID, byteSize, duration, &GetChunkName);
+}
+
 void WrappedID3D11Device::AddDebugMessage(MessageCategory c, MessageSeverity sv, MessageSource src,
                                           rdcstr d)
 {
@@ -1440,7 +1446,10 @@ RDResult WrappedID3D11Device::ReadLogInitialisation(RDCFile *rdc, bool storeStru
         // save any debug messages we built up
         savedDebugMessages.swap(m_DebugMessages);
 
-        GetResourceManager()->ApplyInitialContents();
+        {
+          ScopedInitialContentsProfile profile(m_ReplayProfile);
+          GetResourceManager()->ApplyInitialContents();
+        }
 
         // restore saved messages - which implicitly discards any generated while applying initial
         // contents
@@ -1496,6 +1505,8 @@ RDResult WrappedID3D11Device::ReadLogInitialisation(RDCFile *rdc, bool storeStru
     }
   }
 
+  SetChunkLoadProfile(m_ReplayProfile, chunkInfos, &GetChunkName);
+
 #if ENABLED(RDOC_DEVEL)
   for(auto it = chunkInfos.begin(); it != chunkInfos.end(); ++it)
   {
@@ -1545,6 +1556,7 @@ void WrappedID3D11Device::ReplayLog(uint32_t startEventID, uint32_t endEventID,
   if(!partial)
   {
     RENDERDOC_PROFILEREGION("ApplyInitialContents");
+    ScopedInitialContentsProfile profile(m_ReplayProfile);
     D3D11MarkerRegion apply("!!!!RenderDoc Internal: ApplyInitialContents");
     GetResourceManager()->ApplyInitialContents();
   }
@@ -617,6 +617,7 @@ private:
   double m_TimeFrequency = 1.0f;
   SDFile *m_StructuredFile = NULL;
   SDFile *m_StoredStructuredData;
+  ReplayProfile m_ReplayProfile;
 
   int m_OOMHandler = 0;
   rdcarray<DebugMessage> m_DebugMessages;
@@ -775,6 +776,8 @@ public:
     m_State = CaptureState::StructuredExport;
   }
   RDResult ReadLogInitialisation(RDCFile *rdc, bool storeStructuredBuffers);
+  const ReplayProfile &GetReplayProfile() { return m_ReplayProfile; }
+  void AddChunkReplayProfile(uint32_t chunkID, uint64_t byteSize, double duration);
   bool ProcessChunk(ReadSerialiser &ser, D3D11Chunk context);
   void ReplayLog(uint32_t startEventID, uint32_t endEventID, ReplayLogType replayType);
 
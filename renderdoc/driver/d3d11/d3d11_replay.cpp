@@ -1617,6 +1617,11 @@ RDResult D3D11Replay::ReadLogInitialisation(RDCFile *rdc, bool storeStructuredBu
   return m_pDevice->ReadLogInitialisation(rdc, storeStructuredBuffers);
 }
 
+ReplayProfile D3D11Replay::GetReplayProfile()
+{
+  return m_pDevice->GetReplayProfile();
+}
+
 void D3D11Replay::ReplayLog(uint32_t endEventID, ReplayLogType replayType)
 {
   m_pDevice->ReplayLog(0, endEventID, replayType);
@@ -4414,4 +4419,5 @@ RDResult D3D11_ProcessStructured(RDCFile *rdc, SDFile &output)
 }
 
 static StructuredProcessRegistration D3D11ProcessRegistration(RDCDriver::D3D11,
-                                                              &D3D11_ProcessStructured);
+                                                              &D3D11_ProcessStructured,
+                                                              &WrappedID3D11Device::GetChunkName);
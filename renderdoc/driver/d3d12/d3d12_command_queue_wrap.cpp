@@ -905,9 +905,6 @@ void WrappedID3D12CommandQueue::ExecuteCommandListsInternal(UINT NumCommandLists
         // here AND serialise them there, but we'll play it safe.
         res->LockMaps();
 
-        size_t diffStart = 0, diffEnd = 0;
-        bool found = true;
-
         byte *ref = res->GetShadow(subres);
         byte *data = res->GetMap(subres);
 
@@ -962,18 +959,16 @@ void WrappedID3D12CommandQueue::ExecuteCommandListsInternal(UINT NumCommandLists
             }
           }
 
+          // {offset, length} of each changed range
+          rdcarray<rdcpair<size_t, size_t>> diffRanges;
+
           if(ref)
-            found = FindDiffRange(data, ref, size, diffStart, diffEnd);
+            FindDiffRanges(data, ref, size, MapDiffMergeGap, diffRanges);
           else
-            diffEnd = size;
+            diffRanges.push_back({0, size});
 
-          if(found)
+          if(!diffRanges.empty())
           {
-            RDCLOG("Persistent map flush forced for %s (%llu -> %llu)",
-                   ToStr(res->GetResourceID()).c_str(), (uint64_t)diffStart, (uint64_t)diffEnd);
-
-            D3D12_RANGE range = {diffStart, diffEnd};
-
             if(ref == NULL)
             {
               res->AllocShadow(subres, size);
@@ -981,9 +976,19 @@ void WrappedID3D12CommandQueue::ExecuteCommandListsInternal(UINT NumCommandLists
               ref = res->GetShadow(subres);
             }
 
-            // passing true here asks the serialisation function to update the shadow pointer for
-            // this resource
-            m_pDevice->MapDataWrite(res, subres, data, range, true);
+            RDCLOG("Persistent map flush forced for %s (%zu ranges, %llu -> %llu)",
+                   ToStr(res->GetResourceID()).c_str(), diffRanges.size(),
+                   (uint64_t)diffRanges.front().first,
+                   (uint64_t)(diffRanges.back().first + diffRanges.back().second));
+
+            for(const rdcpair<size_t, size_t> &diff : diffRanges)
+            {
+              D3D12_RANGE range = {diff.first, diff.first + diff.second};
+
+              // passing true here asks the serialisation function to update the shadow pointer for
+              // this resource
+              m_pDevice->MapDataWrite(res, subres, data, range, true);
+            }
 
             GetResourceManager()->MarkDirtyResource(res->GetResourceID());
           }
@@ -1009,6 +1009,8 @@ RDResult WrappedID3D12CommandQueue::ReplayLog(CaptureState readType, uint32_t st
 
     m_Cmd.m_CurChunkOffset = ser.GetReader()->GetOffset();
 
+    PerformanceTimer chunkTimer;
+
     D3D12Chunk context = ser.ReadChunk<D3D12Chunk>();
 
     if(ser.GetReader()->IsErrored())
@@ -1070,6 +1072,11 @@ RDResult WrappedID3D12CommandQueue::ReplayLog(CaptureState readType, uint32_t st
       return m_Cmd.m_FailedReplayResult;
     }
 
+    if(IsActiveReplaying(m_State))
+      m_pDevice->AddChunkReplayProfile((uint32_t)context,
+                                       ser.GetReader()->GetOffset() - m_Cmd.m_CurChunkOffset,
+                                       chunkTimer.GetMilliseconds());
+
     RenderDoc::Inst().SetProgress(
         LoadProgress::FrameEventsRead,
         float(m_Cmd.m_CurChunkOffset - startOffset) / float(ser.GetReader()->GetSize()));
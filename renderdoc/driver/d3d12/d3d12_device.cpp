@@ -58,6 +58,12 @@ rdcstr WrappedID3D12Device::GetChunkName(uint32_t idx)
   return ToStr((D3D12Chunk)idx);
 }
 
+void WrappedID3D12Device::AddChunkReplayProfile(uint32_t chunkID, uint64_t byteSize,
+                                                double duration)
+{
+  ::AddChunkReplayProfile(m_ReplayProfile, chunkID, byteSize, duration, &GetChunkName);
+}
+
 D3D12DebugManager *WrappedID3D12Device::GetDebugManager()
 {
   return m_Replay->GetDebugManager();
@@ -1330,6 +1336,8 @@ void WrappedID3D12Device::ApplyInitialContents()
 {
   RENDERDOC_PROFILEFUNCTION();
 
+  ScopedInitialContentsProfile profile(m_ReplayProfile);
+
   initStateCurBatch = 0;
   initStateCurList = NULL;
 
@@ -4345,6 +4353,8 @@ RDResult WrappedID3D12Device::ReadLogInitialisation(RDCFile *rdc, bool storeStru
     }
   }
 
+  SetChunkLoadProfile(m_ReplayProfile, chunkInfos, &GetChunkName);
+
 #if ENABLED(RDOC_DEVEL)
   for(auto it = chunkInfos.begin(); it != chunkInfos.end(); ++it)
   {
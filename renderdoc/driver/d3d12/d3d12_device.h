@@ -692,6 +692,7 @@ private:
   double m_TimeFrequency = 1.0f;
   SDFile *m_StructuredFile = NULL;
   SDFile *m_StoredStructuredData;
+  ReplayProfile m_ReplayProfile;
 
   uint32_t m_FrameCounter = 0;
   rdcarray<FrameDescription> m_CapturedFrames;
@@ -960,6 +961,8 @@ public:
                                          const rdcarray<DynamicDescriptorCopy> &DescriptorCopies);
 
   RDResult ReadLogInitialisation(RDCFile *rdc, bool storeStructuredBuffers);
+  const ReplayProfile &GetReplayProfile() { return m_ReplayProfile; }
+  void AddChunkReplayProfile(uint32_t chunkID, uint64_t byteSize, double duration);
   void ReplayLog(uint32_t startEventID, uint32_t endEventID, ReplayLogType replayType);
 
   void SetStructuredExport(uint64_t sectionVersion)
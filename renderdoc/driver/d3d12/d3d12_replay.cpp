@@ -216,6 +216,11 @@ RDResult D3D12Replay::ReadLogInitialisation(RDCFile *rdc, bool storeStructuredBu
   return m_pDevice->ReadLogInitialisation(rdc, storeStructuredBuffers);
 }
 
+ReplayProfile D3D12Replay::GetReplayProfile()
+{
+  return m_pDevice->GetReplayProfile();
+}
+
 rdcarray<GPUDevice> D3D12Replay::GetAvailableGPUs()
 {
   rdcarray<GPUDevice> ret;
@@ -4619,4 +4624,5 @@ RDResult D3D12_ProcessStructured(RDCFile *rdc, SDFile &output)
 }
 
 static StructuredProcessRegistration D3D12ProcessRegistration(RDCDriver::D3D12,
-                                                              &D3D12_ProcessStructured);
+                                                              &D3D12_ProcessStructured,
+                                                              &WrappedID3D12Device::GetChunkName);
@@ -3468,7 +3468,10 @@ RDResult WrappedOpenGL::ReadLogInitialisation(RDCFile *rdc, bool storeStructured
       // save any debug messages we built up
       savedDebugMessages.swap(m_DebugMessages);
 
-      GetResourceManager()->ApplyInitialContents();
+      {
+        ScopedInitialContentsProfile profile(m_ReplayProfile);
+        GetResourceManager()->ApplyInitialContents();
+      }
 
       // restore saved messages - which implicitly discards any generated while applying initial
       // contents
@@ -3498,6 +3501,8 @@ RDResult WrappedOpenGL::ReadLogInitialisation(RDCFile *rdc, bool storeStructured
             m_ImplicitThreadSwitches));
   }
 
+  SetChunkLoadProfile(m_ReplayProfile, chunkInfos, &GetChunkName);
+
 #if ENABLED(RDOC_DEVEL)
   for(auto it = chunkInfos.begin(); it != chunkInfos.end(); ++it)
   {
@@ -5251,6 +5256,8 @@ RDResult WrappedOpenGL::ContextReplayLog(CaptureState readType, uint32_t startEv
 
     m_CurChunkOffset = ser.GetReader()->GetOffset();
 
+    PerformanceTimer chunkTimer;
+
     GLChunk chunktype = ser.ReadChunk<GLChunk>();
 
     if(ser.GetReader()->IsErrored())
@@ -5270,6 +5277,11 @@ RDResult WrappedOpenGL::ContextReplayLog(CaptureState readType, uint32_t startEv
     if(!success)
       return m_FailedReplayResult;
 
+    if(IsActiveReplaying(m_State))
+      AddChunkReplayProfile(m_ReplayProfile, (uint32_t)chunktype,
+                            ser.GetReader()->GetOffset() - m_CurChunkOffset,
+                            chunkTimer.GetMilliseconds(), &GetChunkName);
+
     RenderDoc::Inst().SetProgress(
         LoadProgress::FrameEventsRead,
         float(m_CurChunkOffset - startOffset) / float(ser.GetReader()->GetSize()));
@@ -5769,6 +5781,7 @@ void WrappedOpenGL::ReplayLog(uint32_t startEventID, uint32_t endEventID, Replay
   if(!partial)
   {
     RENDERDOC_PROFILEREGION("ApplyInitialContents");
+    ScopedInitialContentsProfile profile(m_ReplayProfile);
     GLMarkerRegion apply("!!!!RenderDoc Internal: ApplyInitialContents");
     GetResourceManager()->ApplyInitialContents();
 
@@ -226,6 +226,7 @@ private:
   double m_TimeFrequency = 1.0f;
   SDFile *m_StructuredFile;
   SDFile *m_StoredStructuredData;
+  ReplayProfile m_ReplayProfile;
 
   void AddResource(ResourceId id, ResourceType type, const char *defaultNamePrefix);
   void DerivedResource(GLResource parent, ResourceId child);
@@ -668,6 +669,7 @@ public:
   void Initialise(GLInitParams &params, uint64_t sectionVersion, const ReplayOptions &opts);
   void ReplayLog(uint32_t startEventID, uint32_t endEventID, ReplayLogType replayType);
   RDResult ReadLogInitialisation(RDCFile *rdc, bool storeStructuredBuffers);
+  const ReplayProfile &GetReplayProfile() { return m_ReplayProfile; }
 
   GLuint GetFakeVAO0() { return m_Global_VAO0; }
   GLuint GetCurrentDefaultFBO() { return m_CurrentDefaultFBO; }
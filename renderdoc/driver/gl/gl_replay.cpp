@@ -114,6 +114,11 @@ RDResult GLReplay::ReadLogInitialisation(RDCFile *rdc, bool storeStructuredBuffe
   return m_pDriver->ReadLogInitialisation(rdc, storeStructuredBuffers);
 }
 
+ReplayProfile GLReplay::GetReplayProfile()
+{
+  return m_pDriver->GetReplayProfile();
+}
+
 void GLReplay::ReplayLog(uint32_t endEventID, ReplayLogType replayType)
 {
   MakeCurrentReplayContext(&m_ReplayCtx);
@@ -3929,9 +3934,11 @@ RDResult GL_ProcessStructured(RDCFile *rdc, SDFile &output)
   return status;
 }
 
-static StructuredProcessRegistration GLProcessRegistration(RDCDriver::OpenGL, &GL_ProcessStructured);
+static StructuredProcessRegistration GLProcessRegistration(RDCDriver::OpenGL, &GL_ProcessStructured,
+                                                           &WrappedOpenGL::GetChunkName);
 static StructuredProcessRegistration GLESProcessRegistration(RDCDriver::OpenGLES,
-                                                             &GL_ProcessStructured);
+                                                             &GL_ProcessStructured,
+                                                             &WrappedOpenGL::GetChunkName);
 
 rdcarray<GLVersion> GetReplayVersions(RDCDriver api)
 {
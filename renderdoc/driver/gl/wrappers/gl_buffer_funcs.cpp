@@ -3065,28 +3065,31 @@ void WrappedOpenGL::PersistentMapMemoryBarrier(const std::set<GLResourceRecord *
 
     if(record->Map.ptr)
     {
-      size_t diffStart = 0, diffEnd = record->Map.length;
-      bool found = true;
+      // {offset, length} of each changed range
+      rdcarray<rdcpair<size_t, size_t>> diffRanges;
 
-      if(record->GetShadowPtr(0))
-        found = FindDiffRange(record->GetShadowPtr(0), record->Map.ptr, (size_t)record->Map.length,
-                              diffStart, diffEnd);
+      const bool hadShadow = record->GetShadowPtr(0) != NULL;
 
-      if(found && diffEnd > diffStart)
+      if(hadShadow)
+        FindDiffRanges(record->GetShadowPtr(0), record->Map.ptr, (size_t)record->Map.length,
+                       MapDiffMergeGap, diffRanges);
+      else if(record->Map.length > 0)
+        diffRanges.push_back({0, (size_t)record->Map.length});
+
+      for(const rdcpair<size_t, size_t> &diff : diffRanges)
       {
         // update the modified region in the 'comparison' shadow buffer for next check
-        if(record->GetShadowPtr(0) == NULL)
+        if(!hadShadow)
           record->AllocShadowStorage(record->Map.length);
         else
-          memcpy(record->GetShadowPtr(0) + diffStart, record->Map.ptr + diffStart,
-                 diffEnd - diffStart);
+          memcpy(record->GetShadowPtr(0) + diff.first, record->Map.ptr + diff.first, diff.second);
 
         // we use our own flush function so it will serialise chunks when necessary, and it
         // also handles copying into the persistent mapped pointer and flushing the real GL
         // buffer
         gl_CurChunk = GLChunk::CoherentMapWrite;
-        glFlushMappedNamedBufferRangeEXT(record->Resource.name, GLintptr(diffStart),
-                                         GLsizeiptr(diffEnd - diffStart));
+        glFlushMappedNamedBufferRangeEXT(record->Resource.name, GLintptr(diff.first),
+                                         GLsizeiptr(diff.second));
       }
     }
   }
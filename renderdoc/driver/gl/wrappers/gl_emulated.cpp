@@ -3450,13 +3450,16 @@ void APIENTRY _glGetTexImage(GLenum target, GLint level, const GLenum format, co
           RDCDEBUG("Handling D24 only");
         }
 
-        // go pixel-by-pixel, reading in the readback format and writing in the dest format
+        // read in the readback format and write in the dest format
+        rdcarray<FloatVector> vecs;
+        vecs.resize(width * height);
+        DecodeFormattedComponents(readFmt, srcPixel, readCompSize * readCompCount, vecs.data(),
+                                  vecs.size());
+        EncodeFormattedComponents(origFmt, vecs.data(), dstPixel, dstStride, vecs.size());
+
+        // then fix up pixel-by-pixel
         for(GLint i = 0; i < width * height; i++)
         {
-          FloatVector vec = DecodeFormattedComponents(readFmt, srcPixel);
-
-          EncodeFormattedComponents(origFmt, vec, dstPixel);
-
           // GL expects ABGR order for these formats where our standard encoder writes BGRA, swizzle
           // here
           if(origFmt.type == ResourceFormatType::R4G4B4A4)
@@ -3485,7 +3488,6 @@ void APIENTRY _glGetTexImage(GLenum target, GLint level, const GLenum format, co
           }
 
           dstPixel += dstStride;
-          srcPixel += readCompSize * readCompCount;
         }
       }
 
@@ -842,30 +842,29 @@ void WrappedMTLDevice::CaptureCmdBufSubmit(MetalResourceRecord *record)
         MetalBufferInfo *bufInfo = refRecord->bufInfo;
         if(bufInfo->storageMode == MTL::StorageModeShared)
         {
-          size_t diffStart = 0;
-          size_t diffEnd = bufInfo->length;
-          bool foundDifference = true;
+          // {offset, length} of each changed range
+          rdcarray<rdcpair<size_t, size_t>> diffRanges;
           if(!bufInfo->baseSnapshot.isEmpty())
+            FindDiffRanges(bufInfo->data, bufInfo->baseSnapshot.data(), bufInfo->length,
+                           MapDiffMergeGap, diffRanges);
+          else
+            diffRanges.push_back({0, (size_t)bufInfo->length});
+
+          if(!diffRanges.empty() && bufInfo->data == NULL)
           {
-            foundDifference = FindDiffRange(bufInfo->data, bufInfo->baseSnapshot.data(),
-                                            bufInfo->length, diffStart, diffEnd);
-            if(diffEnd <= diffStart)
-              foundDifference = false;
+            RDCERR("Writing buffer memory %s that is NULL", ToStr(id).c_str());
+            continue;
           }
 
-          if(foundDifference)
+          for(const rdcpair<size_t, size_t> &diff : diffRanges)
           {
-            if(bufInfo->data == NULL)
-            {
-              RDCERR("Writing buffer memory %s that is NULL", ToStr(id).c_str());
-              continue;
-            }
             Chunk *chunk = NULL;
             {
               CACHE_THREAD_SERIALISER();
               SCOPED_SERIALISE_CHUNK(MetalChunk::MTLBuffer_InternalModifyCPUContents);
               ((WrappedMTLBuffer *)refRecord->m_Resource)
-                  ->Serialise_InternalModifyCPUContents(ser, diffStart, diffEnd, bufInfo);
+                  ->Serialise_InternalModifyCPUContents(ser, diff.first, diff.first + diff.second,
+                                                        bufInfo);
               chunk = scope.Get();
             }
             record->AddChunk(chunk);
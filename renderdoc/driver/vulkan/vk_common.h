@@ -415,6 +415,7 @@ enum class MemoryScope : uint8_t
   // allocated the same way
   ImmutableReplayDebug = InitialContents,
   IndirectReadback,
+  ReplayCheckpoint,
   Count,
 };
 
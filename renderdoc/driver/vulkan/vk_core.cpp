@@ -38,6 +38,11 @@
 #include "stb/stb_image_write.h"
 
 RDOC_EXTERN_CONFIG(bool, Vulkan_Debug_VerboseCommandRecording);
+RDOC_EXTERN_CONFIG(uint32_t, Vulkan_ReplayCheckpointIntervalMS);
+
+RDOC_DEBUG_CONFIG(bool, Vulkan_Debug_ReplayAllCommandChunks, false,
+                  "Deserialise every recorded command on replay, including commands in command "
+                  "buffers that aren't being re-recorded.");
 
 uint64_t VkInitParams::GetSerialiseSize()
 {
@@ -2749,6 +2754,8 @@ RDResult WrappedVulkan::ReadLogInitialisation(RDCFile *rdc, bool storeStructured
 
   SAFE_DELETE(sink);
 
+  SetChunkLoadProfile(m_ReplayProfile, chunkInfos, &GetChunkName);
+
 #if ENABLED(RDOC_DEVEL)
   for(auto it = chunkInfos.begin(); it != chunkInfos.end(); ++it)
   {
@@ -2803,6 +2810,28 @@ RDResult WrappedVulkan::ReadLogInitialisation(RDCFile *rdc, bool storeStructured
   return ResultCode::Succeeded;
 }
 
+void WrappedVulkan::AddCommandChunkRun(VulkanChunk chunk, uint64_t nextOffset)
+{
+  // begin and end are always processed, since they decide whether the command buffer is
+  // re-recorded and reset its state
+  if(m_LastCmdBufferID == ResourceId() || chunk == VulkanChunk::vkBeginCommandBuffer ||
+     chunk == VulkanChunk::vkEndCommandBuffer)
+    return;
+
+  if(!m_CommandChunkRuns.empty() && m_CommandChunkRuns.back().cmd == m_LastCmdBufferID &&
+     m_CommandChunkRuns.back().end == m_CurChunkOffset)
+  {
+    m_CommandChunkRuns.back().end = nextOffset;
+    return;
+  }
+
+  CommandChunkRun run;
+  run.start = m_CurChunkOffset;
+  run.end = nextOffset;
+  run.cmd = m_LastCmdBufferID;
+  m_CommandChunkRuns.push_back(run);
+}
+
 RDResult WrappedVulkan::ContextReplayLog(CaptureState readType, uint32_t startEventID,
                                          uint32_t endEventID, bool partial)
 {
@@ -2881,6 +2910,14 @@ RDResult WrappedVulkan::ContextReplayLog(CaptureState readType, uint32_t startEv
     if(partial)
       ser.GetReader()->SetOffset(ev.fileOffset);
 
+    // unless a replay checkpoint was restored, in which case everything up to its queue submit has
+    // been replayed already
+    if(!partial && m_ResumeBoundary.fileOffset != 0)
+    {
+      ser.GetReader()->SetOffset(m_ResumeBoundary.fileOffset);
+      m_RootEventID = m_ResumeBoundary.eventId;
+    }
+
     m_FirstEventID = startEventID;
     m_LastEventID = endEventID;
 
@@ -2903,6 +2940,21 @@ RDResult WrappedVulkan::ContextReplayLog(CaptureState readType, uint32_t startEv
 
   uint64_t startOffset = ser.GetReader()->GetOffset();
 
+  m_ResumeBoundary = ReplayCheckpointBoundary();
+
+  // checkpoints are only created during full replays, which replay every queue submit
+  bool createCheckpoints = IsActiveReplaying(m_State) && !partial && ReplayCheckpointsEnabled();
+  size_t nextBoundary = 0;
+  PerformanceTimer checkpointTimer;
+
+  // when replaying from the start of the frame, commands in command buffers that aren't
+  // re-recorded are never executed so we can jump over them. Replaying a range inside a command
+  // buffer or into an outside command buffer needs every command to be processed.
+  bool skipCommandRuns = IsActiveReplaying(m_State) && startEventID <= 1 &&
+                         m_OutsideCmdBuffer == VK_NULL_HANDLE &&
+                         !Vulkan_Debug_ReplayAllCommandChunks();
+  size_t nextRun = 0;
+
   for(;;)
   {
     if(IsActiveReplaying(m_State) && m_RootEventID > endEventID)
@@ -2914,6 +2966,60 @@ RDResult WrappedVulkan::ContextReplayLog(CaptureState readType, uint32_t startEv
 
     m_CurChunkOffset = ser.GetReader()->GetOffset();
 
+    if(createCheckpoints)
+    {
+      while(nextBoundary < m_CheckpointBoundaries.size() &&
+            m_CheckpointBoundaries[nextBoundary].fileOffset < m_CurChunkOffset)
+        nextBoundary++;
+
+      if(nextBoundary < m_CheckpointBoundaries.size() &&
+         m_CheckpointBoundaries[nextBoundary].fileOffset == m_CurChunkOffset)
+      {
+        const ReplayCheckpointBoundary &boundary = m_CheckpointBoundaries[nextBoundary];
+
+        RDCASSERTEQUAL(boundary.eventId, m_RootEventID);
+
+        bool exists = false;
+        for(const ReplayCheckpoint &checkpoint : m_Checkpoints)
+          exists |= (checkpoint.boundary.eventId == boundary.eventId);
+
+        // checkpoints are spaced by a fixed amount of elapsed replay time. Neither the cost of
+        // replaying the events in between nor the size of the checkpoint is considered.
+        if(exists)
+        {
+          checkpointTimer.Restart();
+        }
+        else if(boundary.eventId == m_RootEventID &&
+                checkpointTimer.GetMilliseconds() >= Vulkan_ReplayCheckpointIntervalMS())
+        {
+          CreateReplayCheckpoint(boundary);
+          checkpointTimer.Restart();
+
+          createCheckpoints = ReplayCheckpointsEnabled();
+        }
+      }
+    }
+
+    if(skipCommandRuns)
+    {
+      while(nextRun < m_CommandChunkRuns.size() &&
+            m_CommandChunkRuns[nextRun].start < m_CurChunkOffset)
+        nextRun++;
+
+      if(nextRun < m_CommandChunkRuns.size() &&
+         m_CommandChunkRuns[nextRun].start == m_CurChunkOffset &&
+         m_RerecordCmds.find(m_CommandChunkRuns[nextRun].cmd) == m_RerecordCmds.end())
+      {
+        // the vkEndCommandBuffer after the run resets the event counter for this command buffer,
+        // so nothing else needs to be updated
+        ser.GetReader()->SetOffset(m_CommandChunkRuns[nextRun].end);
+        nextRun++;
+        continue;
+      }
+    }
+
+    PerformanceTimer chunkTimer;
+
     VulkanChunk chunktype = ser.ReadChunk<VulkanChunk>();
 
     if(ser.GetReader()->IsErrored())
@@ -2958,6 +3064,11 @@ RDResult WrappedVulkan::ContextReplayLog(CaptureState readType, uint32_t startEv
       return m_FailedReplayResult;
     }
 
+    if(IsActiveReplaying(m_State))
+      AddChunkReplayProfile(m_ReplayProfile, (uint32_t)chunktype,
+                            ser.GetReader()->GetOffset() - m_CurChunkOffset,
+                            chunkTimer.GetMilliseconds(), &GetChunkName);
+
     RenderDoc::Inst().SetProgress(
         LoadProgress::FrameEventsRead,
         float(m_CurChunkOffset - startOffset) / float(ser.GetReader()->GetSize()));
@@ -2990,6 +3101,12 @@ RDResult WrappedVulkan::ContextReplayLog(CaptureState readType, uint32_t startEv
          chunktype != VulkanChunk::vkEndCommandBuffer)
         m_BakedCmdBufferInfo[m_LastCmdBufferID].curEventID++;
     }
+
+    if(IsLoading(m_State))
+    {
+      AddReplayCheckpointChunk(chunktype, ser.GetReader()->GetOffset());
+      AddCommandChunkRun(chunktype, ser.GetReader()->GetOffset());
+    }
   }
 
   if(!partial && !IsStructuredExporting(m_State))
@@ -3011,6 +3128,8 @@ RDResult WrappedVulkan::ContextReplayLog(CaptureState readType, uint32_t startEv
     SetupActionPointers(m_Actions, GetReplay()->WriteFrameRecord().actionList);
 
     m_ParentAction.children.clear();
+
+    FinaliseReplayCheckpointBoundaries();
   }
 
   if(!IsStructuredExporting(m_State))
@@ -3060,6 +3179,8 @@ void WrappedVulkan::ApplyInitialContents()
   if(HasFatalError())
     return;
 
+  ScopedInitialContentsProfile profile(m_ReplayProfile);
+
   VkMarkerRegion region("ApplyInitialContents");
 
   initStateCurBatch = 0;
@@ -3815,9 +3936,34 @@ void WrappedVulkan::ReplayLog(uint32_t startEventID, uint32_t endEventID, Replay
 
   if(!partial)
   {
-    VkMarkerRegion::Begin("!!!!RenderDoc Internal: ApplyInitialContents");
-    ApplyInitialContents();
-    VkMarkerRegion::End();
+    // find the latest replay checkpoint that doesn't go past the events being replayed
+    const ReplayCheckpoint *checkpoint = NULL;
+
+    if(ReplayCheckpointsEnabled())
+    {
+      uint32_t lastEventID = endEventID;
+      if(replayType == eReplay_WithoutDraw)
+        lastEventID = RDCMAX(1U, endEventID) - 1;
+
+      for(const ReplayCheckpoint &cp : m_Checkpoints)
+        if(cp.boundary.eventId <= lastEventID)
+          checkpoint = &cp;
+    }
+
+    if(checkpoint)
+    {
+      VkMarkerRegion::Begin("!!!!RenderDoc Internal: RestoreReplayCheckpoint");
+      RestoreReplayCheckpoint(*checkpoint);
+      VkMarkerRegion::End();
+
+      m_ResumeBoundary = checkpoint->boundary;
+    }
+    else
+    {
+      VkMarkerRegion::Begin("!!!!RenderDoc Internal: ApplyInitialContents");
+      ApplyInitialContents();
+      VkMarkerRegion::End();
+    }
   }
 
   m_State = CaptureState::ActiveReplaying;
@@ -385,6 +385,7 @@ private:
   double m_TimeFrequency = 1.0f;
   SDFile *m_StructuredFile;
   SDFile *m_StoredStructuredData;
+  ReplayProfile m_ReplayProfile;
 
   void AddResource(ResourceId id, ResourceType type, const char *defaultNamePrefix);
   void DerivedResource(ResourceId parentLive, ResourceId child);
@@ -975,6 +976,72 @@ private:
 
   std::set<ResourceId> m_SparseBindResources;
 
+  // replay checkpoints, snapshots of the frame's mutable state taken at a queue submit boundary
+  // during a full replay so that later replays can start from there instead of from the
+  // beginning of the frame.
+  struct ReplayCheckpointBoundary
+  {
+    // offset of the first chunk after the submit, 0 if the boundary is not set
+    uint64_t fileOffset = 0;
+    // the root event ID that the replay would have when reaching fileOffset
+    uint32_t eventId = 0;
+  };
+
+  struct ReplayCheckpointContents
+  {
+    ResourceId id;
+    VkBuffer buf = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+    // for memory, the written ranges packed into buf. For images, the subresources in buf, or
+    // empty for multisampled images which are copied as one slice per sample
+    rdcarray<VkBufferCopy> memRegions;
+    rdcarray<VkBufferImageCopy> imageRegions;
+  };
+
+  struct ReplayCheckpoint
+  {
+    ReplayCheckpointBoundary boundary;
+    uint64_t byteSize = 0;
+    rdcarray<ReplayCheckpointContents> memory;
+    rdcarray<ReplayCheckpointContents> images;
+    rdcarray<rdcpair<ResourceId, ImageState>> imageStates;
+    rdcarray<rdcpair<ResourceId, VkInitialContents>> descSets;
+  };
+
+  // submit boundaries found while loading that are safe to resume replaying from
+  rdcarray<ReplayCheckpointBoundary> m_CheckpointBoundaries;
+  // file offset of the vkBeginCommandBuffer for each baked command buffer, only used while loading
+  std::map<ResourceId, uint64_t> m_CheckpointCmdBegins;
+  // descriptor sets updated during the frame, which need to be saved in each checkpoint
+  std::set<ResourceId> m_CheckpointDescSets;
+  // checkpoints taken so far, sorted by event
+  rdcarray<ReplayCheckpoint> m_Checkpoints;
+  uint64_t m_CheckpointBytes = 0;
+  bool m_CheckpointsSupported = true;
+  // the boundary that the next ContextReplayLog should resume from, if a checkpoint was restored
+  ReplayCheckpointBoundary m_ResumeBoundary;
+
+  void AddReplayCheckpointChunk(VulkanChunk chunk, uint64_t nextOffset);
+  void FinaliseReplayCheckpointBoundaries();
+  bool ReplayCheckpointsEnabled();
+  bool CreateReplayCheckpoint(const ReplayCheckpointBoundary &boundary);
+  void RestoreReplayCheckpoint(const ReplayCheckpoint &checkpoint);
+
+  // a contiguous run of recorded commands between a vkBeginCommandBuffer and vkEndCommandBuffer
+  // that all belong to one baked command buffer, found while loading. On replay a run whose
+  // command buffer isn't being re-recorded has no effect, so it's skipped without deserialising.
+  struct CommandChunkRun
+  {
+    uint64_t start = 0;
+    uint64_t end = 0;
+    ResourceId cmd;
+  };
+
+  // sorted by file offset
+  rdcarray<CommandChunkRun> m_CommandChunkRuns;
+
+  void AddCommandChunkRun(VulkanChunk chunk, uint64_t nextOffset);
+
   RDResult m_FailedReplayResult = ResultCode::APIReplayFailed;
 
   VulkanActionTreeNode m_ParentAction;
@@ -1080,6 +1147,11 @@ public:
                               const VkInitialContents *initial);
   void Create_InitialState(ResourceId id, WrappedVkRes *live, bool hasData);
   void Apply_InitialState(WrappedVkRes *live, const VkInitialContents &initial);
+  bool CreateDescriptorSetWrites(ResourceId liveid, VkDescriptorSet set,
+                                 const DescSetLayout &layout, const DescriptorSetSlot *bindings,
+                                 uint32_t numBindings, const bytebuf &inlineData,
+                                 VkInitialContents &initialContents);
+  void ClearReplayCheckpoints();
 
   void RemapQueueFamilyIndices(uint32_t &srcQueueFamily, uint32_t &dstQueueFamily);
   uint32_t GetQueueFamilyIndex() const { return m_QueueFamilyIdx; }
@@ -1098,6 +1170,7 @@ public:
   void ReplayLog(uint32_t startEventID, uint32_t endEventID, ReplayLogType replayType);
   void ReplayDraw(VkCommandBuffer cmd, const ActionDescription &action);
   RDResult ReadLogInitialisation(RDCFile *rdc, bool storeStructuredBuffers);
+  const ReplayProfile &GetReplayProfile() { return m_ReplayProfile; }
 
   SDFile *GetStructuredFile() { return m_StructuredFile; }
   SDFile *DetachStructuredFile()
@@ -26,6 +26,18 @@
 #include "vk_core.h"
 #include "vk_debug.h"
 
+RDOC_CONFIG(uint32_t, Vulkan_ReplayCheckpointBudgetMB, 0,
+            "The amount of GPU memory in MB that can be used for replay checkpoints. A checkpoint "
+            "saves the memory, images and descriptor sets written in the frame at a queue submit, "
+            "so that replaying to a later event can start from the closest checkpoint instead of "
+            "from the start of the frame. 0 disables checkpoints.");
+
+RDOC_CONFIG(uint32_t, Vulkan_ReplayCheckpointIntervalMS, 20,
+            "The minimum amount of replay time in milliseconds between two replay checkpoints. "
+            "This is a fixed interval of wall-clock time measured during the full replay: "
+            "checkpoints are placed at the first suitable queue submit once it has elapsed, not "
+            "chosen by the cost of replaying or of saving the state at each submit.");
+
 // VKTODOLOW there's a lot of duplicated code in this file for creating a buffer to do
 // a memory copy and saving to disk.
 
@@ -953,6 +965,117 @@ SparseBinding::SparseBinding(WrappedVulkan *vk, VkImage unwrappedImage,
   pImageBinds = &imgBind;
 }
 
+// fill out the descriptor writes in initialContents that will set the descriptor set to the given
+// slot contents. The slots refer to resources by their original IDs.
+bool WrappedVulkan::CreateDescriptorSetWrites(ResourceId liveid, VkDescriptorSet set,
+                                              const DescSetLayout &layout,
+                                              const DescriptorSetSlot *bindings,
+                                              uint32_t numBindings, const bytebuf &inlineData,
+                                              VkInitialContents &initialContents)
+{
+  bool ret = true;
+
+  initialContents.descriptorInfo = new VkDescriptorBufferInfo[numBindings];
+  initialContents.inlineInfo = NULL;
+
+  if(layout.inlineCount > 0)
+  {
+    initialContents.inlineInfo = new VkWriteDescriptorSetInlineUniformBlock[layout.inlineCount];
+    initialContents.inlineData = AllocAlignedBuffer(inlineData.size());
+    RDCASSERTEQUAL(layout.inlineByteSize, inlineData.size());
+    memcpy(initialContents.inlineData, inlineData.data(), inlineData.size());
+  }
+
+  RDCCOMPILE_ASSERT(sizeof(VkDescriptorBufferInfo) >= sizeof(VkDescriptorImageInfo),
+                    "Descriptor structs sizes are unexpected, ensure largest size is used");
+
+  rdcarray<VkWriteDescriptorSet> writes;
+
+  VkDescriptorBufferInfo *writeScratch = initialContents.descriptorInfo;
+  VkWriteDescriptorSetInlineUniformBlock *dstInline = initialContents.inlineInfo;
+  const DescriptorSetSlot *srcBindings = bindings;
+  byte *srcInlineData = initialContents.inlineData;
+
+  for(uint32_t bind = 0; bind < (uint32_t)layout.bindings.size(); bind++)
+  {
+    const DescSetLayout::Binding &layoutBind = layout.bindings[bind];
+
+    uint32_t descriptorCount = layoutBind.descriptorCount;
+
+    if(layoutBind.variableSize)
+      descriptorCount = m_DescriptorSetState[liveid].data.variableDescriptorCount;
+
+    if(descriptorCount == 0)
+      continue;
+
+    uint32_t inlineSize = 0;
+
+    if(layoutBind.layoutDescType == VK_DESCRIPTOR_TYPE_INLINE_UNIFORM_BLOCK)
+    {
+      inlineSize = descriptorCount;
+      descriptorCount = 1;
+    }
+
+    const DescriptorSetSlot *slots = srcBindings;
+    srcBindings += descriptorCount;
+
+    // check that the resources we need for this write are present, as some might have been
+    // skipped due to stale descriptor set slots or otherwise unreferenced objects (the
+    // descriptor set initial contents do not cause a frame reference for their resources).
+    //
+    // For the non-array case it's trivial as either the descriptor is valid, in which case it
+    // gets a write, or not, in which case we skip.
+    // For the array case we batch up updates as much as possible, iterating along the array and
+    // skipping any invalid descriptors.
+    // We also use this loop for handling mutable descriptor types, since descriptors in a
+    // mutable array could have various different types and each contiguous block will need a
+    // separate write.
+
+    // inline block can't be mutable and can't be arrayed, handle it directly here
+    if(layoutBind.layoutDescType == VK_DESCRIPTOR_TYPE_INLINE_UNIFORM_BLOCK)
+    {
+      // handle inline uniform block specially because the descriptorCount doesn't mean what it
+      // normally means in the write.
+      dstInline->sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_INLINE_UNIFORM_BLOCK;
+      dstInline->pNext = NULL;
+      dstInline->pData = srcInlineData + slots->offset;
+      dstInline->dataSize = inlineSize;
+
+      VkWriteDescriptorSet write = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+      write.pNext = dstInline;
+      write.dstSet = set;
+      write.descriptorType = VK_DESCRIPTOR_TYPE_INLINE_UNIFORM_BLOCK;
+      write.dstBinding = bind;
+      write.descriptorCount = inlineSize;
+
+      writes.push_back(write);
+
+      dstInline++;
+    }
+    // quick check for slots that were completely uninitialised and so don't have valid data
+    else if(!NULLDescriptorsAllowed() && descriptorCount == 1 &&
+            slots->resource == ResourceId() && slots->sampler == ResourceId())
+    {
+      // do nothing - don't increment bind so that the same write descriptor is used next time.
+      continue;
+    }
+    else
+    {
+      bool success = CreateDescriptorWritesForSlotData(this, writes, writeScratch, slots,
+                                                       descriptorCount, set, bind, layoutBind);
+      if(!success)
+        ret = false;
+    }
+  }
+
+  initialContents.descriptorWrites = new VkWriteDescriptorSet[writes.size()];
+  memcpy(initialContents.descriptorWrites, writes.data(), writes.byteSize());
+
+  initialContents.numDescriptors = (uint32_t)writes.size();
+
+  return ret;
+}
+
 template <typename SerialiserType>
 bool WrappedVulkan::Serialise_InitialState(SerialiserType &ser, ResourceId id, VkResourceRecord *,
                                            const VkInitialContents *initial)
@@ -1047,103 +1170,9 @@ bool WrappedVulkan::Serialise_InitialState(SerialiserType &ser, ResourceId id, V
 
       VkInitialContents initialContents(type, VkInitialContents::DescriptorSet);
 
-      initialContents.descriptorInfo = new VkDescriptorBufferInfo[NumBindings];
-      initialContents.inlineInfo = NULL;
-
-      if(layout.inlineCount > 0)
-      {
-        initialContents.inlineInfo = new VkWriteDescriptorSetInlineUniformBlock[layout.inlineCount];
-        initialContents.inlineData = AllocAlignedBuffer(InlineData.size());
-        RDCASSERTEQUAL(layout.inlineByteSize, InlineData.size());
-        memcpy(initialContents.inlineData, InlineData.data(), InlineData.size());
-      }
-
-      RDCCOMPILE_ASSERT(sizeof(VkDescriptorBufferInfo) >= sizeof(VkDescriptorImageInfo),
-                        "Descriptor structs sizes are unexpected, ensure largest size is used");
-
-      rdcarray<VkWriteDescriptorSet> writes;
-
-      VkDescriptorBufferInfo *writeScratch = initialContents.descriptorInfo;
-      VkWriteDescriptorSetInlineUniformBlock *dstInline = initialContents.inlineInfo;
-      DescriptorSetSlot *srcBindings = Bindings;
-      byte *srcInlineData = initialContents.inlineData;
-
-      for(uint32_t bind = 0; bind < (uint32_t)layout.bindings.size(); bind++)
-      {
-        const DescSetLayout::Binding &layoutBind = layout.bindings[bind];
-
-        uint32_t descriptorCount = layoutBind.descriptorCount;
-
-        if(layoutBind.variableSize)
-          descriptorCount = m_DescriptorSetState[liveid].data.variableDescriptorCount;
-
-        if(descriptorCount == 0)
-          continue;
-
-        uint32_t inlineSize = 0;
-
-        if(layoutBind.layoutDescType == VK_DESCRIPTOR_TYPE_INLINE_UNIFORM_BLOCK)
-        {
-          inlineSize = descriptorCount;
-          descriptorCount = 1;
-        }
-
-        DescriptorSetSlot *slots = srcBindings;
-        srcBindings += descriptorCount;
-
-        // check that the resources we need for this write are present, as some might have been
-        // skipped due to stale descriptor set slots or otherwise unreferenced objects (the
-        // descriptor set initial contents do not cause a frame reference for their resources).
-        //
-        // For the non-array case it's trivial as either the descriptor is valid, in which case it
-        // gets a write, or not, in which case we skip.
-        // For the array case we batch up updates as much as possible, iterating along the array and
-        // skipping any invalid descriptors.
-        // We also use this loop for handling mutable descriptor types, since descriptors in a
-        // mutable array could have various different types and each contiguous block will need a
-        // separate write.
-
-        // inline block can't be mutable and can't be arrayed, handle it directly here
-        if(layoutBind.layoutDescType == VK_DESCRIPTOR_TYPE_INLINE_UNIFORM_BLOCK)
-        {
-          // handle inline uniform block specially because the descriptorCount doesn't mean what it
-          // normally means in the write.
-          dstInline->sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_INLINE_UNIFORM_BLOCK;
-          dstInline->pNext = NULL;
-          dstInline->pData = srcInlineData + slots->offset;
-          dstInline->dataSize = inlineSize;
-
-          VkWriteDescriptorSet write = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
-          write.pNext = dstInline;
-          write.dstSet = set;
-          write.descriptorType = VK_DESCRIPTOR_TYPE_INLINE_UNIFORM_BLOCK;
-          write.dstBinding = bind;
-          write.descriptorCount = inlineSize;
-
-          writes.push_back(write);
-
-          dstInline++;
-        }
-        // quick check for slots that were completely uninitialised and so don't have valid data
-        else if(!NULLDescriptorsAllowed() && descriptorCount == 1 &&
-                slots->resource == ResourceId() && slots->sampler == ResourceId())
-        {
-          // do nothing - don't increment bind so that the same write descriptor is used next time.
-          continue;
-        }
-        else
-        {
-          bool success = CreateDescriptorWritesForSlotData(this, writes, writeScratch, slots,
-                                                           descriptorCount, set, bind, layoutBind);
-          if(!success)
-            ret = false;
-        }
-      }
-
-      initialContents.descriptorWrites = new VkWriteDescriptorSet[writes.size()];
-      memcpy(initialContents.descriptorWrites, writes.data(), writes.byteSize());
-
-      initialContents.numDescriptors = (uint32_t)writes.size();
+      if(!CreateDescriptorSetWrites(liveid, set, layout, Bindings, NumBindings, InlineData,
+                                    initialContents))
+        ret = false;
 
       GetResourceManager()->SetInitialContents(id, initialContents);
     }
@@ -2170,3 +2199,700 @@ void WrappedVulkan::Apply_InitialState(WrappedVkRes *live, const VkInitialConten
     RDCERR("Unhandled resource type %d", type);
   }
 }
+
+// returns true if any of the image's contents are written during the frame, either through the
+// image itself or through the memory bound to it.
+static bool CheckpointImageWritten(VulkanResourceManager *rm, const ImageState &state)
+{
+  if(IncludesWrite(state.maxRefType))
+    return true;
+
+  for(auto it = state.subresourceStates.begin(); it != state.subresourceStates.end(); ++it)
+    if(IncludesWrite(it->state().refType))
+      return true;
+
+  MemRefs *memRefs = rm->FindMemRefs(rm->GetOriginalID(state.boundMemory));
+
+  if(memRefs)
+  {
+    for(auto it = memRefs->rangeRefs.find(state.boundMemoryOffset);
+        it != memRefs->rangeRefs.end() &&
+        it->start() < state.boundMemoryOffset + state.boundMemorySize;
+        ++it)
+    {
+      if(IncludesWrite(it->value()))
+        return true;
+    }
+  }
+
+  return false;
+}
+
+// fill out the regions to copy every subresource of a non-multisampled image tightly into a
+// buffer, in the same layout as initial contents, and return the size of buffer needed.
+static VkDeviceSize GetCheckpointImageRegions(const ImageInfo &imageInfo,
+                                              rdcarray<VkBufferImageCopy> &regions)
+{
+  VkFormat fmt = imageInfo.format;
+  uint32_t planeCount = GetYUVPlaneCount(fmt);
+  VkImageAspectFlags aspectFlags = FormatImageAspects(fmt);
+
+  // must ensure offset remains valid. Must be multiple of block size, or 4, depending on format
+  VkDeviceSize bufAlignment = 4;
+  if(IsBlockFormat(fmt))
+    bufAlignment = (VkDeviceSize)GetByteSize(1, 1, 1, fmt, 0);
+
+  VkDeviceSize bufOffset = 0;
+
+  for(uint32_t a = 0; a < imageInfo.layerCount; a++)
+  {
+    VkExtent3D extent = imageInfo.extent;
+
+    for(uint32_t m = 0; m < imageInfo.levelCount; m++)
+    {
+      VkBufferImageCopy region = {
+          0, 0, 0, {aspectFlags, m, a, 1}, {0, 0, 0}, extent,
+      };
+
+      // pass 0 for mip to the size functions since we've already pre-downscaled extent
+      if(planeCount > 1)
+      {
+        for(uint32_t i = 0; i < planeCount; i++)
+        {
+          bufOffset = AlignUp(bufOffset, bufAlignment);
+
+          VkExtent2D planeShape = GetPlaneShape(extent.width, extent.height, fmt, i);
+
+          region.bufferOffset = bufOffset;
+          region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_PLANE_0_BIT << i;
+          region.imageExtent = {planeShape.width, planeShape.height, extent.depth};
+
+          bufOffset += GetPlaneByteSize(extent.width, extent.height, extent.depth, fmt, 0, i);
+
+          regions.push_back(region);
+        }
+      }
+      else if(aspectFlags == (VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT))
+      {
+        bufOffset = AlignUp(bufOffset, bufAlignment);
+
+        region.bufferOffset = bufOffset;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+
+        bufOffset +=
+            GetByteSize(extent.width, extent.height, extent.depth, GetDepthOnlyFormat(fmt), 0);
+
+        regions.push_back(region);
+
+        bufOffset = AlignUp(bufOffset, bufAlignment);
+
+        region.bufferOffset = bufOffset;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_STENCIL_BIT;
+
+        bufOffset += GetByteSize(extent.width, extent.height, extent.depth, VK_FORMAT_S8_UINT, 0);
+
+        regions.push_back(region);
+      }
+      else
+      {
+        bufOffset = AlignUp(bufOffset, bufAlignment);
+
+        region.bufferOffset = bufOffset;
+
+        bufOffset += GetByteSize(extent.width, extent.height, extent.depth, fmt, 0);
+
+        regions.push_back(region);
+      }
+
+      // update the extent for the next mip
+      extent.width = RDCMAX(extent.width >> 1, 1U);
+      extent.height = RDCMAX(extent.height >> 1, 1U);
+      extent.depth = RDCMAX(extent.depth >> 1, 1U);
+    }
+  }
+
+  return bufOffset;
+}
+
+bool WrappedVulkan::ReplayCheckpointsEnabled()
+{
+  return Vulkan_ReplayCheckpointBudgetMB() > 0 && m_CheckpointsSupported &&
+         m_ActionCallback == NULL && !IsStructuredExporting(m_State);
+}
+
+void WrappedVulkan::AddReplayCheckpointChunk(VulkanChunk chunk, uint64_t nextOffset)
+{
+  if(chunk == VulkanChunk::vkBeginCommandBuffer)
+  {
+    m_CheckpointCmdBegins[m_LastCmdBufferID] = m_CurChunkOffset;
+  }
+  else if(chunk == VulkanChunk::vkQueueBindSparse)
+  {
+    // we don't track sparse page tables at arbitrary points in the frame
+    m_CheckpointsSupported = false;
+  }
+  else if((chunk == VulkanChunk::vkQueueSubmit || chunk == VulkanChunk::vkQueueSubmit2) &&
+          m_LastCmdBufferID == ResourceId())
+  {
+    // after a submit the root event ID has already been incremented to the next event
+    ReplayCheckpointBoundary boundary;
+    boundary.fileOffset = nextOffset;
+    boundary.eventId = m_RootEventID;
+    m_CheckpointBoundaries.push_back(boundary);
+  }
+}
+
+// a boundary can only be resumed from if no command buffer recorded before it is submitted
+// after it, since resuming skips over the recording. cmdBegins has the file offset each command
+// buffer was begun at, and lastSubmits the event of its last submission.
+static bool CanResumeFromBoundary(uint64_t fileOffset, uint32_t eventId,
+                                  const std::map<ResourceId, uint64_t> &cmdBegins,
+                                  const std::map<ResourceId, uint32_t> &lastSubmits)
+{
+  for(auto it = cmdBegins.begin(); it != cmdBegins.end(); ++it)
+  {
+    if(it->second >= fileOffset)
+      continue;
+
+    auto submitIt = lastSubmits.find(it->first);
+    if(submitIt != lastSubmits.end() && submitIt->second >= eventId)
+      return false;
+  }
+
+  return true;
+}
+
+void WrappedVulkan::FinaliseReplayCheckpointBoundaries()
+{
+  std::map<ResourceId, uint32_t> lastSubmits;
+
+  for(int p = 0; p < ePartialNum; p++)
+  {
+    for(auto it = m_Partial[p].cmdBufferSubmits.begin();
+        it != m_Partial[p].cmdBufferSubmits.end(); ++it)
+    {
+      for(const Submission &submit : it->second)
+        lastSubmits[it->first] = RDCMAX(lastSubmits[it->first], submit.baseEvent);
+    }
+  }
+
+  rdcarray<ReplayCheckpointBoundary> boundaries;
+  boundaries.swap(m_CheckpointBoundaries);
+
+  for(const ReplayCheckpointBoundary &b : boundaries)
+  {
+    if(CanResumeFromBoundary(b.fileOffset, b.eventId, m_CheckpointCmdBegins, lastSubmits))
+      m_CheckpointBoundaries.push_back(b);
+  }
+
+  m_CheckpointCmdBegins.clear();
+
+  RDCLOG("%zu of %zu queue submits can be used as replay checkpoints",
+         m_CheckpointBoundaries.size(), boundaries.size());
+}
+
+bool WrappedVulkan::CreateReplayCheckpoint(const ReplayCheckpointBoundary &boundary)
+{
+  RENDERDOC_PROFILEFUNCTION();
+  if(HasFatalError())
+    return false;
+
+  VulkanResourceManager *rm = GetResourceManager();
+
+  ReplayCheckpoint checkpoint;
+  checkpoint.boundary = boundary;
+
+  // gather the ranges of each memory allocation that are written during the frame
+  for(auto it = m_CreationInfo.m_Memory.begin(); it != m_CreationInfo.m_Memory.end(); ++it)
+  {
+    if(it->second.wholeMemBuf == VK_NULL_HANDLE)
+      continue;
+
+    ResourceId orig = rm->GetOriginalID(it->first);
+    MemRefs *memRefs = rm->FindMemRefs(orig);
+    VkDeviceSize memSize = it->second.wholeMemBufSize;
+
+    ReplayCheckpointContents contents;
+    contents.id = it->first;
+
+    VkDeviceSize bufSize = 0;
+
+    if(memRefs)
+    {
+      for(auto refIt = memRefs->rangeRefs.begin(); refIt != memRefs->rangeRefs.end(); ++refIt)
+      {
+        if(!IncludesWrite(refIt->value()) || refIt->start() >= memSize)
+          continue;
+
+        VkDeviceSize size = RDCMIN(refIt->finish(), memSize) - refIt->start();
+        contents.memRegions.push_back({refIt->start(), bufSize, size});
+        bufSize += size;
+      }
+    }
+    else if(rm->GetInitialContents(orig).type == eResDeviceMemory)
+    {
+      // with no information about the memory usage in the frame, be pessimistic like the
+      // initial contents and save everything
+      contents.memRegions.push_back({0, 0, memSize});
+      bufSize = memSize;
+    }
+
+    if(bufSize == 0)
+      continue;
+
+    contents.size = bufSize;
+    checkpoint.byteSize += bufSize;
+    checkpoint.memory.push_back(contents);
+  }
+
+  {
+    SCOPED_LOCK(m_ImageStatesLock);
+
+    for(auto it = m_ImageStates.begin(); it != m_ImageStates.end(); ++it)
+    {
+      const ImageState &state = *it->second.state();
+
+      checkpoint.imageStates.push_back({it->first, state});
+
+      if(!state.isMemoryBound || !CheckpointImageWritten(rm, state))
+        continue;
+
+      // we don't track which memory sparse images have bound partway through the frame
+      if(state.boundMemory == ResourceId())
+      {
+        RDCLOG("Disabling replay checkpoints, sparse image %s is written in the frame",
+               ToStr(rm->GetOriginalID(it->first)).c_str());
+        m_CheckpointsSupported = false;
+        ClearReplayCheckpoints();
+        return false;
+      }
+
+      bool external = false;
+      for(auto subIt = state.subresourceStates.begin(); subIt != state.subresourceStates.end();
+          ++subIt)
+      {
+        if(subIt->state().newQueueFamilyIndex == VK_QUEUE_FAMILY_FOREIGN_EXT ||
+           subIt->state().newQueueFamilyIndex == VK_QUEUE_FAMILY_EXTERNAL)
+          external = true;
+      }
+
+      // like initial contents, we can't fetch images owned by external/foreign queue families
+      if(external)
+        continue;
+
+      const ImageInfo &imageInfo = state.GetImageInfo();
+
+      ReplayCheckpointContents contents;
+      contents.id = it->first;
+
+      if(imageInfo.sampleCount > 1)
+      {
+        // the multisampled copy decomposes each sample into a separate slice
+        contents.size = VkDeviceSize(imageInfo.layerCount) * imageInfo.sampleCount *
+                        GetByteSize(imageInfo.extent.width, imageInfo.extent.height,
+                                    imageInfo.extent.depth, imageInfo.format, 0);
+      }
+      else
+      {
+        contents.size = GetCheckpointImageRegions(imageInfo, contents.imageRegions);
+      }
+
+      checkpoint.byteSize += contents.size;
+      checkpoint.images.push_back(contents);
+    }
+  }
+
+  uint64_t budget = uint64_t(Vulkan_ReplayCheckpointBudgetMB()) * 1024 * 1024;
+  if(m_CheckpointBytes + checkpoint.byteSize > budget)
+  {
+    RDCDEBUG("Skipping replay checkpoint at event %u, %llu bytes would exceed the budget",
+             boundary.eventId, checkpoint.byteSize);
+    return false;
+  }
+
+  VkDevice d = GetDev();
+  VkResult vkr = VK_SUCCESS;
+
+  VkBufferCreateInfo bufInfo = {
+      VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, NULL, 0, 0, VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                                                            VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                                                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+  };
+
+  // create a buffer for each resource's contents
+  for(int pass = 0; pass < 2; pass++)
+  {
+    rdcarray<ReplayCheckpointContents> &list = pass == 0 ? checkpoint.memory : checkpoint.images;
+
+    for(ReplayCheckpointContents &contents : list)
+    {
+      bufInfo.size = contents.size;
+
+      vkr = ObjDisp(d)->CreateBuffer(Unwrap(d), &bufInfo, NULL, &contents.buf);
+      CheckVkResult(vkr);
+
+      GetResourceManager()->WrapResource(Unwrap(d), contents.buf);
+
+      MemoryAllocation mem = AllocateMemoryForResource(
+          contents.buf, MemoryScope::ReplayCheckpoint, MemoryType::GPULocal);
+
+      if(mem.mem == VK_NULL_HANDLE)
+      {
+        RDCWARN("Couldn't allocate replay checkpoint memory, disabling replay checkpoints");
+
+        // add the incomplete checkpoint so that the buffers created so far are cleared too
+        m_Checkpoints.push_back(checkpoint);
+        m_CheckpointsSupported = false;
+        ClearReplayCheckpoints();
+        return false;
+      }
+
+      vkr = ObjDisp(d)->BindBufferMemory(Unwrap(d), Unwrap(contents.buf), Unwrap(mem.mem),
+                                         mem.offs);
+      CheckVkResult(vkr);
+    }
+  }
+
+  VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL,
+                                        VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+
+  // make sure all of the frame's work up to here is complete and visible to our copies
+  ObjDisp(d)->DeviceWaitIdle(Unwrap(d));
+
+  VkCommandBuffer cmd = GetNextCmd();
+
+  if(cmd == VK_NULL_HANDLE)
+    return false;
+
+  vkr = ObjDisp(cmd)->BeginCommandBuffer(Unwrap(cmd), &beginInfo);
+  CheckVkResult(vkr);
+
+  VkMemoryBarrier memBarrier = {
+      VK_STRUCTURE_TYPE_MEMORY_BARRIER, NULL, VK_ACCESS_ALL_WRITE_BITS,
+      VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_SHADER_READ_BIT,
+  };
+
+  DoPipelineBarrier(cmd, 1, &memBarrier);
+
+  for(const ReplayCheckpointContents &contents : checkpoint.memory)
+  {
+    ObjDisp(cmd)->CmdCopyBuffer(
+        Unwrap(cmd), Unwrap(m_CreationInfo.m_Memory[contents.id].wholeMemBuf), Unwrap(contents.buf),
+        (uint32_t)contents.memRegions.size(), contents.memRegions.data());
+  }
+
+  for(const ReplayCheckpointContents &contents : checkpoint.images)
+  {
+    if(contents.imageRegions.empty())
+      continue;
+
+    ImageBarrierSequence setupBarriers, cleanupBarriers;
+
+    FindImageState(contents.id)
+        ->TempTransition(m_QueueFamilyIdx, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                         VK_ACCESS_TRANSFER_READ_BIT, setupBarriers, cleanupBarriers,
+                         GetImageTransitionInfo());
+    InlineSetupImageBarriers(cmd, setupBarriers);
+    m_setupImageBarriers.Merge(setupBarriers);
+
+    ObjDisp(cmd)->CmdCopyImageToBuffer(
+        Unwrap(cmd), Unwrap(rm->GetCurrentHandle<VkImage>(contents.id)),
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, Unwrap(contents.buf),
+        (uint32_t)contents.imageRegions.size(), contents.imageRegions.data());
+
+    InlineCleanupImageBarriers(cmd, cleanupBarriers);
+    m_cleanupImageBarriers.Merge(cleanupBarriers);
+  }
+
+  vkr = ObjDisp(cmd)->EndCommandBuffer(Unwrap(cmd));
+  CheckVkResult(vkr);
+
+  SubmitAndFlushImageStateBarriers(m_setupImageBarriers);
+  SubmitCmds();
+  FlushQ();
+  SubmitAndFlushImageStateBarriers(m_cleanupImageBarriers);
+
+  // multisampled images are copied with a compute shader that submits its own work
+  for(const ReplayCheckpointContents &contents : checkpoint.images)
+  {
+    if(!contents.imageRegions.empty())
+      continue;
+
+    const ImageInfo imageInfo = FindImageState(contents.id)->GetImageInfo();
+
+    ImageBarrierSequence setupBarriers, cleanupBarriers;
+
+    FindImageState(contents.id)
+        ->TempTransition(m_QueueFamilyIdx, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                         VK_ACCESS_SHADER_READ_BIT, setupBarriers, cleanupBarriers,
+                         GetImageTransitionInfo());
+    SubmitAndFlushImageStateBarriers(setupBarriers);
+
+    GetDebugManager()->CopyTex2DMSToBuffer(
+        Unwrap(contents.buf), Unwrap(rm->GetCurrentHandle<VkImage>(contents.id)), imageInfo.extent,
+        0, imageInfo.layerCount, 0, imageInfo.sampleCount, imageInfo.format);
+
+    SubmitAndFlushImageStateBarriers(cleanupBarriers);
+  }
+
+  // save the descriptor sets updated in the frame as writes, the same as their initial contents
+  for(ResourceId id : m_CheckpointDescSets)
+  {
+    auto setIt = m_DescriptorSetState.find(id);
+    if(setIt == m_DescriptorSetState.end() || setIt->second.push ||
+       !rm->HasCurrentResource(id))
+      continue;
+
+    DescriptorSetSlot *slots = NULL;
+    uint32_t slotCount = 0;
+    byte *inlineData = NULL;
+    size_t inlineSize = 0;
+
+    setIt->second.data.copy(slots, slotCount, inlineData, inlineSize);
+
+    // the set's slots refer to live IDs but the writes are created from original IDs
+    for(uint32_t i = 0; i < slotCount; i++)
+    {
+      slots[i].resource = rm->GetOriginalID(slots[i].resource);
+      slots[i].sampler = rm->GetOriginalID(slots[i].sampler);
+    }
+
+    VkInitialContents contents(eResDescriptorSet, VkInitialContents::DescriptorSet);
+    CreateDescriptorSetWrites(id, rm->GetCurrentHandle<VkDescriptorSet>(id),
+                              m_CreationInfo.m_DescSetLayout[setIt->second.layout], slots,
+                              slotCount, setIt->second.data.inlineBytes, contents);
+
+    SAFE_DELETE_ARRAY(slots);
+    FreeAlignedBuffer(inlineData);
+
+    checkpoint.descSets.push_back({id, contents});
+  }
+
+  RDCLOG("Created replay checkpoint at event %u: %zu memory, %zu images, %zu descriptor sets, "
+         "%llu bytes",
+         boundary.eventId, checkpoint.memory.size(), checkpoint.images.size(),
+         checkpoint.descSets.size(), checkpoint.byteSize);
+
+  m_CheckpointBytes += checkpoint.byteSize;
+
+  size_t idx = 0;
+  while(idx < m_Checkpoints.size() && m_Checkpoints[idx].boundary.eventId < boundary.eventId)
+    idx++;
+  m_Checkpoints.insert(idx, checkpoint);
+
+  return true;
+}
+
+void WrappedVulkan::RestoreReplayCheckpoint(const ReplayCheckpoint &checkpoint)
+{
+  RENDERDOC_PROFILEFUNCTION();
+  if(HasFatalError())
+    return;
+
+  VkMarkerRegion region(
+      StringFormat::Fmt("RestoreReplayCheckpoint %u", checkpoint.boundary.eventId));
+
+  VulkanResourceManager *rm = GetResourceManager();
+  VkDevice d = GetDev();
+  VkResult vkr = VK_SUCCESS;
+
+  ObjDisp(d)->DeviceWaitIdle(Unwrap(d));
+
+  VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL,
+                                        VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+
+  VkCommandBuffer cmd = GetNextCmd();
+
+  if(cmd == VK_NULL_HANDLE)
+    return;
+
+  vkr = ObjDisp(cmd)->BeginCommandBuffer(Unwrap(cmd), &beginInfo);
+  CheckVkResult(vkr);
+
+  VkMemoryBarrier memBarrier = {
+      VK_STRUCTURE_TYPE_MEMORY_BARRIER, NULL, VK_ACCESS_ALL_WRITE_BITS,
+      VK_ACCESS_ALL_READ_BITS | VK_ACCESS_TRANSFER_WRITE_BIT,
+  };
+
+  DoPipelineBarrier(cmd, 1, &memBarrier);
+
+  for(const ReplayCheckpointContents &contents : checkpoint.memory)
+  {
+    rdcarray<VkBufferCopy> regions = contents.memRegions;
+    for(VkBufferCopy &r : regions)
+      std::swap(r.srcOffset, r.dstOffset);
+
+    ObjDisp(cmd)->CmdCopyBuffer(Unwrap(cmd), Unwrap(contents.buf),
+                                Unwrap(m_CreationInfo.m_Memory[contents.id].wholeMemBuf),
+                                (uint32_t)regions.size(), regions.data());
+  }
+
+  for(const ReplayCheckpointContents &contents : checkpoint.images)
+  {
+    LockedImageStateRef state = FindImageState(contents.id);
+    if(!state)
+      continue;
+
+    VkImage im = Unwrap(rm->GetCurrentHandle<VkImage>(contents.id));
+
+    ImageBarrierSequence setupBarriers;
+    state->DiscardContents();
+
+    if(contents.imageRegions.empty())
+    {
+      state->Transition(m_QueueFamilyIdx, VK_IMAGE_LAYOUT_GENERAL,
+                        VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                        VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                        setupBarriers, GetImageTransitionInfo());
+      InlineSetupImageBarriers(cmd, setupBarriers);
+      m_setupImageBarriers.Merge(setupBarriers);
+
+      const ImageInfo &imageInfo = state->GetImageInfo();
+
+      GetDebugManager()->CopyBufferToTex2DMS(cmd, im, Unwrap(contents.buf), imageInfo.extent,
+                                             imageInfo.layerCount, imageInfo.sampleCount,
+                                             imageInfo.format);
+    }
+    else
+    {
+      state->Transition(m_QueueFamilyIdx, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                        VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, setupBarriers,
+                        GetImageTransitionInfo());
+      InlineSetupImageBarriers(cmd, setupBarriers);
+      m_setupImageBarriers.Merge(setupBarriers);
+
+      ObjDisp(cmd)->CmdCopyBufferToImage(Unwrap(cmd), Unwrap(contents.buf), im,
+                                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                         (uint32_t)contents.imageRegions.size(),
+                                         contents.imageRegions.data());
+    }
+  }
+
+  vkr = ObjDisp(cmd)->EndCommandBuffer(Unwrap(cmd));
+  CheckVkResult(vkr);
+
+  for(const rdcpair<ResourceId, VkInitialContents> &set : checkpoint.descSets)
+    Apply_InitialState(rm->GetCurrentResource(set.first), set.second);
+
+  // put every image back into the layout it had at the checkpoint
+  for(const rdcpair<ResourceId, ImageState> &cpState : checkpoint.imageStates)
+  {
+    if(!rm->HasCurrentResource(cpState.first))
+      continue;
+
+    LockedImageStateRef state = FindImageState(cpState.first);
+    if(state)
+      state->Transition(cpState.second, VK_ACCESS_ALL_WRITE_BITS, VK_ACCESS_ALL_READ_BITS,
+                        m_cleanupImageBarriers, GetImageTransitionInfo());
+  }
+
+  cmd = GetNextCmd();
+
+  vkr = ObjDisp(cmd)->BeginCommandBuffer(Unwrap(cmd), &beginInfo);
+  CheckVkResult(vkr);
+
+  memBarrier.dstAccessMask = VK_ACCESS_ALL_READ_BITS;
+  DoPipelineBarrier(cmd, 1, &memBarrier);
+
+  vkr = ObjDisp(cmd)->EndCommandBuffer(Unwrap(cmd));
+  CheckVkResult(vkr);
+
+  SubmitAndFlushImageStateBarriers(m_setupImageBarriers);
+  SubmitCmds();
+  FlushQ();
+  SubmitAndFlushImageStateBarriers(m_cleanupImageBarriers);
+}
+
+void WrappedVulkan::ClearReplayCheckpoints()
+{
+  if(m_Checkpoints.empty())
+    return;
+
+  VkDevice d = GetDev();
+
+  ObjDisp(d)->DeviceWaitIdle(Unwrap(d));
+
+  for(ReplayCheckpoint &checkpoint : m_Checkpoints)
+  {
+    for(int pass = 0; pass < 2; pass++)
+    {
+      for(ReplayCheckpointContents &contents : pass == 0 ? checkpoint.memory : checkpoint.images)
+      {
+        if(contents.buf == VK_NULL_HANDLE)
+          continue;
+
+        ObjDisp(d)->DestroyBuffer(Unwrap(d), Unwrap(contents.buf), NULL);
+        GetResourceManager()->ReleaseWrappedResource(contents.buf);
+      }
+    }
+
+    for(rdcpair<ResourceId, VkInitialContents> &set : checkpoint.descSets)
+      set.second.Free(GetResourceManager());
+  }
+
+  m_Checkpoints.clear();
+  m_CheckpointBytes = 0;
+
+  FreeAllMemory(MemoryScope::ReplayCheckpoint);
+}
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#undef None
+#undef Always
+
+#include "catch/catch.hpp"
+
+TEST_CASE("Replay checkpoint boundary filtering", "[vulkan]")
+{
+  ResourceId a = ResourceIDGen::GetNewUniqueID();
+  ResourceId b = ResourceIDGen::GetNewUniqueID();
+  ResourceId c = ResourceIDGen::GetNewUniqueID();
+  ResourceId unsubmitted = ResourceIDGen::GetNewUniqueID();
+
+  // command buffers recorded at these file offsets
+  std::map<ResourceId, uint64_t> cmdBegins = {
+      {a, 100},
+      {b, 150},
+      {c, 250},
+      {unsubmitted, 120},
+  };
+
+  // a is submitted once at event 10, b at event 10 and again at 20, c at 30
+  std::map<ResourceId, uint32_t> lastSubmits = {
+      {a, 10},
+      {b, 20},
+      {c, 30},
+  };
+
+  SECTION("Before any recording")
+  {
+    CHECK(CanResumeFromBoundary(50, 5, cmdBegins, lastSubmits));
+  }
+
+  SECTION("A command buffer recorded earlier is submitted again after the boundary")
+  {
+    CHECK_FALSE(CanResumeFromBoundary(200, 11, cmdBegins, lastSubmits));
+
+    lastSubmits[b] = 10;
+    CHECK(CanResumeFromBoundary(200, 11, cmdBegins, lastSubmits));
+  }
+
+  SECTION("Command buffers recorded after the boundary don't matter")
+  {
+    lastSubmits.erase(b);
+    CHECK(CanResumeFromBoundary(200, 11, cmdBegins, lastSubmits));
+
+    // but do once the boundary comes after their recording
+    CHECK_FALSE(CanResumeFromBoundary(300, 21, cmdBegins, lastSubmits));
+  }
+
+  SECTION("The submit that ends at the boundary itself")
+  {
+    // the root event ID has already moved past a submit when its boundary is added
+    CHECK(CanResumeFromBoundary(300, 31, cmdBegins, lastSubmits));
+    CHECK_FALSE(CanResumeFromBoundary(300, 30, cmdBegins, lastSubmits));
+  }
+}
+
+#endif
@@ -225,6 +225,11 @@ RDResult VulkanReplay::ReadLogInitialisation(RDCFile *rdc, bool storeStructuredB
   return m_pDriver->ReadLogInitialisation(rdc, storeStructuredBuffers);
 }
 
+ReplayProfile VulkanReplay::GetReplayProfile()
+{
+  return m_pDriver->GetReplayProfile();
+}
+
 void VulkanReplay::ReplayLog(uint32_t endEventID, ReplayLogType replayType)
 {
   if(replayType == eReplay_OnlyDraw)
@@ -4382,6 +4387,9 @@ void VulkanReplay::ReplaceResource(ResourceId from, ResourceId to)
 
   ClearPostVSCache();
   ClearFeedbackCache();
+
+  // the frame's results can change with the replacement, so any saved state is stale
+  m_pDriver->ClearReplayCheckpoints();
 }
 
 void VulkanReplay::RemoveReplacement(ResourceId id)
@@ -4394,6 +4402,8 @@ void VulkanReplay::RemoveReplacement(ResourceId id)
 
     ClearPostVSCache();
     ClearFeedbackCache();
+
+    m_pDriver->ClearReplayCheckpoints();
   }
 }
 
@@ -4753,4 +4763,5 @@ RDResult Vulkan_ProcessStructured(RDCFile *rdc, SDFile &output)
 }
 
 static StructuredProcessRegistration VulkanProcessRegistration(RDCDriver::Vulkan,
-                                                               &Vulkan_ProcessStructured);
+                                                               &Vulkan_ProcessStructured,
+                                                               &WrappedVulkan::GetChunkName);
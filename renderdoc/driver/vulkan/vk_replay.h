@@ -300,6 +300,7 @@ public:
   ShaderDebugData &GetShaderDebugData() { return m_ShaderDebugData; }
   FrameRecord &WriteFrameRecord() { return m_FrameRecord; }
   FrameRecord GetFrameRecord() { return m_FrameRecord; }
+  ReplayProfile GetReplayProfile();
   rdcarray<DebugMessage> GetDebugMessages();
 
   void SetPipelineStates(D3D11Pipe::State *d3d11, D3D12Pipe::State *d3d12, GLPipe::State *gl,
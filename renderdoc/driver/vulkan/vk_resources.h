@@ -1150,6 +1150,9 @@ struct MemMapState
   // flush this may point to the readback memory so that we read from that fast copy instead of the
   // slow actual pointer.
   byte *cpuReadPtr = NULL;
+  // if not NULL, tracks which pages of a coherent map the application has written so only those
+  // need to be compared against refData
+  Process::WriteWatch *writeWatch = NULL;
   Threading::CriticalSection mrLock;
 };
 
@@ -258,6 +258,7 @@ rdcstr DoStringise(const MemoryScope &el)
   {
     STRINGISE_ENUM_CLASS(InitialContents);
     STRINGISE_ENUM_CLASS(IndirectReadback);
+    STRINGISE_ENUM_CLASS(ReplayCheckpoint);
   }
   END_ENUM_STRINGISE()
 }
@@ -831,6 +831,10 @@ void WrappedVulkan::ReplayDescriptorSetWrite(VkDevice device, const VkWriteDescr
     VkWriteDescriptorSet unwrapped = UnwrapInfo(&writeDesc);
     ObjDisp(device)->UpdateDescriptorSets(Unwrap(device), 1, &unwrapped, 0, NULL);
 
+    // sets updated within the frame have their contents saved in replay checkpoints
+    if(IsLoading(m_State))
+      m_CheckpointDescSets.insert(GetResID(writeDesc.dstSet));
+
     // update our local tracking
     rdcarray<DescriptorSetSlot *> &bindings =
         m_DescriptorSetState[GetResID(writeDesc.dstSet)].data.binds;
@@ -943,6 +947,9 @@ void WrappedVulkan::ReplayDescriptorSetCopy(VkDevice device, const VkCopyDescrip
   ResourceId dstSetId = GetResID(copyDesc.dstSet);
   ResourceId srcSetId = GetResID(copyDesc.srcSet);
 
+  if(IsLoading(m_State))
+    m_CheckpointDescSets.insert(dstSetId);
+
   // update our local tracking
   rdcarray<DescriptorSetSlot *> &dstbindings = m_DescriptorSetState[dstSetId].data.binds;
   rdcarray<DescriptorSetSlot *> &srcbindings = m_DescriptorSetState[srcSetId].data.binds;
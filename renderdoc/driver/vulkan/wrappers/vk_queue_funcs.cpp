@@ -1088,9 +1088,6 @@ void WrappedVulkan::CaptureQueueSubmit(VkQueue queue,
           continue;
         }
 
-        size_t diffStart = 0, diffEnd = 0;
-        bool found = true;
-
         // this causes vkFlushMappedMemoryRanges call to allocate and copy to refData
         // from serialised buffer. We want to copy *precisely* the serialised data,
         // otherwise there is a gap in time between serialising out a snapshot of
@@ -1192,42 +1189,66 @@ void WrappedVulkan::CaptureQueueSubmit(VkQueue queue,
           state.cpuReadPtr = state.mappedPtr;
         }
 
-        // if we have a previous set of data, compare.
-        // otherwise just serialise it all
-        if(state.refData)
-          found = FindDiffRange(((byte *)state.cpuReadPtr) + state.mapOffset, state.refData,
-                                (size_t)state.mapSize, diffStart, diffEnd);
+        // if writes to the map are tracked, only the pages written since the last check can differ
+        // from the reference data. This resets the tracking before anything is read, so any write
+        // from here on is caught next time.
+        rdcarray<rdcpair<size_t, size_t>> writtenRanges;
+        if(state.writeWatch)
+          Process::GetWrittenRanges(state.writeWatch, writtenRanges, true);
         else
-          diffEnd = (size_t)state.mapSize;
+          writtenRanges.push_back({0, (size_t)state.mapSize});
 
-        // sanitise diff start/end. Since the mapped pointer might be written on another thread
-        // (or even the GPU) this could cause a difference to appear and disappear transiently. In
-        // this case FindDiffRange could find the difference when locating the start but not find
-        // it when locating the end. In this case we don't need to write the difference (the
-        // application is responsible for ensuring it's not writing to memory the GPU might need)
-        if(diffEnd <= diffStart)
-          found = false;
+        // {start, end} of each range to flush
+        rdcarray<rdcpair<size_t, size_t>> diffRanges;
 
-        if(found)
+        // if we have a previous set of data, compare.
+        // otherwise just serialise it all
+        if(state.refData)
         {
-          // MULTIDEVICE should find the device for this queue.
-          // MULTIDEVICE only want to flush maps associated with this queue
-          VkDevice dev = GetDev();
+          rdcarray<rdcpair<size_t, size_t>> changed;
 
+          for(const rdcpair<size_t, size_t> &written : writtenRanges)
           {
-            RDCLOG("Persistent map flush forced for %s (%llu -> %llu)",
-                   ToStr(record->GetResourceID()).c_str(), (uint64_t)diffStart, (uint64_t)diffEnd);
-            VkMappedMemoryRange range = {
-                VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
-                NULL,
-                (VkDeviceMemory)(uint64_t)record->Resource,
-                state.mapOffset + diffStart,
-                diffEnd - diffStart,
-            };
-            InternalFlushMemoryRange(dev, range, true, capframe);
+            // the mapped pointer might be written on another thread (or even the GPU) while we
+            // compare, so differences can appear and disappear transiently. Whatever is found here
+            // is what gets serialised and copied into the ref data, so nothing is missed - the
+            // application is responsible for ensuring it's not writing to memory the GPU might need
+            FindDiffRanges(((byte *)state.cpuReadPtr) + state.mapOffset + written.first,
+                           state.refData + written.first, written.second, MapDiffMergeGap, changed);
+
+            for(const rdcpair<size_t, size_t> &c : changed)
+              diffRanges.push_back({written.first + c.first, written.first + c.first + c.second});
           }
         }
         else
+        {
+          diffRanges.push_back({0, (size_t)state.mapSize});
+        }
+
+        // MULTIDEVICE should find the device for this queue.
+        // MULTIDEVICE only want to flush maps associated with this queue
+        VkDevice dev = GetDev();
+
+        if(!diffRanges.empty())
+        {
+          RDCLOG("Persistent map flush forced for %s (%zu ranges, %llu -> %llu)",
+                 ToStr(record->GetResourceID()).c_str(), diffRanges.size(),
+                 (uint64_t)diffRanges.front().first, (uint64_t)diffRanges.back().second);
+        }
+
+        for(const rdcpair<size_t, size_t> &diff : diffRanges)
+        {
+          VkMappedMemoryRange range = {
+              VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+              NULL,
+              (VkDeviceMemory)(uint64_t)record->Resource,
+              state.mapOffset + diff.first,
+              diff.second - diff.first,
+          };
+          InternalFlushMemoryRange(dev, range, true, capframe);
+        }
+
+        if(diffRanges.empty())
         {
           RDCDEBUG("Persistent map flush not needed for %s", ToStr(record->GetResourceID()).c_str());
         }
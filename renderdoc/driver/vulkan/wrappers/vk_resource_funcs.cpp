@@ -31,6 +31,13 @@ RDOC_CONFIG(bool, Vulkan_GPUReadbackDeviceLocal, true,
             "When reading back mapped device-local memory from discrete GPUs, use a GPU copy "
             "instead of a CPU side comparison directly to mapped memory.");
 
+RDOC_CONFIG(bool, Vulkan_TrackMapWrites, false,
+            "While capturing, track which pages of persistent coherent maps are written by "
+            "write-protecting them, so that only written pages are compared and serialised on "
+            "submit instead of the whole map. Only supported on linux. Each page faults once when "
+            "first written after a submit, and the application can't have the kernel write into "
+            "mapped memory directly (e.g. with read()) while this is enabled.");
+
 /************************************************************************
  *
  * Mapping is simpler in Vulkan, at least in concept, but that comes with
@@ -784,6 +791,9 @@ void WrappedVulkan::vkFreeMemory(VkDevice device, VkDeviceMemory memory,
         memMapState->refData = NULL;
       }
 
+      Process::EndWriteWatch(memMapState->writeWatch);
+      memMapState->writeWatch = NULL;
+
       // destroy the wholeMemBuf if it's one we allocated ourselves
       if(!memMapState->dedicated)
         wholeMemDestroy = memMapState->wholeMemBuf;
@@ -859,6 +869,10 @@ VkResult WrappedVulkan::vkMapMemory(VkDevice device, VkDeviceMemory mem, VkDevic
 
       if(state.mapCoherent)
       {
+        // memory read back on the GPU is compared from the readback copy, so don't bother tracking
+        if(Vulkan_TrackMapWrites() && !state.readbackOnGPU)
+          state.writeWatch = Process::BeginWriteWatch(realData, (size_t)state.mapSize);
+
         SCOPED_LOCK(m_CoherentMapsLock);
         m_CoherentMaps.push_back(memrecord);
       }
@@ -1076,6 +1090,9 @@ void WrappedVulkan::vkUnmapMemory(VkDevice device, VkDeviceMemory mem)
       }
 
       state.cpuReadPtr = state.mappedPtr = NULL;
+
+      Process::EndWriteWatch(state.writeWatch);
+      state.writeWatch = NULL;
     }
 
     FreeAlignedBuffer(state.refData);
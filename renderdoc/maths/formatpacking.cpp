@@ -25,11 +25,16 @@
 #include "formatpacking.h"
 #include <float.h>
 #include <math.h>
+#include <limits>
 #include "api/replay/data_types.h"
 #include "api/replay/rdcpair.h"
 #include "common/common.h"
 #include "os/os_specific.h"
 
+#if defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
 //	for(int i=0; i < 256; i++)
 //	{
 //		uint8_t comp = i&0xff;
@@ -828,12 +833,556 @@ void EncodeFormattedComponents(const ResourceFormat &fmt, FloatVector v, byte *d
   }
 }
 
+// The batched conversions pick a kernel for the format once up front, then run a tight loop over
+// the elements. Each per-component conversion below is exactly the expression used in the
+// per-element functions above, so that results are identical - anything not covered here falls
+// back to converting element by element.
+
+// where each decoded output channel comes from: a component index, or -1 for a constant. This
+// folds in the A8/S8 remapping and BGRA swizzle done after decoding a single element.
+struct DecodeLayout
+{
+  uint32_t compCount;
+  int32_t src[4];
+  float constant[4];
+};
+
+template <typename T>
+T LoadComponent(const byte *data)
+{
+  T ret;
+  memcpy(&ret, data, sizeof(T));
+  return ret;
+}
+
+template <typename T>
+void StoreComponent(byte *data, T val)
+{
+  memcpy(data, &val, sizeof(T));
+}
+
+template <typename T>
+struct DecodeCast
+{
+  typedef T Type;
+  static float Do(T v) { return float(v); }
+};
+
+struct DecodeFloat
+{
+  typedef float Type;
+  static float Do(float v) { return v; }
+};
+
+struct DecodeHalf
+{
+  typedef uint16_t Type;
+  static float Do(uint16_t v) { return ConvertFromHalf(v); }
+};
+
+struct DecodeUNorm16
+{
+  typedef uint16_t Type;
+  static float Do(uint16_t v) { return float(v) / 65535.0f; }
+};
+
+struct DecodeSNorm16
+{
+  typedef int16_t Type;
+  static float Do(int16_t v) { return v == -32768 ? -1.0f : float(v) / 32767.0f; }
+};
+
+template <typename T>
+struct EncodeCast
+{
+  typedef T Type;
+  static T Do(float v) { return T(v); }
+};
+
+template <typename T>
+struct EncodeClamped
+{
+  typedef T Type;
+  static T Do(float v)
+  {
+    return T(RDCCLAMP(v, float(std::numeric_limits<T>::min()), float(std::numeric_limits<T>::max())));
+  }
+};
+
+struct EncodeFloat
+{
+  typedef float Type;
+  static float Do(float v) { return v; }
+};
+
+struct EncodeDouble
+{
+  typedef double Type;
+  static double Do(float v) { return v; }
+};
+
+struct EncodeHalf
+{
+  typedef uint16_t Type;
+  static uint16_t Do(float v) { return ConvertToHalf(v); }
+};
+
+struct EncodeUNorm16
+{
+  typedef uint16_t Type;
+  static uint16_t Do(float v) { return uint16_t(RDCCLAMP(v, 0.0f, 1.0f) * float(0xffff) + 0.5f); }
+};
+
+struct EncodeSNorm16
+{
+  typedef int16_t Type;
+  static int16_t Do(float v)
+  {
+    float f = RDCCLAMP(v, -1.0f, 1.0f) * 0x7fff;
+    return f < 0.0f ? int16_t(f - 0.5f) : int16_t(f + 0.5f);
+  }
+};
+
+struct EncodeUNorm8
+{
+  typedef uint8_t Type;
+  static uint8_t Do(float v) { return uint8_t(RDCCLAMP(v, 0.0f, 1.0f) * float(0xff) + 0.5f); }
+};
+
+struct EncodeSNorm8
+{
+  typedef int8_t Type;
+  static int8_t Do(float v)
+  {
+    float f = RDCCLAMP(v, -1.0f, 1.0f) * 0x7f;
+    return f < 0.0f ? int8_t(f - 0.5f) : int8_t(f + 0.5f);
+  }
+};
+
+struct EncodeSRGB8
+{
+  typedef uint8_t Type;
+  static uint8_t Do(float v) { return uint8_t(ConvertLinearToSRGB(v) * float(0xff) + 0.5f); }
+};
+
+static DecodeLayout GetDecodeLayout(const ResourceFormat &fmt)
+{
+  DecodeLayout ret = {};
+  ret.compCount = fmt.compCount;
+
+  // the same defaults as DecodeFormattedComponents
+  const float defaults[4] = {
+      0.0f, 0.0f, 0.0f,
+      (fmt.compType == CompType::UInt || fmt.compType == CompType::SInt || fmt.compCount == 4)
+          ? 0.0f
+          : 1.0f,
+  };
+
+  // track each channel through the same moves, with negative values for the default of a channel
+  int32_t slot[4] = {-1, -2, -3, -4};
+  for(uint32_t c = 0; c < fmt.compCount; c++)
+    slot[c] = (int32_t)c;
+
+  if(fmt.type == ResourceFormatType::A8)
+  {
+    slot[3] = slot[0];
+    slot[0] = -1;
+  }
+  else if(fmt.type == ResourceFormatType::S8)
+  {
+    slot[1] = slot[0];
+    slot[0] = -1;
+  }
+
+  if(fmt.BGRAOrder())
+    std::swap(slot[0], slot[2]);
+
+  for(uint32_t k = 0; k < 4; k++)
+  {
+    ret.src[k] = slot[k] >= 0 ? slot[k] : -1;
+    ret.constant[k] = slot[k] >= 0 ? 0.0f : defaults[-1 - slot[k]];
+  }
+
+  return ret;
+}
+
+static inline void ApplyDecodeLayout(const DecodeLayout &layout, const float *comp, FloatVector &out)
+{
+  float *o = &out.x;
+  for(uint32_t k = 0; k < 4; k++)
+    o[k] = layout.src[k] >= 0 ? comp[layout.src[k]] : layout.constant[k];
+}
+
+template <typename Conv>
+static void DecodeComponents(const DecodeLayout &layout, const byte *data, size_t stride,
+                             FloatVector *out, size_t count)
+{
+  typedef typename Conv::Type T;
+
+  for(size_t i = 0; i < count; i++, data += stride)
+  {
+    float comp[4] = {};
+    for(uint32_t c = 0; c < layout.compCount; c++)
+      comp[c] = Conv::Do(LoadComponent<T>(data + c * sizeof(T)));
+
+    ApplyDecodeLayout(layout, comp, out[i]);
+  }
+}
+
+// 8-bit components have few enough values to decode through a table per component
+static void DecodeBytes(const ResourceFormat &fmt, const DecodeLayout &layout, const byte *data,
+                        size_t stride, FloatVector *out, size_t count)
+{
+  float table[4][256];
+
+  for(uint32_t c = 0; c < layout.compCount; c++)
+  {
+    CompType compType = fmt.compType;
+
+    // alpha is never interpreted as sRGB
+    if(compType == CompType::UNormSRGB && c == 3)
+      compType = CompType::UNorm;
+
+    for(uint32_t v = 0; v < 256; v++)
+    {
+      const uint8_t u8 = uint8_t(v);
+      const int8_t i8 = int8_t(v);
+
+      if(compType == CompType::UInt || compType == CompType::UScaled)
+        table[c][v] = float(u8);
+      else if(compType == CompType::SInt || compType == CompType::SScaled)
+        table[c][v] = float(i8);
+      else if(compType == CompType::UNormSRGB)
+        table[c][v] = SRGB8_lookuptable[u8];
+      else if(compType == CompType::UNorm)
+        table[c][v] = float(u8) / 255.0f;
+      else
+        table[c][v] = i8 == -128 ? -1.0f : float(i8) / 127.0f;
+    }
+  }
+
+  for(size_t i = 0; i < count; i++, data += stride)
+  {
+    float comp[4] = {};
+    for(uint32_t c = 0; c < layout.compCount; c++)
+      comp[c] = table[c][data[c]];
+
+    ApplyDecodeLayout(layout, comp, out[i]);
+  }
+}
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+enum class DecodeSIMD
+{
+  Float32,
+  SInt32,
+  UInt16,
+  SInt16,
+  UNorm16,
+  SNorm16,
+};
+
+// four components at a time, for RGBA and BGRA layouts. The SSE conversions and divisions round the
+// same way as the scalar ones.
+template <DecodeSIMD mode>
+static void DecodeComponents4(bool bgra, const byte *data, size_t stride, FloatVector *out,
+                              size_t count)
+{
+  for(size_t i = 0; i < count; i++, data += stride)
+  {
+    __m128 v;
+
+    if(mode == DecodeSIMD::Float32)
+    {
+      v = _mm_loadu_ps((const float *)data);
+    }
+    else if(mode == DecodeSIMD::SInt32)
+    {
+      v = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)data));
+    }
+    else
+    {
+      __m128i h = _mm_loadl_epi64((const __m128i *)data);
+
+      if(mode == DecodeSIMD::UInt16 || mode == DecodeSIMD::UNorm16)
+        h = _mm_unpacklo_epi16(h, _mm_setzero_si128());
+      else
+        h = _mm_srai_epi32(_mm_unpacklo_epi16(h, h), 16);
+
+      v = _mm_cvtepi32_ps(h);
+
+      if(mode == DecodeSIMD::UNorm16)
+        v = _mm_div_ps(v, _mm_set1_ps(65535.0f));
+      else if(mode == DecodeSIMD::SNorm16)
+        v = _mm_max_ps(_mm_div_ps(v, _mm_set1_ps(32767.0f)), _mm_set1_ps(-1.0f));
+    }
+
+    if(bgra)
+      v = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 1, 2));
+
+    _mm_storeu_ps(&out[i].x, v);
+  }
+}
+
+static bool DecodeSIMDComponents(const ResourceFormat &fmt, const byte *data, size_t stride,
+                                 FloatVector *out, size_t count)
+{
+  if(fmt.type != ResourceFormatType::Regular || fmt.compCount != 4)
+    return false;
+
+  const bool bgra = fmt.BGRAOrder();
+  const CompType compType = fmt.compType;
+
+  if(fmt.compByteWidth == 4)
+  {
+    if(compType == CompType::Float || compType == CompType::Depth)
+      DecodeComponents4<DecodeSIMD::Float32>(bgra, data, stride, out, count);
+    else if(compType == CompType::SInt || compType == CompType::SScaled)
+      DecodeComponents4<DecodeSIMD::SInt32>(bgra, data, stride, out, count);
+    else
+      return false;
+  }
+  else if(fmt.compByteWidth == 2)
+  {
+    if(compType == CompType::UInt || compType == CompType::UScaled)
+      DecodeComponents4<DecodeSIMD::UInt16>(bgra, data, stride, out, count);
+    else if(compType == CompType::SInt || compType == CompType::SScaled)
+      DecodeComponents4<DecodeSIMD::SInt16>(bgra, data, stride, out, count);
+    else if(compType == CompType::UNorm || compType == CompType::Depth)
+      DecodeComponents4<DecodeSIMD::UNorm16>(bgra, data, stride, out, count);
+    else if(compType == CompType::SNorm)
+      DecodeComponents4<DecodeSIMD::SNorm16>(bgra, data, stride, out, count);
+    else
+      return false;
+  }
+  else
+  {
+    return false;
+  }
+
+  return true;
+}
+
+#else
+
+static bool DecodeSIMDComponents(const ResourceFormat &fmt, const byte *data, size_t stride,
+                                 FloatVector *out, size_t count)
+{
+  return false;
+}
+
+#endif
+
+static bool DecodeBatch(const ResourceFormat &fmt, const byte *data, size_t stride,
+                        FloatVector *out, size_t count)
+{
+  if(fmt.type != ResourceFormatType::Regular && fmt.type != ResourceFormatType::A8 &&
+     fmt.type != ResourceFormatType::S8)
+    return false;
+
+  if(fmt.compCount < 1 || fmt.compCount > 4)
+    return false;
+
+  if(DecodeSIMDComponents(fmt, data, stride, out, count))
+    return true;
+
+  const DecodeLayout layout = GetDecodeLayout(fmt);
+  const CompType compType = fmt.compType;
+  const bool isUInt = (compType == CompType::UInt || compType == CompType::UScaled);
+  const bool isSInt = (compType == CompType::SInt || compType == CompType::SScaled);
+
+  if(fmt.compByteWidth == 8)
+  {
+    if(compType == CompType::Float)
+      DecodeComponents<DecodeCast<double>>(layout, data, stride, out, count);
+    else if(isUInt)
+      DecodeComponents<DecodeCast<uint64_t>>(layout, data, stride, out, count);
+    else if(isSInt)
+      DecodeComponents<DecodeCast<int64_t>>(layout, data, stride, out, count);
+    else
+      return false;
+  }
+  else if(fmt.compByteWidth == 4)
+  {
+    if(compType == CompType::Float || compType == CompType::Depth)
+      DecodeComponents<DecodeFloat>(layout, data, stride, out, count);
+    else if(isUInt)
+      DecodeComponents<DecodeCast<uint32_t>>(layout, data, stride, out, count);
+    else if(isSInt)
+      DecodeComponents<DecodeCast<int32_t>>(layout, data, stride, out, count);
+    else
+      return false;
+  }
+  else if(fmt.compByteWidth == 2)
+  {
+    if(compType == CompType::Float)
+      DecodeComponents<DecodeHalf>(layout, data, stride, out, count);
+    else if(isUInt)
+      DecodeComponents<DecodeCast<uint16_t>>(layout, data, stride, out, count);
+    else if(isSInt)
+      DecodeComponents<DecodeCast<int16_t>>(layout, data, stride, out, count);
+    else if(compType == CompType::UNorm || compType == CompType::Depth)
+      DecodeComponents<DecodeUNorm16>(layout, data, stride, out, count);
+    else if(compType == CompType::SNorm)
+      DecodeComponents<DecodeSNorm16>(layout, data, stride, out, count);
+    else
+      return false;
+  }
+  else if(fmt.compByteWidth == 1)
+  {
+    if(isUInt || isSInt || compType == CompType::UNormSRGB || compType == CompType::UNorm ||
+       compType == CompType::SNorm)
+      DecodeBytes(fmt, layout, data, stride, out, count);
+    else
+      return false;
+  }
+  else
+  {
+    return false;
+  }
+
+  return true;
+}
+
+template <typename Conv, typename AlphaConv = Conv>
+static void EncodeComponents(uint32_t compCount, const FloatVector *in, byte *data, size_t stride,
+                             size_t count)
+{
+  typedef typename Conv::Type T;
+
+  for(size_t i = 0; i < count; i++, data += stride)
+  {
+    const float *comp = &in[i].x;
+    for(uint32_t c = 0; c < compCount; c++)
+    {
+      if(c == 3)
+        StoreComponent<T>(data + c * sizeof(T), AlphaConv::Do(comp[c]));
+      else
+        StoreComponent<T>(data + c * sizeof(T), Conv::Do(comp[c]));
+    }
+  }
+}
+
+static bool EncodeBatch(const ResourceFormat &fmt, const FloatVector *in, byte *data, size_t stride,
+                        size_t count)
+{
+  if(fmt.type != ResourceFormatType::Regular && fmt.type != ResourceFormatType::A8 &&
+     fmt.type != ResourceFormatType::S8)
+    return false;
+
+  if(fmt.compCount < 1 || fmt.compCount > 4)
+    return false;
+
+  const uint32_t compCount = fmt.compCount;
+  const CompType compType = fmt.compType;
+  const bool isUInt = (compType == CompType::UInt || compType == CompType::UScaled);
+  const bool isSInt = (compType == CompType::SInt || compType == CompType::SScaled);
+
+  if(fmt.compByteWidth == 8)
+  {
+    if(compType == CompType::Float)
+      EncodeComponents<EncodeDouble>(compCount, in, data, stride, count);
+    else if(isUInt)
+      EncodeComponents<EncodeCast<uint64_t>>(compCount, in, data, stride, count);
+    else if(isSInt)
+      EncodeComponents<EncodeCast<int64_t>>(compCount, in, data, stride, count);
+    else
+      return false;
+  }
+  else if(fmt.compByteWidth == 4)
+  {
+    if(compType == CompType::Float || compType == CompType::Depth)
+      EncodeComponents<EncodeFloat>(compCount, in, data, stride, count);
+    else if(isUInt)
+      EncodeComponents<EncodeClamped<uint32_t>>(compCount, in, data, stride, count);
+    else if(isSInt)
+      EncodeComponents<EncodeClamped<int32_t>>(compCount, in, data, stride, count);
+    else
+      return false;
+  }
+  else if(fmt.compByteWidth == 2)
+  {
+    if(compType == CompType::Float)
+      EncodeComponents<EncodeHalf>(compCount, in, data, stride, count);
+    else if(isUInt)
+      EncodeComponents<EncodeClamped<uint16_t>>(compCount, in, data, stride, count);
+    else if(isSInt)
+      EncodeComponents<EncodeClamped<int16_t>>(compCount, in, data, stride, count);
+    else if(compType == CompType::UNorm || compType == CompType::Depth)
+      EncodeComponents<EncodeUNorm16>(compCount, in, data, stride, count);
+    else if(compType == CompType::SNorm)
+      EncodeComponents<EncodeSNorm16>(compCount, in, data, stride, count);
+    else
+      return false;
+  }
+  else if(fmt.compByteWidth == 1)
+  {
+    if(isUInt)
+      EncodeComponents<EncodeClamped<uint8_t>>(compCount, in, data, stride, count);
+    else if(isSInt)
+      EncodeComponents<EncodeClamped<int8_t>>(compCount, in, data, stride, count);
+    // alpha is never interpreted as sRGB
+    else if(compType == CompType::UNormSRGB)
+      EncodeComponents<EncodeSRGB8, EncodeUNorm8>(compCount, in, data, stride, count);
+    else if(compType == CompType::UNorm)
+      EncodeComponents<EncodeUNorm8>(compCount, in, data, stride, count);
+    else if(compType == CompType::SNorm)
+      EncodeComponents<EncodeSNorm8>(compCount, in, data, stride, count);
+    else
+      return false;
+  }
+  else
+  {
+    return false;
+  }
+
+  return true;
+}
+
+void DecodeFormattedComponents(const ResourceFormat &fmt, const byte *data, size_t stride,
+                               FloatVector *out, size_t count, bool *success)
+{
+  // assume success, we'll set it to false if we hit an error
+  if(success)
+    *success = true;
+
+  if(count > 0 && DecodeBatch(fmt, data, stride, out, count))
+    return;
+
+  // whether a format is supported doesn't depend on the data, so only the first element needs to
+  // report it
+  if(count == 0)
+    DecodeFormattedComponents(fmt, NULL, success);
+
+  for(size_t i = 0; i < count; i++)
+    out[i] = DecodeFormattedComponents(fmt, data + i * stride, i == 0 ? success : NULL);
+}
+
+void EncodeFormattedComponents(const ResourceFormat &fmt, const FloatVector *in, byte *data,
+                               size_t stride, size_t count, bool *success)
+{
+  // assume success, we'll set it to false if we hit an error
+  if(success)
+    *success = true;
+
+  if(count > 0 && EncodeBatch(fmt, in, data, stride, count))
+    return;
+
+  if(count == 0)
+    EncodeFormattedComponents(fmt, FloatVector(), NULL, success);
+
+  for(size_t i = 0; i < count; i++)
+    EncodeFormattedComponents(fmt, in[i], data + i * stride, i == 0 ? success : NULL);
+}
+
 #if ENABLED(ENABLE_UNIT_TESTS)
 
 #undef None
 
 #include "catch/catch.hpp"
 #include "common/formatting.h"
+#include "common/timing.h"
 
 template <>
 rdcstr DoStringise(const FloatVector &el)
@@ -1557,4 +2106,236 @@ TEST_CASE("Check format conversion", "[format]")
   };
 }
 
+static rdcarray<ResourceFormat> BatchTestFormats()
+{
+  rdcarray<ResourceFormat> ret;
+
+  ResourceFormat fmt;
+
+  const CompType compTypes[] = {
+      CompType::Typeless, CompType::Float,  CompType::UNorm,   CompType::SNorm,
+      CompType::UInt,     CompType::SInt,   CompType::UScaled, CompType::SScaled,
+      CompType::Depth,    CompType::UNormSRGB,
+  };
+
+  for(uint8_t width : {1, 2, 3, 4, 8})
+  {
+    for(uint8_t count = 1; count <= 4; count++)
+    {
+      for(CompType compType : compTypes)
+      {
+        fmt = ResourceFormat();
+        fmt.type = ResourceFormatType::Regular;
+        fmt.compByteWidth = width;
+        fmt.compCount = count;
+        fmt.compType = compType;
+        ret.push_back(fmt);
+
+        if(count >= 3)
+        {
+          fmt.SetBGRAOrder(true);
+          ret.push_back(fmt);
+        }
+      }
+    }
+  }
+
+  for(ResourceFormatType type : {ResourceFormatType::A8, ResourceFormatType::S8})
+  {
+    for(CompType compType : {CompType::UNorm, CompType::UInt})
+    {
+      fmt = ResourceFormat();
+      fmt.type = type;
+      fmt.compByteWidth = 1;
+      fmt.compCount = 1;
+      fmt.compType = compType;
+      ret.push_back(fmt);
+    }
+  }
+
+  for(ResourceFormatType type : {
+          ResourceFormatType::R10G10B10A2, ResourceFormatType::R11G11B10,
+          ResourceFormatType::R5G6B5, ResourceFormatType::R5G5B5A1, ResourceFormatType::R9G9B9E5,
+          ResourceFormatType::R4G4B4A4, ResourceFormatType::R4G4, ResourceFormatType::D16S8,
+          ResourceFormatType::D24S8, ResourceFormatType::D32S8, ResourceFormatType::BC1,
+          ResourceFormatType::YUV8,
+      })
+  {
+    fmt = ResourceFormat();
+    fmt.type = type;
+    fmt.compByteWidth = 1;
+    fmt.compCount = 4;
+    fmt.compType = CompType::UNorm;
+    ret.push_back(fmt);
+  }
+
+  return ret;
+}
+
+TEST_CASE("Check batched format conversion", "[format]")
+{
+  const size_t count = 97;
+
+  uint32_t seed = 0x1234567;
+  auto next = [&seed]() {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+  };
+
+  for(const ResourceFormat &fmt : BatchTestFormats())
+  {
+    // pad between elements to check the stride is respected
+    const size_t stride = fmt.ElementSize() + 3;
+
+    INFO("Format: " << fmt.Name().c_str() << " compType " << ToStr(fmt.compType).c_str()
+                    << " width " << (uint32_t)fmt.compByteWidth << " count "
+                    << (uint32_t)fmt.compCount);
+
+    // batched decoding matches single elements
+    {
+      bytebuf data;
+      data.resize(stride * count);
+      for(byte &b : data)
+        b = byte(next());
+
+      rdcarray<FloatVector> expected, actual;
+      expected.resize(count);
+      actual.resize(count);
+
+      bool expectedSuccess = false;
+      for(size_t i = 0; i < count; i++)
+        expected[i] = DecodeFormattedComponents(fmt, data.data() + i * stride, &expectedSuccess);
+
+      bool success = !expectedSuccess;
+      DecodeFormattedComponents(fmt, data.data(), stride, actual.data(), count, &success);
+
+      CHECK(success == expectedSuccess);
+      CHECK(memcmp(expected.data(), actual.data(), count * sizeof(FloatVector)) == 0);
+
+      success = !expectedSuccess;
+      DecodeFormattedComponents(fmt, data.data(), stride, actual.data(), 0, &success);
+      CHECK(success == expectedSuccess);
+    }
+
+    // batched encoding matches single elements
+    {
+      // keep 64-bit unsigned integers in range, as the conversion is undefined otherwise
+      const bool unsignedOnly = fmt.compByteWidth == 8 &&
+                                (fmt.compType == CompType::UInt || fmt.compType == CompType::UScaled);
+
+      rdcarray<FloatVector> input;
+      input.resize(count);
+      for(FloatVector &v : input)
+      {
+        for(uint32_t c = 0; c < 4; c++)
+        {
+          // a mix of values in the normalised range and ones that need clamping
+          float f = float(next() % 4001) / 1000.0f - 2.0f;
+          if(next() % 4 == 0)
+            f *= 100000.0f;
+          if(unsignedOnly)
+            f = fabsf(f);
+          (&v.x)[c] = f;
+        }
+      }
+
+      bytebuf expected, actual;
+      expected.resize(stride * count);
+      actual.resize(stride * count);
+      memset(expected.data(), 0xcd, expected.size());
+      memset(actual.data(), 0xcd, actual.size());
+
+      bool expectedSuccess = false;
+      for(size_t i = 0; i < count; i++)
+        EncodeFormattedComponents(fmt, input[i], expected.data() + i * stride, &expectedSuccess);
+
+      bool success = !expectedSuccess;
+      EncodeFormattedComponents(fmt, input.data(), actual.data(), stride, count, &success);
+
+      CHECK(success == expectedSuccess);
+      CHECK((expected == actual));
+    }
+  }
+}
+
+TEST_CASE("Benchmark batched format conversion", "[.][benchmark][format]")
+{
+  const size_t count = 1024 * 1024;
+
+  rdcarray<FloatVector> decoded;
+  decoded.resize(count);
+
+  bytebuf data;
+
+  // every non-regular format type, and the regular formats that are common in textures and meshes
+  rdcarray<ResourceFormat> formats;
+  for(const ResourceFormat &fmt : BatchTestFormats())
+    if(fmt.type != ResourceFormatType::Regular)
+      formats.push_back(fmt);
+
+  struct
+  {
+    CompType compType;
+    uint8_t width;
+    uint8_t count;
+  } regular[] = {
+      {CompType::UNorm, 1, 4},  {CompType::UNormSRGB, 1, 4}, {CompType::SNorm, 1, 4},
+      {CompType::Float, 2, 4},  {CompType::UNorm, 2, 2},     {CompType::Float, 4, 4},
+      {CompType::Float, 4, 3},  {CompType::SInt, 4, 4},      {CompType::UInt, 4, 1},
+      {CompType::UInt, 2, 1},   {CompType::Float, 8, 2},
+  };
+
+  for(const auto &r : regular)
+  {
+    ResourceFormat fmt;
+    fmt.type = ResourceFormatType::Regular;
+    fmt.compType = r.compType;
+    fmt.compByteWidth = r.width;
+    fmt.compCount = r.count;
+    formats.push_back(fmt);
+  }
+
+  for(const ResourceFormat &fmt : formats)
+  {
+    const size_t stride = fmt.ElementSize();
+    if(stride == 0)
+      continue;
+
+    data.resize(stride * count);
+    for(size_t i = 0; i < data.size(); i++)
+      data[i] = byte(i * 7 + (i >> 8));
+
+    PerformanceTimer timer;
+
+    for(size_t i = 0; i < count; i++)
+      decoded[i] = DecodeFormattedComponents(fmt, data.data() + i * stride);
+
+    double singleDecode = timer.GetMilliseconds();
+    timer.Restart();
+
+    DecodeFormattedComponents(fmt, data.data(), stride, decoded.data(), count);
+
+    double batchDecode = timer.GetMilliseconds();
+    timer.Restart();
+
+    for(size_t i = 0; i < count; i++)
+      EncodeFormattedComponents(fmt, decoded[i], data.data() + i * stride);
+
+    double singleEncode = timer.GetMilliseconds();
+    timer.Restart();
+
+    EncodeFormattedComponents(fmt, decoded.data(), data.data(), stride, count);
+
+    double batchEncode = timer.GetMilliseconds();
+
+    WARN(StringFormat::Fmt(
+        "%s %s x%u (%u bytes): decode %.1f ms -> %.1f ms (%.1fx), encode %.1f ms -> %.1f ms (%.1fx)",
+        ToStr(fmt.type).c_str(), ToStr(fmt.compType).c_str(), (uint32_t)fmt.compCount,
+        (uint32_t)fmt.compByteWidth, singleDecode, batchDecode, singleDecode / batchDecode,
+        singleEncode, batchEncode, singleEncode / batchEncode));
+  }
+}
+
 #endif
@@ -182,3 +182,12 @@ FloatVector DecodeFormattedComponents(const ResourceFormat &fmt, const byte *dat
                                       bool *success = NULL);
 void EncodeFormattedComponents(const ResourceFormat &fmt, FloatVector v, byte *data,
                                bool *success = NULL);
+
+// batched versions of the above, converting count elements that are stride bytes apart in data.
+// The format is only inspected once to pick a conversion, so these are much faster on whole rows or
+// buffers than converting element by element, and give identical results. As with the single
+// element versions the source comes before the destination, and count is always last.
+void DecodeFormattedComponents(const ResourceFormat &fmt, const byte *data, size_t stride,
+                               FloatVector *out, size_t count, bool *success = NULL);
+void EncodeFormattedComponents(const ResourceFormat &fmt, const FloatVector *in, byte *data,
+                               size_t stride, size_t count, bool *success = NULL);
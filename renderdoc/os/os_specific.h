@@ -87,6 +87,20 @@ void *LoadModule(const rdcstr &module);
 void *GetFunctionAddress(void *module, const rdcstr &function);
 uint32_t GetCurrentPID();
 
+// tracks which pages of a region of memory are written by the CPU, by write-protecting the region
+// and catching the faults on the first write to each page. Returns NULL if this isn't supported on
+// the platform or the region can't be protected, in which case the caller must assume any part of
+// it may have been written. While a region is watched, the kernel can't write into it on the
+// process's behalf (e.g. read() into it fails) since those writes don't fault.
+struct WriteWatch;
+WriteWatch *BeginWriteWatch(void *base, size_t size);
+// returns the {offset, length} byte ranges, relative to base and clamped to size, of the pages
+// written since tracking began or since the last reset. Adjacent pages are merged into one range.
+// If reset is true, those pages are protected again, before this returns - so reading the ranges
+// afterwards sees every write up to that point, and any later write is reported next time.
+void GetWrittenRanges(WriteWatch *watch, rdcarray<rdcpair<size_t, size_t>> &ranges, bool reset);
+void EndWriteWatch(WriteWatch *watch);
+
 void Shutdown();
 };
 
@@ -158,6 +172,24 @@ void DetachThread(ThreadHandle handle);
 void CloseThread(ThreadHandle handle);
 void Sleep(uint32_t milliseconds);
 
+// returns the number of logical CPUs available, always at least 1
+uint32_t GetCPUCount();
+
+// simple counting semaphore. Each Wake() releases that many waiters, or if there are no waiters
+// the wakes are remembered and the next WaitForWake() calls return immediately.
+class Semaphore
+{
+public:
+  static Semaphore *Create();
+  void Destroy();
+  void Wake(uint32_t numToWake);
+  void WaitForWake();
+
+protected:
+  Semaphore() = default;
+  ~Semaphore() = default;
+};
+
 // kind of windows specific, to handle this case:
 // http://blogs.msdn.com/b/oldnewthing/archive/2013/11/05/10463645.aspx
 void KeepModuleAlive();
@@ -234,6 +266,8 @@ int64_t Inc64(int64_t *i);
 int64_t Dec64(int64_t *i);
 int64_t ExchAdd64(int64_t *i, int64_t a);
 int32_t CmpExch32(int32_t *dest, int32_t oldVal, int32_t newVal);
+int64_t CmpExch64(int64_t *dest, int64_t oldVal, int64_t newVal);
+void *CmpExchPtr(void **dest, void *oldVal, void *newVal);
 };
 
 namespace Callstack
@@ -333,6 +367,21 @@ bool feof(FILE *f);
 
 int fclose(FILE *f);
 
+// read or write length bytes at an absolute offset in an open file, without using the stream's
+// position, so several threads can access disjoint regions of the same file at once. Any buffered
+// writes must be flushed with fflush first. fpread leaves the stream position unchanged, but after
+// fpwrite it is unspecified so seek before using fread/fwrite again. Returns false if not all
+// bytes were transferred.
+bool fpread(FILE *f, void *buf, size_t length, uint64_t offset);
+bool fpwrite(FILE *f, const void *buf, size_t length, uint64_t offset);
+
+// map a read-only view of [offset, offset+length) in an open file into memory. Returns NULL if
+// the region can't be mapped, in which case the caller should fall back to normal reads. The file
+// can be closed while the mapping is still alive.
+struct FileMapping;
+FileMapping *fmap(FILE *f, uint64_t offset, uint64_t length, const byte **data);
+void funmap(FileMapping *mapping);
+
 // functions for atomically appending to a log that may be in use in multiple
 // processes
 struct LogFileHandle;
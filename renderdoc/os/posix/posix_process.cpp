@@ -29,6 +29,7 @@
 #include <signal.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
@@ -1032,6 +1033,284 @@ uint32_t Process::GetCurrentPID()
   return (uint32_t)getpid();
 }
 
+#if ENABLED(RDOC_LINUX)
+
+struct Process::WriteWatch
+{
+  // the region being watched
+  byte *base;
+  size_t size;
+
+  // the region actually protected, expanded out to page boundaries
+  byte *pageBase;
+  size_t numPages;
+
+  // one flag per page, set by the fault handler when the page is first written
+  int32_t *dirty;
+};
+
+// the fault handler can't take locks, so watches live in a fixed table that it scans
+static const int32_t MaxWriteWatches = 256;
+static Process::WriteWatch *writeWatches[MaxWriteWatches] = {};
+
+// a thread can fault on a watched page just before the watch ends, and only get to the handler
+// after it's gone. Remember the last few regions that ended so those faults can be retried instead
+// of being treated as real crashes.
+static const int32_t NumEndedWriteWatches = 16;
+static byte *endedWriteWatches[NumEndedWriteWatches][2] = {};
+static int32_t endedWriteWatchIdx = 0;
+
+static int32_t writeWatchFaultsInFlight = 0;
+static Threading::SpinLock writeWatchLock;
+static struct sigaction writeWatchPrevAction;
+static size_t writeWatchPageSize = 0;
+
+static void WriteWatchFaultHandler(int signum, siginfo_t *info, void *context)
+{
+  // save errno
+  int saved_errno = errno;
+
+  Atomic::Inc32(&writeWatchFaultsInFlight);
+
+  byte *addr = (byte *)info->si_addr;
+  bool handled = false;
+
+  // writes to a protected page are access errors, any other fault isn't ours
+  if(info->si_code == SEGV_ACCERR)
+  {
+    for(int32_t i = 0; i < MaxWriteWatches && !handled; i++)
+    {
+      Process::WriteWatch *watch =
+          (Process::WriteWatch *)Atomic::CmpExchPtr((void **)&writeWatches[i], NULL, NULL);
+
+      if(watch && addr >= watch->pageBase &&
+         addr < watch->pageBase + watch->numPages * writeWatchPageSize)
+      {
+        size_t page = size_t(addr - watch->pageBase) / writeWatchPageSize;
+
+        // unprotect before marking, so that if the page is reset in between it's only reported
+        // again rather than left writable without being marked
+        mprotect(watch->pageBase + page * writeWatchPageSize, writeWatchPageSize,
+                 PROT_READ | PROT_WRITE);
+        Atomic::CmpExch32(&watch->dirty[page], 0, 1);
+
+        handled = true;
+      }
+    }
+
+    for(int32_t i = 0; i < NumEndedWriteWatches && !handled; i++)
+    {
+      byte *start = (byte *)Atomic::CmpExchPtr((void **)&endedWriteWatches[i][0], NULL, NULL);
+      byte *end = (byte *)Atomic::CmpExchPtr((void **)&endedWriteWatches[i][1], NULL, NULL);
+
+      // forget the region once it's been retried, so a genuine fault in memory reused since then
+      // goes to the previous handler the second time around
+      if(start && addr >= start && addr < end &&
+         Atomic::CmpExchPtr((void **)&endedWriteWatches[i][0], start, NULL) == start)
+        handled = true;
+    }
+  }
+
+  Atomic::Dec32(&writeWatchFaultsInFlight);
+
+  // restore errno
+  errno = saved_errno;
+
+  if(handled)
+    return;
+
+  // call the old handler
+  if(writeWatchPrevAction.sa_flags & SA_SIGINFO)
+  {
+    writeWatchPrevAction.sa_sigaction(signum, info, context);
+  }
+  else if(writeWatchPrevAction.sa_handler == SIG_DFL || writeWatchPrevAction.sa_handler == SIG_IGN)
+  {
+    // restore the default behaviour, so the faulting instruction crashes as normal when it re-runs
+    signal(SIGSEGV, SIG_DFL);
+  }
+  else
+  {
+    writeWatchPrevAction.sa_handler(signum);
+  }
+}
+
+Process::WriteWatch *Process::BeginWriteWatch(void *base, size_t size)
+{
+  if(base == NULL || size == 0)
+    return NULL;
+
+  SCOPED_SPINLOCK(writeWatchLock);
+
+  writeWatchPageSize = (size_t)sysconf(_SC_PAGESIZE);
+
+  // if someone else installed a handler since we last checked, put ours back in front of it.
+  // Otherwise their handler would see the faults on watched pages as crashes
+  struct sigaction cur_action = {};
+  sigaction(SIGSEGV, NULL, &cur_action);
+
+  if(!(cur_action.sa_flags & SA_SIGINFO) || cur_action.sa_sigaction != &WriteWatchFaultHandler)
+  {
+    struct sigaction new_action = {};
+    sigemptyset(&new_action.sa_mask);
+    new_action.sa_flags = SA_SIGINFO | SA_RESTART | SA_ONSTACK;
+    new_action.sa_sigaction = &WriteWatchFaultHandler;
+
+    if(sigaction(SIGSEGV, &new_action, &writeWatchPrevAction) != 0)
+    {
+      RDCWARN("Couldn't install fault handler for write watching: %s",
+              FileIO::ErrorString().c_str());
+      return NULL;
+    }
+  }
+
+  byte *pageBase = (byte *)base - ((uintptr_t)base % writeWatchPageSize);
+  byte *pageEnd = (byte *)base + size;
+  if((uintptr_t)pageEnd % writeWatchPageSize)
+    pageEnd += writeWatchPageSize - ((uintptr_t)pageEnd % writeWatchPageSize);
+
+  int32_t slot = -1;
+
+  for(int32_t i = 0; i < MaxWriteWatches; i++)
+  {
+    WriteWatch *other = writeWatches[i];
+
+    if(other == NULL)
+    {
+      if(slot < 0)
+        slot = i;
+      continue;
+    }
+
+    // two watches can't share a page, as ending one would unprotect the page under the other
+    if(pageBase < other->pageBase + other->numPages * writeWatchPageSize &&
+       other->pageBase < pageEnd)
+      return NULL;
+  }
+
+  if(slot < 0)
+    return NULL;
+
+  WriteWatch *watch = new WriteWatch;
+  watch->base = (byte *)base;
+  watch->size = size;
+  watch->pageBase = pageBase;
+  watch->numPages = size_t(pageEnd - pageBase) / writeWatchPageSize;
+  watch->dirty = new int32_t[watch->numPages];
+  memset(watch->dirty, 0, watch->numPages * sizeof(int32_t));
+
+  // register before protecting, so that any fault is always caught
+  Atomic::CmpExchPtr((void **)&writeWatches[slot], NULL, watch);
+
+  if(mprotect(pageBase, size_t(pageEnd - pageBase), PROT_READ) != 0)
+  {
+    RDCWARN("Couldn't protect %llu bytes at %p for write watching: %s", (uint64_t)size, base,
+            FileIO::ErrorString().c_str());
+
+    Atomic::CmpExchPtr((void **)&writeWatches[slot], watch, NULL);
+
+    delete[] watch->dirty;
+    delete watch;
+    return NULL;
+  }
+
+  return watch;
+}
+
+void Process::GetWrittenRanges(WriteWatch *watch, rdcarray<rdcpair<size_t, size_t>> &ranges,
+                               bool reset)
+{
+  ranges.clear();
+
+  if(!watch)
+    return;
+
+  const size_t baseOffset = size_t(watch->base - watch->pageBase);
+
+  for(size_t page = 0; page < watch->numPages;)
+  {
+    if(Atomic::CmpExch32(&watch->dirty[page], 0, 0) == 0)
+    {
+      page++;
+      continue;
+    }
+
+    // find the run of written pages, clearing them as we go if we're resetting
+    size_t first = page;
+    while(page < watch->numPages && Atomic::CmpExch32(&watch->dirty[page], 0, 0) != 0)
+    {
+      if(reset)
+        Atomic::CmpExch32(&watch->dirty[page], 1, 0);
+      page++;
+    }
+
+    if(reset)
+      mprotect(watch->pageBase + first * writeWatchPageSize, (page - first) * writeWatchPageSize,
+               PROT_READ);
+
+    // convert from pages to bytes relative to the watched base, clamping to the watched region
+    size_t start = first * writeWatchPageSize;
+    size_t end = page * writeWatchPageSize;
+
+    start = start > baseOffset ? start - baseOffset : 0;
+    end = RDCMIN(end - baseOffset, watch->size);
+
+    if(end > start)
+      ranges.push_back({start, end - start});
+  }
+}
+
+void Process::EndWriteWatch(WriteWatch *watch)
+{
+  if(!watch)
+    return;
+
+  byte *pageEnd = watch->pageBase + watch->numPages * writeWatchPageSize;
+
+  mprotect(watch->pageBase, size_t(pageEnd - watch->pageBase), PROT_READ | PROT_WRITE);
+
+  {
+    SCOPED_SPINLOCK(writeWatchLock);
+
+    for(int32_t i = 0; i < MaxWriteWatches; i++)
+      if(writeWatches[i] == watch)
+        Atomic::CmpExchPtr((void **)&writeWatches[i], watch, NULL);
+
+    int32_t idx = endedWriteWatchIdx;
+    endedWriteWatchIdx = (endedWriteWatchIdx + 1) % NumEndedWriteWatches;
+
+    Atomic::CmpExchPtr((void **)&endedWriteWatches[idx][0], endedWriteWatches[idx][0], NULL);
+    Atomic::CmpExchPtr((void **)&endedWriteWatches[idx][1], endedWriteWatches[idx][1], pageEnd);
+    Atomic::CmpExchPtr((void **)&endedWriteWatches[idx][0], NULL, watch->pageBase);
+  }
+
+  // wait for any handler that might have seen this watch to finish with it
+  while(Atomic::CmpExch32(&writeWatchFaultsInFlight, 0, 0) != 0)
+    Threading::Sleep(0);
+
+  delete[] watch->dirty;
+  delete watch;
+}
+
+#else
+
+Process::WriteWatch *Process::BeginWriteWatch(void *base, size_t size)
+{
+  return NULL;
+}
+
+void Process::GetWrittenRanges(WriteWatch *watch, rdcarray<rdcpair<size_t, size_t>> &ranges,
+                               bool reset)
+{
+  ranges.clear();
+}
+
+void Process::EndWriteWatch(WriteWatch *watch)
+{
+}
+
+#endif
+
 void Process::Shutdown()
 {
   // delete all items in the freeChildren list
@@ -1451,4 +1730,115 @@ TEST_CASE("Test PID Node list handling", "[osspecific]")
   delete f;
 };
 
+#if ENABLED(RDOC_LINUX)
+
+TEST_CASE("Test write watching on anonymous memory", "[osspecific]")
+{
+  const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+  const size_t numPages = 64;
+
+  byte *mem = (byte *)mmap(NULL, numPages * pageSize, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  REQUIRE(mem != MAP_FAILED);
+
+  rdcarray<rdcpair<size_t, size_t>> ranges;
+
+  SECTION("Written pages are reported and reset")
+  {
+    Process::WriteWatch *watch = Process::BeginWriteWatch(mem, numPages * pageSize);
+    REQUIRE(watch);
+
+    Process::GetWrittenRanges(watch, ranges, false);
+    CHECK(ranges.empty());
+
+    // reading doesn't count as a write
+    volatile byte val = mem[5 * pageSize];
+    (void)val;
+
+    mem[3 * pageSize + 17] = 1;
+    mem[10 * pageSize] = 2;
+    mem[11 * pageSize + 100] = 3;
+    mem[12 * pageSize + pageSize - 1] = 4;
+
+    Process::GetWrittenRanges(watch, ranges, false);
+    REQUIRE(ranges.size() == 2);
+    CHECK(ranges[0].first == 3 * pageSize);
+    CHECK(ranges[0].second == pageSize);
+    CHECK(ranges[1].first == 10 * pageSize);
+    CHECK(ranges[1].second == 3 * pageSize);
+
+    // without resetting the same pages are still reported, and now we reset
+    Process::GetWrittenRanges(watch, ranges, true);
+    CHECK(ranges.size() == 2);
+
+    Process::GetWrittenRanges(watch, ranges, false);
+    CHECK(ranges.empty());
+
+    // writes after a reset are reported again
+    mem[11 * pageSize] = 5;
+
+    Process::GetWrittenRanges(watch, ranges, true);
+    REQUIRE(ranges.size() == 1);
+    CHECK(ranges[0].first == 11 * pageSize);
+    CHECK(ranges[0].second == pageSize);
+
+    CHECK(mem[3 * pageSize + 17] == 1);
+    CHECK(mem[11 * pageSize] == 5);
+
+    Process::EndWriteWatch(watch);
+
+    // after the watch ends the memory is writable as normal
+    mem[20 * pageSize] = 6;
+    CHECK(mem[20 * pageSize] == 6);
+  }
+
+  SECTION("Unaligned regions are clamped")
+  {
+    byte *base = mem + 2 * pageSize + 100;
+    size_t size = 4 * pageSize;
+
+    Process::WriteWatch *watch = Process::BeginWriteWatch(base, size);
+    REQUIRE(watch);
+
+    // overlapping watches aren't allowed
+    CHECK(Process::BeginWriteWatch(mem + 5 * pageSize, pageSize) == NULL);
+
+    base[0] = 1;
+    base[size - 1] = 2;
+
+    Process::GetWrittenRanges(watch, ranges, true);
+    REQUIRE(ranges.size() == 2);
+    CHECK(ranges[0].first == 0);
+    CHECK(ranges[0].second == pageSize - 100);
+    CHECK(ranges[1].first == 4 * pageSize - 100);
+    CHECK(ranges[1].second == 100);
+
+    Process::EndWriteWatch(watch);
+  }
+
+  SECTION("Writes from multiple threads")
+  {
+    Process::WriteWatch *watch = Process::BeginWriteWatch(mem, numPages * pageSize);
+    REQUIRE(watch);
+
+    // write every other page from jobs
+    Threading::JobSystem::ParallelFor(uint32_t(numPages / 2),
+                                      [&](uint32_t i) { mem[i * 2 * pageSize + i] = byte(i); });
+
+    Process::GetWrittenRanges(watch, ranges, true);
+    REQUIRE(ranges.size() == numPages / 2);
+    for(size_t i = 0; i < ranges.size(); i++)
+    {
+      CHECK(ranges[i].first == i * 2 * pageSize);
+      CHECK(ranges[i].second == pageSize);
+    }
+
+    Process::EndWriteWatch(watch);
+  }
+
+  munmap(mem, numPages * pageSize);
+};
+
+#endif    // ENABLED(RDOC_LINUX)
+
 #endif    // ENABLED(ENABLE_UNIT_TESTS)
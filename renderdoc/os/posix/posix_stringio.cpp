@@ -32,6 +32,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/file.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <time.h>
@@ -451,6 +452,99 @@ int fclose(FILE *f)
   return ::fclose(f);
 }
 
+bool fpread(FILE *f, void *buf, size_t length, uint64_t offset)
+{
+  int fd = ::fileno(f);
+  byte *dst = (byte *)buf;
+
+  while(length > 0)
+  {
+    ssize_t numRead = ::pread(fd, dst, length, (off_t)offset);
+
+    if(numRead < 0 && errno == EINTR)
+      continue;
+
+    if(numRead <= 0)
+      return false;
+
+    dst += numRead;
+    length -= (size_t)numRead;
+    offset += (uint64_t)numRead;
+  }
+
+  return true;
+}
+
+bool fpwrite(FILE *f, const void *buf, size_t length, uint64_t offset)
+{
+  int fd = ::fileno(f);
+  const byte *src = (const byte *)buf;
+
+  while(length > 0)
+  {
+    ssize_t numWritten = ::pwrite(fd, src, length, (off_t)offset);
+
+    if(numWritten < 0 && errno == EINTR)
+      continue;
+
+    if(numWritten <= 0)
+      return false;
+
+    src += numWritten;
+    length -= (size_t)numWritten;
+    offset += (uint64_t)numWritten;
+  }
+
+  return true;
+}
+
+struct FileMapping
+{
+  void *base;
+  size_t length;
+};
+
+FileMapping *fmap(FILE *f, uint64_t offset, uint64_t length, const byte **data)
+{
+  // can't map regions larger than the address space, e.g. on 32-bit
+  if(length == 0 || uint64_t(size_t(length)) != length)
+    return NULL;
+
+  // the mapping offset must be page aligned, so map from the previous page boundary
+  uint64_t pageSize = (uint64_t)sysconf(_SC_PAGESIZE);
+  uint64_t alignedOffset = offset - (offset % pageSize);
+  size_t mapLength = size_t(length + (offset - alignedOffset));
+
+  // flush any buffered writes so the mapping sees them
+  ::fflush(f);
+
+  void *base = ::mmap(NULL, mapLength, PROT_READ, MAP_PRIVATE, ::fileno(f), (off_t)alignedOffset);
+
+  if(base == MAP_FAILED)
+  {
+    RDCWARN("Couldn't map %llu bytes of file at offset %llu: %s", length, offset,
+            ErrorString().c_str());
+    return NULL;
+  }
+
+  FileMapping *ret = new FileMapping;
+  ret->base = base;
+  ret->length = mapLength;
+
+  *data = (const byte *)base + (offset - alignedOffset);
+
+  return ret;
+}
+
+void funmap(FileMapping *mapping)
+{
+  if(mapping == NULL)
+    return;
+
+  ::munmap(mapping->base, mapping->length);
+  delete mapping;
+}
+
 bool IsUntrustedFile(const rdcstr &filename)
 {
   // do android/linux have any way of marking files as potentially unsafe?
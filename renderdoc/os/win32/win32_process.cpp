@@ -165,6 +165,23 @@ rdcstr Process::GetEnvVariable(const rdcstr &name)
   return ret;
 }
 
+// GetWriteWatch only works for memory we allocate ourselves with MEM_WRITE_WATCH, and mapped
+// memory comes from the driver, so there's no write tracking on windows.
+Process::WriteWatch *Process::BeginWriteWatch(void *base, size_t size)
+{
+  return NULL;
+}
+
+void Process::GetWrittenRanges(WriteWatch *watch, rdcarray<rdcpair<size_t, size_t>> &ranges,
+                               bool reset)
+{
+  ranges.clear();
+}
+
+void Process::EndWriteWatch(WriteWatch *watch)
+{
+}
+
 uint64_t Process::GetMemoryUsage()
 {
   HANDLE proc = GetCurrentProcess();
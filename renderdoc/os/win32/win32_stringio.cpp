@@ -705,6 +705,146 @@ int fclose(FILE *f)
   return ::fclose(f);
 }
 
+bool fpread(FILE *f, void *buf, size_t length, uint64_t offset)
+{
+  HANDLE crtFile = (HANDLE)::_get_osfhandle(::_fileno(f));
+
+  if(crtFile == INVALID_HANDLE_VALUE)
+    return false;
+
+  // a synchronous ReadFile moves the handle's file pointer even when given an offset, which the
+  // CRT relies on for the FILE's position. Saving and restoring it isn't safe with several
+  // threads reading at once, so read through a separate handle with its own file pointer.
+  HANDLE file = ReOpenFile(crtFile, GENERIC_READ,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, 0);
+
+  if(file == INVALID_HANDLE_VALUE)
+    return false;
+
+  byte *dst = (byte *)buf;
+  bool success = true;
+
+  while(length > 0)
+  {
+    // ReadFile takes a 32-bit length, so split very large reads
+    DWORD chunkSize = (DWORD)RDCMIN(length, size_t(0x40000000));
+
+    // with a synchronous handle, the offset in the OVERLAPPED is used as the position to read from
+    OVERLAPPED overlapped = {};
+    overlapped.Offset = DWORD(offset & 0xffffffff);
+    overlapped.OffsetHigh = DWORD(offset >> 32);
+
+    DWORD numRead = 0;
+    if(!ReadFile(file, dst, chunkSize, &numRead, &overlapped) || numRead == 0)
+    {
+      success = false;
+      break;
+    }
+
+    dst += numRead;
+    length -= numRead;
+    offset += numRead;
+  }
+
+  CloseHandle(file);
+
+  return success;
+}
+
+bool fpwrite(FILE *f, const void *buf, size_t length, uint64_t offset)
+{
+  HANDLE file = (HANDLE)::_get_osfhandle(::_fileno(f));
+
+  if(file == INVALID_HANDLE_VALUE)
+    return false;
+
+  const byte *src = (const byte *)buf;
+
+  while(length > 0)
+  {
+    DWORD chunkSize = (DWORD)RDCMIN(length, size_t(0x40000000));
+
+    OVERLAPPED overlapped = {};
+    overlapped.Offset = DWORD(offset & 0xffffffff);
+    overlapped.OffsetHigh = DWORD(offset >> 32);
+
+    DWORD numWritten = 0;
+    if(!WriteFile(file, src, chunkSize, &numWritten, &overlapped) || numWritten == 0)
+      return false;
+
+    src += numWritten;
+    length -= numWritten;
+    offset += numWritten;
+  }
+
+  return true;
+}
+
+struct FileMapping
+{
+  HANDLE mapping;
+  void *view;
+};
+
+FileMapping *fmap(FILE *f, uint64_t offset, uint64_t length, const byte **data)
+{
+  // can't map regions larger than the address space, e.g. on 32-bit
+  if(length == 0 || uint64_t(size_t(length)) != length)
+    return NULL;
+
+  // views must start on an allocation granularity boundary
+  SYSTEM_INFO sysInfo = {};
+  GetSystemInfo(&sysInfo);
+
+  uint64_t granularity = sysInfo.dwAllocationGranularity;
+  uint64_t alignedOffset = offset - (offset % granularity);
+  SIZE_T mapLength = SIZE_T(length + (offset - alignedOffset));
+
+  // flush any buffered writes so the mapping sees them
+  ::fflush(f);
+
+  HANDLE file = (HANDLE)::_get_osfhandle(::_fileno(f));
+
+  if(file == INVALID_HANDLE_VALUE)
+    return NULL;
+
+  HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+  if(mapping == NULL)
+  {
+    RDCWARN("Couldn't create file mapping: %d", GetLastError());
+    return NULL;
+  }
+
+  void *view = MapViewOfFile(mapping, FILE_MAP_READ, DWORD(alignedOffset >> 32),
+                             DWORD(alignedOffset & 0xffffffff), mapLength);
+
+  if(view == NULL)
+  {
+    RDCWARN("Couldn't map %llu bytes of file at offset %llu: %d", length, offset, GetLastError());
+    CloseHandle(mapping);
+    return NULL;
+  }
+
+  FileMapping *ret = new FileMapping;
+  ret->mapping = mapping;
+  ret->view = view;
+
+  *data = (const byte *)view + (offset - alignedOffset);
+
+  return ret;
+}
+
+void funmap(FileMapping *mapping)
+{
+  if(mapping == NULL)
+    return;
+
+  UnmapViewOfFile(mapping->view);
+  CloseHandle(mapping->mapping);
+  delete mapping;
+}
+
 LogFileHandle *logfile_open(const rdcstr &filename)
 {
   rdcwstr wfn = StringFormat::UTF82Wide(filename);
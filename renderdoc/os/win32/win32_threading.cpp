@@ -83,6 +83,16 @@ int32_t CmpExch32(int32_t *dest, int32_t oldVal, int32_t newVal)
 {
   return (int32_t)InterlockedCompareExchange((volatile LONG *)dest, newVal, oldVal);
 }
+
+int64_t CmpExch64(int64_t *dest, int64_t oldVal, int64_t newVal)
+{
+  return (int64_t)InterlockedCompareExchange64((volatile LONG64 *)dest, newVal, oldVal);
+}
+
+void *CmpExchPtr(void **dest, void *oldVal, void *newVal)
+{
+  return InterlockedCompareExchangePointer(dest, newVal, oldVal);
+}
 };
 
 namespace Threading
@@ -368,4 +378,42 @@ void Sleep(uint32_t milliseconds)
 {
   ::Sleep((DWORD)milliseconds);
 }
+
+uint32_t GetCPUCount()
+{
+  SYSTEM_INFO info = {};
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors > 0 ? (uint32_t)info.dwNumberOfProcessors : 1;
+}
+
+struct Win32Semaphore : public Semaphore
+{
+  HANDLE handle;
+};
+
+Semaphore *Semaphore::Create()
+{
+  Win32Semaphore *sem = new Win32Semaphore();
+  sem->handle = CreateSemaphore(NULL, 0, LONG_MAX, NULL);
+  return sem;
+}
+
+void Semaphore::Destroy()
+{
+  Win32Semaphore *sem = (Win32Semaphore *)this;
+  CloseHandle(sem->handle);
+  delete sem;
+}
+
+void Semaphore::Wake(uint32_t numToWake)
+{
+  Win32Semaphore *sem = (Win32Semaphore *)this;
+  ReleaseSemaphore(sem->handle, (LONG)numToWake, NULL);
+}
+
+void Semaphore::WaitForWake()
+{
+  Win32Semaphore *sem = (Win32Semaphore *)this;
+  WaitForSingleObject(sem->handle, INFINITE);
+}
 };
@@ -0,0 +1,567 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019-2022 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "block_compression.h"
+#include "common/common.h"
+#include "common/threading.h"
+#include "compressonator/CMP_Core.h"
+#include "maths/half_convert.h"
+
+static uint32_t BlockByteSize(ResourceFormatType type)
+{
+  return type == ResourceFormatType::BC1 || type == ResourceFormatType::BC4 ? 8 : 16;
+}
+
+static uint32_t TexelByteSize(ResourceFormatType type)
+{
+  if(type == ResourceFormatType::BC4)
+    return 1;
+  if(type == ResourceFormatType::BC5)
+    return 2;
+  if(type == ResourceFormatType::BC6)
+    return 6;
+  return 4;
+}
+
+// the encoder options for a format, created once and then shared read-only by every block. This
+// also means any global tables the encoder lazily initialises are set up before going wide.
+struct BlockOptions
+{
+  BlockOptions(ResourceFormatType type, float quality) : type(type)
+  {
+#if DISABLED(RDOC_ANDROID)
+    switch(type)
+    {
+      case ResourceFormatType::BC1:
+        CreateOptionsBC1(&options);
+        if(quality >= 0.0f)
+          SetQualityBC1(options, quality);
+        break;
+      case ResourceFormatType::BC2:
+        CreateOptionsBC2(&options);
+        if(quality >= 0.0f)
+          SetQualityBC2(options, quality);
+        break;
+      case ResourceFormatType::BC3:
+        CreateOptionsBC3(&options);
+        if(quality >= 0.0f)
+          SetQualityBC3(options, quality);
+        break;
+      case ResourceFormatType::BC4:
+        CreateOptionsBC4(&options);
+        if(quality >= 0.0f)
+          SetQualityBC4(options, quality);
+        break;
+      case ResourceFormatType::BC5:
+        CreateOptionsBC5(&options);
+        if(quality >= 0.0f)
+          SetQualityBC5(options, quality);
+        break;
+      case ResourceFormatType::BC6:
+        CreateOptionsBC6(&options);
+        if(quality >= 0.0f)
+          SetQualityBC6(options, quality);
+        break;
+      case ResourceFormatType::BC7:
+        CreateOptionsBC7(&options);
+        CreateOptionsBC7(&fallback);
+        if(quality >= 0.0f)
+        {
+          SetQualityBC7(options, quality);
+          SetQualityBC7(fallback, quality);
+        }
+        // mode 6 only - a single subset with RGBA endpoints
+        SetMaskBC7(fallback, 0x40);
+        break;
+      default: break;
+    }
+#endif
+  }
+
+  ~BlockOptions()
+  {
+#if DISABLED(RDOC_ANDROID)
+    switch(type)
+    {
+      case ResourceFormatType::BC1: DestroyOptionsBC1(options); break;
+      case ResourceFormatType::BC2: DestroyOptionsBC2(options); break;
+      case ResourceFormatType::BC3: DestroyOptionsBC3(options); break;
+      case ResourceFormatType::BC4: DestroyOptionsBC4(options); break;
+      case ResourceFormatType::BC5: DestroyOptionsBC5(options); break;
+      case ResourceFormatType::BC6: DestroyOptionsBC6(options); break;
+      case ResourceFormatType::BC7:
+        DestroyOptionsBC7(options);
+        DestroyOptionsBC7(fallback);
+        break;
+      default: break;
+    }
+#endif
+  }
+
+  ResourceFormatType type;
+  void *options = NULL;
+  // BC7 only, see EncodeBlock
+  void *fallback = NULL;
+};
+
+#if DISABLED(RDOC_ANDROID)
+static uint32_t BlockError(const byte *a, const byte *b)
+{
+  uint32_t ret = 0;
+  for(uint32_t i = 0; i < 4 * 4 * 4; i++)
+    ret += uint32_t(abs(int(a[i]) - int(b[i])));
+  return ret;
+}
+#endif
+
+// texels is a tightly packed 4x4 block
+static void EncodeBlock(const BlockOptions &opts, const byte *texels, byte *block)
+{
+#if DISABLED(RDOC_ANDROID)
+  switch(opts.type)
+  {
+    case ResourceFormatType::BC1: CompressBlockBC1(texels, 4 * 4, block, opts.options); break;
+    case ResourceFormatType::BC2: CompressBlockBC2(texels, 4 * 4, block, opts.options); break;
+    case ResourceFormatType::BC3: CompressBlockBC3(texels, 4 * 4, block, opts.options); break;
+    case ResourceFormatType::BC4: CompressBlockBC4(texels, 4, block, opts.options); break;
+    case ResourceFormatType::BC5:
+    {
+      byte red[16], green[16];
+      for(uint32_t i = 0; i < 16; i++)
+      {
+        red[i] = texels[i * 2 + 0];
+        green[i] = texels[i * 2 + 1];
+      }
+      CompressBlockBC5(red, 4, green, 4, block, opts.options);
+      break;
+    }
+    case ResourceFormatType::BC6:
+      CompressBlockBC6((const uint16_t *)texels, 4 * 3, block, opts.options);
+      break;
+    case ResourceFormatType::BC7:
+    {
+      CompressBlockBC7(texels, 4 * 4, block, opts.options);
+
+      // the encoder's partition search occasionally fails outright on some blocks (e.g. ones with
+      // repeated rows, as when padding the edge of an image) and leaves texels decoding to zero.
+      // Check the result and if it's badly off, try again with the single-subset mode which always
+      // gives a reasonable fit, keeping whichever is closer.
+      byte decoded[4 * 4 * 4];
+      DecompressBlockBC7(block, decoded, opts.options);
+
+      uint32_t err = BlockError(texels, decoded);
+      if(err > 4 * 4 * 4 * 8)
+      {
+        byte retry[16];
+        CompressBlockBC7(texels, 4 * 4, retry, opts.fallback);
+        DecompressBlockBC7(retry, decoded, opts.fallback);
+
+        if(BlockError(texels, decoded) < err)
+          memcpy(block, retry, sizeof(retry));
+      }
+      break;
+    }
+    default: break;
+  }
+#endif
+}
+
+// texels is filled with a tightly packed 4x4 block
+static void DecodeBlock(const BlockOptions &opts, const byte *block, byte *texels)
+{
+#if DISABLED(RDOC_ANDROID)
+  switch(opts.type)
+  {
+    case ResourceFormatType::BC1: DecompressBlockBC1(block, texels, opts.options); break;
+    case ResourceFormatType::BC2: DecompressBlockBC2(block, texels, opts.options); break;
+    case ResourceFormatType::BC3: DecompressBlockBC3(block, texels, opts.options); break;
+    case ResourceFormatType::BC4: DecompressBlockBC4(block, texels, opts.options); break;
+    case ResourceFormatType::BC5:
+    {
+      byte red[16], green[16];
+      DecompressBlockBC5(block, red, green, opts.options);
+      for(uint32_t i = 0; i < 16; i++)
+      {
+        texels[i * 2 + 0] = red[i];
+        texels[i * 2 + 1] = green[i];
+      }
+      break;
+    }
+    case ResourceFormatType::BC6: DecompressBlockBC6(block, (uint16_t *)texels, opts.options); break;
+    case ResourceFormatType::BC7: DecompressBlockBC7(block, texels, opts.options); break;
+    default: break;
+  }
+#endif
+}
+
+bool IsBlockCompressionSupported(const ResourceFormat &fmt)
+{
+#if ENABLED(RDOC_ANDROID)
+  return false;
+#else
+  switch(fmt.type)
+  {
+    case ResourceFormatType::BC1:
+    case ResourceFormatType::BC2:
+    case ResourceFormatType::BC3:
+    case ResourceFormatType::BC7: return true;
+    case ResourceFormatType::BC4:
+    case ResourceFormatType::BC5:
+    case ResourceFormatType::BC6: return fmt.compType != CompType::SNorm;
+    default: return false;
+  }
+#endif
+}
+
+ResourceFormat GetBlockUncompressedFormat(const ResourceFormat &fmt)
+{
+  ResourceFormat ret;
+  ret.type = ResourceFormatType::Regular;
+  ret.compByteWidth = 1;
+  ret.compType = fmt.compType == CompType::UNormSRGB ? CompType::UNormSRGB : CompType::UNorm;
+
+  switch(fmt.type)
+  {
+    case ResourceFormatType::BC4: ret.compCount = 1; break;
+    case ResourceFormatType::BC5: ret.compCount = 2; break;
+    case ResourceFormatType::BC6:
+      ret.compCount = 3;
+      ret.compByteWidth = 2;
+      ret.compType = CompType::Float;
+      break;
+    default: ret.compCount = 4; break;
+  }
+
+  return ret;
+}
+
+size_t GetBlockCompressedSize(const ResourceFormat &fmt, uint32_t width, uint32_t height)
+{
+  return size_t(AlignUp4(width) / 4) * (AlignUp4(height) / 4) * BlockByteSize(fmt.type);
+}
+
+bytebuf EncodeBlocks(const ResourceFormat &fmt, uint32_t width, uint32_t height,
+                     const byte *texels, float quality)
+{
+  bytebuf ret;
+
+  if(!IsBlockCompressionSupported(fmt))
+  {
+    RDCERR("Can't encode unsupported format %s", fmt.Name().c_str());
+    return ret;
+  }
+
+  const uint32_t blockSize = BlockByteSize(fmt.type);
+  const uint32_t texelSize = TexelByteSize(fmt.type);
+  const uint32_t blocksWide = AlignUp4(width) / 4;
+  const uint32_t blocksHigh = AlignUp4(height) / 4;
+
+  ret.resize(GetBlockCompressedSize(fmt, width, height));
+
+  BlockOptions opts(fmt.type, quality);
+
+  byte *out = ret.data();
+
+  Threading::JobSystem::ParallelFor(blocksHigh, [&](uint32_t by) {
+    // enough for 4x4 texels of the widest format, aligned for BC6's 16-bit input
+    uint16_t blockTexels[4 * 4 * 3];
+
+    for(uint32_t bx = 0; bx < blocksWide; bx++)
+    {
+      byte *dst = (byte *)blockTexels;
+
+      // repeat the last row and column for partial blocks
+      for(uint32_t y = 0; y < 4; y++)
+      {
+        const uint32_t srcY = RDCMIN(by * 4 + y, height - 1);
+        for(uint32_t x = 0; x < 4; x++)
+        {
+          const uint32_t srcX = RDCMIN(bx * 4 + x, width - 1);
+          memcpy(dst, texels + (size_t(srcY) * width + srcX) * texelSize, texelSize);
+          dst += texelSize;
+        }
+      }
+
+      EncodeBlock(opts, (const byte *)blockTexels,
+                  out + (size_t(by) * blocksWide + bx) * blockSize);
+    }
+  });
+
+  return ret;
+}
+
+bytebuf DecodeBlocks(const ResourceFormat &fmt, uint32_t width, uint32_t height, const byte *blocks)
+{
+  bytebuf ret;
+
+  if(!IsBlockCompressionSupported(fmt))
+  {
+    RDCERR("Can't decode unsupported format %s", fmt.Name().c_str());
+    return ret;
+  }
+
+  const uint32_t blockSize = BlockByteSize(fmt.type);
+  const uint32_t texelSize = TexelByteSize(fmt.type);
+  const uint32_t blocksWide = AlignUp4(width) / 4;
+  const uint32_t blocksHigh = AlignUp4(height) / 4;
+
+  ret.resize(size_t(width) * height * texelSize);
+
+  BlockOptions opts(fmt.type, -1.0f);
+
+  byte *out = ret.data();
+
+  Threading::JobSystem::ParallelFor(blocksHigh, [&](uint32_t by) {
+    uint16_t blockTexels[4 * 4 * 3];
+
+    for(uint32_t bx = 0; bx < blocksWide; bx++)
+    {
+      DecodeBlock(opts, blocks + (size_t(by) * blocksWide + bx) * blockSize, (byte *)blockTexels);
+
+      // clip partial blocks at the edges
+      const uint32_t copyWidth = RDCMIN(4U, width - bx * 4);
+      const uint32_t copyHeight = RDCMIN(4U, height - by * 4);
+
+      for(uint32_t y = 0; y < copyHeight; y++)
+        memcpy(out + (size_t(by * 4 + y) * width + bx * 4) * texelSize,
+               (const byte *)blockTexels + y * 4 * texelSize, copyWidth * texelSize);
+    }
+  });
+
+  return ret;
+}
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+#include "common/formatting.h"
+#include "common/timing.h"
+
+static bytebuf MakeBlockTestImage(const ResourceFormat &fmt, uint32_t width, uint32_t height)
+{
+  const ResourceFormat uncompressed = GetBlockUncompressedFormat(fmt);
+  const uint32_t texelSize = uncompressed.ElementSize();
+
+  bytebuf ret;
+  ret.resize(size_t(width) * height * texelSize);
+
+  // smooth gradients, which every format can represent reasonably well
+  for(uint32_t y = 0; y < height; y++)
+  {
+    for(uint32_t x = 0; x < width; x++)
+    {
+      const float u = float(x) / float(width);
+      const float v = float(y) / float(height);
+      const float vals[4] = {u, v, 1.0f - u, 1.0f};
+
+      byte *texel = ret.data() + (size_t(y) * width + x) * texelSize;
+
+      for(uint32_t c = 0; c < uncompressed.compCount; c++)
+      {
+        if(uncompressed.compByteWidth == 2)
+        {
+          uint16_t h = ConvertToHalf(vals[c]);
+          memcpy(texel + c * 2, &h, 2);
+        }
+        else
+        {
+          texel[c] = byte(vals[c] * 255.0f + 0.5f);
+        }
+      }
+    }
+  }
+
+  return ret;
+}
+
+TEST_CASE("Check block compression encode and decode", "[blockcompression]")
+{
+  const ResourceFormatType types[] = {
+      ResourceFormatType::BC1, ResourceFormatType::BC2, ResourceFormatType::BC3,
+      ResourceFormatType::BC4, ResourceFormatType::BC5, ResourceFormatType::BC6,
+      ResourceFormatType::BC7,
+  };
+
+  for(ResourceFormatType type : types)
+  {
+    ResourceFormat fmt;
+    fmt.type = type;
+    fmt.compType = type == ResourceFormatType::BC6 ? CompType::Float : CompType::UNorm;
+    fmt.compCount = 4;
+    fmt.compByteWidth = 1;
+
+    INFO("Format: " << ToStr(type).c_str());
+
+    REQUIRE(IsBlockCompressionSupported(fmt));
+
+    const ResourceFormat uncompressed = GetBlockUncompressedFormat(fmt);
+    const uint32_t texelSize = uncompressed.ElementSize();
+
+    // not a multiple of the block size, and enough rows to be split up
+    const uint32_t width = 77, height = 41;
+
+    bytebuf image = MakeBlockTestImage(fmt, width, height);
+
+    bytebuf blocks = EncodeBlocks(fmt, width, height, image.data());
+    REQUIRE(blocks.size() == GetBlockCompressedSize(fmt, width, height));
+    CHECK(blocks.size() == size_t(20 * 11 * (type == ResourceFormatType::BC1 ||
+                                                     type == ResourceFormatType::BC4
+                                                 ? 8
+                                                 : 16)));
+
+    // encoding in parallel gives the same blocks as encoding serially, and a bottom-right partial
+    // block is padded by repeating the edge
+    {
+      BlockOptions opts(type, -1.0f);
+
+      uint16_t blockTexels[4 * 4 * 3];
+      byte block[16];
+
+      byte *dst = (byte *)blockTexels;
+      for(uint32_t y = 0; y < 4; y++)
+      {
+        for(uint32_t x = 0; x < 4; x++)
+        {
+          const uint32_t srcX = RDCMIN(76U + x, width - 1);
+          const uint32_t srcY = RDCMIN(40U + y, height - 1);
+          memcpy(dst, image.data() + (srcY * width + srcX) * texelSize, texelSize);
+          dst += texelSize;
+        }
+      }
+
+      EncodeBlock(opts, (const byte *)blockTexels, block);
+
+      const uint32_t blockSize = BlockByteSize(type);
+      CHECK(memcmp(blocks.data() + blocks.size() - blockSize, block, blockSize) == 0);
+    }
+
+    bytebuf decoded = DecodeBlocks(fmt, width, height, blocks.data());
+    REQUIRE(decoded.size() == image.size());
+
+    // decoding gets back close to the original
+    double maxError = 0.0;
+    for(size_t t = 0; t < size_t(width) * height; t++)
+    {
+      for(uint32_t c = 0; c < uncompressed.compCount; c++)
+      {
+        float a, b;
+        if(uncompressed.compByteWidth == 2)
+        {
+          uint16_t ha, hb;
+          memcpy(&ha, image.data() + t * texelSize + c * 2, 2);
+          memcpy(&hb, decoded.data() + t * texelSize + c * 2, 2);
+          a = ConvertFromHalf(ha);
+          b = ConvertFromHalf(hb);
+        }
+        else
+        {
+          a = float(image[t * texelSize + c]) / 255.0f;
+          b = float(decoded[t * texelSize + c]) / 255.0f;
+        }
+
+        maxError = RDCMAX(maxError, fabs(double(a) - double(b)));
+      }
+    }
+
+    // the BC6H encoder is coarse on smooth gradients and can flatten whole blocks, but anything
+    // broken in the block layout or edge handling would be far worse than this.
+    CHECK(maxError < (type == ResourceFormatType::BC6 ? 0.15 : 0.05));
+  }
+
+  SECTION("Signed formats are unsupported")
+  {
+    ResourceFormat fmt;
+    fmt.type = ResourceFormatType::BC5;
+    fmt.compType = CompType::SNorm;
+
+    CHECK_FALSE(IsBlockCompressionSupported(fmt));
+
+    byte texels[16 * 2] = {};
+    CHECK(EncodeBlocks(fmt, 4, 4, texels).empty());
+  }
+}
+
+TEST_CASE("Check BC7 blocks the encoder fails on are re-encoded", "[blockcompression]")
+{
+  // four texels repeated on every row. The encoder's partition search fails on this block and
+  // leaves it far from the original
+  const byte row[16] = {
+      0x0a, 0xf8, 0x92, 0xae, 0xcb, 0x82, 0x83, 0x4a,
+      0x8e, 0x39, 0x9f, 0x32, 0xa3, 0x6d, 0x8a, 0x1a,
+  };
+
+  byte texels[4 * 4 * 4];
+  for(uint32_t y = 0; y < 4; y++)
+    memcpy(texels + y * sizeof(row), row, sizeof(row));
+
+  BlockOptions opts(ResourceFormatType::BC7, -1.0f);
+
+  byte block[16], decoded[4 * 4 * 4];
+
+  CompressBlockBC7(texels, 4 * 4, block, opts.options);
+  DecompressBlockBC7(block, decoded, opts.options);
+
+  const uint32_t encoderError = BlockError(texels, decoded);
+  REQUIRE(encoderError > 4 * 4 * 4 * 8);
+
+  // EncodeBlock notices and falls back to mode 6
+  EncodeBlock(opts, texels, block);
+  DecodeBlock(opts, block, decoded);
+
+  CHECK(block[0] == 0x40);
+  CHECK(BlockError(texels, decoded) * 2 < encoderError);
+}
+
+TEST_CASE("Benchmark block compression", "[.][benchmark][blockcompression]")
+{
+  const uint32_t width = 512, height = 512;
+
+  for(ResourceFormatType type : {ResourceFormatType::BC1, ResourceFormatType::BC7})
+  {
+    ResourceFormat fmt;
+    fmt.type = type;
+    fmt.compType = CompType::UNorm;
+    fmt.compCount = 4;
+    fmt.compByteWidth = 1;
+
+    bytebuf image = MakeBlockTestImage(fmt, width, height);
+
+    PerformanceTimer timer;
+
+    bytebuf blocks = EncodeBlocks(fmt, width, height, image.data(), 0.1f);
+
+    double encodeMs = timer.GetMilliseconds();
+    timer.Restart();
+
+    bytebuf decoded = DecodeBlocks(fmt, width, height, blocks.data());
+
+    double decodeMs = timer.GetMilliseconds();
+
+    WARN(StringFormat::Fmt("%s %ux%u with %u workers: encode %.1f ms, decode %.1f ms",
+                           ToStr(type).c_str(), width, height,
+                           Threading::JobSystem::GetWorkerCount(), encodeMs, decodeMs));
+  }
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
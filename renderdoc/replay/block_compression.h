@@ -0,0 +1,54 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019-2022 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include "api/replay/renderdoc_replay.h"
+
+// CPU encoding and decoding of BC1-BC7 block compressed images, with rows of blocks spread across
+// the job system.
+//
+// Uncompressed texels are tightly packed in the format returned by GetBlockUncompressedFormat():
+//   BC1, BC2, BC3, BC7: RGBA8 unorm
+//   BC4: R8 unorm
+//   BC5: RG8 unorm
+//   BC6: RGB16 float
+// Compressed data is tightly packed rows of blocks, with partial blocks at the right and bottom
+// edges padded out by repeating the last texel.
+//
+// Signed BC4, BC5 and BC6 are not supported. Nothing is supported on android, where the encoder isn't
+// available.
+
+bool IsBlockCompressionSupported(const ResourceFormat &fmt);
+
+ResourceFormat GetBlockUncompressedFormat(const ResourceFormat &fmt);
+
+size_t GetBlockCompressedSize(const ResourceFormat &fmt, uint32_t width, uint32_t height);
+
+// quality is from 0 to 1, or negative to use the encoder's default for the format. Returns an empty
+// buffer if the format is not supported.
+bytebuf EncodeBlocks(const ResourceFormat &fmt, uint32_t width, uint32_t height,
+                     const byte *texels, float quality = -1.0f);
+
+bytebuf DecodeBlocks(const ResourceFormat &fmt, uint32_t width, uint32_t height, const byte *blocks);
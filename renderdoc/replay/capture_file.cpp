@@ -22,7 +22,9 @@
  * THE SOFTWARE.
  ******************************************************************************/
 
+#include "common/threading.h"
 #include "core/core.h"
+#include "core/settings.h"
 #include "jpeg-compressor/jpgd.h"
 #include "jpeg-compressor/jpge.h"
 #include "replay/replay_controller.h"
@@ -32,6 +34,15 @@
 #include "stb/stb_image_resize.h"
 #include "stb/stb_image_write.h"
 
+RDOC_CONFIG(bool, Replay_LazyStructuredData, false,
+            "When structured data is requested from a capture file, only read the list of chunks "
+            "up front and decode the chunk contents the first time any of them is accessed. The "
+            "chunks then can't be accessed from more than one thread at once until they have been "
+            "decoded, since any access may be the one that decodes them.");
+RDOC_CONFIG(bool, Replay_BackgroundStructuredDecode, false,
+            "When structured data is decoded lazily, start decoding the chunk contents "
+            "immediately on a worker thread with a separate handle to the capture file.");
+
 static void writeToBytebuf(void *context, void *data, int size)
 {
   bytebuf *buf = (bytebuf *)context;
@@ -132,8 +143,9 @@ public:
   rdcarray<GPUDevice> GetAvailableGPUs() { return RenderDoc::Inst().GetAvailableGPUs(); }
   const SDFile &GetStructuredData()
   {
-    // decompile to structured data on demand.
-    InitStructuredData();
+    // decompile to structured data on demand. The chunk contents may be decoded lazily when first
+    // accessed.
+    InitStructuredData(RENDERDOC_ProgressCallback(), true);
 
     return m_StructuredData;
   }
@@ -171,13 +183,30 @@ public:
 private:
   ResultDetails Init();
 
-  RDResult InitStructuredData(RENDERDOC_ProgressCallback progress = RENDERDOC_ProgressCallback());
+  RDResult InitStructuredData(RENDERDOC_ProgressCallback progress = RENDERDOC_ProgressCallback(),
+                              bool lazy = false);
+  RDResult IndexStructuredData(StructuredChunkLookup lookup);
+  RDResult MaterialiseStructuredData(RENDERDOC_ProgressCallback progress);
+  void CancelStructuredDecode();
 
   RDCFile *m_RDC = NULL;
   Callstack::StackResolver *m_Resolver = NULL;
 
+  rdcstr m_Filename;
+
   SDFile m_StructuredData;
 
+  // when structured data is fetched lazily only the chunk headers are read up front, and the
+  // contents of every chunk are filled in from a full decode the first time any of them is used.
+  bool m_LazyStructuredData = false;
+  Threading::CriticalSection m_StructuredLock;
+
+  // optional full decode running on a worker thread, with its own handle to the file
+  Threading::JobSystem::Job *m_StructuredDecodeJob = NULL;
+  RDCFile *m_StructuredDecodeRDC = NULL;
+  SDFile *m_StructuredDecodeFile = NULL;
+  RDResult m_StructuredDecodeResult;
+
   rdcstr m_DriverName, m_Ident;
   ReplaySupport m_Support = ReplaySupport::Unsupported;
 };
@@ -188,6 +217,7 @@ CaptureFile::CaptureFile()
 
 CaptureFile::~CaptureFile()
 {
+  CancelStructuredDecode();
   SAFE_DELETE(m_RDC);
   SAFE_DELETE(m_Resolver);
 }
@@ -203,6 +233,7 @@ ResultDetails CaptureFile::OpenFile(const rdcstr &filename, const rdcstr &filety
 
     {
       StreamReader reader(FileIO::fopen(filename, FileIO::ReadBinary));
+      m_Filename.clear();
       SAFE_DELETE(m_RDC);
       m_RDC = new RDCFile;
       ret = importer(filename, reader, m_RDC, m_StructuredData, progress);
@@ -222,6 +253,7 @@ ResultDetails CaptureFile::OpenFile(const rdcstr &filename, const rdcstr &filety
     if(progress)
       progress(0.0f);
 
+    m_Filename = filename;
     SAFE_DELETE(m_RDC);
     m_RDC = new RDCFile;
     m_RDC->Open(filename);
@@ -244,6 +276,7 @@ ResultDetails CaptureFile::OpenBuffer(const bytebuf &buffer, const rdcstr &filet
 
     {
       StreamReader reader(buffer);
+      m_Filename.clear();
       SAFE_DELETE(m_RDC);
       m_RDC = new RDCFile;
       ret = importer(rdcstr(), reader, m_RDC, m_StructuredData, progress);
@@ -263,6 +296,7 @@ ResultDetails CaptureFile::OpenBuffer(const bytebuf &buffer, const rdcstr &filet
     if(progress)
       progress(0.0f);
 
+    m_Filename.clear();
     SAFE_DELETE(m_RDC);
     m_RDC = new RDCFile;
     m_RDC->Open(buffer);
@@ -318,13 +352,27 @@ ResultDetails CaptureFile::Init()
   return RDResult();
 }
 
-RDResult CaptureFile::InitStructuredData(RENDERDOC_ProgressCallback progress)
+RDResult CaptureFile::InitStructuredData(RENDERDOC_ProgressCallback progress, bool lazy)
 {
   if(m_StructuredData.chunks.empty())
   {
     if(m_RDC && m_RDC->SectionIndex(SectionType::FrameCapture) >= 0)
     {
       StructuredProcessor proc = RenderDoc::Inst().GetStructuredProcessor(m_RDC->GetDriver());
+      StructuredChunkLookup lookup =
+          RenderDoc::Inst().GetStructuredChunkLookup(m_RDC->GetDriver());
+
+      if(lazy && proc && lookup && Replay_LazyStructuredData())
+      {
+        RDResult result = IndexStructuredData(lookup);
+
+        if(result == ResultCode::Succeeded)
+          return result;
+
+        // fall back to a full decode, which will report any error properly
+        RDCWARN("Couldn't index structured data chunks: %s",
+                ResultDetails(result).Message().c_str());
+      }
 
       RenderDoc::Inst().SetProgressCallback<LoadProgress>(progress);
 
@@ -345,9 +393,200 @@ RDResult CaptureFile::InitStructuredData(RENDERDOC_ProgressCallback progress)
                         "Can't initialise structured data for capture with no API data");
   }
 
+  // if the data was previously fetched lazily, make sure it's complete now
+  if(!lazy)
+    return MaterialiseStructuredData(progress);
+
   return RDResult();
 }
 
+RDResult CaptureFile::IndexStructuredData(StructuredChunkLookup lookup)
+{
+  int sectionIdx = m_RDC->SectionIndex(SectionType::FrameCapture);
+
+  StreamReader *reader = m_RDC->ReadSection(sectionIdx);
+
+  if(reader->IsErrored())
+  {
+    RDResult result = reader->GetError();
+    delete reader;
+    return result;
+  }
+
+  uint64_t version = m_RDC->GetSectionProperties(sectionIdx).version;
+
+  {
+    ReadSerialiser ser(reader, Ownership::Stream);
+
+    // drivers don't do any timebase conversion when structured exporting, so neither do we. The
+    // timestamps stay in the file's raw ticks alongside its timebase, the same as once the contents
+    // are decoded, and as the capture exporters expect to write back out.
+    ser.ConfigureStructuredExport(lookup, false, 0, 1.0);
+    ser.SetVersion(version);
+
+    ser.ReadChunkHeaders();
+
+    if(ser.IsErrored())
+      return ser.GetError();
+
+    ser.GetStructuredFile().Swap(m_StructuredData);
+  }
+
+  m_StructuredData.version = version;
+  m_LazyStructuredData = true;
+
+  // drivers can only decode a whole section at once, so the first access to any chunk's contents
+  // decodes every chunk. The saving is for users that only need the chunk list, and the background
+  // decode below means the contents are often ready by the time they're first needed.
+  for(SDChunk *chunk : m_StructuredData.chunks)
+    chunk->SetLazyContents(
+        [this](SDObject *) { MaterialiseStructuredData(RENDERDOC_ProgressCallback()); });
+
+  if(Replay_BackgroundStructuredDecode() && !m_Filename.empty())
+  {
+    m_StructuredDecodeRDC = new RDCFile;
+    m_StructuredDecodeRDC->Open(m_Filename);
+
+    if(m_StructuredDecodeRDC->Error() == ResultCode::Succeeded)
+    {
+      StructuredProcessor proc = RenderDoc::Inst().GetStructuredProcessor(m_RDC->GetDriver());
+
+      m_StructuredDecodeFile = new SDFile;
+      m_StructuredDecodeJob = Threading::JobSystem::AddJob([this, proc]() {
+        m_StructuredDecodeResult = proc(m_StructuredDecodeRDC, *m_StructuredDecodeFile);
+      });
+    }
+    else
+    {
+      RDCWARN("Couldn't re-open capture for background structured decode: %s",
+              ResultDetails(m_StructuredDecodeRDC->Error()).Message().c_str());
+      SAFE_DELETE(m_StructuredDecodeRDC);
+    }
+  }
+
+  return RDResult();
+}
+
+void CaptureFile::CancelStructuredDecode()
+{
+  // there's no way to interrupt a decode in progress, so we just wait for it
+  if(m_StructuredDecodeJob)
+    Threading::JobSystem::SyncJob(m_StructuredDecodeJob);
+
+  m_StructuredDecodeJob = NULL;
+  SAFE_DELETE(m_StructuredDecodeRDC);
+  SAFE_DELETE(m_StructuredDecodeFile);
+}
+
+RDResult CaptureFile::MaterialiseStructuredData(RENDERDOC_ProgressCallback progress)
+{
+  SCOPED_LOCK(m_StructuredLock);
+
+  if(!m_LazyStructuredData)
+    return RDResult();
+
+  // whatever happens we only try this once
+  m_LazyStructuredData = false;
+
+  RDResult result;
+  SDFile decoded;
+
+  if(m_StructuredDecodeJob)
+  {
+    Threading::JobSystem::SyncJob(m_StructuredDecodeJob);
+    m_StructuredDecodeJob = NULL;
+
+    result = m_StructuredDecodeResult;
+    decoded.Swap(*m_StructuredDecodeFile);
+
+    SAFE_DELETE(m_StructuredDecodeRDC);
+    SAFE_DELETE(m_StructuredDecodeFile);
+  }
+  else
+  {
+    StructuredProcessor proc = RenderDoc::Inst().GetStructuredProcessor(m_RDC->GetDriver());
+
+    RenderDoc::Inst().SetProgressCallback<LoadProgress>(progress);
+
+    result = proc(m_RDC, decoded);
+
+    RenderDoc::Inst().SetProgressCallback<LoadProgress>(RENDERDOC_ProgressCallback());
+  }
+
+  StructuredChunkList &chunks = m_StructuredData.chunks;
+
+  if(result != ResultCode::Succeeded)
+  {
+    RDCERR("Failed to decode structured data contents: %s",
+           ResultDetails(result).Message().c_str());
+
+    // leave the chunks empty rather than trying again on every access
+    for(SDChunk *chunk : chunks)
+      chunk->DeleteChildren();
+
+    return result;
+  }
+
+  // the driver decodes every chunk in the section in order, the same as the index read the headers,
+  // so the decoded chunks correspond to the indexed ones by position. Matching by ID instead could
+  // pair up the wrong chunks when the same call appears many times in a row. If the two disagree
+  // the chunks from the first mismatch on are left empty rather than given the wrong contents.
+  rdcarray<SDChunk *> sources;
+  sources.resize(chunks.size());
+
+  size_t numMatched = 0;
+  for(; numMatched < chunks.size() && numMatched < decoded.chunks.size(); numMatched++)
+  {
+    if(decoded.chunks[numMatched]->metadata.chunkID != chunks[numMatched]->metadata.chunkID)
+      break;
+
+    sources[numMatched] = decoded.chunks[numMatched];
+  }
+
+  if(numMatched != chunks.size() || numMatched != decoded.chunks.size())
+    RDCERR("Indexed %zu chunks but decoded %zu, only the first %zu match", chunks.size(),
+           decoded.chunks.size(), numMatched);
+
+  // the decoded objects may come from the decoded file's arena, which needs to live as long as we do
+  m_StructuredData.TakeArena(decoded);
+
+  // moving the contents across is independent per chunk, so split it up into batches
+  const uint32_t batchSize = 1024;
+  const uint32_t numBatches = uint32_t((chunks.size() + batchSize - 1) / batchSize);
+
+  Threading::JobSystem::ParallelFor(numBatches, [&chunks, &sources, batchSize](uint32_t batch) {
+    StructuredObjectList children;
+
+    size_t end = RDCMIN(chunks.size(), size_t(batch + 1) * batchSize);
+    for(size_t c = size_t(batch) * batchSize; c < end; c++)
+    {
+      SDChunk *dst = chunks[c];
+      SDChunk *src = sources[c];
+
+      dst->DeleteChildren();
+
+      if(!src)
+        continue;
+
+      dst->name = src->name;
+      dst->type.flags = src->type.flags;
+      dst->type.byteSize = src->type.byteSize;
+      dst->metadata = src->metadata;
+
+      src->TakeAllChildren(children);
+
+      dst->ReserveChildren(children.size());
+      for(SDObject *child : children)
+        dst->AddAndOwnChild(child);
+    }
+  });
+
+  // the header index has no buffers, so the decoded buffer indices are valid as-is
+  m_StructuredData.buffers.swap(decoded.buffers);
+
+  return result;
+}
+
 rdcpair<ResultDetails, IReplayController *> CaptureFile::OpenCapture(const ReplayOptions &opts,
                                                                      RENDERDOC_ProgressCallback progress)
 {
@@ -412,6 +651,29 @@ void CaptureFile::SetMetadata(const rdcstr &driverName, uint64_t machineIdent, F
   m_RDC->SetData(driver, driverName, machineIdent, thumb, timeBase, timeFreq);
 }
 
+// writes a section to output with the given properties, decompressing it from source and then
+// compressing it again as props and the current settings describe
+static RDResult RecompressSection(RDCFile &output, const RDCFile &source, int index,
+                                  const SectionProperties &props,
+                                  RENDERDOC_ProgressCallback progress)
+{
+  StreamWriter *writer = output.WriteSection(props);
+  StreamReader *reader = source.ReadSection(index);
+
+  StreamTransfer(writer, reader, progress);
+
+  writer->Finish();
+
+  RDResult ret = writer->GetError();
+  if(ret == ResultCode::Succeeded)
+    ret = reader->GetError();
+
+  delete reader;
+  delete writer;
+
+  return ret;
+}
+
 ResultDetails CaptureFile::Convert(const rdcstr &filename, const rdcstr &filetype,
                                    const SDFile *file, RENDERDOC_ProgressCallback progress)
 {
@@ -498,25 +760,23 @@ ResultDetails CaptureFile::Convert(const rdcstr &filename, const rdcstr &filetyp
     if(ret != ResultCode::Succeeded)
       return ret;
   }
+  else if((m_RDC->GetSectionProperties(frameCaptureIndex).flags & SectionFlags::ZstdCompressed) &&
+          m_RDC->IsCompressedAsConfigured(frameCaptureIndex))
+  {
+    // if it's already zstd compressed at the requested level, copy the compressed data straight
+    // across
+    RDResult ret = output.CopySection(*m_RDC, frameCaptureIndex, progress);
+
+    if(ret != ResultCode::Succeeded)
+      return ret;
+  }
   else
   {
-    // otherwise write it straight, but compress it to zstd
+    // otherwise decompress it if needed and compress it to zstd at the requested level
     SectionProperties props = m_RDC->GetSectionProperties(frameCaptureIndex);
     props.flags = SectionFlags::ZstdCompressed;
 
-    StreamWriter *writer = output.WriteSection(props);
-    StreamReader *reader = m_RDC->ReadSection(frameCaptureIndex);
-
-    StreamTransfer(writer, reader, progress);
-
-    writer->Finish();
-
-    RDResult ret = writer->GetError();
-    if(ret == ResultCode::Succeeded)
-      ret = reader->GetError();
-
-    delete reader;
-    delete writer;
+    RDResult ret = RecompressSection(output, *m_RDC, frameCaptureIndex, props, progress);
 
     if(ret != ResultCode::Succeeded)
       return ret;
@@ -527,24 +787,20 @@ ResultDetails CaptureFile::Convert(const rdcstr &filename, const rdcstr &filetyp
   {
     const SectionProperties &props = m_RDC->GetSectionProperties(i);
 
-    if(props.type == SectionType::FrameCapture)
+    // the block index is regenerated as sections are written
+    if(props.type == SectionType::FrameCapture || props.type == SectionType::BlockIndex)
       continue;
 
-    StreamWriter *writer = output.WriteSection(props);
-    StreamReader *reader = m_RDC->ReadSection(i);
-
-    StreamTransfer(writer, reader, NULL);
-
-    writer->Finish();
-
-    RDResult ret = writer->GetError();
-    if(ret == ResultCode::Succeeded)
-      ret = reader->GetError();
-
-    delete reader;
-    delete writer;
+    // other sections keep their compression, so they're copied without recompressing unless a
+    // different zstd level has been requested
+    RDResult ret;
+    if(m_RDC->IsCompressedAsConfigured(i))
+      ret = output.CopySection(*m_RDC, i);
+    else
+      ret = RecompressSection(output, *m_RDC, i, props, NULL);
 
-    return ret;
+    if(ret != ResultCode::Succeeded)
+      return ret;
   }
 
   return RDResult();
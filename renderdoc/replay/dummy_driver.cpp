@@ -35,6 +35,7 @@ DummyDriver::DummyDriver(IReplayDriver *original, const rdcarray<ShaderReflectio
   m_Buffers = original->GetBuffers();
   m_Textures = original->GetTextures();
   m_FrameRecord = original->GetFrameRecord();
+  m_ReplayProfile = original->GetReplayProfile();
   m_TargetEncodings = original->GetTargetShaderEncodings();
   m_DriverInfo = original->GetDriverInfo();
 
@@ -148,6 +149,11 @@ FrameRecord DummyDriver::GetFrameRecord()
   return m_FrameRecord;
 }
 
+ReplayProfile DummyDriver::GetReplayProfile()
+{
+  return m_ReplayProfile;
+}
+
 RDResult DummyDriver::ReadLogInitialisation(RDCFile *rdc, bool storeStructuredBuffers)
 {
   return ResultCode::APIReplayFailed;
@@ -62,6 +62,7 @@ public:
   void SavePipelineState(uint32_t eventId);
 
   FrameRecord GetFrameRecord();
+  ReplayProfile GetReplayProfile();
 
   RDResult ReadLogInitialisation(RDCFile *rdc, bool storeStructuredBuffers);
   void ReplayLog(uint32_t endEventID, ReplayLogType replayType);
@@ -189,6 +190,7 @@ private:
   rdcarray<BufferDescription> m_Buffers;
   rdcarray<TextureDescription> m_Textures;
   FrameRecord m_FrameRecord;
+  ReplayProfile m_ReplayProfile;
   rdcarray<ShaderEncoding> m_TargetEncodings;
   DriverInformation m_DriverInfo;
 
@@ -771,6 +771,41 @@ void DoSerialise(SerialiserType &ser, FrameDescription &el)
   SIZE_CHECK(504);
 }
 
+template <typename SerialiserType>
+void DoSerialise(SerialiserType &ser, ChunkProfile &el)
+{
+  SERIALISE_MEMBER(name);
+  SERIALISE_MEMBER(chunkID);
+  SERIALISE_MEMBER(count);
+  SERIALISE_MEMBER(byteSize);
+  SERIALISE_MEMBER(duration);
+
+  SIZE_CHECK(48);
+}
+
+template <typename SerialiserType>
+void DoSerialise(SerialiserType &ser, EventReplayProfile &el)
+{
+  SERIALISE_MEMBER(eventId);
+  SERIALISE_MEMBER(count);
+  SERIALISE_MEMBER(duration);
+  SERIALISE_MEMBER(maxDuration);
+
+  SIZE_CHECK(24);
+}
+
+template <typename SerialiserType>
+void DoSerialise(SerialiserType &ser, ReplayProfile &el)
+{
+  SERIALISE_MEMBER(chunks);
+  SERIALISE_MEMBER(replayChunks);
+  SERIALISE_MEMBER(initialContentsCount);
+  SERIALISE_MEMBER(initialContentsDuration);
+  SERIALISE_MEMBER(events);
+
+  SIZE_CHECK(88);
+}
+
 template <typename SerialiserType>
 void DoSerialise(SerialiserType &ser, FrameRecord &el)
 {
@@ -2408,6 +2443,9 @@ INSTANTIATE_SERIALISE_TYPE(RasterizationStats)
 INSTANTIATE_SERIALISE_TYPE(OutputTargetStats)
 INSTANTIATE_SERIALISE_TYPE(FrameStatistics)
 INSTANTIATE_SERIALISE_TYPE(FrameDescription)
+INSTANTIATE_SERIALISE_TYPE(ChunkProfile)
+INSTANTIATE_SERIALISE_TYPE(EventReplayProfile)
+INSTANTIATE_SERIALISE_TYPE(ReplayProfile)
 INSTANTIATE_SERIALISE_TYPE(FrameRecord)
 INSTANTIATE_SERIALISE_TYPE(MeshFormat)
 INSTANTIATE_SERIALISE_TYPE(FloatVector)
@@ -27,12 +27,15 @@
 #include <string.h>
 #include <time.h>
 #include "common/dds_readwrite.h"
+#include "common/threading.h"
+#include "core/settings.h"
 #include "driver/ihv/amd/amd_isa.h"
 #include "driver/ihv/amd/amd_rgp.h"
 #include "jpeg-compressor/jpgd.h"
 #include "jpeg-compressor/jpge.h"
 #include "maths/formatpacking.h"
 #include "os/os_specific.h"
+#include "replay/texture_stats.h"
 #include "serialise/rdcfile.h"
 #include "serialise/serialiser.h"
 #include "stb/stb_image.h"
@@ -40,11 +43,27 @@
 #include "strings/string_utils.h"
 #include "tinyexr/tinyexr.h"
 
+RDOC_CONFIG(bool, Replay_CPUTextureStats, false,
+            "Calculate texture min/max and histograms on the CPU from the texture's data, for "
+            "formats that can be decoded on the CPU, instead of with the replay driver. This reads "
+            "back the whole texture subresource, which costs far more than the GPU reduction on "
+            "a local GPU replay, so it's mostly useful for checking the two against each other.");
+
 static void fileWriteFunc(void *context, void *data, int size)
 {
   FileIO::fwrite(data, 1, size, (FILE *)context);
 }
 
+// copy a tightly packed slice into a larger image at the given offset, a row at a time
+static void CopySliceToGrid(const byte *slice, uint32_t sliceWidth, uint32_t sliceHeight,
+                            uint32_t pixelStride, byte *grid, uint32_t gridWidth, uint32_t xoffs,
+                            uint32_t yoffs)
+{
+  for(uint32_t y = 0; y < sliceHeight; y++)
+    memcpy(grid + (size_t(y + yoffs) * gridWidth + xoffs) * pixelStride,
+           slice + size_t(y) * sliceWidth * pixelStride, size_t(sliceWidth) * pixelStride);
+}
+
 ReplayController::ReplayController()
 {
   m_ThreadID = Threading::GetCurrentID();
@@ -75,6 +94,11 @@ void ReplayController::SetFrameEvent(uint32_t eventId, bool force)
   {
     m_EventID = eventId;
 
+    // texture contents are about to change
+    m_CPUStatsSlice = CPUStatsSlice();
+
+    PerformanceTimer timer;
+
     m_pDevice->ReplayLog(eventId, eReplay_WithoutDraw);
     FatalErrorCheck();
 
@@ -84,6 +108,14 @@ void ReplayController::SetFrameEvent(uint32_t eventId, bool force)
     m_pDevice->ReplayLog(eventId, eReplay_OnlyDraw);
     FatalErrorCheck();
 
+    double duration = timer.GetMilliseconds();
+
+    EventReplayProfile &profile = m_EventProfile[eventId];
+    profile.eventId = eventId;
+    profile.count++;
+    profile.duration += duration;
+    profile.maxDuration = RDCMAX(profile.maxDuration, duration);
+
     FetchPipelineState(eventId);
   }
 }
@@ -174,6 +206,72 @@ const SDFile &ReplayController::GetStructuredFile()
   return *m_pDevice->GetStructuredFile();
 }
 
+ReplayProfile ReplayController::GetReplayProfile()
+{
+  CHECK_REPLAY_THREAD();
+
+  ReplayProfile ret = m_pDevice->GetReplayProfile();
+  FatalErrorCheck();
+
+  ret.events.reserve(m_EventProfile.size());
+  for(auto it = m_EventProfile.begin(); it != m_EventProfile.end(); ++it)
+    ret.events.push_back(it->second);
+
+  return ret;
+}
+
+static RDResult ExportReplayProfile(const ReplayProfile &profile, const rdcstr &filename)
+{
+  CaptureExporter exporter = RenderDoc::Inst().GetCaptureExporter("chrome.json");
+
+  if(!exporter)
+    RETURN_ERROR_RESULT(ResultCode::InternalError, "chrome.json exporter is not available");
+
+  // the exporter only looks at chunk names and timing metadata, so express the profile as a fake
+  // structured file. Each category gets its own thread so they show up on separate tracks.
+  SDFile file;
+  uint64_t timestamp = 0;
+
+  auto addSpan = [&file, &timestamp](const rdcstr &name, uint64_t track, double duration) {
+    SDChunk *chunk = new SDChunk(name);
+    chunk->metadata.threadID = track;
+    chunk->metadata.timestampMicro = timestamp;
+    chunk->metadata.durationMicro = RDCMAX(int64_t(1), int64_t(duration * 1000.0));
+    file.chunks.push_back(chunk);
+
+    timestamp += chunk->metadata.durationMicro;
+  };
+
+  for(const ChunkProfile &chunk : profile.chunks)
+    addSpan(StringFormat::Fmt("%s (%u chunks, %llu bytes)", chunk.name.c_str(), chunk.count,
+                              chunk.byteSize),
+            1, chunk.duration);
+
+  if(profile.initialContentsCount > 0)
+    addSpan(StringFormat::Fmt("Initial contents (%u applies)", profile.initialContentsCount), 2,
+            profile.initialContentsDuration);
+
+  for(const ChunkProfile &chunk : profile.replayChunks)
+    addSpan(StringFormat::Fmt("%s (%u chunks replayed, %llu bytes)", chunk.name.c_str(),
+                              chunk.count, chunk.byteSize),
+            3, chunk.duration);
+
+  for(const EventReplayProfile &ev : profile.events)
+    addSpan(StringFormat::Fmt("EID %u (%u replays, %.3fms max)", ev.eventId, ev.count,
+                              ev.maxDuration),
+            4, ev.duration);
+
+  RDCFile rdc;
+  return exporter(filename, rdc, file, RENDERDOC_ProgressCallback());
+}
+
+ResultDetails ReplayController::ExportReplayProfile(const rdcstr &filename)
+{
+  CHECK_REPLAY_THREAD();
+
+  return ::ExportReplayProfile(GetReplayProfile(), filename);
+}
+
 ActionDescription *ReplayController::GetActionByEID(uint32_t eventId)
 {
   CHECK_REPLAY_THREAD();
@@ -952,28 +1050,16 @@ ResultDetails ReplayController::SaveTexture(const TextureSave &saveData, const r
 
     memset(combinedData, 0, td.width * td.height * pixelStride);
 
-    for(size_t i = 0; i < subdata.size(); i++)
-    {
-      uint32_t gridx = (uint32_t)i % sd.slice.sliceGridWidth;
-      uint32_t gridy = (uint32_t)i / sd.slice.sliceGridWidth;
-
-      uint32_t yoffs = gridy * sliceHeight;
-      uint32_t xoffs = gridx * sliceWidth;
+    // each slice goes to a separate part of the grid, so they can be copied in parallel
+    Threading::JobSystem::ParallelFor((uint32_t)subdata.size(), [&](uint32_t i) {
+      uint32_t gridx = i % sd.slice.sliceGridWidth;
+      uint32_t gridy = i / sd.slice.sliceGridWidth;
 
-      for(uint32_t y = 0; y < sliceHeight; y++)
-      {
-        for(uint32_t x = 0; x < sliceWidth; x++)
-        {
-          uint32_t *srcpix = (uint32_t *)&subdata[i][(y * sliceWidth + x) * pixelStride + 0];
-          uint32_t *dstpix =
-              (uint32_t *)&combinedData[((y + yoffs) * td.width + x + xoffs) * pixelStride + 0];
-
-          memcpy(dstpix, srcpix, pixelStride);
-        }
-      }
+      CopySliceToGrid(subdata[i], sliceWidth, sliceHeight, pixelStride, combinedData, td.width,
+                      gridx * sliceWidth, gridy * sliceHeight);
 
       delete[] subdata[i];
-    }
+    });
 
     subdata.resize(1);
     subdata[0] = combinedData;
@@ -1014,25 +1100,12 @@ ResultDetails ReplayController::SaveTexture(const TextureSave &saveData, const r
     uint32_t gridx[6] = {2, 0, 1, 1, 1, 3};
     uint32_t gridy[6] = {1, 1, 0, 2, 1, 1};
 
-    for(size_t i = 0; i < subdata.size(); i++)
-    {
-      uint32_t yoffs = gridy[i] * sliceHeight;
-      uint32_t xoffs = gridx[i] * sliceWidth;
-
-      for(uint32_t y = 0; y < sliceHeight; y++)
-      {
-        for(uint32_t x = 0; x < sliceWidth; x++)
-        {
-          uint32_t *srcpix = (uint32_t *)&subdata[i][(y * sliceWidth + x) * pixelStride + 0];
-          uint32_t *dstpix =
-              (uint32_t *)&combinedData[((y + yoffs) * td.width + x + xoffs) * pixelStride + 0];
-
-          memcpy(dstpix, srcpix, pixelStride);
-        }
-      }
+    Threading::JobSystem::ParallelFor((uint32_t)subdata.size(), [&](uint32_t i) {
+      CopySliceToGrid(subdata[i], sliceWidth, sliceHeight, pixelStride, combinedData, td.width,
+                      gridx[i] * sliceWidth, gridy[i] * sliceHeight);
 
       delete[] subdata[i];
-    }
+    });
 
     subdata.resize(1);
     subdata[0] = combinedData;
@@ -1280,12 +1353,17 @@ ResultDetails ReplayController::SaveTexture(const TextureSave &saveData, const r
       if(saveFmt.compType == CompType::Depth && pixStride == 3)
         pixStride = 4;
 
+      rdcarray<FloatVector> row;
+      row.resize(td.width);
+
       for(uint32_t y = 0; y < td.height; y++)
       {
+        DecodeFormattedComponents(saveFmt, srcData, pixStride, row.data(), td.width);
+        srcData += pixStride * td.width;
+
         for(uint32_t x = 0; x < td.width; x++)
         {
-          FloatVector pixel = DecodeFormattedComponents(saveFmt, srcData);
-          srcData += pixStride;
+          FloatVector pixel = row[x];
 
           // HDR can't represent negative values
           if(sd.destType == FileType::HDR)
@@ -1570,8 +1648,16 @@ rdcpair<PixelValue, PixelValue> ReplayController::GetMinMax(ResourceId textureId
   PixelValue minval = {{0.0f, 0.0f, 0.0f, 0.0f}};
   PixelValue maxval = {{1.0f, 1.0f, 1.0f, 1.0f}};
 
-  m_pDevice->GetMinMax(m_pDevice->GetLiveID(textureId), sub, typeCast, &minval.floatValue[0],
-                       &maxval.floatValue[0]);
+  ResourceId liveId = m_pDevice->GetLiveID(textureId);
+
+  const CPUStatsSlice *slice = GetCPUStatsSlice(textureId, liveId, sub, typeCast);
+
+  if(slice && CalculateTextureMinMax(slice->fmt, typeCast, slice->width, slice->height,
+                                     slice->data.data() + slice->offset, slice->size,
+                                     &minval.floatValue[0], &maxval.floatValue[0]))
+    return make_rdcpair(minval, maxval);
+
+  m_pDevice->GetMinMax(liveId, sub, typeCast, &minval.floatValue[0], &maxval.floatValue[0]);
   FatalErrorCheck();
 
   return make_rdcpair(minval, maxval);
@@ -1585,13 +1671,83 @@ rdcarray<uint32_t> ReplayController::GetHistogram(ResourceId textureId, const Su
 
   rdcarray<uint32_t> hist;
 
-  m_pDevice->GetHistogram(m_pDevice->GetLiveID(textureId), sub, typeCast, minval, maxval, channels,
-                          hist);
+  ResourceId liveId = m_pDevice->GetLiveID(textureId);
+
+  const CPUStatsSlice *slice = GetCPUStatsSlice(textureId, liveId, sub, typeCast);
+
+  if(slice && CalculateTextureHistogram(slice->fmt, typeCast, slice->width, slice->height,
+                                        slice->data.data() + slice->offset, slice->size, minval,
+                                        maxval, channels, hist))
+    return hist;
+
+  m_pDevice->GetHistogram(liveId, sub, typeCast, minval, maxval, channels, hist);
   FatalErrorCheck();
 
   return hist;
 }
 
+// fetches the contents of a texture for calculating min/max or histograms on the CPU, and returns
+// the 2D slice that the GPU implementations would look at. Returns NULL if the format can't be
+// decoded on the CPU or the data can't be fetched cheaply, so the driver should be used instead.
+const ReplayController::CPUStatsSlice *ReplayController::GetCPUStatsSlice(ResourceId textureId,
+                                                                          ResourceId liveId,
+                                                                          const Subresource &sub,
+                                                                          CompType typeCast)
+{
+  // fetching the data from a remote proxy would cost far more than calculating remotely
+  if(!Replay_CPUTextureStats() || liveId == ResourceId() || m_pDevice->IsRemoteProxy())
+    return NULL;
+
+  TextureDescription tex = m_pDevice->GetTexture(liveId);
+
+  // MSAA textures come back from GetTextureData with all samples mapped to array slices
+  if(tex.msSamp > 1 || sub.mip >= tex.mips || !CanCalculateTextureStats(tex.format, typeCast))
+    return NULL;
+
+  // min/max and histograms are usually requested together, so reuse the last readback. Only
+  // textures from the capture are kept, since their contents only change when the frame is
+  // replayed. Outputs like custom shader textures can be re-rendered at any time.
+  if(m_CPUStatsSlice.texture == textureId && m_CPUStatsSlice.sub == sub)
+    return &m_CPUStatsSlice;
+
+  m_CPUStatsSlice = CPUStatsSlice();
+
+  CPUStatsSlice slice;
+
+  GetTextureDataParams params;
+  params.standardLayout = true;
+
+  m_pDevice->GetTextureData(liveId, sub, params, slice.data);
+  if(FatalErrorCheck())
+    return NULL;
+
+  slice.fmt = tex.format;
+  slice.width = RDCMAX(1U, tex.width >> sub.mip);
+  slice.height = RDCMAX(1U, tex.height >> sub.mip);
+  slice.size = size_t(slice.width) * slice.height * slice.fmt.ElementSize();
+
+  // 3D textures return all depth slices of the mip at once
+  if(tex.dimension == 3)
+    slice.offset = RDCMIN(sub.slice, RDCMAX(1U, tex.depth >> sub.mip) - 1) * slice.size;
+
+  if(slice.offset + slice.size > slice.data.size())
+    return NULL;
+
+  bool captureTexture = false;
+  for(const TextureDescription &t : m_Textures)
+    captureTexture |= (t.resourceId == textureId);
+
+  // other textures are still returned from here, but won't be matched next time
+  if(captureTexture)
+  {
+    slice.texture = textureId;
+    slice.sub = sub;
+  }
+
+  m_CPUStatsSlice = std::move(slice);
+  return &m_CPUStatsSlice;
+}
+
 ShaderDebugTrace *ReplayController::DebugVertex(uint32_t vertid, uint32_t instid, uint32_t idx,
                                                 uint32_t view)
 {
@@ -2215,3 +2371,170 @@ void ReplayController::FetchPipelineState(uint32_t eventId)
   else if(m_APIProps.pipelineType == GraphicsAPI::Vulkan)
     m_PipeState.SetState(&m_VulkanPipelineState);
 }
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+
+static rdcstr TestChunkName(uint32_t idx)
+{
+  return StringFormat::Fmt("Chunk%u", idx);
+}
+
+TEST_CASE("Check replay profiles accumulate and export", "[replay]")
+{
+  SECTION("Replayed chunks are accumulated per type and sorted by ID")
+  {
+    ReplayProfile profile;
+
+    AddChunkReplayProfile(profile, 1005, 100, 1.5, &TestChunkName);
+    AddChunkReplayProfile(profile, 1002, 40, 0.25, &TestChunkName);
+    AddChunkReplayProfile(profile, 1005, 60, 2.0, &TestChunkName);
+    AddChunkReplayProfile(profile, 1010, 8, 0.5, &TestChunkName);
+    AddChunkReplayProfile(profile, 1002, 20, 0.25, &TestChunkName);
+
+    REQUIRE(profile.replayChunks.size() == 3);
+
+    CHECK(profile.replayChunks[0].chunkID == 1002);
+    CHECK(profile.replayChunks[0].name == "Chunk1002");
+    CHECK(profile.replayChunks[0].count == 2);
+    CHECK(profile.replayChunks[0].byteSize == 60);
+    CHECK(profile.replayChunks[0].duration == 0.5);
+
+    CHECK(profile.replayChunks[1].chunkID == 1005);
+    CHECK(profile.replayChunks[1].count == 2);
+    CHECK(profile.replayChunks[1].byteSize == 160);
+    CHECK(profile.replayChunks[1].duration == 3.5);
+
+    CHECK(profile.replayChunks[2].chunkID == 1010);
+    CHECK(profile.replayChunks[2].count == 1);
+
+    CHECK(profile.chunks.empty());
+  };
+
+  SECTION("Exported profiles round-trip through chrome.json")
+  {
+    ReplayProfile profile;
+
+    ChunkProfile chunk;
+    chunk.chunkID = 1001;
+    chunk.name = "vkCreateBuffer";
+    chunk.count = 3;
+    chunk.byteSize = 300;
+    chunk.duration = 2.0;
+    profile.chunks.push_back(chunk);
+
+    chunk.chunkID = 1002;
+    chunk.name = "vkCreateImage";
+    chunk.count = 1;
+    chunk.byteSize = 50;
+    chunk.duration = 0.5;
+    profile.chunks.push_back(chunk);
+
+    profile.initialContentsCount = 4;
+    profile.initialContentsDuration = 8.0;
+
+    chunk.chunkID = 1003;
+    chunk.name = "vkCmdDraw";
+    chunk.count = 10;
+    chunk.byteSize = 400;
+    chunk.duration = 1.25;
+    profile.replayChunks.push_back(chunk);
+
+    EventReplayProfile ev;
+    ev.eventId = 12;
+    ev.count = 2;
+    ev.duration = 3.0;
+    ev.maxDuration = 2.0;
+    profile.events.push_back(ev);
+
+    // a duration too short to be visible is still exported
+    ev.eventId = 20;
+    ev.count = 1;
+    ev.duration = 0.0;
+    ev.maxDuration = 0.0;
+    profile.events.push_back(ev);
+
+    rdcstr filename = FileIO::GetTempFolderFilename() + "replay_profile_test.json";
+
+    RDResult result = ExportReplayProfile(profile, filename);
+    REQUIRE(result.code == ResultCode::Succeeded);
+
+    rdcstr json;
+    REQUIRE(FileIO::ReadAll(filename, json));
+    FileIO::Delete(filename);
+
+    struct Span
+    {
+      rdcstr name;
+      uint64_t begin, end;
+      uint32_t track;
+    };
+
+    // parse each begin/end pair back out of the trace events
+    rdcarray<Span> spans;
+    int32_t offs = json.find("\"ph\": \"B\"");
+    while(offs >= 0)
+    {
+      int32_t nameStart = json.find_last_of("{", 0, offs);
+      REQUIRE(nameStart >= 0);
+      nameStart = json.find("\"name\": \"", nameStart);
+      REQUIRE(nameStart >= 0);
+      nameStart += 9;
+      int32_t nameEnd = json.find("\"", nameStart);
+
+      Span span;
+      span.name = json.substr(nameStart, nameEnd - nameStart);
+
+      unsigned long long begin = 0, end = 0;
+      uint32_t track = 0, endTrack = 0;
+      REQUIRE(sscanf(json.c_str() + offs, "\"ph\": \"B\", \"ts\": %llu, \"pid\": 5, \"tid\": %u",
+                     &begin, &track) == 2);
+
+      int32_t endOffs = json.find("\"ph\": \"E\"", offs);
+      REQUIRE(endOffs >= 0);
+      REQUIRE(sscanf(json.c_str() + endOffs, "\"ph\": \"E\", \"ts\": %llu, \"pid\": 5, \"tid\": %u",
+                     &end, &endTrack) == 2);
+      CHECK(track == endTrack);
+
+      span.begin = begin;
+      span.end = end;
+      span.track = track;
+      spans.push_back(span);
+
+      offs = json.find("\"ph\": \"B\"", endOffs);
+    }
+
+    REQUIRE(spans.size() == 6);
+
+    CHECK(spans[0].name == "vkCreateBuffer (3 chunks, 300 bytes)");
+    CHECK(spans[0].track == 1);
+    CHECK(spans[0].end - spans[0].begin == 2000);
+
+    CHECK(spans[1].name == "vkCreateImage (1 chunks, 50 bytes)");
+    CHECK(spans[1].track == 1);
+    CHECK(spans[1].end - spans[1].begin == 500);
+
+    CHECK(spans[2].name == "Initial contents (4 applies)");
+    CHECK(spans[2].track == 2);
+    CHECK(spans[2].end - spans[2].begin == 8000);
+
+    CHECK(spans[3].name == "vkCmdDraw (10 chunks replayed, 400 bytes)");
+    CHECK(spans[3].track == 3);
+    CHECK(spans[3].end - spans[3].begin == 1250);
+
+    CHECK(spans[4].name == "EID 12 (2 replays, 2.000ms max)");
+    CHECK(spans[4].track == 4);
+    CHECK(spans[4].end - spans[4].begin == 3000);
+
+    CHECK(spans[5].name == "EID 20 (1 replays, 0.000ms max)");
+    CHECK(spans[5].track == 4);
+    CHECK(spans[5].end - spans[5].begin == 1);
+
+    // the spans are laid out one after another
+    for(size_t i = 1; i < spans.size(); i++)
+      CHECK(spans[i].begin == spans[i - 1].end);
+  };
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -174,6 +174,8 @@ public:
 
   FrameDescription GetFrameInfo();
   const SDFile &GetStructuredFile();
+  ReplayProfile GetReplayProfile();
+  ResultDetails ExportReplayProfile(const rdcstr &filename);
   const rdcarray<ActionDescription> &GetRootActions();
   void AddFakeMarkers();
   rdcarray<CounterResult> FetchCounters(const rdcarray<GPUCounter> &counters);
@@ -247,6 +249,23 @@ private:
   bool ContainsMarker(const rdcarray<ActionDescription> &actions);
   bool PassEquivalent(const ActionDescription &a, const ActionDescription &b);
 
+  // the texture contents used for calculating min/max and histograms on the CPU
+  struct CPUStatsSlice
+  {
+    // set only if the contents can be reused until the next replay
+    ResourceId texture;
+    Subresource sub;
+
+    bytebuf data;
+    ResourceFormat fmt;
+    uint32_t width = 0, height = 0;
+    // the offset and size of the 2D slice within data
+    size_t offset = 0, size = 0;
+  };
+
+  const CPUStatsSlice *GetCPUStatsSlice(ResourceId textureId, ResourceId liveId,
+                                        const Subresource &sub, CompType typeCast);
+
   IReplayDriver *GetDevice() { return m_pDevice; }
   FrameRecord m_FrameRecord;
   rdcarray<ActionDescription *> m_Actions;
@@ -266,6 +285,11 @@ private:
 
   std::map<uint32_t, uint32_t> m_EventRemap;
 
+  // CPU time spent in SetFrameEvent replaying to each event
+  std::map<uint32_t, EventReplayProfile> m_EventProfile;
+
+  CPUStatsSlice m_CPUStatsSlice;
+
   D3D11Pipe::State m_D3D11PipelineState;
   D3D12Pipe::State m_D3D12PipelineState;
   GLPipe::State m_GLPipelineState;
@@ -23,7 +23,8 @@
  ******************************************************************************/
 
 #include "replay_driver.h"
-#include "compressonator/CMP_Core.h"
+#include <algorithm>
+#include "block_compression.h"
 #include "maths/formatpacking.h"
 #include "maths/half_convert.h"
 #include "serialise/serialiser.h"
@@ -541,6 +542,32 @@ static void StandardFillCBufferVariables(ResourceId shader, const rdcarray<Shade
   }
 }
 
+void AddChunkReplayProfile(ReplayProfile &profile, uint32_t chunkID, uint64_t byteSize,
+                           double duration, rdcstr (*getChunkName)(uint32_t))
+{
+  rdcarray<ChunkProfile> &chunks = profile.replayChunks;
+
+  // this is called for every chunk replayed, so keep the array sorted to find the chunk quickly
+  size_t idx = std::lower_bound(chunks.begin(), chunks.end(), chunkID,
+                                [](const ChunkProfile &chunk, uint32_t id) {
+                                  return chunk.chunkID < id;
+                                }) -
+               chunks.begin();
+
+  if(idx == chunks.size() || chunks[idx].chunkID != chunkID)
+  {
+    ChunkProfile chunk;
+    chunk.chunkID = chunkID;
+    chunk.name = getChunkName(chunkID);
+    chunks.insert(idx, chunk);
+  }
+
+  ChunkProfile &chunk = chunks[idx];
+  chunk.count++;
+  chunk.byteSize += byteSize;
+  chunk.duration += duration;
+}
+
 void PreprocessLineDirectives(rdcarray<ShaderSourceFile> &sourceFiles)
 {
   struct SplitFile
@@ -1651,106 +1678,53 @@ bytebuf GetDiscardPattern(DiscardType type, const ResourceFormat &fmt, uint32_t
 #if ENABLED(RDOC_ANDROID)
     RDCERR("Format %s not supported on android", fmt.Name().c_str());
 #else
-    const uint16_t whalf = ConvertToHalf(1000.0f);
+    // signed formats get the same blocks as unsigned
+    ResourceFormat encodeFmt = fmt;
+    if(encodeFmt.compType == CompType::SNorm)
+      encodeFmt.compType = CompType::UNorm;
 
-    byte block[16];
-
-    uint32_t blockSize =
-        fmt.type == ResourceFormatType::BC1 || fmt.type == ResourceFormatType::BC4 ? 8 : 16;
-    uint32_t tightPitch = (DiscardPatternWidth / 4) * blockSize;
-    rowPitch = RDCMAX(rowPitch, tightPitch);
-
-    ret.reserve(rowPitch * (DiscardPatternHeight / 4));
-
-    bytebuf inblock;
-
-    void *bc6opts = NULL;
+    const uint32_t texelSize = GetBlockUncompressedFormat(encodeFmt).ElementSize();
+    const uint16_t whalf = ConvertToHalf(1000.0f);
 
-    CreateOptionsBC6(&bc6opts);
+    bytebuf texels;
+    texels.resize(DiscardPatternWidth * DiscardPatternHeight * texelSize);
 
-    SetQualityBC6(bc6opts, 0.1f);
+    byte *texel = texels.data();
 
-    for(uint32_t yi = 0; yi < DiscardPatternHeight; yi += 4)
+    for(uint32_t yi = 0; yi < DiscardPatternHeight; yi++)
     {
-      uint32_t baseY = invert ? DiscardPatternHeight - 1 - yi : yi;
-
-      for(uint32_t baseX = 0; baseX < DiscardPatternWidth; baseX += 4)
+      uint32_t y = invert ? DiscardPatternHeight - 1 - yi : yi;
+      for(uint32_t x = 0; x < DiscardPatternWidth; x++)
       {
-        inblock.clear();
+        char c = pattern.c_str()[y * DiscardPatternWidth + x];
 
-        // inblock is 4x4 RGBA8_UNORM
-        if(fmt.type == ResourceFormatType::BC1 || fmt.type == ResourceFormatType::BC2 ||
-           fmt.type == ResourceFormatType::BC3 || fmt.type == ResourceFormatType::BC7)
+        // texels are RGB16_FLOAT for BC6, and 8-bit UNORM channels otherwise
+        if(fmt.type == ResourceFormatType::BC6)
         {
-          for(uint32_t y = baseY; y < baseY + 4; invert ? y-- : y++)
-          {
-            for(uint32_t x = baseX; x < baseX + 4; x++)
-            {
-              char c = pattern.c_str()[y * DiscardPatternWidth + x];
-
-              inblock.push_back(c == '#' ? 0xff : 0x00);
-              inblock.push_back(c == '#' ? 0xff : 0x00);
-              inblock.push_back(c == '#' ? 0xff : 0x00);
-              inblock.push_back(c == '#' ? 0xff : 0x00);
-            }
-          }
+          uint16_t val[3] = {};
+          if(c == '#')
+            val[0] = val[1] = val[2] = whalf;
+          memcpy(texel, val, sizeof(val));
         }
-        // inblock is 4x4 R8_UNORM
-        else if(fmt.type == ResourceFormatType::BC4 || fmt.type == ResourceFormatType::BC5)
+        else
         {
-          for(uint32_t y = baseY; y < baseY + 4; invert ? y-- : y++)
-          {
-            for(uint32_t x = baseX; x < baseX + 4; x++)
-            {
-              char c = pattern.c_str()[y * DiscardPatternWidth + x];
-
-              inblock.push_back(c == '#' ? 0xff : 0x00);
-            }
-          }
+          memset(texel, c == '#' ? 0xff : 0x00, texelSize);
         }
-        // inblock is 4x4 RGB16_FLOAT
-        else if(fmt.type == ResourceFormatType::BC6)
-        {
-          for(uint32_t y = baseY; y < baseY + 4; invert ? y-- : y++)
-          {
-            for(uint32_t x = baseX; x < baseX + 4; x++)
-            {
-              char c = pattern.c_str()[y * DiscardPatternWidth + x];
-
-              inblock.push_back(c == '#' ? (whalf & 0xff) : 0x00);
-              inblock.push_back(c == '#' ? ((whalf >> 8) & 0xff) : 0x00);
 
-              inblock.push_back(c == '#' ? (whalf & 0xff) : 0x00);
-              inblock.push_back(c == '#' ? ((whalf >> 8) & 0xff) : 0x00);
+        texel += texelSize;
+      }
+    }
 
-              inblock.push_back(c == '#' ? (whalf & 0xff) : 0x00);
-              inblock.push_back(c == '#' ? ((whalf >> 8) & 0xff) : 0x00);
-            }
-          }
-        }
+    bytebuf blocks = EncodeBlocks(encodeFmt, DiscardPatternWidth, DiscardPatternHeight,
+                                  texels.data(), fmt.type == ResourceFormatType::BC6 ? 0.1f : -1.0f);
 
-        if(fmt.type == ResourceFormatType::BC1)
-          CompressBlockBC1(inblock.data(), 4 * sizeof(uint32_t), block, NULL);
-        else if(fmt.type == ResourceFormatType::BC2)
-          CompressBlockBC2(inblock.data(), 4 * sizeof(uint32_t), block, NULL);
-        else if(fmt.type == ResourceFormatType::BC3)
-          CompressBlockBC3(inblock.data(), 4 * sizeof(uint32_t), block, NULL);
-        else if(fmt.type == ResourceFormatType::BC4)
-          CompressBlockBC4(inblock.data(), 4, block, NULL);
-        else if(fmt.type == ResourceFormatType::BC5)
-          CompressBlockBC5(inblock.data(), 4, inblock.data(), 4, block, NULL);
-        else if(fmt.type == ResourceFormatType::BC6)
-          CompressBlockBC6((uint16_t *)inblock.data(), 4 * 3, block, bc6opts);
-        else if(fmt.type == ResourceFormatType::BC7)
-          CompressBlockBC7(inblock.data(), 4 * sizeof(uint32_t), block, NULL);
-
-        ret.append(block, blockSize);
-      }
+    uint32_t tightPitch = uint32_t(blocks.size() / (DiscardPatternHeight / 4));
+    rowPitch = RDCMAX(rowPitch, tightPitch);
 
-      ret.resize(ret.size() + (rowPitch - tightPitch));
-    }
+    ret.resize(rowPitch * (DiscardPatternHeight / 4));
 
-    DestroyOptionsBC6(bc6opts);
+    for(uint32_t by = 0; by < DiscardPatternHeight / 4; by++)
+      memcpy(ret.data() + by * rowPitch, blocks.data() + by * tightPitch, tightPitch);
 #endif
   }
   else if(fmt.type == ResourceFormatType::ETC2 || fmt.type == ResourceFormatType::EAC ||
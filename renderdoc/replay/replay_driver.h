@@ -163,6 +163,7 @@ public:
   virtual void SavePipelineState(uint32_t eventId) = 0;
 
   virtual FrameRecord GetFrameRecord() = 0;
+  virtual ReplayProfile GetReplayProfile() = 0;
 
   virtual RDResult ReadLogInitialisation(RDCFile *rdc, bool storeStructuredBuffers) = 0;
   virtual void ReplayLog(uint32_t endEventID, ReplayLogType replayType) = 0;
@@ -323,6 +324,45 @@ void StandardFillCBufferVariables(ResourceId shader, const rdcarray<ShaderConsta
                                   rdcarray<ShaderVariable> &outvars, const bytebuf &data);
 void PreprocessLineDirectives(rdcarray<ShaderSourceFile> &sourceFiles);
 
+// counts the time until the end of the scope as one application of the frame's initial contents
+struct ScopedInitialContentsProfile
+{
+  ScopedInitialContentsProfile(ReplayProfile &profile) : m_Profile(profile) {}
+  ~ScopedInitialContentsProfile()
+  {
+    m_Profile.initialContentsCount++;
+    m_Profile.initialContentsDuration += m_Timer.GetMilliseconds();
+  }
+
+private:
+  ReplayProfile &m_Profile;
+  PerformanceTimer m_Timer;
+};
+
+// fills in the per-chunk load profile from the statistics each driver gathers while loading
+template <typename ChunkType, typename ChunkInfo>
+void SetChunkLoadProfile(ReplayProfile &profile, const std::map<ChunkType, ChunkInfo> &chunkInfos,
+                         rdcstr (*getChunkName)(uint32_t))
+{
+  profile.chunks.clear();
+  profile.chunks.reserve(chunkInfos.size());
+
+  for(auto it = chunkInfos.begin(); it != chunkInfos.end(); ++it)
+  {
+    ChunkProfile chunk;
+    chunk.chunkID = (uint32_t)it->first;
+    chunk.name = getChunkName(chunk.chunkID);
+    chunk.count = (uint32_t)it->second.count;
+    chunk.byteSize = it->second.totalsize;
+    chunk.duration = it->second.total;
+    profile.chunks.push_back(chunk);
+  }
+}
+
+// adds the CPU cost of replaying one chunk to the profile's per-chunk replay costs
+void AddChunkReplayProfile(ReplayProfile &profile, uint32_t chunkID, uint64_t byteSize,
+                           double duration, rdcstr (*getChunkName)(uint32_t));
+
 // simple cache for when we need buffer data for highlighting
 // vertices, typical use will be lots of vertices in the same
 // mesh, not jumping back and forth much between meshes.
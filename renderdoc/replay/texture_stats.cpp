@@ -0,0 +1,956 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019-2022 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "texture_stats.h"
+#include <limits>
+#include "common/threading.h"
+#include "maths/formatpacking.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+// matches HGRAM_NUM_BUCKETS used by the GPU implementations
+static const uint32_t NumHistogramBuckets = 256;
+
+// roughly how many texels each job processes when the work is split across threads
+static const uint32_t TexelsPerJob = 64 * 1024;
+
+// how a format is processed. Regular integer and normalised formats are reduced on their raw
+// component values since decoding is monotonic, and only the results are decoded. Everything else
+// decodes each texel.
+enum class StatsPath
+{
+  Generic,
+  Bytes,
+  Shorts,
+  Words,
+  Floats,
+};
+
+struct StatsFormat
+{
+  ResourceFormat fmt;
+  StatsPath path = StatsPath::Generic;
+  uint32_t elemSize = 0;
+  uint32_t compCount = 0;
+  // xor'd with raw values so that an unsigned comparison orders them, for signed formats
+  uint32_t bias = 0;
+  // which output channel each component is returned in, and which output channels come from the
+  // data at all. Others are constant, 0 for RGB and 1 for alpha as when sampling on the GPU
+  uint32_t outChannel[4] = {0, 1, 2, 3};
+  bool covered[4] = {};
+};
+
+static bool GetStatsFormat(const ResourceFormat &format, CompType typeCast, StatsFormat &ret)
+{
+  ret.fmt = format;
+
+  if(typeCast != CompType::Typeless && format.type == ResourceFormatType::Regular)
+    ret.fmt.compType = typeCast;
+
+  const ResourceFormat &fmt = ret.fmt;
+
+  switch(fmt.type)
+  {
+    case ResourceFormatType::Regular:
+    case ResourceFormatType::A8:
+    case ResourceFormatType::R10G10B10A2:
+    case ResourceFormatType::R11G11B10:
+    case ResourceFormatType::R5G5B5A1:
+    case ResourceFormatType::R5G6B5:
+    case ResourceFormatType::R4G4B4A4:
+    case ResourceFormatType::R4G4:
+    case ResourceFormatType::R9G9B9E5: break;
+    default: return false;
+  }
+
+  if(fmt.compType == CompType::Depth || fmt.compType == CompType::Typeless)
+    return false;
+
+  if(fmt.compCount == 0 || fmt.compCount > 4)
+    return false;
+
+  if(fmt.type == ResourceFormatType::Regular && fmt.compByteWidth != 1 &&
+     fmt.compByteWidth != 2 && fmt.compByteWidth != 4)
+    return false;
+
+  bool supported = false;
+  DecodeFormattedComponents(fmt, NULL, &supported);
+  if(!supported)
+    return false;
+
+  ret.elemSize = fmt.ElementSize();
+  ret.compCount = fmt.compCount;
+
+  if(fmt.type != ResourceFormatType::Regular && fmt.type != ResourceFormatType::A8)
+    return true;
+
+  for(uint32_t c = 0; c < fmt.compCount; c++)
+  {
+    uint32_t out = c;
+    if(fmt.type == ResourceFormatType::A8)
+      out = 3;
+    else if(fmt.BGRAOrder() && c == 0)
+      out = 2;
+    else if(fmt.BGRAOrder() && c == 2)
+      out = 0;
+
+    ret.outChannel[c] = out;
+    ret.covered[out] = true;
+  }
+
+  if(fmt.compType == CompType::Float)
+  {
+    // halfs aren't ordered as integers, so they go through the generic path
+    if(fmt.compByteWidth == 4)
+      ret.path = StatsPath::Floats;
+    return true;
+  }
+
+  if(fmt.compByteWidth == 1)
+    ret.path = StatsPath::Bytes;
+  else if(fmt.compByteWidth == 2)
+    ret.path = StatsPath::Shorts;
+  else
+    ret.path = StatsPath::Words;
+
+  if(fmt.compType == CompType::SNorm || fmt.compType == CompType::SInt ||
+     fmt.compType == CompType::SScaled)
+    ret.bias = 1U << (fmt.compByteWidth * 8 - 1);
+
+  return true;
+}
+
+// convert the raw bits of a component to the value the GPU would return for it
+static double ComponentValue(const StatsFormat &f, uint32_t c, uint32_t raw)
+{
+  const CompType compType = f.fmt.compType;
+  const uint32_t width = f.fmt.compByteWidth;
+
+  if(compType == CompType::UInt)
+    return double(raw);
+
+  if(compType == CompType::SInt)
+  {
+    if(width == 1)
+      return double(int8_t(raw));
+    if(width == 2)
+      return double(int16_t(raw));
+    return double(int32_t(raw));
+  }
+
+  if(f.path == StatsPath::Floats)
+  {
+    float val;
+    memcpy(&val, &raw, sizeof(val));
+    return val;
+  }
+
+  // otherwise decode a texel with only this component set, to get exactly the same conversion
+  byte texel[16] = {};
+  memcpy(texel + c * width, &raw, width);
+
+  FloatVector v = DecodeFormattedComponents(f.fmt, texel);
+  return (&v.x)[f.outChannel[c]];
+}
+
+// the same as ComponentValue for 2 and 4 byte components, in float, for use per-texel
+static inline float ComponentFloat(CompType compType, uint32_t width, uint32_t raw)
+{
+  if(compType == CompType::UNorm)
+    return width == 2 ? float(raw) / 65535.0f : float(double(raw) / 4294967295.0);
+
+  if(compType == CompType::SNorm)
+  {
+    if(width == 2)
+    {
+      int16_t i16 = int16_t(raw);
+      return i16 == -32768 ? -1.0f : float(i16) / 32767.0f;
+    }
+
+    int32_t i32 = int32_t(raw);
+    return i32 == INT32_MIN ? -1.0f : float(double(i32) / 2147483647.0);
+  }
+
+  if(compType == CompType::SInt || compType == CompType::SScaled)
+    return width == 2 ? float(int16_t(raw)) : float(int32_t(raw));
+
+  return float(raw);
+}
+
+static inline float ConstantChannel(uint32_t channel)
+{
+  return channel == 3 ? 1.0f : 0.0f;
+}
+
+static void MinMaxBytes(const byte *data, size_t count, uint32_t compCount, uint32_t bias,
+                        uint32_t *mn, uint32_t *mx)
+{
+  size_t i = 0;
+
+#if defined(__x86_64__) || defined(_M_X64)
+  if(16 % compCount == 0 && count >= 16)
+  {
+    const __m128i vbias = _mm_set1_epi8((char)bias);
+    __m128i vmn = _mm_set1_epi8(-1);
+    __m128i vmx = _mm_setzero_si128();
+
+    for(; i + 16 <= count; i += 16)
+    {
+      __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(data + i)), vbias);
+      vmn = _mm_min_epu8(vmn, v);
+      vmx = _mm_max_epu8(vmx, v);
+    }
+
+    uint8_t lanemn[16], lanemx[16];
+    _mm_storeu_si128((__m128i *)lanemn, vmn);
+    _mm_storeu_si128((__m128i *)lanemx, vmx);
+
+    for(uint32_t j = 0; j < 16; j++)
+    {
+      mn[j % compCount] = RDCMIN(mn[j % compCount], uint32_t(lanemn[j]));
+      mx[j % compCount] = RDCMAX(mx[j % compCount], uint32_t(lanemx[j]));
+    }
+  }
+#endif
+
+  for(; i < count; i++)
+  {
+    uint32_t c = uint32_t(i % compCount);
+    uint32_t key = data[i] ^ bias;
+    mn[c] = RDCMIN(mn[c], key);
+    mx[c] = RDCMAX(mx[c], key);
+  }
+}
+
+static void MinMaxShorts(const uint16_t *data, size_t count, uint32_t compCount, uint32_t bias,
+                         uint32_t *mn, uint32_t *mx)
+{
+  size_t i = 0;
+
+#if defined(__x86_64__) || defined(_M_X64)
+  if(8 % compCount == 0 && count >= 8)
+  {
+    // SSE2 only has signed 16-bit min/max, so flip the top bit of unsigned values to order them
+    // as signed. The results are then flipped back, which also turns signed values into keys.
+    const __m128i vflip = _mm_set1_epi16(short(0x8000 ^ bias));
+    __m128i vmn = _mm_set1_epi16(0x7fff);
+    __m128i vmx = _mm_set1_epi16(-0x8000);
+
+    for(; i + 8 <= count; i += 8)
+    {
+      __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(data + i)), vflip);
+      vmn = _mm_min_epi16(vmn, v);
+      vmx = _mm_max_epi16(vmx, v);
+    }
+
+    uint16_t lanemn[8], lanemx[8];
+    _mm_storeu_si128((__m128i *)lanemn, vmn);
+    _mm_storeu_si128((__m128i *)lanemx, vmx);
+
+    for(uint32_t j = 0; j < 8; j++)
+    {
+      mn[j % compCount] = RDCMIN(mn[j % compCount], uint32_t(lanemn[j] ^ 0x8000));
+      mx[j % compCount] = RDCMAX(mx[j % compCount], uint32_t(lanemx[j] ^ 0x8000));
+    }
+  }
+#endif
+
+  for(; i < count; i++)
+  {
+    uint32_t c = uint32_t(i % compCount);
+    uint32_t key = data[i] ^ bias;
+    mn[c] = RDCMIN(mn[c], key);
+    mx[c] = RDCMAX(mx[c], key);
+  }
+}
+
+static void MinMaxWords(const uint32_t *data, size_t count, uint32_t compCount, uint32_t bias,
+                        uint32_t *mn, uint32_t *mx)
+{
+  for(size_t i = 0; i < count; i += compCount)
+  {
+    for(uint32_t c = 0; c < compCount; c++)
+    {
+      uint32_t key = data[i + c] ^ bias;
+      mn[c] = RDCMIN(mn[c], key);
+      mx[c] = RDCMAX(mx[c], key);
+    }
+  }
+}
+
+// NaNs are ignored, as with min()/max() on the GPU
+static void MinMaxFloats(const float *data, size_t count, uint32_t compCount, float *mn, float *mx)
+{
+  size_t i = 0;
+
+#if defined(__x86_64__) || defined(_M_X64)
+  if(4 % compCount == 0 && count >= 4)
+  {
+    __m128 vmn = _mm_set1_ps(std::numeric_limits<float>::infinity());
+    __m128 vmx = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+
+    for(; i + 4 <= count; i += 4)
+    {
+      __m128 v = _mm_loadu_ps(data + i);
+      // these return the second operand if either is NaN, so NaN data never replaces the result
+      vmn = _mm_min_ps(v, vmn);
+      vmx = _mm_max_ps(v, vmx);
+    }
+
+    float lanemn[4], lanemx[4];
+    _mm_storeu_ps(lanemn, vmn);
+    _mm_storeu_ps(lanemx, vmx);
+
+    for(uint32_t j = 0; j < 4; j++)
+    {
+      mn[j % compCount] = RDCMIN(mn[j % compCount], lanemn[j]);
+      mx[j % compCount] = RDCMAX(mx[j % compCount], lanemx[j]);
+    }
+  }
+#endif
+
+  for(; i < count; i++)
+  {
+    uint32_t c = uint32_t(i % compCount);
+    if(data[i] < mn[c])
+      mn[c] = data[i];
+    if(data[i] > mx[c])
+      mx[c] = data[i];
+  }
+}
+
+static void MinMaxTexels(const StatsFormat &f, const byte *data, size_t numTexels, double *mn,
+                         double *mx)
+{
+  const size_t count = numTexels * f.compCount;
+
+  if(f.path == StatsPath::Generic)
+  {
+    FloatVector vmn, vmx;
+    for(uint32_t k = 0; k < 4; k++)
+    {
+      (&vmn.x)[k] = std::numeric_limits<float>::infinity();
+      (&vmx.x)[k] = -std::numeric_limits<float>::infinity();
+    }
+
+    for(size_t t = 0; t < numTexels; t++)
+    {
+      FloatVector v = DecodeFormattedComponents(f.fmt, data + t * f.elemSize);
+
+      for(uint32_t k = 0; k < 4; k++)
+      {
+        if((&v.x)[k] < (&vmn.x)[k])
+          (&vmn.x)[k] = (&v.x)[k];
+        if((&v.x)[k] > (&vmx.x)[k])
+          (&vmx.x)[k] = (&v.x)[k];
+      }
+    }
+
+    for(uint32_t k = 0; k < 4; k++)
+    {
+      mn[k] = (&vmn.x)[k];
+      mx[k] = (&vmx.x)[k];
+    }
+
+    return;
+  }
+
+  for(uint32_t k = 0; k < 4; k++)
+    mn[k] = mx[k] = ConstantChannel(k);
+
+  if(f.path == StatsPath::Floats)
+  {
+    float fmn[4], fmx[4];
+    for(uint32_t c = 0; c < 4; c++)
+    {
+      fmn[c] = std::numeric_limits<float>::infinity();
+      fmx[c] = -std::numeric_limits<float>::infinity();
+    }
+
+    MinMaxFloats((const float *)data, count, f.compCount, fmn, fmx);
+
+    for(uint32_t c = 0; c < f.compCount; c++)
+    {
+      mn[f.outChannel[c]] = fmn[c];
+      mx[f.outChannel[c]] = fmx[c];
+    }
+
+    return;
+  }
+
+  uint32_t kmn[4] = {~0U, ~0U, ~0U, ~0U};
+  uint32_t kmx[4] = {0, 0, 0, 0};
+
+  if(f.path == StatsPath::Bytes)
+    MinMaxBytes(data, count, f.compCount, f.bias, kmn, kmx);
+  else if(f.path == StatsPath::Shorts)
+    MinMaxShorts((const uint16_t *)data, count, f.compCount, f.bias, kmn, kmx);
+  else
+    MinMaxWords((const uint32_t *)data, count, f.compCount, f.bias, kmn, kmx);
+
+  // decoding is monotonic, so the smallest and largest raw values decode to the min and max
+  for(uint32_t c = 0; c < f.compCount; c++)
+  {
+    mn[f.outChannel[c]] = ComponentValue(f, c, kmn[c] ^ f.bias);
+    mx[f.outChannel[c]] = ComponentValue(f, c, kmx[c] ^ f.bias);
+  }
+}
+
+// the same calculation as the GPU histogram shader
+static inline void AddToHistogram(uint32_t *buckets, float val, float minval, float range,
+                                  uint32_t count)
+{
+  float normalised = (val - minval) / range;
+
+  // values below the minimum are discarded, and NaNs fail both tests
+  if(normalised >= 0.0f)
+  {
+    normalised *= float(NumHistogramBuckets);
+    if(normalised < float(NumHistogramBuckets))
+      buckets[uint32_t(normalised)] += count;
+  }
+}
+
+static void HistogramTexels(const StatsFormat &f, const byte *data, size_t numTexels,
+                            float minval, float range, const rdcfixedarray<bool, 4> &channels,
+                            uint32_t *buckets)
+{
+  if(f.path == StatsPath::Generic)
+  {
+    for(size_t t = 0; t < numTexels; t++)
+    {
+      FloatVector v = DecodeFormattedComponents(f.fmt, data + t * f.elemSize);
+
+      for(uint32_t k = 0; k < 4; k++)
+        if(channels[k])
+          AddToHistogram(buckets, (&v.x)[k], minval, range, 1);
+    }
+
+    return;
+  }
+
+  for(uint32_t k = 0; k < 4; k++)
+    if(!f.covered[k] && channels[k])
+      AddToHistogram(buckets, ConstantChannel(k), minval, range, (uint32_t)numTexels);
+
+  const uint32_t compCount = f.compCount;
+  const CompType compType = f.fmt.compType;
+
+  if(f.path == StatsPath::Bytes)
+  {
+    // count each raw value first, then only convert each distinct value once
+    uint32_t counts[4][256] = {};
+
+    for(size_t t = 0; t < numTexels; t++, data += compCount)
+      for(uint32_t c = 0; c < compCount; c++)
+        counts[c][data[c]]++;
+
+    for(uint32_t c = 0; c < compCount; c++)
+    {
+      if(!channels[f.outChannel[c]])
+        continue;
+
+      for(uint32_t raw = 0; raw < 256; raw++)
+        if(counts[c][raw])
+          AddToHistogram(buckets, (float)ComponentValue(f, c, raw), minval, range, counts[c][raw]);
+    }
+  }
+  else if(f.path == StatsPath::Shorts)
+  {
+    const uint16_t *u16 = (const uint16_t *)data;
+    for(size_t t = 0; t < numTexels; t++, u16 += compCount)
+      for(uint32_t c = 0; c < compCount; c++)
+        if(channels[f.outChannel[c]])
+          AddToHistogram(buckets, ComponentFloat(compType, 2, u16[c]), minval, range, 1);
+  }
+  else if(f.path == StatsPath::Words)
+  {
+    const uint32_t *u32 = (const uint32_t *)data;
+    for(size_t t = 0; t < numTexels; t++, u32 += compCount)
+      for(uint32_t c = 0; c < compCount; c++)
+        if(channels[f.outChannel[c]])
+          AddToHistogram(buckets, ComponentFloat(compType, 4, u32[c]), minval, range, 1);
+  }
+  else if(f.path == StatsPath::Floats)
+  {
+    const float *f32 = (const float *)data;
+    for(size_t t = 0; t < numTexels; t++, f32 += compCount)
+      for(uint32_t c = 0; c < compCount; c++)
+        if(channels[f.outChannel[c]])
+          AddToHistogram(buckets, f32[c], minval, range, 1);
+  }
+}
+
+static uint32_t RowsPerJob(uint32_t width)
+{
+  return RDCMAX(1U, TexelsPerJob / width);
+}
+
+static uint32_t NumJobs(uint32_t width, uint32_t height)
+{
+  return (height + RowsPerJob(width) - 1) / RowsPerJob(width);
+}
+
+// split the rows of the slice into jobs of roughly TexelsPerJob texels each, run across threads
+static void ForEachRowRange(uint32_t width, uint32_t height,
+                            std::function<void(uint32_t job, uint32_t row, uint32_t numRows)> callback)
+{
+  const uint32_t rowsPerJob = RowsPerJob(width);
+
+  Threading::JobSystem::ParallelFor(NumJobs(width, height), [&](uint32_t job) {
+    uint32_t row = job * rowsPerJob;
+    callback(job, row, RDCMIN(rowsPerJob, height - row));
+  });
+}
+
+bool CanCalculateTextureStats(const ResourceFormat &fmt, CompType typeCast)
+{
+  StatsFormat f;
+  return GetStatsFormat(fmt, typeCast, f);
+}
+
+bool CalculateTextureMinMax(const ResourceFormat &fmt, CompType typeCast, uint32_t width,
+                            uint32_t height, const byte *data, size_t dataSize, float *minval,
+                            float *maxval)
+{
+  StatsFormat f;
+  if(!GetStatsFormat(fmt, typeCast, f))
+    return false;
+
+  const uint64_t rowSize = uint64_t(width) * f.elemSize;
+
+  if(width == 0 || height == 0 || rowSize * height > dataSize)
+    return false;
+
+  const uint32_t numJobs = NumJobs(width, height);
+
+  // each job writes its min then max
+  rdcarray<double> results;
+  results.resize(numJobs * 8);
+
+  ForEachRowRange(width, height, [&](uint32_t job, uint32_t row, uint32_t numRows) {
+    MinMaxTexels(f, data + row * rowSize, size_t(numRows) * width, &results[job * 8],
+                 &results[job * 8 + 4]);
+  });
+
+  double mn[4], mx[4];
+  for(uint32_t k = 0; k < 4; k++)
+  {
+    mn[k] = results[k];
+    mx[k] = results[4 + k];
+  }
+
+  for(uint32_t job = 1; job < numJobs; job++)
+  {
+    for(uint32_t k = 0; k < 4; k++)
+    {
+      mn[k] = RDCMIN(mn[k], results[job * 8 + k]);
+      mx[k] = RDCMAX(mx[k], results[job * 8 + 4 + k]);
+    }
+  }
+
+  // integer formats return integers, as with the GPU
+  for(uint32_t k = 0; k < 4; k++)
+  {
+    if(f.fmt.compType == CompType::UInt)
+    {
+      ((uint32_t *)minval)[k] = uint32_t(mn[k]);
+      ((uint32_t *)maxval)[k] = uint32_t(mx[k]);
+    }
+    else if(f.fmt.compType == CompType::SInt)
+    {
+      ((int32_t *)minval)[k] = int32_t(mn[k]);
+      ((int32_t *)maxval)[k] = int32_t(mx[k]);
+    }
+    else
+    {
+      minval[k] = float(mn[k]);
+      maxval[k] = float(mx[k]);
+    }
+  }
+
+  return true;
+}
+
+bool CalculateTextureHistogram(const ResourceFormat &fmt, CompType typeCast, uint32_t width,
+                               uint32_t height, const byte *data, size_t dataSize, float minval,
+                               float maxval, const rdcfixedarray<bool, 4> &channels,
+                               rdcarray<uint32_t> &histogram)
+{
+  StatsFormat f;
+  if(!GetStatsFormat(fmt, typeCast, f))
+    return false;
+
+  const uint64_t rowSize = uint64_t(width) * f.elemSize;
+
+  if(width == 0 || height == 0 || rowSize * height > dataSize)
+    return false;
+
+  if(minval >= maxval)
+    return false;
+
+  // as on the GPU, any value equal to maxval must go into the last bucket so add a small delta.
+  const float range = (maxval + maxval * 1e-6f) - minval;
+
+  const uint32_t numJobs = NumJobs(width, height);
+
+  rdcarray<uint32_t> jobBuckets;
+  jobBuckets.fill(numJobs * NumHistogramBuckets, 0);
+
+  ForEachRowRange(width, height, [&](uint32_t job, uint32_t row, uint32_t numRows) {
+    HistogramTexels(f, data + row * rowSize, size_t(numRows) * width, minval, range, channels,
+                    &jobBuckets[job * NumHistogramBuckets]);
+  });
+
+  histogram.fill(NumHistogramBuckets, 0);
+
+  for(uint32_t job = 0; job < numJobs; job++)
+    for(uint32_t b = 0; b < NumHistogramBuckets; b++)
+      histogram[b] += jobBuckets[job * NumHistogramBuckets + b];
+
+  return true;
+}
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+#include "common/formatting.h"
+#include "common/timing.h"
+
+// the straightforward implementation, decoding every texel
+static void ReferenceMinMax(const ResourceFormat &fmt, uint32_t numTexels, const byte *data,
+                            float *minval, float *maxval)
+{
+  const uint32_t elemSize = fmt.ElementSize();
+
+  // 32-bit integers don't survive a round trip through float, so compare them directly
+  if(fmt.type == ResourceFormatType::Regular && fmt.compByteWidth == 4 &&
+     (fmt.compType == CompType::UInt || fmt.compType == CompType::SInt))
+  {
+    const bool sint = fmt.compType == CompType::SInt;
+    int64_t mn[4], mx[4];
+    for(uint32_t k = 0; k < 4; k++)
+      mn[k] = mx[k] = k < fmt.compCount ? 0 : (k == 3 ? 1 : 0);
+
+    for(uint32_t t = 0; t < numTexels; t++)
+    {
+      for(uint32_t k = 0; k < fmt.compCount; k++)
+      {
+        uint32_t raw;
+        memcpy(&raw, data + t * elemSize + k * 4, sizeof(raw));
+        int64_t val = sint ? int64_t(int32_t(raw)) : int64_t(raw);
+        mn[k] = t == 0 ? val : RDCMIN(mn[k], val);
+        mx[k] = t == 0 ? val : RDCMAX(mx[k], val);
+      }
+    }
+
+    for(uint32_t k = 0; k < 4; k++)
+    {
+      ((uint32_t *)minval)[k] = uint32_t(mn[k]);
+      ((uint32_t *)maxval)[k] = uint32_t(mx[k]);
+    }
+
+    return;
+  }
+
+  for(uint32_t k = 0; k < 4; k++)
+  {
+    minval[k] = std::numeric_limits<float>::infinity();
+    maxval[k] = -std::numeric_limits<float>::infinity();
+  }
+
+  for(uint32_t t = 0; t < numTexels; t++)
+  {
+    FloatVector v = DecodeFormattedComponents(fmt, data + t * elemSize);
+
+    // integer formats decode missing alpha as 0, but it samples as 1 on the GPU
+    if(fmt.type == ResourceFormatType::Regular && fmt.compCount < 4 &&
+       (fmt.compType == CompType::UInt || fmt.compType == CompType::SInt))
+      v.w = 1.0f;
+
+    // NaNs are ignored
+    for(uint32_t k = 0; k < 4; k++)
+    {
+      float val = (&v.x)[k];
+      if(val < minval[k])
+        minval[k] = val;
+      if(val > maxval[k])
+        maxval[k] = val;
+    }
+  }
+
+  for(uint32_t k = 0; k < 4; k++)
+  {
+    if(fmt.compType == CompType::UInt)
+    {
+      ((uint32_t *)minval)[k] = uint32_t(minval[k]);
+      ((uint32_t *)maxval)[k] = uint32_t(maxval[k]);
+    }
+    else if(fmt.compType == CompType::SInt)
+    {
+      ((int32_t *)minval)[k] = int32_t(minval[k]);
+      ((int32_t *)maxval)[k] = int32_t(maxval[k]);
+    }
+  }
+}
+
+static rdcarray<uint32_t> ReferenceHistogram(const ResourceFormat &fmt, uint32_t numTexels,
+                                             const byte *data, float minval, float maxval,
+                                             const rdcfixedarray<bool, 4> &channels)
+{
+  rdcarray<uint32_t> ret;
+  ret.fill(NumHistogramBuckets, 0);
+
+  const uint32_t elemSize = fmt.ElementSize();
+  const float adjustedMax = maxval + maxval * 1e-6f;
+
+  for(uint32_t t = 0; t < numTexels; t++)
+  {
+    FloatVector v = DecodeFormattedComponents(fmt, data + t * elemSize);
+
+    if(fmt.type == ResourceFormatType::Regular && fmt.compCount < 4 &&
+       (fmt.compType == CompType::UInt || fmt.compType == CompType::SInt))
+      v.w = 1.0f;
+
+    for(uint32_t k = 0; k < 4; k++)
+    {
+      if(!channels[k])
+        continue;
+
+      float normalised = ((&v.x)[k] - minval) / (adjustedMax - minval);
+      if(normalised < 0.0f)
+        normalised = 2.0f;
+      normalised *= float(NumHistogramBuckets);
+
+      if(normalised < float(NumHistogramBuckets))
+        ret[(uint32_t)floorf(normalised)]++;
+    }
+  }
+
+  return ret;
+}
+
+static ResourceFormat MakeFormat(uint32_t compCount, uint32_t compByteWidth, CompType compType)
+{
+  ResourceFormat ret;
+  ret.type = ResourceFormatType::Regular;
+  ret.compCount = (uint8_t)compCount;
+  ret.compByteWidth = (uint8_t)compByteWidth;
+  ret.compType = compType;
+  return ret;
+}
+
+TEST_CASE("Test CPU texture min/max and histogram", "[texturestats]")
+{
+  // odd sizes, so that rows don't line up with vectors or jobs
+  const uint32_t width = 301, height = 517;
+
+  rdcarray<ResourceFormat> formats = {
+      MakeFormat(4, 1, CompType::UNorm),    MakeFormat(4, 1, CompType::UNormSRGB),
+      MakeFormat(1, 1, CompType::UNorm),    MakeFormat(2, 1, CompType::SNorm),
+      MakeFormat(3, 1, CompType::UInt),     MakeFormat(4, 1, CompType::SInt),
+      MakeFormat(2, 2, CompType::UNorm),    MakeFormat(4, 2, CompType::SNorm),
+      MakeFormat(1, 2, CompType::UInt),     MakeFormat(3, 2, CompType::SInt),
+      MakeFormat(4, 2, CompType::Float),    MakeFormat(1, 4, CompType::Float),
+      MakeFormat(3, 4, CompType::Float),    MakeFormat(4, 4, CompType::Float),
+      MakeFormat(2, 4, CompType::UInt),     MakeFormat(4, 4, CompType::SInt),
+  };
+
+  {
+    ResourceFormat bgra = MakeFormat(4, 1, CompType::UNorm);
+    bgra.SetBGRAOrder(true);
+    formats.push_back(bgra);
+
+    ResourceFormat packed;
+    packed.type = ResourceFormatType::R10G10B10A2;
+    packed.compCount = 4;
+    packed.compType = CompType::UNorm;
+    formats.push_back(packed);
+
+    packed.compType = CompType::UInt;
+    formats.push_back(packed);
+
+    packed.type = ResourceFormatType::R5G6B5;
+    packed.compCount = 3;
+    packed.compType = CompType::UNorm;
+    formats.push_back(packed);
+
+    packed.type = ResourceFormatType::R11G11B10;
+    packed.compType = CompType::Float;
+    formats.push_back(packed);
+
+    packed.type = ResourceFormatType::A8;
+    packed.compCount = 1;
+    packed.compByteWidth = 1;
+    packed.compType = CompType::UNorm;
+    formats.push_back(packed);
+  }
+
+  bytebuf data, floatData;
+  data.resize(width * height * 16);
+  floatData.resize(data.size());
+
+  uint32_t seed = 1234;
+  for(size_t i = 0; i < data.size(); i++)
+  {
+    seed = seed * 1103515245 + 12345;
+    data[i] = byte(seed >> 16);
+  }
+
+  // 32-bit floats need sensible values, with the occasional NaN
+  {
+    float *f = (float *)floatData.data();
+    for(size_t i = 0; i < floatData.size() / sizeof(float); i++)
+      f[i] = (i % 977) == 500 ? std::numeric_limits<float>::quiet_NaN()
+                              : float(int((i * 2654435761ULL) >> 20) % 2000 - 1000) / 100.0f;
+  }
+
+  for(const ResourceFormat &fmt : formats)
+  {
+    bytebuf fmtData = data;
+    if(fmt.compType == CompType::Float && fmt.compByteWidth == 4)
+    {
+      fmtData = floatData;
+    }
+    else if(fmt.compType == CompType::Float && fmt.compByteWidth == 2)
+    {
+      // keep the exponent of halfs from being all 1s, to avoid NaNs and infinities
+      for(size_t i = 0; i + 1 < fmtData.size(); i += 2)
+        fmtData[i + 1] &= 0xbb;
+    }
+
+    INFO("Format: " << fmt.Name().c_str());
+
+    REQUIRE(CanCalculateTextureStats(fmt, CompType::Typeless));
+
+    float expectedMin[4], expectedMax[4];
+    ReferenceMinMax(fmt, width * height, fmtData.data(), expectedMin, expectedMax);
+
+    float minval[4] = {}, maxval[4] = {};
+    REQUIRE(CalculateTextureMinMax(fmt, CompType::Typeless, width, height, fmtData.data(),
+                                   fmtData.size(), minval, maxval));
+
+    CHECK(memcmp(minval, expectedMin, sizeof(minval)) == 0);
+    CHECK(memcmp(maxval, expectedMax, sizeof(maxval)) == 0);
+
+    rdcfixedarray<bool, 4> channels = {true, true, true, true};
+    float histMin = 0.0f, histMax = 1.0f;
+
+    if(fmt.compType == CompType::UInt || fmt.compType == CompType::SInt)
+    {
+      histMin = 1.0f;
+      histMax = 200.0f;
+    }
+    else if(fmt.compType == CompType::Float)
+    {
+      histMin = -5.0f;
+      histMax = 7.5f;
+      channels[1] = false;
+    }
+
+    rdcarray<uint32_t> histogram;
+    REQUIRE(CalculateTextureHistogram(fmt, CompType::Typeless, width, height, fmtData.data(),
+                                      fmtData.size(), histMin, histMax, channels, histogram));
+
+    CHECK((histogram ==
+           ReferenceHistogram(fmt, width * height, fmtData.data(), histMin, histMax, channels)));
+  }
+
+  SECTION("Type casting")
+  {
+    ResourceFormat fmt = MakeFormat(4, 1, CompType::UNorm);
+
+    float minval[4] = {}, maxval[4] = {};
+    REQUIRE(CalculateTextureMinMax(fmt, CompType::UInt, width, height, data.data(), data.size(),
+                                   minval, maxval));
+
+    float expectedMin[4], expectedMax[4];
+    ReferenceMinMax(MakeFormat(4, 1, CompType::UInt), width * height, data.data(), expectedMin,
+                    expectedMax);
+
+    CHECK(memcmp(minval, expectedMin, sizeof(minval)) == 0);
+    CHECK(memcmp(maxval, expectedMax, sizeof(maxval)) == 0);
+  }
+
+  SECTION("Unsupported formats")
+  {
+    ResourceFormat fmt;
+    fmt.type = ResourceFormatType::BC1;
+    CHECK_FALSE(CanCalculateTextureStats(fmt, CompType::Typeless));
+
+    fmt = MakeFormat(1, 4, CompType::Depth);
+    CHECK_FALSE(CanCalculateTextureStats(fmt, CompType::Typeless));
+
+    fmt = MakeFormat(4, 8, CompType::Float);
+    CHECK_FALSE(CanCalculateTextureStats(fmt, CompType::Typeless));
+
+    // no API has 32-bit normalised formats, and they can't be decoded
+    fmt = MakeFormat(1, 4, CompType::UNorm);
+    CHECK_FALSE(CanCalculateTextureStats(fmt, CompType::Typeless));
+
+    float minval[4] = {}, maxval[4] = {};
+
+    // too little data
+    fmt = MakeFormat(4, 1, CompType::UNorm);
+    CHECK_FALSE(CalculateTextureMinMax(fmt, CompType::Typeless, width, height, data.data(), 100,
+                                       minval, maxval));
+  }
+}
+
+TEST_CASE("Benchmark CPU texture min/max and histogram", "[.][benchmark][texturestats]")
+{
+  // an 8K float image, like an EXR
+  const uint32_t width = 7680, height = 4320;
+
+  ResourceFormat fmt = MakeFormat(4, 4, CompType::Float);
+
+  bytebuf data;
+  data.resize(size_t(width) * height * fmt.ElementSize());
+
+  float *f = (float *)data.data();
+  for(size_t i = 0; i < data.size() / sizeof(float); i++)
+    f[i] = float(i % 4099) / 4099.0f;
+
+  PerformanceTimer timer;
+
+  float minval[4], maxval[4];
+  CalculateTextureMinMax(fmt, CompType::Typeless, width, height, data.data(), data.size(), minval,
+                         maxval);
+
+  double minmaxMs = timer.GetMilliseconds();
+  timer.Restart();
+
+  rdcarray<uint32_t> histogram;
+  CalculateTextureHistogram(fmt, CompType::Typeless, width, height, data.data(), data.size(), 0.0f,
+                            1.0f, {true, true, true, true}, histogram);
+
+  double histogramMs = timer.GetMilliseconds();
+
+  WARN(StringFormat::Fmt("8K RGBA32F: min/max %.2f ms, histogram %.2f ms", minmaxMs, histogramMs)
+           .c_str());
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
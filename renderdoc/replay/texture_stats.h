@@ -0,0 +1,47 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019-2022 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include "api/replay/renderdoc_replay.h"
+
+// CPU implementations of IReplayDriver::GetMinMax and GetHistogram, for when the contents of a
+// texture are already available in memory and there's no need to go to the GPU. They operate on a
+// single 2D slice given as tightly packed rows of texels, the layout returned by GetTextureData(),
+// and return the same results as the GPU implementations - including integer formats returning
+// their min/max as integers in the float storage, as in PixelValue.
+//
+// If the format (after applying typeCast) can't be decoded on the CPU they return false without
+// modifying the outputs, so that the caller can fall back to the GPU.
+
+bool CanCalculateTextureStats(const ResourceFormat &fmt, CompType typeCast);
+
+bool CalculateTextureMinMax(const ResourceFormat &fmt, CompType typeCast, uint32_t width,
+                            uint32_t height, const byte *data, size_t dataSize, float *minval,
+                            float *maxval);
+
+bool CalculateTextureHistogram(const ResourceFormat &fmt, CompType typeCast, uint32_t width,
+                               uint32_t height, const byte *data, size_t dataSize, float minval,
+                               float maxval, const rdcfixedarray<bool, 4> &channels,
+                               rdcarray<uint32_t> &histogram);
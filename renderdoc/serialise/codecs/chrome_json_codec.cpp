@@ -37,6 +37,8 @@ RDResult exportChrome(const rdcstr &filename, const RDCFile &rdc, const SDFile &
     RETURN_ERROR_RESULT(ResultCode::FileIOFailed, "Failed to open '%s' for write: %s",
                         filename.c_str(), FileIO::ErrorString().c_str());
 
+  // events are written out as they're generated rather than building the whole document in memory,
+  // the FILE buffering takes care of batching up the small writes.
   rdcstr str;
 
   // add header, customise this as needed.
@@ -44,6 +46,8 @@ RDResult exportChrome(const rdcstr &filename, const RDCFile &rdc, const SDFile &
   "displayTimeUnit": "ns",
   "traceEvents": [)";
 
+  FileIO::fwrite(str.data(), 1, str.size(), f);
+
   const char *category = "Initialisation";
 
   // stupid JSON not allowing trailing ,s :(
@@ -57,6 +61,8 @@ RDResult exportChrome(const rdcstr &filename, const RDCFile &rdc, const SDFile &
     if(chunk->metadata.chunkID == (uint32_t)SystemChunk::FirstDriverChunk + 1)
       category = "Frame Capture";
 
+    str.clear();
+
     if(!first)
       str += ",";
 
@@ -76,6 +82,8 @@ RDResult exportChrome(const rdcstr &filename, const RDCFile &rdc, const SDFile &
         fmt, chunk->name.c_str(), category, chunk->metadata.timestampMicro, chunk->metadata.threadID,
         chunk->metadata.timestampMicro + chunk->metadata.durationMicro, chunk->metadata.threadID);
 
+    FileIO::fwrite(str.data(), 1, str.size(), f);
+
     if(progress)
       progress(float(i) / float(numChunks));
 
@@ -86,7 +94,7 @@ RDResult exportChrome(const rdcstr &filename, const RDCFile &rdc, const SDFile &
     progress(1.0f);
 
   // end trace events
-  str += "\n  ]\n}";
+  str = "\n  ]\n}";
 
   FileIO::fwrite(str.data(), 1, str.size(), f);
 
@@ -0,0 +1,665 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019-2022 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include <map>
+#include "api/replay/structured_data.h"
+#include "common/common.h"
+#include "serialise/rdcfile.h"
+#include "zstd/xxhash.h"
+
+// The columnar export is intended for bulk analysis over many captures, where it can be memory
+// mapped and queried without any parsing. All values are little-endian and the file is laid out as:
+//
+//   ColumnarHeader
+//   ColumnarTable[tableCount]
+//   ColumnarColumn[...] - the columns for each table are contiguous, starting at firstColumn
+//   column data - rowCount * width bytes for each column, each column starting 8-byte aligned
+//   string pool - each string is a uint32_t length, then the characters and a NULL terminator
+//   blob pool - each blob is a uint64_t length then the data, each blob starting 8-byte aligned
+//
+// The first table is always "$chunks" with one row per chunk in order, giving its id, name, thread,
+// timestamp and duration, and which table and row its contents are in.
+//
+// Each distinct chunk name gets a table of its own with a "$chunk" column giving the row in
+// "$chunks", then one column per basic member named by its path e.g. "CreateInfo.extent.width".
+// Integers, floats, enums and resources keep their natural width. Strings are stored as an offset
+// into the string pool, and enums additionally get a "<path>.str" string column. Buffers store
+// their byte size, with a "<path>.blob" column giving the offset of the contents in the blob pool
+// or ~0 if the buffer contents weren't available.
+//
+// Arrays store their length in a "<path>.count" column and the elements go into a separate table
+// named "<table>/<path>", with a "$parent" column giving the row in the owning table. Arrays of
+// basic types have their elements in a "$value" column.
+//
+// Any value not present in a row, such as a NULL pointer or a member only in some versions of a
+// chunk, reads as 0.
+
+static const char ColumnarMagic[8] = {'R', 'D', 'C', 'C', 'O', 'L', 'S', '\0'};
+static const uint32_t ColumnarVersion = 1;
+
+struct ColumnarHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t tableCount;
+  uint64_t tableOffset;
+  uint64_t columnOffset;
+  uint64_t stringPoolOffset;
+  uint64_t stringPoolSize;
+  uint64_t blobPoolOffset;
+  uint64_t blobPoolSize;
+};
+
+struct ColumnarTable
+{
+  uint64_t name;
+  uint64_t rowCount;
+  uint32_t firstColumn;
+  uint32_t columnCount;
+};
+
+struct ColumnarColumn
+{
+  uint64_t name;
+  uint64_t dataOffset;
+  SDBasic type;
+  uint32_t width;
+};
+
+RDCCOMPILE_ASSERT(sizeof(ColumnarHeader) == 64, "ColumnarHeader is mis-sized");
+RDCCOMPILE_ASSERT(sizeof(ColumnarTable) == 24, "ColumnarTable is mis-sized");
+RDCCOMPILE_ASSERT(sizeof(ColumnarColumn) == 24, "ColumnarColumn is mis-sized");
+
+static const uint64_t NoBlob = ~0ULL;
+
+static uint64_t AlignUp8(uint64_t x)
+{
+  return (x + 7) & ~7ULL;
+}
+
+// store the low width bytes of value in little-endian order, regardless of the host's byte order
+static void StoreLE(byte *dst, uint64_t value, uint32_t width)
+{
+  for(uint32_t i = 0; i < width; i++)
+    dst[i] = byte((value >> (i * 8)) & 0xff);
+}
+
+static void AppendLE(bytebuf &buf, uint64_t value, uint32_t width)
+{
+  byte bytes[8];
+  StoreLE(bytes, value, width);
+  buf.append(bytes, width);
+}
+
+struct ColumnBuilder
+{
+  rdcstr name;
+  SDBasic type;
+  uint32_t width;
+  bytebuf data;
+};
+
+struct TableBuilder
+{
+  rdcstr name;
+  uint64_t rowCount = 0;
+  rdcarray<ColumnBuilder> columns;
+  std::map<rdcstr, size_t> columnLookup;
+
+  uint64_t AddRow() { return rowCount++; }
+  void Set(const rdcstr &column, SDBasic type, uint32_t width, const void *value);
+};
+
+void TableBuilder::Set(const rdcstr &column, SDBasic type, uint32_t width, const void *value)
+{
+  rdcstr key = column;
+
+  auto it = columnLookup.find(key);
+
+  // if a path is seen with a different type than before, give it a separate column rather than
+  // mixing types within one column
+  if(it != columnLookup.end() &&
+     (columns[it->second].type != type || columns[it->second].width != width))
+  {
+    key = StringFormat::Fmt("%s:%s%u", column.c_str(), ToStr(type).c_str(), width);
+    it = columnLookup.find(key);
+  }
+
+  if(it == columnLookup.end())
+  {
+    it = columnLookup.insert(std::make_pair(key, columns.size())).first;
+    columns.push_back({key, type, width, {}});
+  }
+
+  ColumnBuilder &col = columns[it->second];
+
+  // any rows which didn't set this column are filled with zeros
+  col.data.resize(size_t(rowCount * width));
+  memcpy(col.data.data() + (rowCount - 1) * width, value, width);
+}
+
+class ColumnarExporter
+{
+public:
+  ColumnarExporter(const SDFile &structData);
+  ~ColumnarExporter();
+
+  void AddChunk(const SDChunk *chunk);
+  RDResult Write(const rdcstr &filename);
+
+private:
+  size_t GetTable(const rdcstr &name);
+  uint64_t AddString(const rdcstr &str);
+  uint64_t AddBlob(uint64_t bufferIndex);
+  uint64_t BlobLength(uint64_t offset) const;
+
+  void AddObject(size_t table, const rdcstr &path, const SDObject *obj);
+  void AddValue(size_t table, const rdcstr &column, SDBasic type, uint32_t width, uint64_t value)
+  {
+    byte bytes[8];
+    StoreLE(bytes, value, width);
+    m_Tables[table]->Set(column, type, width, bytes);
+  }
+
+  const SDFile &m_Data;
+
+  rdcarray<TableBuilder *> m_Tables;
+  std::map<rdcstr, size_t> m_TableLookup;
+
+  bytebuf m_StringPool;
+  std::map<rdcstr, uint64_t> m_StringLookup;
+
+  bytebuf m_BlobPool;
+  std::map<uint64_t, uint64_t> m_BlobIndexLookup;
+  std::multimap<uint64_t, uint64_t> m_BlobHashLookup;
+};
+
+ColumnarExporter::ColumnarExporter(const SDFile &structData) : m_Data(structData)
+{
+  GetTable("$chunks");
+}
+
+ColumnarExporter::~ColumnarExporter()
+{
+  for(TableBuilder *t : m_Tables)
+    delete t;
+}
+
+size_t ColumnarExporter::GetTable(const rdcstr &name)
+{
+  auto it = m_TableLookup.find(name);
+  if(it != m_TableLookup.end())
+    return it->second;
+
+  TableBuilder *table = new TableBuilder;
+  table->name = name;
+  m_Tables.push_back(table);
+  m_TableLookup[name] = m_Tables.size() - 1;
+  return m_Tables.size() - 1;
+}
+
+uint64_t ColumnarExporter::AddString(const rdcstr &str)
+{
+  auto it = m_StringLookup.find(str);
+  if(it != m_StringLookup.end())
+    return it->second;
+
+  uint64_t offset = m_StringPool.size();
+  AppendLE(m_StringPool, str.size(), sizeof(uint32_t));
+  m_StringPool.append((const byte *)str.c_str(), str.size() + 1);
+
+  m_StringLookup[str] = offset;
+  return offset;
+}
+
+uint64_t ColumnarExporter::AddBlob(uint64_t bufferIndex)
+{
+  if(bufferIndex >= m_Data.buffers.size() || m_Data.buffers[(size_t)bufferIndex] == NULL)
+    return NoBlob;
+
+  // buffers can be referenced many times, only store them once
+  auto it = m_BlobIndexLookup.find(bufferIndex);
+  if(it != m_BlobIndexLookup.end())
+    return it->second;
+
+  const bytebuf &buf = *m_Data.buffers[(size_t)bufferIndex];
+
+  // the same contents are often in many different buffers, e.g. data uploaded every frame, so
+  // share blobs by content too. The hash only finds candidates, which are compared in full.
+  uint64_t hash = XXH64(buf.data(), buf.size(), 0);
+
+  for(auto range = m_BlobHashLookup.equal_range(hash); range.first != range.second; ++range.first)
+  {
+    uint64_t offset = range.first->second;
+    const byte *blob = m_BlobPool.data() + offset + sizeof(uint64_t);
+
+    if(BlobLength(offset) == buf.size() && memcmp(blob, buf.data(), buf.size()) == 0)
+    {
+      m_BlobIndexLookup[bufferIndex] = offset;
+      return offset;
+    }
+  }
+
+  m_BlobPool.resize((size_t)AlignUp8(m_BlobPool.size()));
+
+  uint64_t offset = m_BlobPool.size();
+  AppendLE(m_BlobPool, buf.size(), sizeof(uint64_t));
+  m_BlobPool.append(buf);
+
+  m_BlobIndexLookup[bufferIndex] = offset;
+  m_BlobHashLookup.insert(std::make_pair(hash, offset));
+  return offset;
+}
+
+uint64_t ColumnarExporter::BlobLength(uint64_t offset) const
+{
+  uint64_t len = 0;
+  for(uint32_t i = 0; i < sizeof(uint64_t); i++)
+    len |= uint64_t(m_BlobPool[size_t(offset + i)]) << (i * 8);
+  return len;
+}
+
+void ColumnarExporter::AddChunk(const SDChunk *chunk)
+{
+  size_t table = GetTable(chunk->name);
+
+  uint64_t chunkRow = m_Tables[0]->AddRow();
+  uint64_t row = m_Tables[table]->AddRow();
+
+  AddValue(0, "id", SDBasic::UnsignedInteger, 4, chunk->metadata.chunkID);
+  AddValue(0, "name", SDBasic::String, 8, AddString(chunk->name));
+  AddValue(0, "threadID", SDBasic::UnsignedInteger, 8, chunk->metadata.threadID);
+  AddValue(0, "timestamp", SDBasic::UnsignedInteger, 8, chunk->metadata.timestampMicro);
+  AddValue(0, "duration", SDBasic::SignedInteger, 8, (uint64_t)chunk->metadata.durationMicro);
+  AddValue(0, "table", SDBasic::UnsignedInteger, 4, table);
+  AddValue(0, "row", SDBasic::UnsignedInteger, 8, row);
+
+  AddValue(table, "$chunk", SDBasic::UnsignedInteger, 8, chunkRow);
+
+  for(size_t i = 0; i < chunk->NumChildren(); i++)
+  {
+    const SDObject *child = chunk->GetChild(i);
+    AddObject(table, child->name, child);
+  }
+}
+
+void ColumnarExporter::AddObject(size_t table, const rdcstr &path, const SDObject *obj)
+{
+  uint32_t width = (uint32_t)obj->type.byteSize;
+
+  switch(obj->type.basetype)
+  {
+    case SDBasic::Chunk: RDCERR("Unexpected nested chunk"); break;
+    case SDBasic::Null: break;
+    case SDBasic::Struct:
+    {
+      for(size_t i = 0; i < obj->NumChildren(); i++)
+      {
+        const SDObject *child = obj->GetChild(i);
+        AddObject(table, path.empty() ? rdcstr(child->name) : path + "." + child->name, child);
+      }
+      break;
+    }
+    case SDBasic::Array:
+    {
+      uint64_t parentRow = m_Tables[table]->rowCount - 1;
+
+      AddValue(table, path + ".count", SDBasic::UnsignedInteger, 8, obj->NumChildren());
+
+      if(obj->NumChildren() == 0)
+        break;
+
+      size_t elTable = GetTable(m_Tables[table]->name + "/" + path);
+
+      for(size_t i = 0; i < obj->NumChildren(); i++)
+      {
+        const SDObject *el = obj->GetChild(i);
+
+        m_Tables[elTable]->AddRow();
+        AddValue(elTable, "$parent", SDBasic::UnsignedInteger, 8, parentRow);
+
+        // struct members are named directly, anything else is the element's value
+        AddObject(elTable, el->type.basetype == SDBasic::Struct ? rdcstr() : rdcstr("$value"), el);
+      }
+      break;
+    }
+    case SDBasic::Buffer:
+    {
+      AddValue(table, path, SDBasic::Buffer, 8, obj->type.byteSize);
+      AddValue(table, path + ".blob", SDBasic::UnsignedInteger, 8, AddBlob(obj->data.basic.u));
+      break;
+    }
+    case SDBasic::String:
+    {
+      AddValue(table, path, SDBasic::String, 8, AddString(obj->data.str));
+      break;
+    }
+    case SDBasic::Enum:
+    {
+      AddValue(table, path, SDBasic::Enum, RDCMAX(1U, RDCMIN(width, 8U)), obj->data.basic.u);
+      AddValue(table, path + ".str", SDBasic::String, 8, AddString(obj->data.str));
+      break;
+    }
+    case SDBasic::Resource:
+    case SDBasic::UnsignedInteger:
+    case SDBasic::SignedInteger:
+    {
+      // values are stored with their sign bits so the low bytes are the value at any width
+      if(width != 1 && width != 2 && width != 4)
+        width = 8;
+      AddValue(table, path, obj->type.basetype, width, obj->data.basic.u);
+      break;
+    }
+    case SDBasic::Float:
+    {
+      // floats are stored as their IEEE bits, in the same byte order as everything else
+      if(width == 4)
+      {
+        float f = (float)obj->data.basic.d;
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        AddValue(table, path, SDBasic::Float, 4, bits);
+      }
+      else
+      {
+        uint64_t bits;
+        memcpy(&bits, &obj->data.basic.d, sizeof(bits));
+        AddValue(table, path, SDBasic::Float, 8, bits);
+      }
+      break;
+    }
+    case SDBasic::Boolean:
+    {
+      AddValue(table, path, SDBasic::Boolean, 1, obj->data.basic.b ? 1 : 0);
+      break;
+    }
+    case SDBasic::Character:
+    {
+      AddValue(table, path, SDBasic::Character, 1, (uint8_t)obj->data.basic.c);
+      break;
+    }
+  }
+}
+
+RDResult ColumnarExporter::Write(const rdcstr &filename)
+{
+  // all names must be in the string pool before we know where the pools go
+  rdcarray<ColumnarTable> tables;
+  rdcarray<ColumnarColumn> columns;
+
+  for(TableBuilder *t : m_Tables)
+  {
+    ColumnarTable table = {};
+    table.name = AddString(t->name);
+    table.rowCount = t->rowCount;
+    table.firstColumn = (uint32_t)columns.size();
+    table.columnCount = (uint32_t)t->columns.size();
+    tables.push_back(table);
+
+    for(ColumnBuilder &c : t->columns)
+    {
+      // pad out columns that weren't set in the last rows
+      c.data.resize(size_t(t->rowCount * c.width));
+
+      ColumnarColumn col = {};
+      col.name = AddString(c.name);
+      col.type = c.type;
+      col.width = c.width;
+      columns.push_back(col);
+    }
+  }
+
+  ColumnarHeader header = {};
+  memcpy(header.magic, ColumnarMagic, sizeof(ColumnarMagic));
+  header.version = ColumnarVersion;
+  header.tableCount = (uint32_t)tables.size();
+  header.tableOffset = sizeof(ColumnarHeader);
+  header.columnOffset = header.tableOffset + tables.byteSize();
+
+  uint64_t offset = header.columnOffset + columns.byteSize();
+
+  size_t c = 0;
+  for(TableBuilder *t : m_Tables)
+  {
+    for(const ColumnBuilder &col : t->columns)
+    {
+      columns[c++].dataOffset = offset;
+      offset = AlignUp8(offset + col.data.size());
+    }
+  }
+
+  header.stringPoolOffset = offset;
+  header.stringPoolSize = m_StringPool.size();
+  header.blobPoolOffset = AlignUp8(header.stringPoolOffset + header.stringPoolSize);
+  header.blobPoolSize = m_BlobPool.size();
+
+  FILE *f = FileIO::fopen(filename, FileIO::WriteBinary);
+
+  if(!f)
+    RETURN_ERROR_RESULT(ResultCode::FileIOFailed, "Failed to open '%s' for write: %s",
+                        filename.c_str(), FileIO::ErrorString().c_str());
+
+  StreamWriter writer(f, Ownership::Stream);
+
+  const byte padding[8] = {};
+
+  writer.Write(header);
+  writer.Write(tables.data(), tables.byteSize());
+  writer.Write(columns.data(), columns.byteSize());
+
+  for(TableBuilder *t : m_Tables)
+  {
+    for(const ColumnBuilder &col : t->columns)
+    {
+      writer.Write(col.data.data(), col.data.size());
+      writer.Write(padding, AlignUp8(col.data.size()) - col.data.size());
+    }
+  }
+
+  writer.Write(m_StringPool.data(), m_StringPool.size());
+  writer.Write(padding, header.blobPoolOffset - header.stringPoolOffset - header.stringPoolSize);
+  writer.Write(m_BlobPool.data(), m_BlobPool.size());
+
+  writer.Finish();
+
+  return writer.GetError();
+}
+
+RDResult exportColumnar(const rdcstr &filename, const RDCFile &rdc, const SDFile &structData,
+                        RENDERDOC_ProgressCallback progress)
+{
+  ColumnarExporter exporter(structData);
+
+  for(size_t i = 0; i < structData.chunks.size(); i++)
+  {
+    exporter.AddChunk(structData.chunks[i]);
+
+    if(progress)
+      progress(0.9f * float(i) / float(structData.chunks.size()));
+  }
+
+  RDResult ret = exporter.Write(filename);
+
+  if(progress)
+    progress(1.0f);
+
+  return ret;
+}
+
+static ConversionRegistration ColumnarConversionRegistration(
+    &exportColumnar,
+    {
+        "columns.bin", "Columnar binary tables",
+        R"(Stores the structured data as tables of fixed-width columns, one table per type of chunk, with
+pooled strings and buffers. Designed to be memory mapped for bulk analysis.)",
+        false,
+    });
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+
+TEST_CASE("Columnar structured data export", "[columnar]")
+{
+  rdcstr filename = FileIO::GetTempFolderFilename() + "renderdoc_columnar_test.columns.bin";
+
+  RDCFile rdc;
+  rdc.SetData(RDCDriver::Vulkan, "Vulkan", 1234, NULL, 0, 1.0);
+
+  SDFile sdfile;
+  // the first two buffers have the same contents
+  sdfile.buffers.push_back(new bytebuf({1, 2, 3, 4, 5}));
+  sdfile.buffers.push_back(new bytebuf({1, 2, 3, 4, 5}));
+  sdfile.buffers.push_back(new bytebuf({9, 9}));
+
+  for(uint32_t i = 0; i < 10; i++)
+  {
+    SDChunk *chunk = new SDChunk(i % 2 ? "Draw"_lit : "Upload"_lit);
+    chunk->metadata.chunkID = 100 + i;
+    chunk->metadata.timestampMicro = 1000 + i;
+
+    if(i % 2)
+    {
+      SDObject *params = chunk->AddAndOwnChild(makeSDStruct("params"_lit, "DrawParams"_lit));
+      params->AddAndOwnChild(makeSDUInt32("count"_lit, i * 3));
+      params->AddAndOwnChild(makeSDFloat("scale"_lit, 0.5f));
+
+      SDObject *arr = chunk->AddAndOwnChild(makeSDArray("indices"_lit));
+      for(uint32_t e = 0; e < i; e++)
+        arr->AddAndOwnChild(makeSDUInt32("$el"_lit, e));
+    }
+    else
+    {
+      chunk->AddAndOwnChild(makeSDString("label"_lit, i == 0 ? "first" : "other"));
+
+      // uploads use buffers 0, 1, 2, 0, 1
+      uint64_t bufIdx = (i / 2) % 3;
+
+      SDObject *buf = chunk->AddAndOwnChild(new SDObject("data"_lit, "Byte Buffer"_lit));
+      buf->type.basetype = SDBasic::Buffer;
+      buf->type.byteSize = sdfile.buffers[(size_t)bufIdx]->size();
+      buf->data.basic.u = bufIdx;
+    }
+
+    sdfile.chunks.push_back(chunk);
+  }
+
+  REQUIRE(exportColumnar(filename, rdc, sdfile, NULL).code == ResultCode::Succeeded);
+
+  bytebuf contents;
+  REQUIRE(FileIO::ReadAll(filename, contents));
+  FileIO::Delete(filename);
+
+  REQUIRE(contents.size() >= sizeof(ColumnarHeader));
+
+  const byte *base = contents.data();
+  const ColumnarHeader &header = *(const ColumnarHeader *)base;
+
+  CHECK(memcmp(header.magic, ColumnarMagic, sizeof(ColumnarMagic)) == 0);
+  CHECK(header.version == ColumnarVersion);
+  REQUIRE(header.blobPoolOffset + header.blobPoolSize == contents.size());
+
+  const ColumnarTable *tables = (const ColumnarTable *)(base + header.tableOffset);
+  const ColumnarColumn *columns = (const ColumnarColumn *)(base + header.columnOffset);
+
+  auto getString = [&](uint64_t offs) {
+    return rdcstr((const char *)(base + header.stringPoolOffset + offs + sizeof(uint32_t)));
+  };
+
+  auto findTable = [&](const rdcstr &name) -> const ColumnarTable * {
+    for(uint32_t t = 0; t < header.tableCount; t++)
+      if(getString(tables[t].name) == name)
+        return &tables[t];
+    return NULL;
+  };
+
+  auto findColumn = [&](const ColumnarTable *table, const rdcstr &name) -> const ColumnarColumn * {
+    for(uint32_t c = 0; c < table->columnCount; c++)
+      if(getString(columns[table->firstColumn + c].name) == name)
+        return &columns[table->firstColumn + c];
+    return NULL;
+  };
+
+  // $chunks, Upload, Draw, Draw/indices
+  REQUIRE(header.tableCount == 4);
+  CHECK(getString(tables[0].name) == "$chunks");
+  CHECK(tables[0].rowCount == 10);
+
+  const ColumnarColumn *ids = findColumn(&tables[0], "id");
+  REQUIRE(ids);
+  CHECK(ids->width == 4);
+  CHECK(((const uint32_t *)(base + ids->dataOffset))[7] == 107);
+
+  const ColumnarTable *draws = findTable("Draw");
+  REQUIRE(draws);
+  CHECK(draws->rowCount == 5);
+
+  const ColumnarColumn *count = findColumn(draws, "params.count");
+  REQUIRE(count);
+  CHECK(count->type == SDBasic::UnsignedInteger);
+  CHECK(((const uint32_t *)(base + count->dataOffset))[2] == 15);
+
+  const ColumnarColumn *scale = findColumn(draws, "params.scale");
+  REQUIRE(scale);
+  CHECK(scale->width == 4);
+  CHECK(((const float *)(base + scale->dataOffset))[4] == 0.5f);
+
+  // the first draw has 1 index, the second 3, etc
+  const ColumnarTable *indices = findTable("Draw/indices");
+  REQUIRE(indices);
+  CHECK(indices->rowCount == 1 + 3 + 5 + 7 + 9);
+
+  const ColumnarColumn *parent = findColumn(indices, "$parent");
+  const ColumnarColumn *value = findColumn(indices, "$value");
+  REQUIRE(parent);
+  REQUIRE(value);
+  CHECK(((const uint64_t *)(base + parent->dataOffset))[3] == 1);
+  CHECK(((const uint32_t *)(base + value->dataOffset))[3] == 2);
+
+  const ColumnarTable *uploads = findTable("Upload");
+  REQUIRE(uploads);
+
+  const ColumnarColumn *label = findColumn(uploads, "label");
+  REQUIRE(label);
+  CHECK(getString(((const uint64_t *)(base + label->dataOffset))[0]) == "first");
+  CHECK(getString(((const uint64_t *)(base + label->dataOffset))[1]) == "other");
+
+  const ColumnarColumn *blob = findColumn(uploads, "data.blob");
+  REQUIRE(blob);
+  uint64_t blobOffset = ((const uint64_t *)(base + blob->dataOffset))[0];
+  REQUIRE(blobOffset != NoBlob);
+  CHECK(*(const uint64_t *)(base + header.blobPoolOffset + blobOffset) == 5);
+  CHECK(base[header.blobPoolOffset + blobOffset + sizeof(uint64_t) + 4] == 5);
+
+  // the same contents are only stored once, whichever buffer they're in
+  const uint64_t *blobOffsets = (const uint64_t *)(base + blob->dataOffset);
+  CHECK(blobOffsets[1] == blobOffset);
+  CHECK(blobOffsets[2] != blobOffset);
+  CHECK(blobOffsets[3] == blobOffset);
+  CHECK(blobOffsets[4] == blobOffset);
+  CHECK(*(const uint64_t *)(base + header.blobPoolOffset + blobOffsets[2]) == 2);
+  CHECK(header.blobPoolSize == AlignUp8(sizeof(uint64_t) + 5) + sizeof(uint64_t) + 2);
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -69,6 +69,7 @@ struct xml_file_writer : pugi::xml_writer
   }
 
   void write(const void *data, size_t size) { stream.Write(data, size); }
+  void write_string(const rdcstr &str) { stream.Write(str.c_str(), str.size()); }
 };
 
 // avoid &, <, and > since they throw off the ascii alignment
@@ -284,15 +285,67 @@ static void Obj2XML(pugi::xml_node &parent, SDObject &child)
   }
 }
 
+static void Chunk2XML(pugi::xml_node &parent, SDChunk *chunk)
+{
+  pugi::xml_node xChunk = parent.append_child("chunk");
+
+  xChunk.append_attribute("id") = chunk->metadata.chunkID;
+  xChunk.append_attribute("name") = chunk->name.c_str();
+  xChunk.append_attribute("length") = chunk->metadata.length;
+  if(chunk->metadata.threadID)
+    xChunk.append_attribute("threadID") = chunk->metadata.threadID;
+  if(chunk->metadata.timestampMicro)
+    xChunk.append_attribute("timestamp") = chunk->metadata.timestampMicro;
+  if(chunk->metadata.durationMicro >= 0)
+    xChunk.append_attribute("duration") = chunk->metadata.durationMicro;
+  if(chunk->metadata.flags & SDChunkFlags::HasCallstack)
+  {
+    pugi::xml_node stack = xChunk.append_child("callstack");
+
+    for(size_t i = 0; i < chunk->metadata.callstack.size(); i++)
+    {
+      stack.append_child("address").text() = chunk->metadata.callstack[i];
+    }
+  }
+
+  if(chunk->metadata.flags & SDChunkFlags::OpaqueChunk)
+  {
+    xChunk.append_attribute("opaque") = true;
+
+    RDCASSERT(chunk->NumChildren() > 0);
+    pugi::xml_node opaque = xChunk.append_child("buffer");
+    opaque.append_attribute("byteLength") = chunk->GetChild(0)->type.byteSize;
+    opaque.text() = chunk->GetChild(0)->data.basic.u;
+  }
+  else
+  {
+    for(size_t o = 0; o < chunk->NumChildren(); o++)
+      Obj2XML(xChunk, *chunk->GetChild(o));
+  }
+}
+
+// write out the nodes in a partial document at the given depth, identically to how they'd be written
+// if they were part of the full document.
+static void WriteXMLNodes(xml_file_writer &writer, const pugi::xml_document &doc, unsigned int depth)
+{
+  for(pugi::xml_node node = doc.first_child(); node; node = node.next_sibling())
+    node.print(writer, "\t", pugi::format_default, pugi::encoding_auto, depth);
+}
+
 static RDResult Structured2XML(const rdcstr &filename, const RDCFile &file, uint64_t version,
                                const StructuredChunkList &chunks, RENDERDOC_ProgressCallback progress)
 {
-  pugi::xml_document doc;
+  xml_file_writer writer(filename);
 
-  pugi::xml_node xRoot = doc.append_child("rdc");
+  // we don't build a document for the whole capture as that can be many times larger than the
+  // capture itself. Instead each node directly under the root is built in its own document and
+  // written out before moving onto the next, and the root and <chunks> tags are written by hand.
+  writer.write_string("<?xml version=\"1.0\"?>\n<rdc>\n");
 
   {
-    pugi::xml_node xHeader = xRoot.append_child("header");
+    pugi::xml_document doc;
+
+    pugi::xml_node xHeader = doc.append_child("header");
 
     pugi::xml_node xDriver = xHeader.append_child("driver");
     xDriver.append_attribute("id") = (uint32_t)file.GetDriver();
@@ -324,6 +377,8 @@ static RDResult Structured2XML(const rdcstr &filename, const RDCFile &file, uint
 
     xTimebase.append_attribute("base") = file.GetTimestampBase();
     xTimebase.append_attribute("frequency") = file.GetTimestampFrequency();
+
+    WriteXMLNodes(writer, doc, 1);
   }
 
   if(progress)
@@ -334,9 +389,12 @@ static RDResult Structured2XML(const rdcstr &filename, const RDCFile &file, uint
   {
     const SectionProperties &props = file.GetSectionProperties(i);
 
-    if(props.type == SectionType::FrameCapture)
+    // the block index is regenerated as sections are written
+    if(props.type == SectionType::FrameCapture || props.type == SectionType::BlockIndex)
       continue;
 
+    pugi::xml_document doc;
+
     StreamReader *reader = file.ReadSection(i);
 
     if(props.type == SectionType::ExtendedThumbnail)
@@ -348,7 +406,7 @@ static RDResult Structured2XML(const rdcstr &filename, const RDCFile &file, uint
         bool succeeded = reader->SkipBytes(thumbHeader.len) && !reader->IsErrored();
         if(succeeded && (uint32_t)thumbHeader.format < (uint32_t)FileType::Count)
         {
-          pugi::xml_node xExtThumbnail = xRoot.append_child("extended_thumbnail");
+          pugi::xml_node xExtThumbnail = doc.append_child("extended_thumbnail");
 
           xExtThumbnail.append_attribute("width") = thumbHeader.width;
           xExtThumbnail.append_attribute("height") = thumbHeader.height;
@@ -365,19 +423,23 @@ static RDResult Structured2XML(const rdcstr &filename, const RDCFile &file, uint
         }
       }
 
+      WriteXMLNodes(writer, doc, 1);
+
       delete reader;
       continue;
     }
     else if(props.type == SectionType::EmbeddedLogfile)
     {
-      pugi::xml_node xLogfile = xRoot.append_child("diagnostic_log");
+      pugi::xml_node xLogfile = doc.append_child("diagnostic_log");
       xLogfile.text() = "diagnostic.log";
 
+      WriteXMLNodes(writer, doc, 1);
+
       delete reader;
       continue;
     }
 
-    pugi::xml_node xSection = xRoot.append_child("section");
+    pugi::xml_node xSection = doc.append_child("section");
 
     if(props.flags & SectionFlags::ASCIIStored)
       xSection.append_attribute("ascii");
@@ -415,61 +477,41 @@ static RDResult Structured2XML(const rdcstr &filename, const RDCFile &file, uint
       data.text().set(hexdata.c_str());
     }
 
+    WriteXMLNodes(writer, doc, 1);
+
     delete reader;
   }
 
   if(progress)
     progress(StructuredProgress(0.2f));
 
-  pugi::xml_node xChunks = xRoot.append_child("chunks");
-
-  xChunks.append_attribute("version") = version;
-
-  for(size_t c = 0; c < chunks.size(); c++)
+  if(chunks.empty())
   {
-    pugi::xml_node xChunk = xChunks.append_child("chunk");
-    SDChunk *chunk = chunks[c];
-
-    xChunk.append_attribute("id") = chunk->metadata.chunkID;
-    xChunk.append_attribute("name") = chunk->name.c_str();
-    xChunk.append_attribute("length") = chunk->metadata.length;
-    if(chunk->metadata.threadID)
-      xChunk.append_attribute("threadID") = chunk->metadata.threadID;
-    if(chunk->metadata.timestampMicro)
-      xChunk.append_attribute("timestamp") = chunk->metadata.timestampMicro;
-    if(chunk->metadata.durationMicro >= 0)
-      xChunk.append_attribute("duration") = chunk->metadata.durationMicro;
-    if(chunk->metadata.flags & SDChunkFlags::HasCallstack)
-    {
-      pugi::xml_node stack = xChunk.append_child("callstack");
+    pugi::xml_document doc;
+    doc.append_child("chunks").append_attribute("version") = version;
+    WriteXMLNodes(writer, doc, 1);
+  }
+  else
+  {
+    writer.write_string(StringFormat::Fmt("\t<chunks version=\"%llu\">\n", version));
 
-      for(size_t i = 0; i < chunk->metadata.callstack.size(); i++)
-      {
-        stack.append_child("address").text() = chunk->metadata.callstack[i];
-      }
-    }
+    pugi::xml_document doc;
 
-    if(chunk->metadata.flags & SDChunkFlags::OpaqueChunk)
+    for(size_t c = 0; c < chunks.size(); c++)
     {
-      xChunk.append_attribute("opaque") = true;
+      // reset the document each time so we only hold one chunk's nodes in memory
+      doc.reset();
+      Chunk2XML(doc, chunks[c]);
+      WriteXMLNodes(writer, doc, 2);
 
-      RDCASSERT(chunk->NumChildren() > 0);
-      pugi::xml_node opaque = xChunk.append_child("buffer");
-      opaque.append_attribute("byteLength") = chunk->GetChild(0)->type.byteSize;
-      opaque.text() = chunk->GetChild(0)->data.basic.u;
-    }
-    else
-    {
-      for(size_t o = 0; o < chunk->NumChildren(); o++)
-        Obj2XML(xChunk, *chunk->GetChild(o));
+      if(progress)
+        progress(StructuredProgress(0.2f + 0.8f * (float(c) / float(chunks.size()))));
     }
 
-    if(progress)
-      progress(StructuredProgress(0.2f + 0.8f * (float(c) / float(chunks.size()))));
+    writer.write_string("\t</chunks>\n");
   }
 
-  xml_file_writer writer(filename);
-  doc.save(writer);
+  writer.write_string("</rdc>\n");
 
   return writer.stream.GetError();
 }
@@ -576,20 +618,185 @@ static SDObject *XML2Obj(pugi::xml_node &obj)
   return ret;
 }
 
-static RDResult XML2Structured(const rdcstr &xml, const ThumbTypeAndData &thumb,
-                               const ThumbTypeAndData &extThumb, const bytebuf &logfile,
-                               const StructuredBufferList &buffers, RDCFile *rdc, uint64_t &version,
-                               StructuredChunkList &chunks, RENDERDOC_ProgressCallback progress)
+// Splits an xml capture into the prelude - the header and sections - and then each <chunk> element
+// in turn, reading from the stream only as much as is needed. This means only one chunk's worth of
+// xml is in memory and parsed at any time, rather than the whole document.
+class XMLChunkSplitter
 {
-  pugi::xml_document doc;
-  doc.load_string(xml.c_str());
+public:
+  XMLChunkSplitter(StreamReader &reader) : m_Reader(reader) {}
+  // reads everything up to the <chunks> element, returning the text before it and the start tag
+  bool ReadPrelude(rdcstr &prelude, rdcstr &chunksTag);
+  // returns the next <chunk> element, which remains valid until the next call. At the closing
+  // </chunks> tag this succeeds with an empty element.
+  bool NextChunk(const char *&element, size_t &length);
+  float GetProgress() { return float(m_Reader.GetOffset()) / float(RDCMAX((uint64_t)1, m_Reader.GetSize())); }
+
+private:
+  static const size_t NotFound = ~0U;
+  static const size_t BlockSize = 1024 * 1024;
+
+  bool Fill();
+  size_t Find(const char *needle, size_t from);
+  bool IsTag(size_t offs, const char *tag);
+  size_t Available() { return m_Buffer.size() - m_Pos; }
+
+  StreamReader &m_Reader;
+  rdcstr m_Buffer;
+  size_t m_Pos = 0;
+};
+
+bool XMLChunkSplitter::Fill()
+{
+  uint64_t remaining = m_Reader.GetSize() - m_Reader.GetOffset();
 
-  pugi::xml_node root = doc.child("rdc");
+  if(remaining == 0 || m_Reader.IsErrored())
+    return false;
 
-  if(!root)
-    RETURN_ERROR_RESULT(ResultCode::FileCorrupted,
-                        "Malformed xml document, couldn't get root <rdc> node");
+  // discard what has already been consumed, offsets are all relative to m_Pos so stay valid
+  m_Buffer.erase(0, m_Pos);
+  m_Pos = 0;
+
+  size_t oldSize = m_Buffer.size();
+  size_t readSize = (size_t)RDCMIN(remaining, (uint64_t)BlockSize);
+  m_Buffer.resize(oldSize + readSize);
+
+  return m_Reader.Read(m_Buffer.data() + oldSize, readSize);
+}
 
+size_t XMLChunkSplitter::Find(const char *needle, size_t from)
+{
+  size_t len = strlen(needle);
+
+  for(;;)
+  {
+    int32_t idx = m_Buffer.find(needle, int32_t(m_Pos + from));
+    if(idx >= 0)
+      return size_t(idx) - m_Pos;
+
+    // don't search again what we've already searched, except for a possible partial match at the end
+    if(Available() >= len)
+      from = RDCMAX(from, Available() - len + 1);
+
+    if(!Fill())
+      return NotFound;
+  }
+}
+
+bool XMLChunkSplitter::IsTag(size_t offs, const char *tag)
+{
+  size_t len = strlen(tag);
+
+  // we need one character past the tag name to be sure it's not a longer name
+  while(Available() < offs + len + 1)
+    if(!Fill())
+      return false;
+
+  const char *str = m_Buffer.c_str() + m_Pos + offs;
+  if(strncmp(str, tag, len) != 0)
+    return false;
+
+  char c = str[len];
+  return c == '>' || c == '/' || c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+bool XMLChunkSplitter::ReadPrelude(rdcstr &prelude, rdcstr &chunksTag)
+{
+  // any < in text or attributes is escaped so the first instance of the tag is the real one
+  size_t start = 0;
+  for(;;)
+  {
+    start = Find("<chunks", start);
+    if(start == NotFound)
+      return false;
+
+    if(IsTag(start, "<chunks"))
+      break;
+
+    start++;
+  }
+
+  size_t end = Find(">", start);
+  if(end == NotFound)
+    return false;
+
+  prelude = m_Buffer.substr(m_Pos, start);
+  chunksTag = m_Buffer.substr(m_Pos + start, end + 1 - start);
+  m_Pos += end + 1;
+
+  return true;
+}
+
+bool XMLChunkSplitter::NextChunk(const char *&element, size_t &length)
+{
+  element = NULL;
+  length = 0;
+
+  for(;;)
+  {
+    // skip whitespace between elements
+    while(Available() > 0 && isspace(m_Buffer[m_Pos]))
+      m_Pos++;
+
+    if(Available() == 0)
+    {
+      if(!Fill())
+        return false;
+      continue;
+    }
+
+    while(Available() < 4)
+      if(!Fill())
+        break;
+
+    // skip any comments
+    if(!strncmp(m_Buffer.c_str() + m_Pos, "<!--", 4))
+    {
+      size_t end = Find("-->", 4);
+      if(end == NotFound)
+        return false;
+      m_Pos += end + 3;
+      continue;
+    }
+
+    break;
+  }
+
+  if(IsTag(0, "</chunks"))
+    return true;
+
+  if(!IsTag(0, "<chunk"))
+    return false;
+
+  size_t end = Find(">", 0);
+  if(end == NotFound)
+    return false;
+
+  // if the chunk isn't self-closing find its end tag. Chunks can't be nested so the first end tag is
+  // the right one.
+  if(m_Buffer[m_Pos + end - 1] == '/')
+  {
+    end++;
+  }
+  else
+  {
+    end = Find("</chunk>", end);
+    if(end == NotFound)
+      return false;
+    end += 8;
+  }
+
+  element = m_Buffer.c_str() + m_Pos;
+  length = end;
+  m_Pos += end;
+
+  return true;
+}
+
+static RDResult XML2Header(pugi::xml_node root, const ThumbTypeAndData &thumb,
+                           const ThumbTypeAndData &extThumb, const bytebuf &logfile, RDCFile *rdc,
+                           RENDERDOC_ProgressCallback progress)
+{
   pugi::xml_node xHeader = root.first_child();
 
   if(strcmp(xHeader.name(), "header") != 0)
@@ -765,78 +972,167 @@ static RDResult XML2Structured(const rdcstr &xml, const ThumbTypeAndData &thumb,
     xSection = xSection.next_sibling();
   }
 
+  // the header should only be followed by sections, the chunks are processed separately
+  if(xSection)
+    RETURN_ERROR_RESULT(ResultCode::FileCorrupted,
+                        "Malformed xml document, expected <chunks> node, got <%s>", xSection.name());
+
   if(progress)
     progress(StructuredProgress(0.2f));
 
-  pugi::xml_node xChunks = xSection;
+  return ResultCode::Succeeded;
+}
 
-  if(strcmp(xSection.name(), "chunks") != 0)
+static RDResult XML2Chunk(pugi::xml_node xChunk, StructuredChunkList &chunks)
+{
+  if(strcmp(xChunk.name(), "chunk") != 0)
     RETURN_ERROR_RESULT(ResultCode::FileCorrupted,
-                        "Malformed xml document, expected <chunks> node, got <%s>", xSection.name());
+                        "Malformed xml document, expected <chunk> child under <chunks>, got <%s>",
+                        xChunk.name());
+
+  SDChunk *chunk = new SDChunk(rdcstr(xChunk.attribute("name").as_string()));
+
+  chunk->metadata.chunkID = xChunk.attribute("id").as_uint();
+  chunk->metadata.length = xChunk.attribute("length").as_uint();
+  if(xChunk.attribute("threadID"))
+    chunk->metadata.threadID = xChunk.attribute("threadID").as_ullong();
+  if(xChunk.attribute("timestamp"))
+    chunk->metadata.timestampMicro = xChunk.attribute("timestamp").as_ullong();
+  if(xChunk.attribute("duration"))
+    chunk->metadata.durationMicro = xChunk.attribute("duration").as_ullong();
+
+  pugi::xml_node callstack = xChunk.child("callstack");
+  if(callstack)
+  {
+    chunk->metadata.flags |= SDChunkFlags::HasCallstack;
+
+    size_t i = 0;
+    for(pugi::xml_node address = callstack.first_child(); address; address = address.next_sibling())
+    {
+      chunk->metadata.callstack.push_back(address.text().as_ullong());
+      i++;
+    }
+  }
+
+  if(xChunk.attribute("opaque"))
+  {
+    pugi::xml_node opaque = xChunk.child("buffer");
+
+    chunk->metadata.flags |= SDChunkFlags::OpaqueChunk;
+
+    SDObject *buf = chunk->AddAndOwnChild(new SDObject("Opaque chunk"_lit, "Byte Buffer"_lit));
+    buf->type.basetype = SDBasic::Buffer;
+    buf->type.byteSize = opaque.attribute("byteLength").as_ullong();
+    buf->data.basic.u = opaque.text().as_ullong();
+  }
+  else
+  {
+    for(pugi::xml_node child = xChunk.first_child(); child; child = child.next_sibling())
+    {
+      // the callstack was processed above, it's metadata and not part of the chunk's contents.
+      // Older builds also imported it as a child here. That gave every chunk with a callstack an
+      // extra unnamed object with the Chunk basetype, which hit the nested chunk fatal error if
+      // the imported file was exported again.
+      if(child == callstack)
+        continue;
+
+      chunk->AddAndOwnChild(XML2Obj(child));
+    }
+  }
+
+  chunks.push_back(chunk);
+
+  return ResultCode::Succeeded;
+}
+
+static RDResult XML2Structured(StreamReader &reader, const ThumbTypeAndData &thumb,
+                               const ThumbTypeAndData &extThumb, const bytebuf &logfile,
+                               const StructuredBufferList &buffers, RDCFile *rdc, uint64_t &version,
+                               StructuredChunkList &chunks, RENDERDOC_ProgressCallback progress)
+{
+  XMLChunkSplitter splitter(reader);
+
+  rdcstr prelude, chunksTag;
+  if(!splitter.ReadPrelude(prelude, chunksTag))
+  {
+    if(reader.IsErrored())
+      return reader.GetError();
 
-  if(!xChunks.attribute("version"))
     RETURN_ERROR_RESULT(ResultCode::FileCorrupted,
-                        "Malformed xml document, expected version attribute");
+                        "Malformed xml document, couldn't find <chunks> node");
+  }
 
-  version = xChunks.attribute("version").as_ullong();
+  // close off the root so the header and sections can be parsed as a document of their own
+  prelude += "</rdc>";
 
-  size_t chunkIdx = 0;
-  size_t numChunks = std::distance(xChunks.begin(), xChunks.end());
+  {
+    pugi::xml_document doc;
+    doc.load_buffer(prelude.c_str(), prelude.size());
+
+    pugi::xml_node root = doc.child("rdc");
+
+    if(!root)
+      RETURN_ERROR_RESULT(ResultCode::FileCorrupted,
+                          "Malformed xml document, couldn't get root <rdc> node");
+
+    RDResult res = XML2Header(root, thumb, extThumb, logfile, rdc, progress);
+    if(res != ResultCode::Succeeded)
+      return res;
+  }
+
+  bool selfClosing = chunksTag.size() >= 2 && chunksTag[chunksTag.size() - 2] == '/';
 
-  for(pugi::xml_node xChunk = xChunks.first_child(); xChunk; xChunk = xChunk.next_sibling())
   {
-    if(strcmp(xChunk.name(), "chunk") != 0)
+    if(!selfClosing)
+      chunksTag += "</chunks>";
+
+    pugi::xml_document doc;
+    doc.load_buffer(chunksTag.c_str(), chunksTag.size());
+
+    pugi::xml_node xChunks = doc.child("chunks");
+
+    if(!xChunks.attribute("version"))
       RETURN_ERROR_RESULT(ResultCode::FileCorrupted,
-                          "Malformed xml document, expected <chunk> child under <chunks>, got <%s>",
-                          xChunk.name());
-
-    SDChunk *chunk = new SDChunk(rdcstr(xChunk.attribute("name").as_string()));
-
-    chunk->metadata.chunkID = xChunk.attribute("id").as_uint();
-    chunk->metadata.length = xChunk.attribute("length").as_uint();
-    if(xChunk.attribute("threadID"))
-      chunk->metadata.threadID = xChunk.attribute("threadID").as_ullong();
-    if(xChunk.attribute("timestamp"))
-      chunk->metadata.timestampMicro = xChunk.attribute("timestamp").as_ullong();
-    if(xChunk.attribute("duration"))
-      chunk->metadata.durationMicro = xChunk.attribute("duration").as_ullong();
-
-    pugi::xml_node callstack = xChunk.child("callstack");
-    if(callstack)
-    {
-      chunk->metadata.flags |= SDChunkFlags::HasCallstack;
+                          "Malformed xml document, expected version attribute");
 
-      size_t i = 0;
-      for(pugi::xml_node address = callstack.first_child(); address; address = address.next_sibling())
-      {
-        chunk->metadata.callstack.push_back(address.text().as_ullong());
-        i++;
-      }
-    }
+    version = xChunks.attribute("version").as_ullong();
+  }
 
-    if(xChunk.attribute("opaque"))
-    {
-      pugi::xml_node opaque = xChunk.child("buffer");
+  if(selfClosing)
+    return ResultCode::Succeeded;
 
-      chunk->metadata.flags |= SDChunkFlags::OpaqueChunk;
+  pugi::xml_document doc;
 
-      SDObject *buf = chunk->AddAndOwnChild(new SDObject("Opaque chunk"_lit, "Byte Buffer"_lit));
-      buf->type.basetype = SDBasic::Buffer;
-      buf->type.byteSize = opaque.attribute("byteLength").as_ullong();
-      buf->data.basic.u = opaque.text().as_ullong();
-    }
-    else
+  for(;;)
+  {
+    const char *element = NULL;
+    size_t length = 0;
+    if(!splitter.NextChunk(element, length))
     {
-      for(pugi::xml_node child = xChunk.first_child(); child; child = child.next_sibling())
-        chunk->AddAndOwnChild(XML2Obj(child));
+      if(reader.IsErrored())
+        return reader.GetError();
+
+      RETURN_ERROR_RESULT(ResultCode::FileCorrupted,
+                          "Malformed xml document, expected <chunk> child under <chunks>");
     }
 
-    chunks.push_back(chunk);
+    // reached </chunks>
+    if(length == 0)
+      break;
 
-    if(progress)
-      progress(StructuredProgress(0.2f + 0.8f * (float(chunkIdx) / float(numChunks))));
+    pugi::xml_parse_result parsed =
+        doc.load_buffer(element, length, pugi::parse_default, pugi::encoding_utf8);
+
+    if(!parsed)
+      RETURN_ERROR_RESULT(ResultCode::FileCorrupted, "Malformed xml document, chunk %u: %s",
+                          (uint32_t)chunks.size(), parsed.description());
+
+    RDResult res = XML2Chunk(doc.first_child(), chunks);
+    if(res != ResultCode::Succeeded)
+      return res;
 
-    chunkIdx++;
+    if(progress)
+      progress(StructuredProgress(0.2f + 0.8f * splitter.GetProgress()));
   }
 
   return ResultCode::Succeeded;
@@ -966,9 +1262,8 @@ static RDResult ZIP2Buffers(const rdcstr &filename, ThumbTypeAndData &thumb,
       mz_zip_archive_file_stat zstat;
       mz_zip_reader_file_stat(&zip, i, &zstat);
 
-      size_t sz = 0;
-
-      byte *buf = (byte *)mz_zip_reader_extract_to_heap(&zip, i, &sz, 0);
+      // decompress straight into the destination rather than going via a temporary heap allocation
+      bytebuf *dst = NULL;
 
       // thumbnails are stored separately
       if(strstr(zstat.m_filename, "thumb"))
@@ -982,18 +1277,18 @@ static RDResult ZIP2Buffers(const rdcstr &filename, ThumbTypeAndData &thumb,
         if(strstr(zstat.m_filename, "ext_thumb"))
         {
           extThumb.format = type;
-          extThumb.data.assign(buf, sz);
+          dst = &extThumb.data;
         }
         else
         {
           thumb.format = type;
-          thumb.data.assign(buf, sz);
+          dst = &thumb.data;
         }
       }
       else if(strstr(zstat.m_filename, "diagnostic.log"))
       {
         // same for logfile
-        logfile.assign(buf, sz);
+        dst = &logfile;
       }
       else
       {
@@ -1002,11 +1297,20 @@ static RDResult ZIP2Buffers(const rdcstr &filename, ThumbTypeAndData &thumb,
         if(bufname < (int)buffers.size())
         {
           buffers[bufname] = new bytebuf;
-          buffers[bufname]->assign(buf, sz);
+          dst = buffers[bufname];
         }
       }
 
-      free(buf);
+      if(dst)
+      {
+        dst->resize((size_t)zstat.m_uncomp_size);
+        if(!mz_zip_reader_extract_to_mem(&zip, i, dst->data(), dst->size(), 0))
+        {
+          RDCERR("Failed to extract %s from zip: %s", zstat.m_filename,
+                 mz_zip_get_error_string(zip.m_last_error));
+          dst->clear();
+        }
+      }
 
       if(progress)
         progress(BufferProgress(float(i) / float(numfiles)));
@@ -1030,11 +1334,7 @@ RDResult importXMLZ(const rdcstr &filename, StreamReader &reader, RDCFile *rdc,
       return res;
   }
 
-  rdcstr buf;
-  buf.resize((size_t)reader.GetSize());
-  reader.Read(buf.data(), buf.size());
-
-  return XML2Structured(buf.c_str(), thumb, extThumb, logfile, structData.buffers, rdc,
+  return XML2Structured(reader, thumb, extThumb, logfile, structData.buffers, rdc,
                         structData.version, structData.chunks, progress);
 }
 
@@ -1072,3 +1372,288 @@ static ConversionRegistration XMLOnlyConversionRegistration(
 easier to work with but it cannot then be imported.)",
         false,
     });
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+
+// a file covering every kind of object and chunk metadata the codec handles
+static void MakeXMLTestFile(RDCFile &rdc, SDFile &sdfile)
+{
+  rdc.SetData(RDCDriver::Vulkan, "Vulkan", 1234, NULL, 5, 2.5);
+
+  sdfile.version = 0x10;
+
+  SDChunk *chunk = new SDChunk("vkCreateThing"_lit);
+  chunk->metadata.chunkID = 1000;
+  chunk->metadata.length = 256;
+  chunk->metadata.threadID = 99;
+  chunk->metadata.timestampMicro = 123456;
+  chunk->metadata.durationMicro = 78;
+  chunk->metadata.flags |= SDChunkFlags::HasCallstack;
+  chunk->metadata.callstack = {0x1000, 0x2000, 0xfedcba9876543210ULL};
+
+  chunk->AddAndOwnChild(makeSDString("str"_lit, "quotes \" and <tags> & \t tabs"));
+  chunk->AddAndOwnChild(makeSDInt32("negative"_lit, -42));
+  chunk->AddAndOwnChild(makeSDInt64("big"_lit, -0x123456789LL));
+  chunk->AddAndOwnChild(makeSDUInt64("unsigned"_lit, 0xffffffffffffffffULL));
+  chunk->AddAndOwnChild(makeSDFloat("float"_lit, 1.5f));
+  chunk->AddAndOwnChild(makeSDBool("bool"_lit, true));
+  chunk->AddAndOwnChild(makeSDResourceId("resource"_lit, ResourceId()));
+
+  SDObject *enumObj = chunk->AddAndOwnChild(makeSDEnum("enum"_lit, 3));
+  enumObj->type.name = "VkFormat"_lit;
+  enumObj->data.str = "VK_FORMAT_R8G8B8A8_UNORM"_lit;
+  enumObj->type.flags |= SDTypeFlags::HasCustomString;
+
+  SDObject *nullObj = chunk->AddAndOwnChild(new SDObject("pNext"_lit, "VkBaseInStructure"_lit));
+  nullObj->type.basetype = SDBasic::Null;
+  nullObj->type.flags |= SDTypeFlags::Nullable;
+
+  SDObject *hidden = chunk->AddAndOwnChild(makeSDUInt32("hidden"_lit, 7));
+  hidden->type.flags |= SDTypeFlags::Hidden | SDTypeFlags::Important;
+
+  SDObject *strct = chunk->AddAndOwnChild(makeSDStruct("info"_lit, "VkThingCreateInfo"_lit));
+  strct->type.flags |= SDTypeFlags::Union | SDTypeFlags::ImportantChildren;
+  strct->AddAndOwnChild(makeSDUInt32("flags"_lit, 0));
+
+  SDObject *arr = strct->AddAndOwnChild(makeSDArray("values"_lit));
+  arr->type.flags |= SDTypeFlags::FixedArray;
+  arr->AddAndOwnChild(makeSDFloat("$el"_lit, 0.25f));
+  arr->AddAndOwnChild(makeSDFloat("$el"_lit, -8.0f));
+
+  SDObject *emptyArr = strct->AddAndOwnChild(makeSDArray("empty"_lit));
+  emptyArr->type.name = "uint32_t"_lit;
+
+  SDObject *buf = chunk->AddAndOwnChild(new SDObject("data"_lit, "Byte Buffer"_lit));
+  buf->type.basetype = SDBasic::Buffer;
+  buf->type.byteSize = 16;
+  buf->data.basic.u = 0;
+
+  sdfile.chunks.push_back(chunk);
+
+  chunk = new SDChunk("Empty"_lit);
+  chunk->metadata.chunkID = 2;
+  sdfile.chunks.push_back(chunk);
+
+  chunk = new SDChunk("Opaque"_lit);
+  chunk->metadata.chunkID = 3;
+  chunk->metadata.flags |= SDChunkFlags::OpaqueChunk;
+  buf = chunk->AddAndOwnChild(new SDObject("Opaque chunk"_lit, "Byte Buffer"_lit));
+  buf->type.basetype = SDBasic::Buffer;
+  buf->type.byteSize = 32;
+  buf->data.basic.u = 1;
+  sdfile.chunks.push_back(chunk);
+
+  bytebuf *data = new bytebuf;
+  data->resize(16);
+  sdfile.buffers.push_back(data);
+  data = new bytebuf;
+  data->resize(32);
+  sdfile.buffers.push_back(data);
+}
+
+// written by the exporter from before it was streamed, which built the whole document in memory
+static const char *xmlTestFileDocument = R"(<?xml version="1.0"?>
+<rdc>
+	<header>
+		<driver id="8">Vulkan</driver>
+		<machineIdent>1234</machineIdent>
+		<thumbnail />
+		<timebase base="5" frequency="2.5" />
+	</header>
+	<chunks version="16">
+		<chunk id="1000" name="vkCreateThing" length="256" threadID="99" timestamp="123456" duration="78">
+			<callstack>
+				<address>4096</address>
+				<address>8192</address>
+				<address>18364758544493064720</address>
+			</callstack>
+			<string name="str" typename="string">quotes " and &lt;tags&gt; &amp; 	 tabs</string>
+			<int name="negative" typename="int32_t" width="4">-42</int>
+			<int name="big" typename="int64_t" width="8">-4886718345</int>
+			<uint name="unsigned" typename="uint64_t" width="8">18446744073709551615</uint>
+			<float name="float" typename="float" width="4">1.5</float>
+			<bool name="bool" typename="bool">true</bool>
+			<ResourceId name="resource" typename="ResourceId" width="8">0</ResourceId>
+			<enum name="enum" typename="VkFormat" string="VK_FORMAT_R8G8B8A8_UNORM">3</enum>
+			<null name="pNext" typename="VkBaseInStructure" />
+			<uint name="hidden" typename="uint32_t" width="4" hidden="true" important="true">7</uint>
+			<struct name="info" typename="VkThingCreateInfo" union="true" importantchildren="true">
+				<uint name="flags" typename="uint32_t" width="4">0</uint>
+				<array name="values" fixedarray="true">
+					<float typename="float" width="4">0.25</float>
+					<float typename="float" width="4">-8</float>
+				</array>
+				<array name="empty" typename="uint32_t" />
+			</struct>
+			<buffer name="data" typename="Byte Buffer" byteLength="16">0</buffer>
+		</chunk>
+		<chunk id="2" name="Empty" length="0" />
+		<chunk id="3" name="Opaque" length="0" opaque="true">
+			<buffer byteLength="32">1</buffer>
+		</chunk>
+	</chunks>
+</rdc>
+)";
+
+TEST_CASE("XML export and import match the document exporter", "[xml]")
+{
+  rdcstr filename = FileIO::GetTempFolderFilename() + "renderdoc_xml_codec_compat_test.xml";
+
+  RDCFile rdc;
+  SDFile sdfile;
+  MakeXMLTestFile(rdc, sdfile);
+
+  SECTION("Export")
+  {
+    REQUIRE(exportXMLOnly(filename, rdc, sdfile, NULL).code == ResultCode::Succeeded);
+
+    rdcstr exported;
+    REQUIRE(FileIO::ReadAll(filename, exported));
+    CHECK(exported == xmlTestFileDocument);
+  };
+
+  SECTION("Import")
+  {
+    {
+      FILE *f = FileIO::fopen(filename, FileIO::WriteBinary);
+      REQUIRE(f);
+      FileIO::fwrite(xmlTestFileDocument, 1, strlen(xmlTestFileDocument), f);
+      FileIO::fclose(f);
+    }
+
+    RDCFile rdc2;
+    SDFile sdfile2;
+    {
+      StreamReader reader(FileIO::fopen(filename, FileIO::ReadBinary));
+      REQUIRE(importXMLZ(rdcstr(), reader, &rdc2, sdfile2, NULL).code == ResultCode::Succeeded);
+    }
+
+    CHECK(rdc2.GetDriver() == rdc.GetDriver());
+    CHECK(rdc2.GetMachineIdent() == rdc.GetMachineIdent());
+    CHECK(rdc2.GetTimestampBase() == rdc.GetTimestampBase());
+    CHECK(rdc2.GetTimestampFrequency() == rdc.GetTimestampFrequency());
+    CHECK(sdfile2.version == sdfile.version);
+
+    REQUIRE(sdfile2.chunks.size() == sdfile.chunks.size());
+
+    for(size_t i = 0; i < sdfile.chunks.size(); i++)
+    {
+      const SDChunkMetaData &a = sdfile.chunks[i]->metadata;
+      const SDChunkMetaData &b = sdfile2.chunks[i]->metadata;
+
+      CHECK(sdfile2.chunks[i]->name == sdfile.chunks[i]->name);
+      CHECK(b.chunkID == a.chunkID);
+      CHECK(b.length == a.length);
+      CHECK(b.threadID == a.threadID);
+      CHECK(b.timestampMicro == a.timestampMicro);
+      CHECK(b.durationMicro == a.durationMicro);
+      CHECK(b.flags == a.flags);
+      CHECK(b.callstack == a.callstack);
+      CHECK(sdfile2.chunks[i]->HasEqualValue(sdfile.chunks[i]));
+    }
+
+    // and what was imported exports back to the same document
+    sdfile2.buffers.swap(sdfile.buffers);
+    REQUIRE(exportXMLOnly(filename, rdc2, sdfile2, NULL).code == ResultCode::Succeeded);
+
+    rdcstr exported;
+    REQUIRE(FileIO::ReadAll(filename, exported));
+    CHECK(exported == xmlTestFileDocument);
+  };
+
+  FileIO::Delete(filename);
+}
+
+TEST_CASE("Streaming XML export and import", "[xml]")
+{
+  rdcstr filename = FileIO::GetTempFolderFilename() + "renderdoc_xml_codec_test.xml";
+
+  RDCFile rdc;
+  rdc.SetData(RDCDriver::Vulkan, "Vulkan", 1234, NULL, 5, 1.0);
+
+  SDFile sdfile;
+  sdfile.version = 0x10;
+
+  SECTION("Round trip of chunks")
+  {
+    // a chunk with contents that look like the tags used to split up the document
+    SDChunk *chunk = new SDChunk("</chunk> & <chunks version=\"1\">"_lit);
+    chunk->metadata.chunkID = 1;
+    chunk->metadata.threadID = 99;
+    chunk->metadata.flags |= SDChunkFlags::HasCallstack;
+    chunk->metadata.callstack = {0x1000, 0x2000};
+    chunk->AddAndOwnChild(makeSDString("str"_lit, "<chunk><!-- </chunks> -->"));
+    chunk->AddAndOwnChild(makeSDUInt32("value"_lit, 42));
+    SDObject *arr = chunk->AddAndOwnChild(makeSDArray("arr"_lit));
+    arr->AddAndOwnChild(makeSDUInt32("$el"_lit, 1));
+    arr->AddAndOwnChild(makeSDUInt32("$el"_lit, 2));
+    sdfile.chunks.push_back(chunk);
+
+    // a chunk with no children is written as a self-closing element
+    chunk = new SDChunk("Empty"_lit);
+    chunk->metadata.chunkID = 2;
+    sdfile.chunks.push_back(chunk);
+
+    for(uint32_t i = 0; i < 100; i++)
+    {
+      chunk = new SDChunk("Numbered"_lit);
+      chunk->metadata.chunkID = 3 + i;
+      chunk->AddAndOwnChild(makeSDUInt32("i"_lit, i));
+      sdfile.chunks.push_back(chunk);
+    }
+
+    REQUIRE(exportXMLOnly(filename, rdc, sdfile, NULL).code == ResultCode::Succeeded);
+
+    // the streamed output must still be a single valid document
+    {
+      pugi::xml_document doc;
+      REQUIRE((bool)doc.load_file(filename.c_str()));
+      CHECK(std::distance(doc.child("rdc").child("chunks").begin(),
+                          doc.child("rdc").child("chunks").end()) == 102);
+    }
+
+    RDCFile rdc2;
+    SDFile sdfile2;
+    {
+      StreamReader reader(FileIO::fopen(filename, FileIO::ReadBinary));
+      REQUIRE(importXMLZ(rdcstr(), reader, &rdc2, sdfile2, NULL).code == ResultCode::Succeeded);
+    }
+
+    CHECK(rdc2.GetDriver() == RDCDriver::Vulkan);
+    CHECK(rdc2.GetMachineIdent() == 1234);
+    CHECK(sdfile2.version == 0x10);
+
+    REQUIRE(sdfile2.chunks.size() == sdfile.chunks.size());
+
+    for(size_t i = 0; i < sdfile.chunks.size(); i++)
+    {
+      CHECK(sdfile2.chunks[i]->name == sdfile.chunks[i]->name);
+      CHECK(sdfile2.chunks[i]->metadata.chunkID == sdfile.chunks[i]->metadata.chunkID);
+      CHECK(sdfile2.chunks[i]->HasEqualValue(sdfile.chunks[i]));
+    }
+
+    CHECK(sdfile2.chunks[0]->metadata.threadID == 99);
+    CHECK(sdfile2.chunks[0]->metadata.callstack == sdfile.chunks[0]->metadata.callstack);
+  };
+
+  SECTION("No chunks")
+  {
+    REQUIRE(exportXMLOnly(filename, rdc, sdfile, NULL).code == ResultCode::Succeeded);
+
+    RDCFile rdc2;
+    SDFile sdfile2;
+    {
+      StreamReader reader(FileIO::fopen(filename, FileIO::ReadBinary));
+      REQUIRE(importXMLZ(rdcstr(), reader, &rdc2, sdfile2, NULL).code == ResultCode::Succeeded);
+    }
+
+    CHECK(sdfile2.version == 0x10);
+    CHECK(sdfile2.chunks.empty());
+  };
+
+  FileIO::Delete(filename);
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
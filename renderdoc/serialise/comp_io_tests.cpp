@@ -110,6 +110,124 @@ TEST_CASE("Test LZ4 compression/decompression", "[streamio][lz4]")
   delete[] randomData;
 };
 
+TEST_CASE("Test parallel LZ4 compression/decompression", "[streamio][lz4]")
+{
+  StreamWriter buf(StreamWriter::DefaultScratchSize);
+
+  // use an odd size so the last block is partial
+  const uint64_t dataSize = 3 * 1024 * 1024 + 1234;
+
+  byte *data = new byte[dataSize];
+
+  for(uint64_t i = 0; i < dataSize; i++)
+    data[i] = (i & 0x100000) ? (rand() & 0xff) : (i & 0xff);
+
+  {
+    StreamWriter writer(new LZ4Compressor(&buf, Ownership::Nothing, true), Ownership::Stream);
+
+    // write in irregular pieces to test crossing block boundaries
+    uint64_t offs = 0;
+    uint64_t size = 1;
+    while(offs < dataSize)
+    {
+      uint64_t chunk = RDCMIN(size, dataSize - offs);
+      writer.Write(data + offs, chunk);
+      offs += chunk;
+      size = (size * 7) % 300000 + 1;
+    }
+
+    CHECK(writer.GetOffset() == dataSize);
+    CHECK_FALSE(writer.IsErrored());
+
+    writer.Finish();
+
+    CHECK_FALSE(writer.IsErrored());
+
+    // the non-random half should compress well
+    CHECK(buf.GetOffset() < dataSize * 3 / 4);
+  }
+
+  byte *readData = new byte[dataSize];
+
+  SECTION("Parallel decompression")
+  {
+    StreamReader reader(new LZ4Decompressor(new StreamReader(buf.GetData(), buf.GetOffset()),
+                                            Ownership::Stream, true),
+                        dataSize, Ownership::Stream);
+
+    reader.Read(readData, 1000);
+    reader.Read(readData + 1000, dataSize - 1000);
+
+    CHECK_FALSE(reader.IsErrored());
+    CHECK(reader.AtEnd());
+    CHECK_FALSE(memcmp(readData, data, (size_t)dataSize));
+  }
+
+  SECTION("Serial decompression")
+  {
+    // independent blocks are still readable by the serial decompressor
+    StreamReader reader(
+        new LZ4Decompressor(new StreamReader(buf.GetData(), buf.GetOffset()), Ownership::Stream),
+        dataSize, Ownership::Stream);
+
+    reader.Read(readData, dataSize);
+
+    CHECK_FALSE(reader.IsErrored());
+    CHECK(reader.AtEnd());
+    CHECK_FALSE(memcmp(readData, data, (size_t)dataSize));
+  }
+
+  SECTION("Recompression")
+  {
+    StreamWriter recompressed(StreamWriter::DefaultScratchSize);
+
+    {
+      LZ4Decompressor decomp(new StreamReader(buf.GetData(), buf.GetOffset()), Ownership::Stream,
+                             true);
+      LZ4Compressor comp(&recompressed, Ownership::Nothing);
+
+      CHECK(decomp.Recompress(&comp));
+    }
+
+    StreamReader reader(new LZ4Decompressor(new StreamReader(recompressed.GetData(),
+                                                             recompressed.GetOffset()),
+                                            Ownership::Stream),
+                        dataSize, Ownership::Stream);
+
+    reader.Read(readData, dataSize);
+
+    CHECK_FALSE(reader.IsErrored());
+    CHECK_FALSE(memcmp(readData, data, (size_t)dataSize));
+  }
+
+  delete[] readData;
+  delete[] data;
+};
+
+TEST_CASE("Test parallel LZ4 compression write failure", "[streamio][lz4]")
+{
+  StreamWriter failing(StreamWriter::InvalidStream, RDResult(ResultCode::FileIOFailed));
+
+  bytebuf data;
+  data.resize(1024 * 1024);
+  for(size_t i = 0; i < data.size(); i++)
+    data[i] = byte(i & 0xff);
+
+  LZ4Compressor comp(&failing, Ownership::Nothing, true);
+
+  // enough blocks are in flight that the first write to the stream happens partway through
+  bool success = true;
+  for(int i = 0; i < 8 && success; i++)
+    success = comp.Write(data.data(), data.size());
+
+  CHECK_FALSE(success);
+  CHECK(comp.GetError().code == ResultCode::FileIOFailed);
+
+  // once failed the stream stays failed, without touching the released blocks
+  CHECK_FALSE(comp.Write(data.data(), data.size()));
+  CHECK_FALSE(comp.Finish());
+};
+
 TEST_CASE("Test ZSTD compression/decompression", "[streamio][zstd]")
 {
   StreamWriter buf(StreamWriter::DefaultScratchSize);
@@ -190,4 +308,261 @@ TEST_CASE("Test ZSTD compression/decompression", "[streamio][zstd]")
   delete[] randomData;
 };
 
+TEST_CASE("Test parallel ZSTD compression", "[streamio][zstd]")
+{
+  const uint64_t dataSize = 3 * 1024 * 1024 + 777;
+
+  byte *data = new byte[dataSize];
+
+  for(uint64_t i = 0; i < dataSize; i++)
+    data[i] = (i & 0x80000) ? (rand() & 0xff) : byte(i >> 4);
+
+  for(int level : {1, (int)ZSTDCompressor::DefaultLevel, 12})
+  {
+    StreamWriter buf(StreamWriter::DefaultScratchSize);
+
+    {
+      StreamWriter writer(new ZSTDCompressor(&buf, Ownership::Nothing, level, true),
+                          Ownership::Stream);
+
+      // write in irregular pieces to test crossing block boundaries
+      uint64_t offs = 0;
+      uint64_t size = 3;
+      while(offs < dataSize)
+      {
+        uint64_t chunk = RDCMIN(size, dataSize - offs);
+        writer.Write(data + offs, chunk);
+        offs += chunk;
+        size = (size * 13) % 400000 + 1;
+      }
+
+      writer.Finish();
+
+      CHECK_FALSE(writer.IsErrored());
+      CHECK(buf.GetOffset() < dataSize * 3 / 4);
+    }
+
+    byte *readData = new byte[dataSize];
+
+    {
+      StreamReader reader(
+          new ZSTDDecompressor(new StreamReader(buf.GetData(), buf.GetOffset()), Ownership::Stream),
+          dataSize, Ownership::Stream);
+
+      reader.Read(readData, dataSize);
+
+      CHECK_FALSE(reader.IsErrored());
+      CHECK(reader.AtEnd());
+      CHECK_FALSE(memcmp(readData, data, (size_t)dataSize));
+    }
+
+    delete[] readData;
+  }
+
+  delete[] data;
+};
+
+TEST_CASE("Test ZSTD archive compression", "[streamio][zstd]")
+{
+  // a block of random data that repeats far further apart than a single 128KB frame can see
+  const uint64_t repeatSize = 1024 * 1024;
+  const uint64_t dataSize = repeatSize * 3 + 777;
+
+  byte *data = new byte[dataSize];
+
+  for(uint64_t i = 0; i < repeatSize; i++)
+    data[i] = rand() & 0xff;
+  for(uint64_t i = repeatSize; i < dataSize; i++)
+    data[i] = data[i % repeatSize];
+
+  StreamWriter framed(StreamWriter::DefaultScratchSize);
+  StreamWriter archive(StreamWriter::DefaultScratchSize);
+
+  for(bool isArchive : {false, true})
+  {
+    StreamWriter writer(new ZSTDCompressor(isArchive ? &archive : &framed, Ownership::Nothing,
+                                           ZSTDCompressor::DefaultLevel, false, isArchive),
+                        Ownership::Stream);
+
+    // write in irregular pieces to test crossing block boundaries
+    uint64_t offs = 0;
+    uint64_t size = 3;
+    while(offs < dataSize)
+    {
+      uint64_t chunk = RDCMIN(size, dataSize - offs);
+      writer.Write(data + offs, chunk);
+      offs += chunk;
+      size = (size * 13) % 400000 + 1;
+    }
+
+    writer.Finish();
+
+    CHECK_FALSE(writer.IsErrored());
+  }
+
+  // the repeats are found in archive mode, so it's not much more than the random data itself
+  CHECK(framed.GetOffset() > repeatSize * 3);
+  CHECK(archive.GetOffset() < repeatSize + repeatSize / 8);
+
+  byte *readData = new byte[dataSize];
+
+  SECTION("Decompression")
+  {
+    StreamReader reader(
+        new ZSTDDecompressor(new StreamReader(archive.GetData(), archive.GetOffset()),
+                             Ownership::Stream, true),
+        dataSize, Ownership::Stream);
+
+    uint64_t offs = 0;
+    uint64_t size = 5;
+    while(offs < dataSize)
+    {
+      uint64_t chunk = RDCMIN(size, dataSize - offs);
+      reader.Read(readData + offs, chunk);
+      offs += chunk;
+      size = (size * 17) % 300000 + 1;
+    }
+
+    CHECK_FALSE(reader.IsErrored());
+    CHECK(reader.AtEnd());
+    CHECK_FALSE(memcmp(readData, data, (size_t)dataSize));
+  }
+
+  SECTION("Recompression")
+  {
+    StreamWriter recompressed(StreamWriter::DefaultScratchSize);
+
+    {
+      ZSTDDecompressor decomp(new StreamReader(archive.GetData(), archive.GetOffset()),
+                              Ownership::Stream, true);
+      ZSTDCompressor comp(&recompressed, Ownership::Nothing);
+
+      CHECK(decomp.Recompress(&comp));
+    }
+
+    StreamReader reader(
+        new ZSTDDecompressor(new StreamReader(recompressed.GetData(), recompressed.GetOffset()),
+                             Ownership::Stream),
+        dataSize, Ownership::Stream);
+
+    reader.Read(readData, dataSize);
+
+    CHECK_FALSE(reader.IsErrored());
+    CHECK_FALSE(memcmp(readData, data, (size_t)dataSize));
+  }
+
+  SECTION("Reading past the end")
+  {
+    ZSTDDecompressor decomp(new StreamReader(archive.GetData(), archive.GetOffset()),
+                            Ownership::Stream, true);
+
+    CHECK(decomp.Read(readData, dataSize));
+    CHECK_FALSE(decomp.Read(readData, 1));
+    CHECK(decomp.GetError().code == ResultCode::FileIOFailed);
+  }
+
+  delete[] readData;
+  delete[] data;
+};
+
+TEST_CASE("Test ZSTD compression write failure", "[streamio][zstd]")
+{
+  bytebuf data;
+  data.resize(1024 * 1024);
+  for(size_t i = 0; i < data.size(); i++)
+    data[i] = byte(i & 0xff);
+
+  for(bool parallel : {false, true})
+  {
+    StreamWriter failing(StreamWriter::InvalidStream, RDResult(ResultCode::FileIOFailed));
+
+    ZSTDCompressor comp(&failing, Ownership::Nothing, ZSTDCompressor::DefaultLevel, parallel);
+
+    bool success = true;
+    for(int i = 0; i < 8 && success; i++)
+      success = comp.Write(data.data(), data.size());
+
+    // the failure must be reported with the underlying error, not just a false return
+    CHECK_FALSE(success);
+    CHECK(comp.GetError().code == ResultCode::FileIOFailed);
+    CHECK_FALSE(comp.Finish());
+  }
+};
+
+TEST_CASE("Test seeking in compressed streams", "[streamio][lz4][zstd]")
+{
+  const uint64_t dataSize = 2 * 1024 * 1024 + 4321;
+
+  byte *data = new byte[dataSize];
+
+  for(uint64_t i = 0; i < dataSize; i++)
+    data[i] = byte((i * 13) ^ (i >> 10));
+
+  StreamWriter buf(StreamWriter::DefaultScratchSize);
+  CompressedBlockIndex index;
+
+  bool lz4 = false;
+
+  SECTION("LZ4")
+  {
+    lz4 = true;
+  }
+  SECTION("ZSTD")
+  {
+    lz4 = false;
+  }
+
+  {
+    Compressor *comp = NULL;
+    if(lz4)
+      comp = new LZ4Compressor(&buf, Ownership::Nothing, true);
+    else
+      comp = new ZSTDCompressor(&buf, Ownership::Nothing);
+
+    StreamWriter writer(comp, Ownership::Stream);
+
+    writer.Write(data, dataSize);
+    writer.Finish();
+
+    CHECK_FALSE(writer.IsErrored());
+
+    index = comp->GetBlockIndex();
+  }
+
+  CHECK(index.blockSize > 0);
+  CHECK(index.offsets.size() >= (dataSize + index.blockSize - 1) / index.blockSize);
+
+  Decompressor *decomp = NULL;
+  if(lz4)
+    decomp = new LZ4Decompressor(new StreamReader(buf.GetData(), buf.GetOffset()),
+                                 Ownership::Stream, true);
+  else
+    decomp = new ZSTDDecompressor(new StreamReader(buf.GetData(), buf.GetOffset()),
+                                  Ownership::Stream);
+
+  decomp->SetBlockIndex(index);
+
+  StreamReader reader(decomp, dataSize, Ownership::Stream);
+
+  byte readData[1000];
+
+  // seek forwards, backwards, and across block boundaries
+  const uint64_t offsets[] = {
+      1500000, 10, dataSize - 1000, 65536 - 500, 3 * 65536, 700000, 0, 131072 * 5 + 17,
+  };
+
+  for(uint64_t offs : offsets)
+  {
+    reader.SetOffset(offs);
+    CHECK(reader.GetOffset() == offs);
+
+    reader.Read(readData, sizeof(readData));
+
+    CHECK_FALSE(reader.IsErrored());
+    CHECK_FALSE(memcmp(readData, data + offs, sizeof(readData)));
+  }
+
+  delete[] data;
+};
+
 #endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -26,29 +26,76 @@
 
 static const uint64_t lz4BlockSize = 64 * 1024;
 
-LZ4Compressor::LZ4Compressor(StreamWriter *write, Ownership own) : Compressor(write, own)
+static uint32_t ParallelBlockCount()
 {
+  // enough blocks in flight to keep every worker busy while the previous results are written out
+  return RDCCLAMP(Threading::JobSystem::GetWorkerCount() * 2, 2U, 64U);
+}
+
+LZ4Compressor::LZ4Compressor(StreamWriter *write, Ownership own, bool parallel)
+    : Compressor(write, own)
+{
+  m_PageOffset = 0;
+
+  m_BlockIndex.blockSize = lz4BlockSize;
+
+  if(parallel)
+  {
+    m_Blocks.resize(ParallelBlockCount());
+    for(LZ4ParallelBlock &block : m_Blocks)
+    {
+      block.page = AllocAlignedBuffer(lz4BlockSize);
+      block.compressed = AllocAlignedBuffer(LZ4_COMPRESSBOUND(lz4BlockSize));
+    }
+
+    m_Page[0] = m_Blocks[0].page;
+    m_Page[1] = m_CompressBuffer = NULL;
+
+    m_LZ4Comp = NULL;
+
+    return;
+  }
+
   m_Page[0] = AllocAlignedBuffer(lz4BlockSize);
   m_Page[1] = AllocAlignedBuffer(lz4BlockSize);
   m_CompressBuffer = AllocAlignedBuffer(LZ4_COMPRESSBOUND(lz4BlockSize));
 
-  m_PageOffset = 0;
-
   m_LZ4Comp = LZ4_createStream();
 }
 
 LZ4Compressor::~LZ4Compressor()
 {
-  FreeAlignedBuffer(m_Page[0]);
-  FreeAlignedBuffer(m_Page[1]);
-  FreeAlignedBuffer(m_CompressBuffer);
+  FreeBuffers();
   LZ4_freeStream(m_LZ4Comp);
 }
 
+void LZ4Compressor::FreeBuffers()
+{
+  if(m_Blocks.empty())
+  {
+    FreeAlignedBuffer(m_Page[0]);
+    FreeAlignedBuffer(m_Page[1]);
+    FreeAlignedBuffer(m_CompressBuffer);
+  }
+  else
+  {
+    // jobs may still be compressing from these pages, wait for them before freeing anything
+    for(LZ4ParallelBlock &block : m_Blocks)
+    {
+      Threading::JobSystem::SyncJob(block.job);
+      FreeAlignedBuffer(block.page);
+      FreeAlignedBuffer(block.compressed);
+    }
+    m_Blocks.clear();
+  }
+
+  m_Page[0] = m_Page[1] = m_CompressBuffer = NULL;
+}
+
 bool LZ4Compressor::Write(const void *data, uint64_t numBytes)
 {
   // if we encountered a stream error this will be NULL
-  if(!m_CompressBuffer)
+  if(!m_Page[0])
     return false;
 
   if(numBytes == 0)
@@ -115,15 +162,45 @@ bool LZ4Compressor::Finish()
   // precisely 64kb in size
   // only the last one can be smaller, so we only write a partial page when finishing.
   // Calling Write() after Finish() is illegal
-  return FlushPage0();
+  bool success = FlushPage0();
+
+  // in parallel mode, write out any blocks that are still in flight. The current block was just
+  // written by the flush so the oldest in-flight block is the one after it.
+  for(size_t i = 1; success && i < m_Blocks.size(); i++)
+    success &= WriteBlock(m_Blocks[(m_CurBlock + i) % m_Blocks.size()]);
+
+  return success;
 }
 
 bool LZ4Compressor::FlushPage0()
 {
   // if we encountered a stream error this will be NULL
-  if(!m_CompressBuffer)
+  if(!m_Page[0])
     return false;
 
+  if(!m_Blocks.empty())
+  {
+    // kick off compression of this block with no history, so it's independent of any other blocks
+    LZ4ParallelBlock &block = m_Blocks[m_CurBlock];
+    block.uncompSize = (int32_t)m_PageOffset;
+    block.job = Threading::JobSystem::AddJob([&block]() {
+      block.compSize = LZ4_compress_fast((const char *)block.page, (char *)block.compressed,
+                                         block.uncompSize, (int)LZ4_COMPRESSBOUND(lz4BlockSize), 20);
+    });
+
+    // move to the next block. If it's still in flight it's the oldest block, so wait for it and
+    // write it out - this keeps the blocks in order on disk.
+    m_CurBlock = (m_CurBlock + 1) % m_Blocks.size();
+
+    if(!WriteBlock(m_Blocks[m_CurBlock]))
+      return false;
+
+    m_Page[0] = m_Blocks[m_CurBlock].page;
+    m_PageOffset = 0;
+
+    return true;
+  }
+
   // m_PageOffset is the amount written, usually equal to lz4BlockSize except the last block.
   int32_t compSize =
       LZ4_compress_fast_continue(m_LZ4Comp, (const char *)m_Page[0], (char *)m_CompressBuffer,
@@ -131,14 +208,13 @@ bool LZ4Compressor::FlushPage0()
 
   if(compSize < 0)
   {
-    FreeAlignedBuffer(m_Page[0]);
-    FreeAlignedBuffer(m_Page[1]);
-    FreeAlignedBuffer(m_CompressBuffer);
-    m_Page[0] = m_Page[1] = m_CompressBuffer = NULL;
+    FreeBuffers();
     SET_ERROR_RESULT(m_Error, ResultCode::CompressionFailed, "LZ4 compression failed: %i", compSize);
     return false;
   }
 
+  m_BlockIndex.offsets.push_back(m_Write->GetOffset());
+
   bool success = true;
 
   success &= m_Write->Write(compSize);
@@ -157,15 +233,71 @@ bool LZ4Compressor::FlushPage0()
   return success;
 }
 
-LZ4Decompressor::LZ4Decompressor(StreamReader *read, Ownership own) : Decompressor(read, own)
+bool LZ4Compressor::WriteBlock(LZ4ParallelBlock &block)
 {
-  m_Page[0] = AllocAlignedBuffer(lz4BlockSize);
-  m_Page[1] = AllocAlignedBuffer(lz4BlockSize);
-  m_CompressBuffer = AllocAlignedBuffer(LZ4_COMPRESSBOUND(lz4BlockSize));
+  // nothing to do if this block isn't in use
+  if(!block.job)
+    return true;
+
+  Threading::JobSystem::SyncJob(block.job);
+  block.job = NULL;
+
+  int32_t compSize = block.compSize;
+
+  if(compSize <= 0)
+  {
+    FreeBuffers();
+    SET_ERROR_RESULT(m_Error, ResultCode::CompressionFailed, "LZ4 compression failed: %i", compSize);
+    return false;
+  }
+
+  m_BlockIndex.offsets.push_back(m_Write->GetOffset());
+
+  bool success = true;
 
+  success &= m_Write->Write(compSize);
+  if(!success)
+    m_Error = m_Write->GetError();
+  success &= m_Write->Write(block.compressed, compSize);
+  if(!success)
+    m_Error = m_Write->GetError();
+
+  // like a compression failure, a write failure ends the stream. Release the blocks now, waiting
+  // for any still compressing, rather than holding them until the compressor is destroyed.
+  if(!success)
+    FreeBuffers();
+
+  return success;
+}
+
+LZ4Decompressor::LZ4Decompressor(StreamReader *read, Ownership own, bool parallel)
+    : Decompressor(read, own)
+{
   m_PageOffset = 0;
   m_PageLength = 0;
 
+  if(parallel)
+  {
+    m_Blocks.resize(ParallelBlockCount());
+    for(LZ4ParallelBlock &block : m_Blocks)
+    {
+      block.page = AllocAlignedBuffer(lz4BlockSize);
+      block.compressed = AllocAlignedBuffer(LZ4_COMPRESSBOUND(lz4BlockSize));
+    }
+
+    // nothing is read ahead until the first page is needed
+    m_Page[0] = m_Blocks[0].page;
+    m_Page[1] = m_CompressBuffer = NULL;
+
+    m_LZ4Decomp = NULL;
+
+    return;
+  }
+
+  m_Page[0] = AllocAlignedBuffer(lz4BlockSize);
+  m_Page[1] = AllocAlignedBuffer(lz4BlockSize);
+  m_CompressBuffer = AllocAlignedBuffer(LZ4_COMPRESSBOUND(lz4BlockSize));
+
   m_LZ4Decomp = LZ4_createStreamDecode();
 
   LZ4_setStreamDecode(m_LZ4Decomp, NULL, 0);
@@ -173,18 +305,48 @@ LZ4Decompressor::LZ4Decompressor(StreamReader *read, Ownership own) : Decompress
 
 LZ4Decompressor::~LZ4Decompressor()
 {
-  FreeAlignedBuffer(m_Page[0]);
-  FreeAlignedBuffer(m_Page[1]);
-  FreeAlignedBuffer(m_CompressBuffer);
+  FreeBuffers();
 
   LZ4_freeStreamDecode(m_LZ4Decomp);
 }
 
+void LZ4Decompressor::FreeBuffers()
+{
+  if(m_Blocks.empty())
+  {
+    FreeAlignedBuffer(m_Page[0]);
+    FreeAlignedBuffer(m_Page[1]);
+    FreeAlignedBuffer(m_CompressBuffer);
+  }
+  else
+  {
+    // jobs may still be decompressing into these pages, wait for them before freeing anything
+    for(LZ4ParallelBlock &block : m_Blocks)
+    {
+      Threading::JobSystem::SyncJob(block.job);
+      FreeAlignedBuffer(block.page);
+      FreeAlignedBuffer(block.compressed);
+    }
+    m_Blocks.clear();
+  }
+
+  m_Page[0] = m_Page[1] = m_CompressBuffer = NULL;
+}
+
+bool LZ4Decompressor::HasMoreBlocks()
+{
+  if(m_Blocks.empty() || m_CurBlock < 0)
+    return !m_Read->AtEnd();
+
+  // blocks are read ahead in order, so if the next block wasn't filled we've hit the end
+  return m_Blocks[(m_CurBlock + 1) % m_Blocks.size()].job != NULL;
+}
+
 bool LZ4Decompressor::Recompress(Compressor *comp)
 {
   bool success = true;
 
-  while(success && !m_Read->AtEnd())
+  while(success && HasMoreBlocks())
   {
     success &= FillPage0();
     if(success)
@@ -200,10 +362,57 @@ bool LZ4Decompressor::Recompress(Compressor *comp)
   return success;
 }
 
+bool LZ4Decompressor::Seek(uint64_t offset)
+{
+  // seeking is only possible with an index, which is only provided for independent blocks
+  if(m_BlockIndex.offsets.empty() || m_BlockIndex.blockSize != lz4BlockSize)
+    return false;
+
+  // if we encountered a stream error this will be NULL
+  if(!m_Page[0])
+    return false;
+
+  // an offset at the very end of a full last block will be past the last block, so clamp to the
+  // last block and we'll be positioned at the end of it
+  size_t block = (size_t)RDCMIN(offset / lz4BlockSize, uint64_t(m_BlockIndex.offsets.size() - 1));
+
+  if(!m_Blocks.empty())
+  {
+    // discard anything we've read ahead
+    for(LZ4ParallelBlock &b : m_Blocks)
+    {
+      Threading::JobSystem::SyncJob(b.job);
+      b.job = NULL;
+    }
+
+    m_CurBlock = -1;
+  }
+  else
+  {
+    LZ4_setStreamDecode(m_LZ4Decomp, NULL, 0);
+  }
+
+  m_Read->SetOffset(m_BlockIndex.offsets[block]);
+
+  if(m_Read->IsErrored())
+  {
+    m_Error = m_Read->GetError();
+    FreeBuffers();
+    return false;
+  }
+
+  if(!FillPage0())
+    return false;
+
+  m_PageOffset = RDCMIN(offset - block * lz4BlockSize, m_PageLength);
+
+  return true;
+}
+
 bool LZ4Decompressor::Read(void *data, uint64_t numBytes)
 {
   // if we encountered a stream error this will be NULL
-  if(!m_CompressBuffer)
+  if(!m_Page[0])
     return false;
 
   if(numBytes == 0)
@@ -262,6 +471,59 @@ bool LZ4Decompressor::Read(void *data, uint64_t numBytes)
 
 bool LZ4Decompressor::FillPage0()
 {
+  if(!m_Blocks.empty())
+  {
+    bool success = true;
+
+    if(m_CurBlock < 0)
+    {
+      // first page, start reading ahead into every block
+      for(size_t i = 0; success && i < m_Blocks.size(); i++)
+        success &= QueueBlock(m_Blocks[i]);
+
+      m_CurBlock = 0;
+    }
+    else
+    {
+      // the current block has been consumed, re-use it to read further ahead
+      success &= QueueBlock(m_Blocks[m_CurBlock]);
+
+      m_CurBlock = (m_CurBlock + 1) % (int32_t)m_Blocks.size();
+    }
+
+    if(!success)
+      return false;
+
+    LZ4ParallelBlock &block = m_Blocks[m_CurBlock];
+
+    if(!block.job)
+    {
+      FreeBuffers();
+      SET_ERROR_RESULT(m_Error, ResultCode::CompressionFailed,
+                       "LZ4 decompression ran out of compressed blocks");
+      return false;
+    }
+
+    Threading::JobSystem::SyncJob(block.job);
+    block.job = NULL;
+
+    if(block.uncompSize < 0)
+    {
+      int32_t decompSize = block.uncompSize;
+
+      FreeBuffers();
+      SET_ERROR_RESULT(m_Error, ResultCode::CompressionFailed,
+                       "LZ4 decompression failed on block: %i", decompSize);
+      return false;
+    }
+
+    m_Page[0] = block.page;
+    m_PageOffset = 0;
+    m_PageLength = block.uncompSize;
+
+    return true;
+  }
+
   // swap pages
   std::swap(m_Page[0], m_Page[1]);
 
@@ -321,3 +583,50 @@ bool LZ4Decompressor::FillPage0()
 
   return success;
 }
+
+bool LZ4Decompressor::QueueBlock(LZ4ParallelBlock &block)
+{
+  block.job = NULL;
+
+  // if there's no more data the block stays empty, which marks the end of the stream
+  if(m_Read->AtEnd())
+    return true;
+
+  int32_t compSize = 0;
+
+  bool success = m_Read->Read(compSize);
+  if(!success || compSize < 0 || compSize > (int)LZ4_COMPRESSBOUND(lz4BlockSize))
+  {
+    if(success)
+    {
+      SET_ERROR_RESULT(m_Error, ResultCode::CompressionFailed,
+                       "LZ4 decompression encountered invalid compressed block size: %i", compSize);
+    }
+    else
+    {
+      m_Error = m_Read->GetError();
+    }
+
+    FreeBuffers();
+    return false;
+  }
+
+  success = m_Read->Read(block.compressed, compSize);
+
+  if(!success)
+  {
+    m_Error = m_Read->GetError();
+    FreeBuffers();
+    return false;
+  }
+
+  block.compSize = compSize;
+
+  // blocks written in parallel don't reference any previous history, so decompress independently
+  block.job = Threading::JobSystem::AddJob([&block]() {
+    block.uncompSize = LZ4_decompress_safe((const char *)block.compressed, (char *)block.page,
+                                           block.compSize, (int)lz4BlockSize);
+  });
+
+  return true;
+}
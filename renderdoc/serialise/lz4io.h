@@ -24,13 +24,27 @@
 
 #pragma once
 
+#include "common/threading.h"
 #include "lz4/lz4.h"
 #include "streamio.h"
 
+// In parallel mode each block is compressed independently of the ones before it, on the job system,
+// and written out in order. The on-disk format is identical - a sequence of compressed size and
+// data pairs - so parallel-written data can be decompressed by a serial decompressor. The reverse
+// isn't true, a parallel decompressor needs blocks that don't reference previous history.
+struct LZ4ParallelBlock
+{
+  byte *page = NULL;
+  byte *compressed = NULL;
+  int32_t uncompSize = 0;
+  int32_t compSize = 0;
+  Threading::JobSystem::Job *job = NULL;
+};
+
 class LZ4Compressor : public Compressor
 {
 public:
-  LZ4Compressor(StreamWriter *write, Ownership own);
+  LZ4Compressor(StreamWriter *write, Ownership own, bool parallel = false);
   ~LZ4Compressor();
 
   bool Write(const void *data, uint64_t numBytes);
@@ -38,25 +52,36 @@ public:
 
 private:
   bool FlushPage0();
+  bool WriteBlock(LZ4ParallelBlock &block);
+  void FreeBuffers();
 
   byte *m_Page[2];
   byte *m_CompressBuffer;
   uint64_t m_PageOffset;
 
   LZ4_stream_t *m_LZ4Comp;
+
+  // only used in parallel mode, a ring of blocks in flight. m_Page[0] points to the page of the
+  // block currently being filled
+  rdcarray<LZ4ParallelBlock> m_Blocks;
+  size_t m_CurBlock = 0;
 };
 
 class LZ4Decompressor : public Decompressor
 {
 public:
-  LZ4Decompressor(StreamReader *read, Ownership own);
+  LZ4Decompressor(StreamReader *read, Ownership own, bool parallel = false);
   ~LZ4Decompressor();
 
   bool Recompress(Compressor *comp);
   bool Read(void *data, uint64_t numBytes);
+  bool Seek(uint64_t offset);
 
 private:
   bool FillPage0();
+  bool HasMoreBlocks();
+  bool QueueBlock(LZ4ParallelBlock &block);
+  void FreeBuffers();
 
   byte *m_Page[2];
   byte *m_CompressBuffer;
@@ -64,4 +89,9 @@ private:
   uint64_t m_PageLength;
 
   LZ4_streamDecode_t *m_LZ4Decomp;
+
+  // only used in parallel mode, a ring of blocks being read ahead and decompressed. m_Page[0]
+  // points to the page of the block currently being consumed
+  rdcarray<LZ4ParallelBlock> m_Blocks;
+  int32_t m_CurBlock = -1;
 };
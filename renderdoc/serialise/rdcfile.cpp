@@ -24,14 +24,55 @@
 
 #include "rdcfile.h"
 #include <errno.h>
+#include <map>
 #include "api/replay/version.h"
 #include "common/dds_readwrite.h"
 #include "common/formatting.h"
+#include "common/threading.h"
+#include "core/settings.h"
 #include "jpeg-compressor/jpge.h"
 #include "stb/stb_image.h"
 #include "lz4io.h"
 #include "zstdio.h"
 
+RDOC_CONFIG(bool, Capture_ParallelCompression, true,
+            "Compress capture sections on multiple threads. LZ4 sections are written as "
+            "independent blocks, which compresses slightly less well but is much faster for large "
+            "captures and allows the section to be decompressed in parallel too.");
+
+RDOC_CONFIG(uint32_t, Capture_ZstdLevel, ZSTDCompressor::DefaultLevel,
+            "The compression level used for zstd compressed capture sections, from 1 (fastest) "
+            "to 22 (smallest).");
+
+RDOC_CONFIG(bool, Capture_ZstdArchive, false,
+            "Compress zstd compressed capture sections as a single frame with long distance "
+            "matching and a 128MB window, for archiving captures. This is smaller when large data "
+            "repeats, but is slower to write, can't be read from an arbitrary point, and can't be "
+            "opened by older versions.");
+
+RDOC_CONFIG(uint32_t, Capture_MemoryMapSectionThreshold, 1024 * 1024,
+            "Uncompressed capture sections at least this many bytes large are memory mapped for "
+            "reading instead of being read through a file. 0 disables memory mapping.");
+
+RDOC_CONFIG(bool, Capture_WriteBlockIndex, true,
+            "Write an index of compressed blocks alongside compressed capture sections, so they "
+            "can be read from any point without decompressing everything before it.");
+
+// files with sections currently memory mapped for reading, and how many mappings are live for each.
+// These files can't be modified in place: data moving underneath a mapping would corrupt what the
+// reader sees, and on posix truncating a mapped file makes reading the lost pages fault. Mappings
+// made by other processes can't be tracked, so a capture must not be modified by another program
+// while it's being read.
+static Threading::CriticalSection mappedFilesLock;
+static std::map<rdcstr, int32_t> mappedFiles;
+
+static bool HasLiveMappings(const rdcstr &filename)
+{
+  SCOPED_LOCK(mappedFilesLock);
+  auto it = mappedFiles.find(filename);
+  return it != mappedFiles.end() && it->second > 0;
+}
+
 // not provided by tinyexr, just do by hand
 bool is_exr_file(FILE *f)
 {
@@ -664,7 +705,11 @@ void RDCFile::Init(StreamReader &reader)
     return;
   }
 
-  int index = SectionIndex(SectionType::ExtendedThumbnail);
+  int index = SectionIndex(SectionType::BlockIndex);
+  if(index >= 0)
+    ReadBlockIndex(index);
+
+  index = SectionIndex(SectionType::ExtendedThumbnail);
   if(index >= 0)
   {
     StreamReader *thumbReader = ReadSection(index);
@@ -896,23 +941,67 @@ StreamReader *RDCFile::ReadSection(int index) const
 
   const SectionProperties &props = m_Sections[index];
   SectionLocation offsetSize = m_SectionLocations[index];
+
+  // large uncompressed sections are read straight from a mapping of the file, so the data isn't
+  // copied through a read buffer and can be handed out directly with ReadView()
+  uint32_t mapThreshold = Capture_MemoryMapSectionThreshold();
+  if(mapThreshold > 0 && offsetSize.diskLength >= mapThreshold &&
+     !(props.flags & (SectionFlags::LZ4Compressed | SectionFlags::ZstdCompressed)))
+  {
+    const byte *data = NULL;
+    FileIO::FileMapping *mapping =
+        FileIO::fmap(m_File, offsetSize.dataOffset, offsetSize.diskLength, &data);
+
+    if(mapping)
+    {
+      {
+        SCOPED_LOCK(mappedFilesLock);
+        mappedFiles[m_Filename]++;
+      }
+
+      rdcstr filename = m_Filename;
+
+      StreamReader *mappedReader =
+          new StreamReader(StreamReader::BorrowedMemory, data, offsetSize.diskLength);
+      mappedReader->AddCloseCallback([mapping, filename]() {
+        FileIO::funmap(mapping);
+
+        SCOPED_LOCK(mappedFilesLock);
+        if(--mappedFiles[filename] <= 0)
+          mappedFiles.erase(filename);
+      });
+      return mappedReader;
+    }
+  }
+
   FileIO::fseek64(m_File, offsetSize.dataOffset, SEEK_SET);
 
   StreamReader *fileReader = new StreamReader(m_File, offsetSize.diskLength, Ownership::Nothing);
 
   StreamReader *compReader = NULL;
 
+  Decompressor *decompressor = NULL;
+
   if(props.flags & SectionFlags::LZ4Compressed)
   {
-    // the user will delete the compressed reader, and then it will delete the compressor and the
-    // file reader
-    compReader = new StreamReader(new LZ4Decompressor(fileReader, Ownership::Stream),
-                                  props.uncompressedSize, Ownership::Stream);
+    decompressor = new LZ4Decompressor(fileReader, Ownership::Stream,
+                                       bool(props.flags & SectionFlags::LZ4IndependentBlocks));
   }
   else if(props.flags & SectionFlags::ZstdCompressed)
   {
-    compReader = new StreamReader(new ZSTDDecompressor(fileReader, Ownership::Stream),
-                                  props.uncompressedSize, Ownership::Stream);
+    decompressor = new ZSTDDecompressor(fileReader, Ownership::Stream,
+                                        bool(props.flags & SectionFlags::ZstdArchive));
+  }
+
+  if(decompressor)
+  {
+    const CompressedBlockIndex *blockIndex = FindBlockIndex(index);
+    if(blockIndex)
+      decompressor->SetBlockIndex(*blockIndex);
+
+    // the user will delete the compressed reader, and then it will delete the compressor and the
+    // file reader
+    compReader = new StreamReader(decompressor, props.uncompressedSize, Ownership::Stream);
   }
 
   // if we're compressing return that writer, otherwise return the file writer directly
@@ -920,6 +1009,74 @@ StreamReader *RDCFile::ReadSection(int index) const
 }
 
 StreamWriter *RDCFile::WriteSection(const SectionProperties &props)
+{
+  return BeginSection(props, false, NULL);
+}
+
+RDResult RDCFile::CopySection(const RDCFile &source, int index,
+                              RENDERDOC_ProgressCallback progress)
+{
+  if(index < 0 || index >= source.NumSections())
+    RETURN_ERROR_RESULT(ResultCode::InvalidParameter, "Invalid section index %d to copy", index);
+
+  const SectionProperties &props = source.GetSectionProperties(index);
+
+  StreamReader *reader = NULL;
+  StreamWriter *writer = NULL;
+
+  if(source.m_File)
+  {
+    // read the data as it is on disk, bypassing any decompression
+    const SectionLocation &loc = source.m_SectionLocations[index];
+
+    FileIO::fseek64(source.m_File, loc.dataOffset, SEEK_SET);
+
+    reader = new StreamReader(source.m_File, loc.diskLength, Ownership::Nothing);
+    writer = BeginSection(props, true, source.FindSectionBlockIndex(index));
+  }
+  else
+  {
+    // sections cached in memory are stored uncompressed, so they need to be compressed as normal
+    reader = source.ReadSection(index);
+    writer = BeginSection(props, false, NULL);
+  }
+
+  StreamTransfer(writer, reader, progress);
+
+  writer->Finish();
+
+  RDResult ret = writer->GetError();
+  if(ret == ResultCode::Succeeded)
+    ret = reader->GetError();
+
+  delete reader;
+  delete writer;
+
+  return ret;
+}
+
+bool RDCFile::IsCompressedAsConfigured(int index) const
+{
+  if(index < 0 || index >= NumSections())
+    return false;
+
+  if(!(m_Sections[index].flags & SectionFlags::ZstdCompressed))
+    return true;
+
+  if(bool(m_Sections[index].flags & SectionFlags::ZstdArchive) != Capture_ZstdArchive())
+    return false;
+
+  const SectionBlockIndex *blockIndex = FindSectionBlockIndex(index);
+
+  uint32_t level = (uint32_t)ZSTDCompressor::DefaultLevel;
+  if(blockIndex && blockIndex->zstdLevel != 0)
+    level = blockIndex->zstdLevel;
+
+  return level == Capture_ZstdLevel();
+}
+
+StreamWriter *RDCFile::BeginSection(const SectionProperties &props, bool raw,
+                                    const SectionBlockIndex *rawIndex)
 {
   if(m_Error != ResultCode::Succeeded)
     return new StreamWriter(StreamWriter::InvalidStream);
@@ -999,7 +1156,121 @@ StreamWriter *RDCFile::WriteSection(const SectionProperties &props)
 
   if(SectionIndex(type) >= 0 || SectionIndex(name) >= 0)
   {
-    if(type == SectionType::FrameCapture || name == ToStr(SectionType::FrameCapture))
+    bool isFrameCapture =
+        type == SectionType::FrameCapture || name == ToStr(SectionType::FrameCapture);
+
+    // the frame capture with other sections is always written to a new file below. Anything else
+    // is modified in place, which we can't do while part of the file is mapped for reading. In that
+    // case write a new file with the other sections copied across and the section appended, then
+    // move it over the original. Existing mappings keep seeing the old file's data.
+    if(!(isFrameCapture && NumSections() > 1) && HasLiveMappings(m_Filename))
+    {
+      int index = SectionIndex(type);
+
+      if(index < 0)
+        index = SectionIndex(name);
+
+      RDCASSERT(index >= 0);
+
+      FILE *origFile = m_File;
+      rdcstr origFilename = m_Filename;
+
+      rdcarray<SectionProperties> origSections = m_Sections;
+      rdcarray<SectionLocation> origSectionLocations = m_SectionLocations;
+
+      origSections.erase(index);
+      origSectionLocations.erase(index);
+
+      rdcarray<SectionProperties> savedSections = m_Sections;
+      rdcarray<SectionLocation> savedSectionLocations = m_SectionLocations;
+      rdcarray<SectionBlockIndex> savedBlockIndices = m_BlockIndices;
+      bool savedBlockIndexDirty = m_BlockIndexDirty;
+
+      m_Sections.clear();
+      m_SectionLocations.clear();
+
+      // write next to the capture so the final move is a rename on the same filesystem
+      rdcstr tempFilename = origFilename + ".rewrite";
+
+      // Create leaves the new file open read-only, re-open it to write the sections
+      Create(tempFilename);
+      if(m_File)
+      {
+        FileIO::fclose(m_File);
+        m_File = FileIO::fopen(m_Filename, FileIO::UpdateBinary);
+      }
+
+      // if that failed the original file is untouched, so leave it as it was
+      if(m_File == NULL)
+      {
+        RDResult res;
+        SET_ERROR_RESULT(res, ResultCode::FileIOFailed,
+                         "Couldn't create '%s' to rewrite capture with mapped sections",
+                         tempFilename.c_str());
+        m_Error = RDResult();
+        m_File = origFile;
+        m_Filename = origFilename;
+        m_Sections = savedSections;
+        m_SectionLocations = savedSectionLocations;
+        return new StreamWriter(StreamWriter::InvalidStream, res);
+      }
+
+      FileIO::fseek64(m_File, 0, SEEK_END);
+
+      // copy the other sections, header and data together, to the new file
+      for(size_t i = 0; i < origSections.size(); i++)
+      {
+        SectionLocation loc = origSectionLocations[i];
+
+        FileIO::fseek64(origFile, loc.headerOffset, SEEK_SET);
+
+        uint64_t newHeaderOffset = FileIO::ftell64(m_File);
+        uint64_t headerLen = loc.dataOffset - loc.headerOffset;
+
+        loc.headerOffset = newHeaderOffset;
+        loc.dataOffset = newHeaderOffset + headerLen;
+
+        StreamWriter writer(m_File, Ownership::Nothing);
+        StreamReader reader(origFile, headerLen + loc.diskLength, Ownership::Nothing);
+
+        m_Sections.push_back(origSections[i]);
+        m_SectionLocations.push_back(loc);
+
+        StreamTransfer(&writer, &reader, NULL);
+      }
+
+      FileIO::fclose(origFile);
+
+      // once the new section is written, move the new file over the original and re-open it.
+      modifySectionCallback = [this, origFilename, tempFilename, savedSections,
+                               savedSectionLocations, savedBlockIndices, savedBlockIndexDirty]() {
+        FileIO::fclose(m_File);
+
+        m_Filename = origFilename;
+
+        // if the original can't be replaced (e.g. on windows a mapped file can't be deleted) then
+        // it's unmodified, so the section tables must go back to describing it. We can't copy the
+        // new file's contents over it instead, as that would change the data under the mappings.
+        if(!FileIO::Move(tempFilename, origFilename, true))
+        {
+          RDCERR("Couldn't replace '%s' with rewritten capture, section '%s' was not written: %s",
+                 origFilename.c_str(), m_Sections.back().name.c_str(),
+                 FileIO::ErrorString().c_str());
+
+          FileIO::Delete(tempFilename);
+
+          m_Sections = savedSections;
+          m_SectionLocations = savedSectionLocations;
+          m_BlockIndices = savedBlockIndices;
+          m_BlockIndexDirty = savedBlockIndexDirty;
+        }
+
+        m_File = FileIO::fopen(m_Filename, FileIO::UpdateBinary);
+      };
+
+      // fall through - we write the new section at the end of the new file
+    }
+    else if(isFrameCapture)
     {
       // simple case - if there are no other sections then we can just overwrite the existing frame
       // capture.
@@ -1103,10 +1374,11 @@ StreamWriter *RDCFile::WriteSection(const SectionProperties &props)
     }
     else
     {
-      // we're writing some section after the frame capture. We'll do this in-place by reading the
-      // other sections out to memory (assuming that they are mostly small, and even if they are
-      // somewhat large, it's still much better to leave the frame capture (which should dominate
-      // file size) on disk where it is.
+      // we're writing some section after the frame capture. We'll do this in-place by moving any
+      // sections after it up over where it was, leaving the frame capture (which should dominate
+      // file size) on disk where it is. Sections are stored back to back, so everything after the
+      // removed section moves by the same amount and can be copied in one pass through a bounded
+      // buffer, without reading whole sections into memory or touching their contents.
       int index = SectionIndex(type);
 
       if(index < 0)
@@ -1114,60 +1386,56 @@ StreamWriter *RDCFile::WriteSection(const SectionProperties &props)
 
       RDCASSERT(index >= 0);
 
-      rdcarray<bytebuf> origSectionData;
-      rdcarray<uint64_t> origHeaderSizes;
-
       uint64_t overwriteLocation = m_SectionLocations[index].headerOffset;
       uint64_t oldLength = m_SectionLocations[index].diskLength;
+      uint64_t moveFrom = m_SectionLocations[index].dataOffset + oldLength;
+      uint64_t moveEnd = moveFrom;
+      if(index + 1 < NumSections())
+        moveEnd = m_SectionLocations.back().dataOffset + m_SectionLocations.back().diskLength;
 
       // erase the target section. The others will be moved up to match
       m_Sections.erase(index);
       m_SectionLocations.erase(index);
 
-      origSectionData.reserve(NumSections() - index);
-      origHeaderSizes.reserve(NumSections() - index);
+      uint64_t delta = moveFrom - overwriteLocation;
 
-      // go through all subsequent sections after this one in the file, read them into memory.
-      // this could be optimised since we're going to write them back out below, we could do this
-      // just with an in-memory window large enough.
-      for(int i = index; i < NumSections(); i++)
+      // we write the sections now over where the old section used to be, so the newly written
+      // section is last in the file. This means if the same section is updated over and over, it
+      // doesn't require moving any sections once it's already at the end. The destination is
+      // always before the source so copying front to back never overwrites data not yet moved.
+      if(moveEnd > moveFrom)
       {
-        const SectionLocation &loc = m_SectionLocations[i];
+        FileIO::fflush(m_File);
 
-        FileIO::fseek64(m_File, loc.headerOffset, SEEK_SET);
+        bytebuf moveBuffer;
+        moveBuffer.resize((size_t)RDCMIN(moveEnd - moveFrom, uint64_t(16 * 1024 * 1024)));
 
-        uint64_t headerLen = loc.dataOffset - loc.headerOffset;
+        for(uint64_t offs = moveFrom; offs < moveEnd;)
+        {
+          size_t chunkSize = (size_t)RDCMIN(moveEnd - offs, uint64_t(moveBuffer.size()));
 
-        // read header and data together
-        StreamReader reader(m_File, headerLen + loc.diskLength, Ownership::Nothing);
+          if(!FileIO::fpread(m_File, moveBuffer.data(), chunkSize, offs) ||
+             !FileIO::fpwrite(m_File, moveBuffer.data(), chunkSize, offs - delta))
+          {
+            SET_ERROR_RESULT(m_Error, ResultCode::FileIOFailed,
+                             "Error moving sections to overwrite section '%s': %s", name.c_str(),
+                             FileIO::ErrorString().c_str());
+            return new StreamWriter(StreamWriter::InvalidStream);
+          }
 
-        origHeaderSizes.push_back(headerLen);
-        origSectionData.push_back(bytebuf());
+          offs += chunkSize;
+        }
 
-        bytebuf &data = origSectionData.back();
-        data.resize((size_t)reader.GetSize());
-        reader.Read(data.data(), data.size());
+        // update the offsets to where they are in the file now
+        for(int i = index; i < NumSections(); i++)
+        {
+          m_SectionLocations[i].headerOffset -= delta;
+          m_SectionLocations[i].dataOffset -= delta;
+        }
       }
 
-      // we write the sections now over where the old section used to be, so the newly written
-      // section is last in the file. This means if the same section is updated over and over, it
-      // doesn't require moving any sections once it's already at the end.
-
-      // seek to write to where the removed section started
-      FileIO::fseek64(m_File, overwriteLocation, SEEK_SET);
-
-      // write the old sections
-      for(size_t i = 0; i < origSectionData.size(); i++)
-      {
-        // update the offsets to where they are in the new file
-        m_SectionLocations[index + i].headerOffset = FileIO::ftell64(m_File);
-        m_SectionLocations[index + i].dataOffset =
-            m_SectionLocations[index + i].headerOffset + origHeaderSizes[i];
-
-        // write the data
-        StreamWriter writer(m_File, Ownership::Nothing);
-        writer.Write(origSectionData[i].data(), origSectionData[i].size());
-      }
+      // seek to write after the moved sections
+      FileIO::fseek64(m_File, moveEnd - delta, SEEK_SET);
 
       // after writing, we need to be sure to fixup the size (in case we wrote less data).
       modifySectionCallback = [this, oldLength]() {
@@ -1190,6 +1458,19 @@ StreamWriter *RDCFile::WriteSection(const SectionProperties &props)
 
   uint64_t headerOffset = FileIO::ftell64(m_File);
 
+  // whether LZ4 blocks are independent or zstd is one frame depends on how we compress now, not on
+  // how the section was compressed if it came from another file.
+  SectionFlags flags =
+      props.flags & ~(SectionFlags::LZ4IndependentBlocks | SectionFlags::ZstdArchive);
+  if((flags & SectionFlags::LZ4Compressed) && Capture_ParallelCompression())
+    flags |= SectionFlags::LZ4IndependentBlocks;
+  if((flags & SectionFlags::ZstdCompressed) && Capture_ZstdArchive())
+    flags |= SectionFlags::ZstdArchive;
+
+  // raw data was already compressed, so its flags stay exactly as they were
+  if(raw)
+    flags = props.flags;
+
   size_t numWritten;
 
   // write section header
@@ -1206,7 +1487,7 @@ StreamWriter *RDCFile::WriteSection(const SectionProperties &props)
                                 // sectionVersion
                                 props.version,
                                 // sectionFlags
-                                props.flags,
+                                flags,
                                 // sectionNameLength
                                 uint32_t(name.length() + 1)};
 
@@ -1225,27 +1506,61 @@ StreamWriter *RDCFile::WriteSection(const SectionProperties &props)
   StreamWriter *fileWriter = new StreamWriter(m_File, Ownership::Nothing);
 
   StreamWriter *compWriter = NULL;
+  Compressor *compressor = NULL;
 
-  if(props.flags & SectionFlags::LZ4Compressed)
+  if(raw)
   {
-    // the user will delete the compressed writer, and then it will delete the compressor and the
-    // file writer
-    compWriter =
-        new StreamWriter(new LZ4Compressor(fileWriter, Ownership::Stream), Ownership::Stream);
+    // no compression, the data is written as-is
+  }
+  else if(props.flags & SectionFlags::LZ4Compressed)
+  {
+    compressor = new LZ4Compressor(fileWriter, Ownership::Stream,
+                                   bool(flags & SectionFlags::LZ4IndependentBlocks));
   }
   else if(props.flags & SectionFlags::ZstdCompressed)
   {
-    compWriter =
-        new StreamWriter(new ZSTDCompressor(fileWriter, Ownership::Stream), Ownership::Stream);
+    compressor = new ZSTDCompressor(fileWriter, Ownership::Stream, (int)Capture_ZstdLevel(),
+                                    Capture_ParallelCompression(),
+                                    bool(flags & SectionFlags::ZstdArchive));
   }
 
+  // the user will delete the compressed writer, and then it will delete the compressor and the
+  // file writer
+  if(compressor)
+    compWriter = new StreamWriter(compressor, Ownership::Stream);
+
+  // chained LZ4 blocks depend on the previous block and a zstd archive is a single frame, so they
+  // can't be indexed
+  bool writeIndex = compressor && Capture_WriteBlockIndex() && type != SectionType::BlockIndex &&
+                    !(flags & SectionFlags::ZstdArchive) &&
+                    (!(flags & SectionFlags::LZ4Compressed) ||
+                     (flags & SectionFlags::LZ4IndependentBlocks));
+
   uint64_t dataOffset = FileIO::ftell64(m_File);
 
   m_CurrentWritingProps = props;
   m_CurrentWritingProps.name = name;
+  m_CurrentWritingProps.flags = flags;
+
+  // the uncompressed length of raw data can't be measured from what's written, so it comes from
+  // the properties, as does any index that's copied across with it
+  uint64_t rawUncompressedLength = props.uncompressedSize;
+  bool copyIndex = raw && rawIndex != NULL;
+  CompressedBlockIndex copiedIndex;
+  if(copyIndex)
+    copiedIndex = rawIndex->index;
+
+  // the zstd level is recorded in the block index, so that copies can tell if it matches
+  uint32_t zstdLevel = 0;
+  if(copyIndex)
+    zstdLevel = rawIndex->zstdLevel;
+  else if(!raw && (flags & SectionFlags::ZstdCompressed))
+    zstdLevel = Capture_ZstdLevel();
 
   // register a destroy callback to tidy up the section at the end
-  fileWriter->AddCloseCallback([this, type, name, headerOffset, dataOffset, fileWriter, compWriter]() {
+  fileWriter->AddCloseCallback([this, type, name, headerOffset, dataOffset, fileWriter, compWriter,
+                                compressor, writeIndex, raw, rawUncompressedLength, copyIndex,
+                                copiedIndex, zstdLevel]() {
     FileIO::fflush(m_File);
 
     // the offset of the file writer is how many bytes were written to disk - the compressed length.
@@ -1255,6 +1570,8 @@ StreamWriter *RDCFile::WriteSection(const SectionProperties &props)
     uint64_t uncompressedLength = compressedLength;
     if(compWriter)
       uncompressedLength = compWriter->GetOffset();
+    else if(raw)
+      uncompressedLength = rawUncompressedLength;
 
     RDCLOG("Finishing write to section %u (%s). Compressed from %llu bytes to %llu (%.2f %%)", type,
            name.c_str(), uncompressedLength, compressedLength,
@@ -1273,6 +1590,42 @@ StreamWriter *RDCFile::WriteSection(const SectionProperties &props)
 
     m_CurrentWritingProps = SectionProperties();
 
+    // any existing index for this section is now stale
+    for(size_t i = 0; i < m_BlockIndices.size(); i++)
+    {
+      if(m_BlockIndices[i].name == name)
+      {
+        m_BlockIndices.erase(i);
+        m_BlockIndexDirty = true;
+        break;
+      }
+    }
+
+    // the file writer is destroyed by the compressor's base destructor, so the compressor's block
+    // index is still available here.
+    if(writeIndex)
+    {
+      SectionBlockIndex blockIndex;
+      blockIndex.name = name;
+      blockIndex.compressedSize = compressedLength;
+      blockIndex.uncompressedSize = uncompressedLength;
+      blockIndex.zstdLevel = zstdLevel;
+      blockIndex.index = compressor->GetBlockIndex();
+      m_BlockIndices.push_back(blockIndex);
+      m_BlockIndexDirty = true;
+    }
+    else if(copyIndex)
+    {
+      SectionBlockIndex blockIndex;
+      blockIndex.name = name;
+      blockIndex.compressedSize = compressedLength;
+      blockIndex.uncompressedSize = uncompressedLength;
+      blockIndex.zstdLevel = zstdLevel;
+      blockIndex.index = copiedIndex;
+      m_BlockIndices.push_back(blockIndex);
+      m_BlockIndexDirty = true;
+    }
+
     FileIO::fseek64(m_File, headerOffset + offsetof(BinarySectionHeader, sectionCompressedLength),
                     SEEK_SET);
 
@@ -1303,10 +1656,173 @@ StreamWriter *RDCFile::WriteSection(const SectionProperties &props)
     FileIO::fseek64(m_File, prevPos, SEEK_SET);
   });
 
+  // once the section is completely written, update the block index section if it changed
+  if(type != SectionType::BlockIndex)
+  {
+    fileWriter->AddCloseCallback([this]() {
+      if(m_BlockIndexDirty)
+      {
+        m_BlockIndexDirty = false;
+        WriteBlockIndex();
+      }
+    });
+  }
+
   // if we're compressing return that writer, otherwise return the file writer directly
   return compWriter ? compWriter : fileWriter;
 }
 
+/*
+
+ Block index section format, version 2:
+
+ uint32_t numIndices;
+
+ BlockIndex
+ {
+   uint32_t nameLength; // byte length of the section name below, with no null terminator
+   char name[nameLength]; // name of the section this indexes
+
+   uint64_t compressedSize; // the compressed and uncompressed sizes of the section when this index
+   uint64_t uncompressedSize; // was written, to identify an index that has become stale
+
+   uint32_t zstdLevel; // the level of a zstd compressed section, 0 if unknown. Not in version 1
+
+   uint64_t blockSize; // the uncompressed size of every block except the last
+   uint64_t numBlocks;
+   uint64_t offsets[numBlocks]; // offset of each block relative to the start of the section data
+ }
+
+ BlockIndex indices[numIndices];
+
+*/
+
+void RDCFile::ReadBlockIndex(int index)
+{
+  const SectionProperties &props = m_Sections[index];
+
+  if(props.version < 1 || props.version > 2 ||
+     (props.flags & (SectionFlags::LZ4Compressed | SectionFlags::ZstdCompressed)))
+  {
+    RDCWARN("Ignoring unsupported block index section");
+    return;
+  }
+
+  StreamReader *reader = ReadSection(index);
+
+  uint32_t numIndices = 0;
+  reader->Read(numIndices);
+
+  for(uint32_t i = 0; i < numIndices && !reader->IsErrored(); i++)
+  {
+    SectionBlockIndex blockIndex;
+
+    uint32_t nameLength = 0;
+    reader->Read(nameLength);
+
+    if(nameLength > 2 * 1024)
+    {
+      RDCWARN("Invalid section name length %u in block index", nameLength);
+      break;
+    }
+
+    blockIndex.name.resize(nameLength);
+    reader->Read(blockIndex.name.data(), nameLength);
+
+    uint64_t numBlocks = 0;
+    reader->Read(blockIndex.compressedSize);
+    reader->Read(blockIndex.uncompressedSize);
+    if(props.version >= 2)
+      reader->Read(blockIndex.zstdLevel);
+    reader->Read(blockIndex.index.blockSize);
+    reader->Read(numBlocks);
+
+    // the number of blocks must be consistent with the size of the section. Allow for one trailing
+    // empty block
+    uint64_t expectedBlocks = 0;
+    if(blockIndex.index.blockSize > 0)
+      expectedBlocks = (blockIndex.uncompressedSize + blockIndex.index.blockSize - 1) /
+                       blockIndex.index.blockSize;
+
+    if(blockIndex.index.blockSize == 0 || numBlocks < expectedBlocks ||
+       numBlocks > expectedBlocks + 1)
+    {
+      RDCWARN("Invalid block count %llu in block index for section '%s'", numBlocks,
+              blockIndex.name.c_str());
+      break;
+    }
+
+    blockIndex.index.offsets.resize((size_t)numBlocks);
+    reader->Read(blockIndex.index.offsets.data(), numBlocks * sizeof(uint64_t));
+
+    if(!reader->IsErrored())
+      m_BlockIndices.push_back(blockIndex);
+  }
+
+  if(reader->IsErrored())
+    RDCWARN("Error reading block index section: %s",
+            ResultDetails(reader->GetError()).Message().c_str());
+
+  delete reader;
+}
+
+void RDCFile::WriteBlockIndex()
+{
+  SectionProperties props;
+  props.type = SectionType::BlockIndex;
+  props.version = 2;
+
+  StreamWriter *writer = WriteSection(props);
+
+  writer->Write((uint32_t)m_BlockIndices.size());
+
+  for(const SectionBlockIndex &blockIndex : m_BlockIndices)
+  {
+    writer->Write((uint32_t)blockIndex.name.size());
+    writer->Write(blockIndex.name.data(), blockIndex.name.size());
+    writer->Write(blockIndex.compressedSize);
+    writer->Write(blockIndex.uncompressedSize);
+    writer->Write(blockIndex.zstdLevel);
+    writer->Write(blockIndex.index.blockSize);
+    writer->Write((uint64_t)blockIndex.index.offsets.size());
+    writer->Write(blockIndex.index.offsets.data(),
+                  blockIndex.index.offsets.size() * sizeof(uint64_t));
+  }
+
+  writer->Finish();
+
+  if(writer->IsErrored())
+    RDCERR("Error writing block index section: %s",
+           ResultDetails(writer->GetError()).Message().c_str());
+
+  delete writer;
+}
+
+const RDCFile::SectionBlockIndex *RDCFile::FindSectionBlockIndex(int index) const
+{
+  const SectionProperties &props = m_Sections[index];
+
+  // chained LZ4 blocks can't be seeked even with an index
+  if((props.flags & SectionFlags::LZ4Compressed) &&
+     !(props.flags & SectionFlags::LZ4IndependentBlocks))
+    return NULL;
+
+  for(const SectionBlockIndex &blockIndex : m_BlockIndices)
+  {
+    if(blockIndex.name == props.name && blockIndex.compressedSize == props.compressedSize &&
+       blockIndex.uncompressedSize == props.uncompressedSize)
+      return &blockIndex;
+  }
+
+  return NULL;
+}
+
+const CompressedBlockIndex *RDCFile::FindBlockIndex(int index) const
+{
+  const SectionBlockIndex *blockIndex = FindSectionBlockIndex(index);
+  return blockIndex ? &blockIndex->index : NULL;
+}
+
 FILE *RDCFile::StealImageFileHandle(rdcstr &filename)
 {
   if(m_Driver != RDCDriver::Image)
@@ -1321,3 +1837,337 @@ FILE *RDCFile::StealImageFileHandle(rdcstr &filename)
   m_File = NULL;
   return ret;
 }
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+#include "core/core.h"
+
+static bytebuf ReadRDCSection(const RDCFile &rdc, const rdcstr &name)
+{
+  bytebuf ret;
+
+  int index = rdc.SectionIndex(name);
+  if(index < 0)
+    return ret;
+
+  StreamReader *reader = rdc.ReadSection(index);
+  ret.resize((size_t)reader->GetSize());
+  reader->Read(ret.data(), ret.size());
+  delete reader;
+
+  return ret;
+}
+
+static void WriteRDCSection(RDCFile &rdc, SectionType type, const rdcstr &name, SectionFlags flags,
+                            const bytebuf &contents)
+{
+  SectionProperties props;
+  props.type = type;
+  props.name = name;
+  props.flags = flags;
+
+  StreamWriter *writer = rdc.WriteSection(props);
+  writer->Write(contents.data(), contents.size());
+  writer->Finish();
+  delete writer;
+}
+
+TEST_CASE("Edit and copy capture file sections", "[rdcfile]")
+{
+  rdcstr filename = FileIO::GetTempFolderFilename() + "/renderdoc_rdcfile_test.rdc";
+  rdcstr copyFilename = FileIO::GetTempFolderFilename() + "/renderdoc_rdcfile_copy_test.rdc";
+
+  // contents that compress, but not to nothing
+  auto makeContents = [](size_t size, byte seed) {
+    bytebuf ret;
+    ret.resize(size);
+    for(size_t i = 0; i < size; i++)
+      ret[i] = byte((i / 13) * seed + (i % 7));
+    return ret;
+  };
+
+  bytebuf frame = makeContents(3 * 1024 * 1024, 3);
+  bytebuf a = makeContents(200 * 1024, 5);
+  bytebuf b = makeContents(70 * 1024, 7);
+  bytebuf c = makeContents(150 * 1024, 11);
+
+  {
+    RDCFile rdc;
+    rdc.SetData(RDCDriver::Vulkan, "Vulkan", 0, NULL, 0, 1.0);
+    rdc.Create(filename);
+    REQUIRE(rdc.Error().code == ResultCode::Succeeded);
+
+    WriteRDCSection(rdc, SectionType::FrameCapture, "", SectionFlags::ZstdCompressed, frame);
+    WriteRDCSection(rdc, SectionType::Unknown, "a", SectionFlags::LZ4Compressed, a);
+    WriteRDCSection(rdc, SectionType::Unknown, "b", SectionFlags::NoFlags, b);
+    WriteRDCSection(rdc, SectionType::Unknown, "c", SectionFlags::ZstdCompressed, c);
+
+    REQUIRE(rdc.Error().code == ResultCode::Succeeded);
+
+    uint64_t prevSize = FileIO::GetFileSize(filename);
+
+    // replacing a section in the middle moves the following sections up and appends it after them
+    a = makeContents(20 * 1024, 13);
+    WriteRDCSection(rdc, SectionType::Unknown, "a", SectionFlags::LZ4Compressed, a);
+
+    REQUIRE(rdc.Error().code == ResultCode::Succeeded);
+
+    CHECK(rdc.SectionIndex("a") > rdc.SectionIndex("c"));
+    CHECK(FileIO::GetFileSize(filename) < prevSize);
+    CHECK((ReadRDCSection(rdc, "b") == b));
+    CHECK((ReadRDCSection(rdc, "c") == c));
+    CHECK((ReadRDCSection(rdc, "a") == a));
+  }
+
+  // the edits are all on disk, and the file was truncated to fit the smaller section
+  {
+    RDCFile rdc;
+    rdc.Open(filename);
+    REQUIRE(rdc.Error().code == ResultCode::Succeeded);
+
+    CHECK((ReadRDCSection(rdc, ToStr(SectionType::FrameCapture)) == frame));
+    CHECK((ReadRDCSection(rdc, "a") == a));
+    CHECK((ReadRDCSection(rdc, "b") == b));
+    CHECK((ReadRDCSection(rdc, "c") == c));
+
+    // copying sections to another file writes them byte-for-byte
+    RDCFile copy;
+    copy.SetData(rdc.GetDriver(), rdc.GetDriverName(), rdc.GetMachineIdent(), NULL,
+                 rdc.GetTimestampBase(), rdc.GetTimestampFrequency());
+    copy.Create(copyFilename);
+    REQUIRE(copy.Error().code == ResultCode::Succeeded);
+
+    for(int i = 0; i < rdc.NumSections(); i++)
+    {
+      if(rdc.GetSectionProperties(i).type == SectionType::BlockIndex)
+        continue;
+
+      CHECK(copy.CopySection(rdc, i).code == ResultCode::Succeeded);
+
+      const SectionProperties &src = rdc.GetSectionProperties(i);
+      const SectionProperties &dst = copy.GetSectionProperties(copy.SectionIndex(src.name));
+      CHECK(dst.flags == src.flags);
+      CHECK(dst.compressedSize == src.compressedSize);
+      CHECK(dst.uncompressedSize == src.uncompressedSize);
+    }
+
+    CHECK((ReadRDCSection(copy, ToStr(SectionType::FrameCapture)) == frame));
+    CHECK((ReadRDCSection(copy, "a") == a));
+    CHECK((ReadRDCSection(copy, "b") == b));
+    CHECK((ReadRDCSection(copy, "c") == c));
+  }
+
+  FileIO::Delete(filename);
+  FileIO::Delete(copyFilename);
+}
+
+TEST_CASE("Capture file sections record their zstd level", "[rdcfile]")
+{
+  rdcstr filename = FileIO::GetTempFolderFilename() + "/renderdoc_rdcfile_level_test.rdc";
+  rdcstr copyFilename = FileIO::GetTempFolderFilename() + "/renderdoc_rdcfile_level_copy_test.rdc";
+
+  bytebuf contents;
+  contents.resize(512 * 1024);
+  for(size_t i = 0; i < contents.size(); i++)
+    contents[i] = byte((i / 13) * 3 + (i % 7));
+
+  uint64_t &level = RenderDoc::Inst().SetConfigSetting("Capture.ZstdLevel")->data.basic.u;
+  const uint64_t prevLevel = level;
+
+  level = 3;
+
+  {
+    RDCFile rdc;
+    rdc.SetData(RDCDriver::Vulkan, "Vulkan", 0, NULL, 0, 1.0);
+    rdc.Create(filename);
+    REQUIRE(rdc.Error().code == ResultCode::Succeeded);
+
+    WriteRDCSection(rdc, SectionType::FrameCapture, "", SectionFlags::ZstdCompressed, contents);
+    WriteRDCSection(rdc, SectionType::Unknown, "a", SectionFlags::LZ4Compressed, contents);
+
+    REQUIRE(rdc.Error().code == ResultCode::Succeeded);
+
+    CHECK(rdc.IsCompressedAsConfigured(0));
+    CHECK(rdc.IsCompressedAsConfigured(1));
+  }
+
+  {
+    // the level is read back from the block index
+    RDCFile rdc;
+    rdc.Open(filename);
+    REQUIRE(rdc.Error().code == ResultCode::Succeeded);
+
+    const int frameIndex = rdc.SectionIndex(SectionType::FrameCapture);
+    const int aIndex = rdc.SectionIndex("a");
+
+    CHECK(rdc.IsCompressedAsConfigured(frameIndex));
+
+    level = 9;
+
+    // only zstd sections depend on the level
+    CHECK_FALSE(rdc.IsCompressedAsConfigured(frameIndex));
+    CHECK(rdc.IsCompressedAsConfigured(aIndex));
+
+    // a raw copy keeps the level it was compressed at
+    level = 3;
+
+    RDCFile copy;
+    copy.SetData(rdc.GetDriver(), rdc.GetDriverName(), rdc.GetMachineIdent(), NULL,
+                 rdc.GetTimestampBase(), rdc.GetTimestampFrequency());
+    copy.Create(copyFilename);
+    REQUIRE(copy.Error().code == ResultCode::Succeeded);
+
+    CHECK(copy.CopySection(rdc, frameIndex).code == ResultCode::Succeeded);
+
+    level = 9;
+
+    CHECK_FALSE(copy.IsCompressedAsConfigured(copy.SectionIndex(SectionType::FrameCapture)));
+  }
+
+  level = prevLevel;
+
+  FileIO::Delete(filename);
+  FileIO::Delete(copyFilename);
+}
+
+TEST_CASE("Capture file sections compressed as a zstd archive", "[rdcfile]")
+{
+  rdcstr filename = FileIO::GetTempFolderFilename() + "/renderdoc_rdcfile_archive_test.rdc";
+
+  // random data repeated, so that archiving makes a difference
+  bytebuf contents;
+  contents.resize(2 * 1024 * 1024);
+  for(size_t i = 0; i < contents.size() / 4; i++)
+    contents[i] = byte(rand() & 0xff);
+  for(size_t i = contents.size() / 4; i < contents.size(); i++)
+    contents[i] = contents[i % (contents.size() / 4)];
+
+  bool &archive = RenderDoc::Inst().SetConfigSetting("Capture.ZstdArchive")->data.basic.b;
+  const bool prevArchive = archive;
+
+  archive = true;
+
+  {
+    RDCFile rdc;
+    rdc.SetData(RDCDriver::Vulkan, "Vulkan", 0, NULL, 0, 1.0);
+    rdc.Create(filename);
+    REQUIRE(rdc.Error().code == ResultCode::Succeeded);
+
+    WriteRDCSection(rdc, SectionType::FrameCapture, "", SectionFlags::ZstdCompressed, contents);
+    WriteRDCSection(rdc, SectionType::Unknown, "a", SectionFlags::LZ4Compressed, contents);
+
+    REQUIRE(rdc.Error().code == ResultCode::Succeeded);
+
+    // only zstd sections are archived
+    CHECK(rdc.GetSectionProperties(0).flags ==
+          (SectionFlags::ZstdCompressed | SectionFlags::ZstdArchive));
+    CHECK(rdc.GetSectionProperties(1).flags ==
+          (SectionFlags::LZ4Compressed | SectionFlags::LZ4IndependentBlocks));
+
+    CHECK(rdc.GetSectionProperties(0).compressedSize < contents.size() / 3);
+  }
+
+  {
+    RDCFile rdc;
+    rdc.Open(filename);
+    REQUIRE(rdc.Error().code == ResultCode::Succeeded);
+
+    const int frameIndex = rdc.SectionIndex(SectionType::FrameCapture);
+
+    CHECK(rdc.GetSectionProperties(frameIndex).flags & SectionFlags::ZstdArchive);
+
+    StreamReader *reader = rdc.ReadSection(frameIndex);
+
+    // without a block index the archive can still be skipped forward through
+    bytebuf readBack;
+    readBack.resize(contents.size() - 1000);
+    reader->SetOffset(1000);
+    reader->Read(readBack.data(), readBack.size());
+
+    CHECK_FALSE(reader->IsErrored());
+    CHECK(memcmp(readBack.data(), contents.data() + 1000, readBack.size()) == 0);
+
+    delete reader;
+
+    CHECK(rdc.IsCompressedAsConfigured(frameIndex));
+
+    // a section needs recompressing if it's not archived as requested
+    archive = false;
+
+    CHECK_FALSE(rdc.IsCompressedAsConfigured(frameIndex));
+  }
+
+  archive = prevArchive;
+
+  FileIO::Delete(filename);
+}
+
+TEST_CASE("Edit capture file sections while they're mapped", "[rdcfile]")
+{
+  rdcstr filename = FileIO::GetTempFolderFilename() + "/renderdoc_rdcfile_mapped_test.rdc";
+
+  auto makeContents = [](size_t size, byte seed) {
+    bytebuf ret;
+    ret.resize(size);
+    for(size_t i = 0; i < size; i++)
+      ret[i] = byte((i / 13) * seed + (i % 7));
+    return ret;
+  };
+
+  // large enough to be mapped when read
+  bytebuf a = makeContents(Capture_MemoryMapSectionThreshold() * 2, 5);
+  bytebuf b = makeContents(70 * 1024, 7);
+
+  {
+    RDCFile rdc;
+    rdc.SetData(RDCDriver::Vulkan, "Vulkan", 0, NULL, 0, 1.0);
+    rdc.Create(filename);
+    REQUIRE(rdc.Error().code == ResultCode::Succeeded);
+
+    WriteRDCSection(rdc, SectionType::FrameCapture, "", SectionFlags::NoFlags, b);
+    WriteRDCSection(rdc, SectionType::Unknown, "a", SectionFlags::NoFlags, a);
+    WriteRDCSection(rdc, SectionType::Unknown, "b", SectionFlags::NoFlags, b);
+
+    REQUIRE(rdc.Error().code == ResultCode::Succeeded);
+
+    StreamReader *reader = rdc.ReadSection(rdc.SectionIndex("a"));
+    const byte *view = reader->ReadView(reader->GetSize());
+    REQUIRE(view != NULL);
+
+    // moving "b" up over "a" and truncating the file would pull the data out from under the
+    // mapping, so this must write a new file instead
+    bytebuf newA = makeContents(20 * 1024, 13);
+    WriteRDCSection(rdc, SectionType::Unknown, "a", SectionFlags::NoFlags, newA);
+
+    REQUIRE(rdc.Error().code == ResultCode::Succeeded);
+
+    // the mapping still sees the old contents
+    CHECK(memcmp(view, a.data(), a.size()) == 0);
+    delete reader;
+
+    // the new file was written next to the capture and moved over it
+    CHECK_FALSE(FileIO::exists(filename + ".rewrite"));
+
+    a = newA;
+
+    CHECK((ReadRDCSection(rdc, ToStr(SectionType::FrameCapture)) == b));
+    CHECK((ReadRDCSection(rdc, "a") == a));
+    CHECK((ReadRDCSection(rdc, "b") == b));
+  }
+
+  {
+    RDCFile rdc;
+    rdc.Open(filename);
+    REQUIRE(rdc.Error().code == ResultCode::Succeeded);
+
+    CHECK(rdc.SectionIndex("a") > rdc.SectionIndex("b"));
+    CHECK((ReadRDCSection(rdc, ToStr(SectionType::FrameCapture)) == b));
+    CHECK((ReadRDCSection(rdc, "a") == a));
+    CHECK((ReadRDCSection(rdc, "b") == b));
+  }
+
+  FileIO::Delete(filename);
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
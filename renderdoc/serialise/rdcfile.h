@@ -89,6 +89,17 @@ public:
   StreamReader *ReadSection(int index) const;
   StreamWriter *WriteSection(const SectionProperties &props);
 
+  // copies a section from another file without decompressing and recompressing it. The data on
+  // disk and any block index for it are written across byte-for-byte. If the section is replacing
+  // an existing one the same in-place rules as WriteSection apply.
+  RDResult CopySection(const RDCFile &source, int index, RENDERDOC_ProgressCallback progress = NULL);
+
+  // whether a section's data is compressed as newly written sections would be, i.e. at the
+  // configured zstd level, so that copying it with CopySection() gives the same result as
+  // recompressing it. The level is recorded in the block index, sections without one are assumed to
+  // be at the default level.
+  bool IsCompressedAsConfigured(int index) const;
+
   // Only valid if GetDriver returns RDCDriver::Image, passes over the underlying FILE * for use
   // loading the image directly, since the RDC container isn't there to read from a section.
   FILE *StealImageFileHandle(rdcstr &filename);
@@ -96,6 +107,18 @@ public:
 private:
   void Init(StreamReader &reader);
 
+  struct SectionBlockIndex;
+
+  // if raw is true the data written is already compressed according to props, and is written
+  // straight to disk. rawIndex is then the block index of the data if it has one.
+  StreamWriter *BeginSection(const SectionProperties &props, bool raw,
+                             const SectionBlockIndex *rawIndex);
+
+  void ReadBlockIndex(int index);
+  void WriteBlockIndex();
+  const SectionBlockIndex *FindSectionBlockIndex(int index) const;
+  const CompressedBlockIndex *FindBlockIndex(int index) const;
+
   FILE *m_File = NULL;
   rdcstr m_Filename;
   bytebuf m_Buffer;
@@ -124,4 +147,19 @@ private:
   rdcarray<SectionProperties> m_Sections;
   rdcarray<SectionLocation> m_SectionLocations;
   rdcarray<bytebuf> m_MemorySections;
+
+  // block indices for compressed sections, identified by name. The sizes are used to detect stale
+  // indices if the section was rewritten by something that didn't update the index.
+  struct SectionBlockIndex
+  {
+    rdcstr name;
+    uint64_t compressedSize;
+    uint64_t uncompressedSize;
+    // the level zstd sections were compressed at, or 0 if it isn't known
+    uint32_t zstdLevel = 0;
+    CompressedBlockIndex index;
+  };
+
+  rdcarray<SectionBlockIndex> m_BlockIndices;
+  bool m_BlockIndexDirty = false;
 };
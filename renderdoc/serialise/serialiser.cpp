@@ -27,6 +27,7 @@
 
 #include "serialiser.h"
 #include "api/replay/renderdoc_replay.h"
+#include "common/threading.h"
 #include "core/core.h"
 #include "strings/string_utils.h"
 
@@ -189,7 +190,7 @@ uint32_t Serialiser<SerialiserMode::Reading>::BeginChunk(uint32_t, uint64_t)
     if(name.empty())
       name = "<Unknown Chunk>";
 
-    SDChunk *chunk = new SDChunk(name);
+    SDChunk *chunk = new(Arena()) SDChunk(name);
     chunk->metadata = m_ChunkMetadata;
 
     m_StructuredFile->chunks.push_back(chunk);
@@ -211,7 +212,8 @@ void Serialiser<SerialiserMode::Reading>::SkipCurrentChunk()
 
     SDObject &current = *m_StructureStack.back();
 
-    SDObject &obj = *current.AddAndOwnChild(new SDObject("Opaque chunk"_lit, "Byte Buffer"_lit));
+    SDObject &obj =
+        *current.AddAndOwnChild(new(Arena()) SDObject("Opaque chunk"_lit, "Byte Buffer"_lit));
 
     obj.type.basetype = SDBasic::Buffer;
     obj.type.byteSize = m_ChunkMetadata.length;
@@ -711,7 +713,8 @@ void DoSerialise(SerialiserType &ser, SDObject &el, StructuredObjectList &childr
   // children all at once (which could be slow). This is a bit of a hack as this can take many
   // seconds and cause a timeout during transfer, and it would be uglier to try and keep the
   // connection alive while serialising chunks.
-  uint64_t childCount = children.size();
+  // use NumChildren() rather than the array size directly so lazily decoded contents are populated
+  uint64_t childCount = el.NumChildren();
   SERIALISE_ELEMENT(childCount).Hidden();
 
   if(ser.IsReading())
@@ -1073,66 +1076,149 @@ Chunk *Chunk::Create(Serialiser<SerialiserMode::Writing> &ser, uint16_t chunkTyp
 
 ChunkPagePool::~ChunkPagePool()
 {
-  // all allocated pages are in precisely one list, so just free the contents of both lists
-  for(ChunkPage &p : freePages)
+  // every page has a node, so just free the memory of any node that has it
+  for(uint32_t i = 0; i < (uint32_t)m_NodeCount; i++)
   {
-    FreeAlignedBuffer(p.chunkBase);
-    FreeAlignedBuffer(p.bufferBase);
+    PageNode &node = GetNode(i);
+    FreeAlignedBuffer(node.chunkBase);
+    FreeAlignedBuffer(node.bufferBase);
   }
 
-  for(ChunkPage &p : allocatedPages)
+  for(uint32_t s = 0; s < MaxSegments; s++)
+    delete[] m_Segments[s];
+}
+
+ChunkPagePool::PageNode &ChunkPagePool::GetNode(uint32_t index)
+{
+  if(index < FirstSegmentSize)
+    return m_Segments[0][index];
+
+  uint32_t seg = Log2Floor(index / FirstSegmentSize) + 1;
+  return m_Segments[seg][index - (FirstSegmentSize << (seg - 1))];
+}
+
+uint32_t ChunkPagePool::NewNode()
+{
+  uint32_t index = uint32_t(Atomic::Inc32(&m_NodeCount) - 1);
+
+  uint32_t seg = index < FirstSegmentSize ? 0 : Log2Floor(index / FirstSegmentSize) + 1;
+
+  if(seg >= MaxSegments)
+    RDCFATAL("Too many chunk pages allocated");
+
+  // another thread may have been handed an index in the same new segment. Whichever thread swaps
+  // its segment in first wins and the others free theirs. The swap also makes the segment's
+  // contents visible to this thread before anything uses the index.
+  if(Atomic::CmpExchPtr((void **)&m_Segments[seg], NULL, NULL) == NULL)
   {
-    FreeAlignedBuffer(p.chunkBase);
-    FreeAlignedBuffer(p.bufferBase);
+    PageNode *segment =
+        new PageNode[seg == 0 ? FirstSegmentSize : FirstSegmentSize << (seg - 1)]();
+
+    if(Atomic::CmpExchPtr((void **)&m_Segments[seg], NULL, segment) != NULL)
+      delete[] segment;
   }
+
+  return index;
 }
 
-ChunkPage ChunkPagePool::AllocPage()
+void ChunkPagePool::Push(int64_t &stack, uint32_t index)
 {
-  if(!freePages.empty())
+  PageNode &node = GetNode(index);
+
+  int64_t head = Atomic::CmpExch64(&stack, 0, 0);
+  for(;;)
   {
-    // if there's a free page, move it to the allocated list and return it
-    ChunkPage free = freePages.back();
-    freePages.pop_back();
-    allocatedPages.push_back(free);
+    node.next = uint32_t(head & 0xffffffff);
+
+    int64_t newHead = int64_t(((uint64_t(head) >> 32) + 1) << 32) | int64_t(index + 1);
+
+    int64_t prev = Atomic::CmpExch64(&stack, head, newHead);
+    if(prev == head)
+      return;
+
+    head = prev;
   }
-  else
+}
+
+bool ChunkPagePool::Pop(int64_t &stack, uint32_t &index)
+{
+  int64_t head = Atomic::CmpExch64(&stack, 0, 0);
+  for(;;)
   {
-    // otherwise allocate a new one straight into the allocated list
-    byte *buffers = ::AllocAlignedBuffer(BufferPageSize);
-    byte *chunks = ::AllocAlignedBuffer(ChunkPageSize);
-    allocatedPages.push_back({m_ID++, buffers, buffers, chunks, chunks});
+    uint32_t top = uint32_t(head & 0xffffffff);
+    if(top == 0)
+      return false;
+
+    // the node could be popped and pushed again by another thread before we swap, in which case its
+    // next pointer may have changed. The modification count in the high bits will have changed too
+    // though so the swap will fail and we'll try again.
+    uint32_t next = GetNode(top - 1).next;
+
+    int64_t newHead = int64_t(((uint64_t(head) >> 32) + 1) << 32) | int64_t(next);
+
+    int64_t prev = Atomic::CmpExch64(&stack, head, newHead);
+    if(prev == head)
+    {
+      index = top - 1;
+      return true;
+    }
+
+    head = prev;
+  }
+}
+
+ChunkPage ChunkPagePool::AllocPage()
+{
+  uint32_t index = 0;
+
+  // if there's a free page, return it
+  if(Pop(m_FreePages, index))
+  {
+    PageNode &node = GetNode(index);
+    return {node.ID, index, node.bufferBase, node.bufferBase, node.chunkBase, node.chunkBase};
   }
 
-  return allocatedPages.back();
+  // otherwise allocate a new one, reusing the node of a trimmed page if there is one
+  if(!Pop(m_EmptyNodes, index))
+    index = NewNode();
+
+  PageNode &node = GetNode(index);
+  node.ID = Atomic::Inc64(&m_ID);
+  node.bufferBase = ::AllocAlignedBuffer(BufferPageSize);
+  node.chunkBase = ::AllocAlignedBuffer(ChunkPageSize);
+
+  return {node.ID, index, node.bufferBase, node.bufferBase, node.chunkBase, node.chunkBase};
 }
 
 void ChunkPagePool::Trim()
 {
   // truly release any currently free pages back to the system
-  for(ChunkPage &p : freePages)
+  uint32_t index = 0;
+  while(Pop(m_FreePages, index))
   {
-    FreeAlignedBuffer(p.chunkBase);
-    FreeAlignedBuffer(p.bufferBase);
-  }
+    PageNode &node = GetNode(index);
+    FreeAlignedBuffer(node.chunkBase);
+    FreeAlignedBuffer(node.bufferBase);
+    node.chunkBase = node.bufferBase = NULL;
 
-  freePages.clear();
+    Push(m_EmptyNodes, index);
+  }
 }
 
 void ChunkPagePool::Reset()
 {
-  // forcibly move all allocated pages into the free list
-  freePages.append(allocatedPages);
-  allocatedPages.clear();
+  // forcibly move all pages into the free list
+  m_FreePages = 0;
+  m_EmptyNodes = 0;
 
-  for(ChunkPage &p : freePages)
+  for(uint32_t i = 0; i < (uint32_t)m_NodeCount; i++)
   {
-    // reset head pointers
-    p.bufferHead = p.bufferBase;
-    p.chunkHead = p.chunkBase;
+    PageNode &node = GetNode(i);
 
     // assign a new ID so these pages can't get reset again by any allocator currently holding them
-    p.ID = m_ID++;
+    node.ID = Atomic::Inc64(&m_ID);
+
+    Push(node.bufferBase ? m_FreePages : m_EmptyNodes, i);
   }
 }
 
@@ -1141,25 +1227,15 @@ void ChunkPagePool::ResetPageSet(const rdcarray<ChunkPage> &pages)
   // iterate over each page being freed
   for(const ChunkPage &p : pages)
   {
-    // try to find it in the allocated page list. This compares by ID, so if the page was already
-    // freed with a pool reset we won't find it at all because it will have a new ID - that's fine.
-    int32_t idx = allocatedPages.indexOf(p);
-    if(idx >= 0)
-    {
-      ChunkPage &alloc = allocatedPages[idx];
-      // give a new ID to be safe
-      alloc.ID = m_ID++;
-      // reset head pointers
-      alloc.bufferHead = alloc.bufferBase;
-      alloc.chunkHead = alloc.chunkBase;
-      // move to free list
-      freePages.push_back(alloc);
-      // allocatedPages is not sorted, swap with the back and pop to avoid expensive erases in the
-      // middle of the list
-      std::swap(allocatedPages[idx], allocatedPages.back());
-      allocatedPages.pop_back();
+    PageNode &node = GetNode(p.index);
+
+    // claim the page by giving it a new ID. If the page was already freed with a pool reset it will
+    // already have a new ID and this will fail - that's fine, there's nothing to do.
+    int64_t newID = Atomic::Inc64(&m_ID);
+    if(Atomic::CmpExch64(&node.ID, p.ID, newID) != p.ID)
       continue;
-    }
+
+    Push(m_FreePages, p.index);
   }
 }
 
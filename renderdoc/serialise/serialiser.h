@@ -177,6 +177,12 @@ public:
     m_ExportStructured = (lookup != NULL);
     m_TimerBase = timeBase;
     m_TimerFrequency = timeFreq;
+
+    // when reading a whole file's worth of chunks into our own structured file, allocate objects
+    // from an arena. This isn't used when structuring into an external object, since those objects
+    // may outlive us.
+    if(IsReading() && m_ExportStructured && m_StructureStack.empty())
+      m_StructuredFile->EnableArena();
   }
 
   uint32_t BeginChunk(uint32_t chunkID, uint64_t byteLength);
@@ -232,7 +238,7 @@ public:
 
       SDObject &current = *m_StructureStack.back();
 
-      SDObject &obj = *current.AddAndOwnChild(new SDObject(name, TypeName<T>()));
+      SDObject &obj = *current.AddAndOwnChild(new(Arena()) SDObject(name, TypeName<T>()));
       m_StructureStack.push_back(&obj);
 
       obj.type.byteSize = sizeof(T);
@@ -277,14 +283,16 @@ public:
 
       SDObject &current = *m_StructureStack.back();
 
-      SDObject &obj = *current.AddAndOwnChild(new SDObject(name, "Byte Buffer"_lit));
+      SDObject &obj = *current.AddAndOwnChild(new(Arena()) SDObject(name, "Byte Buffer"_lit));
       m_StructureStack.push_back(&obj);
 
       obj.type.basetype = SDBasic::Buffer;
       obj.type.byteSize = byteSize;
     }
 
-    byte *tempAlloc = NULL;
+    // when exporting buffers the structured file must own a copy of the data. If the caller has no
+    // use for it we read straight into that copy, so there's only ever one copy out of the stream.
+    bytebuf *exportBuf = NULL;
 
     {
       if(IsWriting())
@@ -313,20 +321,21 @@ public:
           else
             el = NULL;
         }
+#endif
 
-        // if we're exporting the buffers, make sure to always alloc space to read the data, so we
+        // if we're exporting the buffers, make sure to always have space to read the data, so we
         // can save it out, even if the external code has no use for it and has asked for no
         // allocation.
         if(el == NULL && ExportStructure() && m_ExportBuffers)
         {
-          if(byteSize > 0)
-            el = tempAlloc = AllocAlignedBuffer(byteSize);
-          else
-            el = NULL;
+          exportBuf = new bytebuf;
+          exportBuf->resize((size_t)byteSize);
+          m_Read->Read(exportBuf->data(), byteSize);
+        }
+        else
+        {
+          m_Read->Read(el, byteSize);
         }
-#endif
-
-        m_Read->Read(el, byteSize);
       }
     }
 
@@ -338,25 +347,20 @@ public:
 
         obj.data.basic.u = m_StructuredFile->buffers.size();
 
-        bytebuf *alloc = new bytebuf;
-        alloc->resize((size_t)byteSize);
-        if(el)
-          memcpy(alloc->data(), el, (size_t)byteSize);
+        if(!exportBuf)
+        {
+          exportBuf = new bytebuf;
+          exportBuf->resize((size_t)byteSize);
+          if(el)
+            memcpy(exportBuf->data(), el, (size_t)byteSize);
+        }
 
-        m_StructuredFile->buffers.push_back(alloc);
+        m_StructuredFile->buffers.push_back(exportBuf);
       }
 
       m_StructureStack.pop_back();
     }
 
-#if !defined(__COVERITY__)
-    if(tempAlloc)
-    {
-      FreeAlignedBuffer(tempAlloc);
-      el = NULL;
-    }
-#endif
-
     return *this;
   }
 
@@ -386,7 +390,7 @@ public:
 
       SDObject &current = *m_StructureStack.back();
 
-      SDObject &obj = *current.AddAndOwnChild(new SDObject(name, "Byte Buffer"_lit));
+      SDObject &obj = *current.AddAndOwnChild(new(Arena()) SDObject(name, "Byte Buffer"_lit));
       m_StructureStack.push_back(&obj);
 
       obj.type.basetype = SDBasic::Buffer;
@@ -498,7 +502,7 @@ public:
 
       SDObject &parent = *m_StructureStack.back();
 
-      SDObject &arr = *parent.AddAndOwnChild(new SDObject(name, TypeName<T>()));
+      SDObject &arr = *parent.AddAndOwnChild(new(Arena()) SDObject(name, TypeName<T>()));
       m_StructureStack.push_back(&arr);
 
       arr.type.basetype = SDBasic::Array;
@@ -509,7 +513,7 @@ public:
 
       for(size_t i = 0; i < N; i++)
       {
-        SDObject &obj = *arr.AddAndOwnChild(new SDObject("$el"_lit, TypeName<T>()));
+        SDObject &obj = *arr.AddAndOwnChild(new(Arena()) SDObject("$el"_lit, TypeName<T>()));
         m_StructureStack.push_back(&obj);
 
         // default to struct. This will be overwritten if appropriate
@@ -615,7 +619,7 @@ public:
 
       SDObject &parent = *m_StructureStack.back();
 
-      SDObject &arr = *parent.AddAndOwnChild(new SDObject(name, TypeName<T>()));
+      SDObject &arr = *parent.AddAndOwnChild(new(Arena()) SDObject(name, TypeName<T>()));
       m_StructureStack.push_back(&arr);
 
       arr.type.basetype = SDBasic::Array;
@@ -651,7 +655,7 @@ public:
       {
         for(uint64_t i = 0; el && i < arrayCount; i++)
         {
-          SDObject &obj = *arr.AddAndOwnChild(new SDObject("$el"_lit, TypeName<T>()));
+          SDObject &obj = *arr.AddAndOwnChild(new(Arena()) SDObject("$el"_lit, TypeName<T>()));
           m_StructureStack.push_back(&obj);
 
           // default to struct. This will be overwritten if appropriate
@@ -718,7 +722,7 @@ public:
 
       SDObject &parent = *m_StructureStack.back();
 
-      SDObject &arr = *parent.AddAndOwnChild(new SDObject(name, TypeName<U>()));
+      SDObject &arr = *parent.AddAndOwnChild(new(Arena()) SDObject(name, TypeName<U>()));
       m_StructureStack.push_back(&arr);
 
       arr.type.basetype = SDBasic::Array;
@@ -744,7 +748,7 @@ public:
       {
         for(size_t i = 0; i < (size_t)size; i++)
         {
-          SDObject &obj = *arr.AddAndOwnChild(new SDObject("$el"_lit, TypeName<U>()));
+          SDObject &obj = *arr.AddAndOwnChild(new(Arena()) SDObject("$el"_lit, TypeName<U>()));
           m_StructureStack.push_back(&obj);
 
           // default to struct. This will be overwritten if appropriate
@@ -797,7 +801,7 @@ public:
 
       SDObject &parent = *m_StructureStack.back();
 
-      SDObject &arr = *parent.AddAndOwnChild(new SDObject(name, TypeName<U>()));
+      SDObject &arr = *parent.AddAndOwnChild(new(Arena()) SDObject(name, TypeName<U>()));
       m_StructureStack.push_back(&arr);
 
       arr.type.basetype = SDBasic::Array;
@@ -808,7 +812,7 @@ public:
 
       for(size_t i = 0; i < N; i++)
       {
-        SDObject &obj = *arr.AddAndOwnChild(new SDObject("$el"_lit, TypeName<U>()));
+        SDObject &obj = *arr.AddAndOwnChild(new(Arena()) SDObject("$el"_lit, TypeName<U>()));
         m_StructureStack.push_back(&obj);
 
         // default to struct. This will be overwritten if appropriate
@@ -873,7 +877,7 @@ public:
 
       SDObject &parent = *m_StructureStack.back();
 
-      SDObject &arr = *parent.AddAndOwnChild(new SDObject(name, "pair"_lit));
+      SDObject &arr = *parent.AddAndOwnChild(new(Arena()) SDObject(name, "pair"_lit));
       m_StructureStack.push_back(&arr);
 
       arr.type.basetype = SDBasic::Struct;
@@ -882,7 +886,7 @@ public:
       arr.ReserveChildren(2);
 
       {
-        SDObject &obj = *arr.AddAndOwnChild(new SDObject("first"_lit, TypeName<U>()));
+        SDObject &obj = *arr.AddAndOwnChild(new(Arena()) SDObject("first"_lit, TypeName<U>()));
         m_StructureStack.push_back(&obj);
 
         // default to struct. This will be overwritten if appropriate
@@ -895,7 +899,7 @@ public:
       }
 
       {
-        SDObject &obj = *arr.AddAndOwnChild(new SDObject("second"_lit, TypeName<V>()));
+        SDObject &obj = *arr.AddAndOwnChild(new(Arena()) SDObject("second"_lit, TypeName<V>()));
         m_StructureStack.push_back(&obj);
 
         // default to struct. This will be overwritten if appropriate
@@ -985,7 +989,7 @@ public:
       {
         SDObject &parent = *m_StructureStack.back();
 
-        SDObject &nullable = *parent.AddAndOwnChild(new SDObject(name, TypeName<T>()));
+        SDObject &nullable = *parent.AddAndOwnChild(new(Arena()) SDObject(name, TypeName<T>()));
 
         nullable.type.basetype = SDBasic::Null;
         nullable.type.byteSize = 0;
@@ -1071,7 +1075,7 @@ public:
 
       SDObject &current = *m_StructureStack.back();
 
-      SDObject &obj = *current.AddAndOwnChild(new SDObject(name, "Byte Buffer"_lit));
+      SDObject &obj = *current.AddAndOwnChild(new(Arena()) SDObject(name, "Byte Buffer"_lit));
       m_StructureStack.push_back(&obj);
 
       obj.type.basetype = SDBasic::Buffer;
@@ -1106,7 +1110,10 @@ public:
       if(totalSize % (uint64_t)bufSize > 0)
         numBufs++;
 
-      byte *buf = new byte[byteSize];
+      // if the whole stream is in memory, write from it directly instead of through a buffer
+      const byte *view = m_Read->ReadView(totalSize);
+
+      byte *buf = view ? NULL : new byte[(size_t)bufSize];
 
       if(progress)
         progress(0.0001f);
@@ -1115,12 +1122,23 @@ public:
       {
         uint64_t payloadLength = RDCMIN(bufSize, totalSize);
 
-        m_Read->Read(buf, payloadLength);
-        stream.Write(buf, payloadLength);
+        const byte *src = view;
+
+        if(view)
+        {
+          view += payloadLength;
+        }
+        else
+        {
+          m_Read->Read(buf, payloadLength);
+          src = buf;
+        }
+
+        stream.Write(src, payloadLength);
 
         if(structBuf)
         {
-          memcpy(structBuf, buf, (size_t)payloadLength);
+          memcpy(structBuf, src, (size_t)payloadLength);
           structBuf += payloadLength;
         }
 
@@ -1514,6 +1532,9 @@ private:
   SDFile *m_StructuredFile = &m_StructData;
   rdcarray<SDObject *> m_StructureStack;
 
+  // the arena that new structured objects should be allocated from, or NULL for the heap
+  SDObjectArena *Arena() { return m_StructuredFile->GetArena(); }
+
   uint32_t m_ChunkFlags = 0;
   SDChunkMetaData m_ChunkMetadata;
   double m_TimerFrequency = 1.0;
@@ -1560,6 +1581,17 @@ public:
     // parameters are ignored when reading
     return (ChunkType)BeginChunk(0, 0);
   }
+
+  // read the header of every remaining chunk in the stream without decoding any contents. When
+  // exporting structured data this adds an empty chunk with the name and metadata for each one.
+  void ReadChunkHeaders()
+  {
+    while(!GetReader()->AtEnd() && !GetReader()->IsErrored())
+    {
+      BeginChunk(0, 0);
+      EndChunk();
+    }
+  }
 };
 
 class StructuredSerialiser : public Serialiser<SerialiserMode::Reading>
@@ -1660,7 +1692,10 @@ struct ChunkPage
   // compare just with the ID, so that old pages w hich have been reset in the pool don't get reset
   // again if an allocator subsequently tries to free them
   bool operator==(const ChunkPage &o) { return ID == o.ID; }
-  size_t ID;
+  int64_t ID;
+
+  // the index of the page in the pool
+  uint32_t index;
 
   // we allocate at two granularities, chunks are 16 bytes, buffers are multiples of 64-bytes
   // to keep things simple we allocate the chunk memory as 16/64 = a quarter the size of the
@@ -1680,6 +1715,10 @@ struct ChunkPage
 // grained allocation, and those allocators can return whole pages back. This is necessary because
 // when fine-grained resetting is allowed we need to associate whole pages with objects and if those
 // objects are allocating interleaved we need to immediately associate pages with them.
+//
+// AllocPage() and ResetPageSet() are lock-free and can be called from any number of threads at
+// once, so allocators on different recording threads can share a pool. Trim() and Reset() operate
+// on the whole pool and must not run concurrently with anything else.
 class ChunkPagePool
 {
 public:
@@ -1707,18 +1746,49 @@ private:
   size_t BufferPageSize;
   size_t ChunkPageSize;
 
-  size_t m_ID = 1;
+  int64_t m_ID = 1;
+
+  struct PageNode
+  {
+    // the ID of the current allocation of this page, changed whenever the page is freed so that
+    // allocators holding stale copies can't free it again.
+    int64_t ID;
+    // the memory for the page, or NULL if it has been trimmed
+    byte *bufferBase;
+    byte *chunkBase;
+    // the index + 1 of the next node in whichever free list this node is in
+    uint32_t next;
+  };
 
-  // a page is in precisely ONE of these arrays at any time.
-  // Reset() will move all allocated pages back to free pages and reclaim all that memory
-  // ResetPageSet() will move any referenced pages from allocatedPages back to freePages
-  rdcarray<ChunkPage> freePages;
-  rdcarray<ChunkPage> allocatedPages;
+  // nodes are never moved once created so they can be accessed without locking. They're stored in
+  // segments that double in size, segment 0 and 1 have FirstSegmentSize nodes and each after that
+  // has twice as many as the previous. Segments are published atomically by NewNode, and every node
+  // index is only ever obtained through an atomic operation after that, so GetNode can read the
+  // segment pointers directly.
+  static const uint32_t FirstSegmentSize = 64;
+  static const uint32_t MaxSegments = 26;
+
+  PageNode *m_Segments[MaxSegments] = {};
+  int32_t m_NodeCount = 0;
+
+  PageNode &GetNode(uint32_t index);
+  uint32_t NewNode();
+
+  // lock-free stacks of nodes. The low 32 bits are the index + 1 of the top node or 0 if the stack
+  // is empty, the high 32 bits count modifications to avoid ABA problems.
+  // Free pages with memory ready to be handed out
+  int64_t m_FreePages = 0;
+  // nodes whose memory has been trimmed and can be reused for new pages
+  int64_t m_EmptyNodes = 0;
+
+  void Push(int64_t &stack, uint32_t index);
+  bool Pop(int64_t &stack, uint32_t &index);
 };
 
 // this is the second level, it should only be used by one object (or a group of objects that are
 // always reset together). It pulls pages from the pool and allocates from them, and can then
-// release those pages back again with a reset operation.
+// release those pages back again with a reset operation. An allocator is not thread-safe itself, each
+// recording thread should use its own allocator - though they can all share one pool.
 class ChunkAllocator
 {
 public:
@@ -23,6 +23,7 @@
  ******************************************************************************/
 
 #include "serialiser.h"
+#include "common/timing.h"
 
 #if ENABLED(ENABLE_UNIT_TESTS)
 
@@ -682,6 +683,275 @@ TEST_CASE("Read/write chunk metadata", "[serialiser]")
   delete buf;
 };
 
+TEST_CASE("Read chunk headers and lazily populate contents", "[serialiser][chunks]")
+{
+  StreamWriter *buf = new StreamWriter(StreamWriter::DefaultScratchSize);
+
+  const uint32_t numChunks = 10;
+
+  {
+    WriteSerialiser ser(buf, Ownership::Nothing);
+
+    ser.SetChunkMetadataRecording(WriteSerialiser::ChunkThreadID);
+
+    for(uint32_t i = 0; i < numChunks; i++)
+    {
+      ser.ChunkMetadata().threadID = 1000 + i;
+
+      SCOPED_SERIALISE_CHUNK(i + 1);
+
+      // give each chunk a different size
+      for(uint32_t j = 0; j <= i; j++)
+        WriteAllBasicTypes(ser);
+    }
+
+    REQUIRE_FALSE(ser.IsErrored());
+  }
+
+  ChunkLookup testChunkLookup = [](uint32_t chunkType) -> rdcstr {
+    return StringFormat::Fmt("TestChunk%u", chunkType);
+  };
+
+  SDFile headers;
+
+  {
+    ReadSerialiser ser(new StreamReader(buf->GetData(), buf->GetOffset()), Ownership::Stream);
+
+    ser.ConfigureStructuredExport(testChunkLookup, true, 0, 1.0);
+
+    ser.ReadChunkHeaders();
+
+    REQUIRE_FALSE(ser.IsErrored());
+
+    CHECK(ser.GetReader()->AtEnd());
+
+    ser.GetStructuredFile().Swap(headers);
+  }
+
+  REQUIRE(headers.chunks.size() == numChunks);
+
+  for(uint32_t i = 0; i < numChunks; i++)
+  {
+    SDChunk *chunk = headers.chunks[i];
+
+    CHECK(chunk->name == StringFormat::Fmt("TestChunk%u", i + 1));
+    CHECK(chunk->metadata.chunkID == i + 1);
+    CHECK(chunk->metadata.threadID == 1000 + i);
+    CHECK(chunk->NumChildren() == 0);
+  }
+
+  SECTION("Contents are generated once, on first access")
+  {
+    int generated = 0;
+
+    SDChunk *chunk = headers.chunks[3];
+
+    chunk->SetLazyContents([&generated](SDObject *obj) {
+      generated++;
+      obj->AddAndOwnChild(makeSDUInt32("a"_lit, 5));
+      obj->AddAndOwnChild(makeSDString("b"_lit, "bbb"));
+    });
+
+    CHECK(generated == 0);
+
+    REQUIRE(chunk->NumChildren() == 2);
+    CHECK(generated == 1);
+
+    CHECK(chunk->GetChild(0)->AsUInt32() == 5);
+    CHECK(chunk->FindChild("b")->AsString() == "bbb");
+    CHECK(chunk->GetChild(0)->GetParent() == chunk);
+
+    SDChunk *dup = chunk->Duplicate();
+    CHECK(dup->NumChildren() == 2);
+    CHECK(dup->HasEqualValue(chunk));
+    delete dup;
+
+    CHECK(generated == 1);
+  }
+
+  SECTION("Duplicating populates the contents")
+  {
+    int generated = 0;
+
+    SDChunk *chunk = headers.chunks[5];
+
+    chunk->SetLazyContents([&generated](SDObject *obj) {
+      generated++;
+      obj->AddAndOwnChild(makeSDUInt32("a"_lit, 7));
+    });
+
+    SDChunk *dup = chunk->Duplicate();
+    CHECK(generated == 1);
+    REQUIRE(dup->NumChildren() == 1);
+    CHECK(dup->GetChild(0)->AsUInt32() == 7);
+    CHECK(chunk->NumChildren() == 1);
+    delete dup;
+
+    CHECK(generated == 1);
+  }
+
+  SECTION("Deleting children discards the generator")
+  {
+    int generated = 0;
+
+    SDChunk *chunk = headers.chunks[7];
+
+    chunk->SetLazyContents([&generated](SDObject *obj) { generated++; });
+
+    chunk->DeleteChildren();
+
+    CHECK(chunk->NumChildren() == 0);
+    CHECK(generated == 0);
+  }
+
+  // the full decode sees the same chunks in the same order
+  {
+    ReadSerialiser ser(new StreamReader(buf->GetData(), buf->GetOffset()), Ownership::Stream);
+
+    ser.ConfigureStructuredExport(testChunkLookup, true, 0, 1.0);
+
+    for(uint32_t i = 0; i < numChunks; i++)
+    {
+      uint32_t chunk = ser.ReadChunk<uint32_t>();
+
+      CHECK(chunk == i + 1);
+
+      ser.SkipCurrentChunk();
+      ser.EndChunk();
+    }
+
+    REQUIRE_FALSE(ser.IsErrored());
+    CHECK(ser.GetReader()->AtEnd());
+
+    const SDFile &full = ser.GetStructuredFile();
+
+    REQUIRE(full.chunks.size() == numChunks);
+    for(uint32_t i = 0; i < numChunks; i++)
+    {
+      CHECK(full.chunks[i]->name == headers.chunks[i]->name);
+      CHECK(full.chunks[i]->type.byteSize == headers.chunks[i]->type.byteSize);
+      CHECK(full.chunks[i]->metadata.threadID == headers.chunks[i]->metadata.threadID);
+    }
+  }
+
+  delete buf;
+};
+
+TEST_CASE("Structured objects allocated from a file arena", "[serialiser][structured]")
+{
+  StreamWriter *buf = new StreamWriter(StreamWriter::DefaultScratchSize);
+
+  const uint32_t numChunks = 100;
+
+  {
+    WriteSerialiser ser(buf, Ownership::Nothing);
+
+    for(uint32_t i = 0; i < numChunks; i++)
+    {
+      SCOPED_SERIALISE_CHUNK(i + 1);
+
+      int64_t a = -1;
+      uint64_t b = i;
+      double k = 11.11011011;
+      rdcstr m = "mmmm";
+      const char *s = "ssss";
+      int t[4] = {20, 20, 20, 20};
+
+      SERIALISE_ELEMENT(a);
+      SERIALISE_ELEMENT(b);
+      SERIALISE_ELEMENT(k);
+      SERIALISE_ELEMENT(m);
+      SERIALISE_ELEMENT(s);
+      SERIALISE_ELEMENT(t);
+    }
+
+    REQUIRE_FALSE(ser.IsErrored());
+  }
+
+  ChunkLookup testChunkLookup = [](uint32_t) -> rdcstr { return "TestChunk"; };
+
+  auto readFile = [&](SDFile &output) {
+    ReadSerialiser ser(new StreamReader(buf->GetData(), buf->GetOffset()), Ownership::Stream);
+
+    ser.ConfigureStructuredExport(testChunkLookup, true, 0, 1.0);
+
+    for(uint32_t i = 0; i < numChunks; i++)
+    {
+      ser.ReadChunk<uint32_t>();
+
+      int64_t a;
+      uint64_t b;
+      double k;
+      rdcstr m;
+      const char *s;
+      int t[4];
+
+      SERIALISE_ELEMENT(a);
+      SERIALISE_ELEMENT(b);
+      SERIALISE_ELEMENT(k);
+      SERIALISE_ELEMENT(m);
+      SERIALISE_ELEMENT(s);
+      SERIALISE_ELEMENT(t);
+
+      ser.EndChunk();
+    }
+
+    REQUIRE_FALSE(ser.IsErrored());
+
+    CHECK(ser.GetStructuredFile().GetArena() != NULL);
+
+    ser.GetStructuredFile().Swap(output);
+  };
+
+  SDFile file;
+  readFile(file);
+
+  // the arena moves with the contents, so the objects are still valid after the serialiser is gone
+  REQUIRE(file.GetArena() != NULL);
+  REQUIRE(file.chunks.size() == numChunks);
+  CHECK(file.chunks[0]->FindChild("a")->AsInt64() == -1);
+  CHECK(file.chunks[50]->FindChild("m")->AsString() == "mmmm");
+  CHECK(file.chunks[99]->FindChild("b")->AsUInt64() == 99);
+  CHECK(file.chunks[99]->FindChild("t")->NumChildren() == 4);
+
+  // objects can still be removed or added individually, mixing arena and heap objects
+  file.chunks[0]->RemoveChild(0);
+  CHECK(file.chunks[0]->GetChild(0)->name == "b");
+  file.chunks[0]->AddAndOwnChild(makeSDUInt32("extra"_lit, 1234));
+  CHECK(file.chunks[0]->FindChild("extra")->AsUInt32() == 1234);
+
+  // duplicates are independent of the arena
+  SDChunk *dup = file.chunks[10]->Duplicate();
+
+  {
+    SDFile other;
+    readFile(other);
+
+    // moving objects between files requires taking over the arena they came from
+    file.TakeArena(other);
+
+    StructuredObjectList children;
+    other.chunks[5]->TakeAllChildren(children);
+
+    SDChunk *last = file.chunks.back();
+    last->DeleteChildren();
+    for(SDObject *child : children)
+      last->AddAndOwnChild(child);
+  }
+
+  CHECK(file.chunks.back()->FindChild("s")->AsString() == "ssss");
+
+  {
+    SDFile empty;
+    empty.Swap(file);
+  }
+
+  CHECK(dup->FindChild("k")->AsDouble() == 11.11011011);
+  delete dup;
+
+  delete buf;
+};
+
 TEST_CASE("Verify multiple chunks can be merged", "[serialiser][chunks]")
 {
   StreamWriter *buf = new StreamWriter(StreamWriter::DefaultScratchSize);
@@ -840,6 +1110,133 @@ TEST_CASE("Verify multiple chunks can be merged", "[serialiser][chunks]")
   delete buf;
 };
 
+TEST_CASE("Chunk page pool shared between threads", "[serialiser][chunks]")
+{
+  ChunkPagePool pool(4096);
+
+  SECTION("Stale pages are not freed twice")
+  {
+    ChunkAllocator a(pool);
+    byte *first = a.AllocAlignedBuffer(64);
+    REQUIRE(first);
+
+    // resetting the whole pool frees the allocator's page out from under it
+    pool.Reset();
+
+    ChunkAllocator b(pool);
+    byte *second = b.AllocAlignedBuffer(64);
+    CHECK(second == first);
+
+    // a's reset must not return b's page to the pool
+    a.Reset();
+
+    ChunkAllocator c(pool);
+    byte *third = c.AllocAlignedBuffer(64);
+    CHECK(third != second);
+
+    // trimming only frees unused pages, and the pool keeps working afterwards
+    c.Reset();
+    pool.Trim();
+
+    byte *fourth = c.AllocAlignedBuffer(64);
+    CHECK(fourth != NULL);
+    CHECK(fourth != second);
+  };
+
+  SECTION("Concurrent allocation and reset")
+  {
+    const uint32_t numThreads = 4;
+    int32_t failures = 0;
+
+    rdcarray<Threading::ThreadHandle> threads;
+    for(uint32_t t = 0; t < numThreads; t++)
+    {
+      threads.push_back(Threading::CreateThread([&pool, &failures, t]() {
+        ChunkAllocator alloc(pool);
+
+        for(uint32_t iter = 0; iter < 50; iter++)
+        {
+          rdcarray<byte *> allocs;
+
+          for(uint32_t i = 0; i < 100; i++)
+          {
+            byte *mem = alloc.AllocAlignedBuffer(64 + (i % 8) * 64);
+            memset(mem, int(t * 50 + iter), 64);
+            allocs.push_back(mem);
+          }
+
+          // if any page was handed out to two allocators at once the memory will be overwritten
+          for(byte *mem : allocs)
+            if(mem[0] != byte(t * 50 + iter) || mem[63] != byte(t * 50 + iter))
+              Atomic::Inc32(&failures);
+
+          alloc.Reset();
+        }
+      }));
+    }
+
+    for(Threading::ThreadHandle th : threads)
+    {
+      Threading::JoinThread(th);
+      Threading::CloseThread(th);
+    }
+
+    CHECK(failures == 0);
+  };
+}
+
+TEST_CASE("Benchmark chunk recording from multiple threads", "[.][benchmark][serialiser]")
+{
+  ChunkPagePool pool(32 * 1024);
+
+  const uint32_t chunksPerThread = 200000;
+
+  for(uint32_t numThreads : {1, 2, 4, 8, 16})
+  {
+    rdcarray<Threading::ThreadHandle> threads;
+
+    PerformanceTimer timer;
+
+    for(uint32_t t = 0; t < numThreads; t++)
+    {
+      threads.push_back(Threading::CreateThread([&pool]() {
+        WriteSerialiser ser(new StreamWriter(StreamWriter::DefaultScratchSize), Ownership::Stream);
+        ChunkAllocator alloc(pool);
+
+        for(uint32_t i = 0; i < chunksPerThread; i++)
+        {
+          {
+            SCOPED_SERIALISE_CHUNK(1);
+
+            uint32_t vertexCount = i;
+            uint64_t offset = i * 16;
+            SERIALISE_ELEMENT(vertexCount);
+            SERIALISE_ELEMENT(offset);
+
+            scope.Get(&alloc)->Delete();
+          }
+
+          // command buffers are regularly reset, returning their pages to the pool
+          if((i % 1000) == 999)
+            alloc.Reset();
+        }
+      }));
+    }
+
+    for(Threading::ThreadHandle th : threads)
+    {
+      Threading::JoinThread(th);
+      Threading::CloseThread(th);
+    }
+
+    double ms = timer.GetMilliseconds();
+
+    WARN(StringFormat::Fmt("%u threads: %llu chunks/sec", numThreads,
+                           uint64_t(double(numThreads) * chunksPerThread / (ms / 1000.0)))
+             .c_str());
+  }
+}
+
 TEST_CASE("Read/write container types", "[serialiser][structured]")
 {
   StreamWriter *buf = new StreamWriter(StreamWriter::DefaultScratchSize);
@@ -62,6 +62,17 @@ StreamReader::StreamReader(const bytebuf &buffer)
   m_Ownership = Ownership::Nothing;
 }
 
+StreamReader::StreamReader(StreamBorrowType, const byte *buffer, uint64_t bufferSize)
+{
+  m_InputSize = m_BufferSize = bufferSize;
+
+  // the buffer is never written to through these pointers
+  m_BufferHead = m_BufferBase = (byte *)buffer;
+  m_BorrowedBuffer = true;
+
+  m_Ownership = Ownership::Nothing;
+}
+
 StreamReader::StreamReader(StreamInvalidType, RDResult res)
 {
   m_InputSize = 0;
@@ -117,6 +128,7 @@ StreamReader::StreamReader(FILE *file, uint64_t fileSize, Ownership own)
   }
 
   m_File = file;
+  m_FileStart = FileIO::ftell64(file);
   m_InputSize = fileSize;
 
   m_BufferSize = initialBufferSize;
@@ -182,7 +194,8 @@ StreamReader::~StreamReader()
   for(StreamCloseCallback cb : m_Callbacks)
     cb();
 
-  FreeAlignedBuffer(m_BufferBase);
+  if(!m_BorrowedBuffer)
+    FreeAlignedBuffer(m_BufferBase);
 
   if(m_Ownership == Ownership::Stream)
   {
@@ -196,15 +209,84 @@ StreamReader::~StreamReader()
 
 void StreamReader::SetOffset(uint64_t offs)
 {
+  if(m_Sock)
+  {
+    RDCERR("Socket stream readers do not support seeking");
+    return;
+  }
+
   if(m_File || m_Decompressor)
   {
-    RDCERR("File and decompress stream readers do not support seeking");
+    if(!m_BufferBase || IsErrored())
+      return;
+
+    if(offs > m_InputSize)
+    {
+      SET_ERROR_RESULT(m_Error, ResultCode::FileIOFailed, "Seeking off the end of data stream");
+      return;
+    }
+
+    uint64_t cur = GetOffset();
+
+    // seeking forward within the window we already have just moves the head
+    if(offs >= cur && offs - cur <= Available())
+    {
+      m_BufferHead += offs - cur;
+      return;
+    }
+
+    if(m_File)
+    {
+      FileIO::fseek64(m_File, m_FileStart + offs, SEEK_SET);
+    }
+    else if(!m_Decompressor->Seek(offs))
+    {
+      if(m_Decompressor->GetError() != ResultCode::Succeeded)
+      {
+        m_Error = m_Decompressor->GetError();
+        return;
+      }
+
+      // without a block index we can only seek forwards, by decompressing everything in between
+      if(offs >= cur)
+      {
+        Read(NULL, offs - cur);
+        return;
+      }
+
+      RDCERR("Decompress stream reader can't seek backwards without a block index");
+      return;
+    }
+
+    // refill the window from the new position
+    m_ReadOffset = offs;
+    m_BufferHead = m_BufferBase;
+    ReadFromExternal(m_BufferBase, RDCMIN(m_BufferSize, m_InputSize - offs));
+
     return;
   }
 
   m_BufferHead = m_BufferBase + offs;
 }
 
+bool StreamReader::ReadAt(uint64_t offs, void *data, uint64_t numBytes)
+{
+  if(m_Dummy || m_Sock || m_Decompressor || !m_BufferBase || IsErrored())
+    return false;
+
+  if(offs + numBytes > m_InputSize)
+    return false;
+
+  if(numBytes == 0)
+    return true;
+
+  if(m_File)
+    return FileIO::fpread(m_File, data, (size_t)numBytes, m_FileStart + offs);
+
+  memcpy(data, m_BufferBase + offs, (size_t)numBytes);
+  return true;
+}
+
 bool StreamReader::Reserve(uint64_t numBytes)
 {
   RDCASSERT(m_Sock || m_File || m_Decompressor);
@@ -615,6 +697,74 @@ void StreamWriter::HandleError(RDResult result)
   m_InMemory = false;
 }
 
+// how many chunks can be read ahead of the caller
+static const uint64_t StreamReadAheadDepth = 4;
+
+void StreamReadAhead(StreamReader *reader, uint64_t size, uint64_t chunkSize,
+                     std::function<void(const byte *data, uint64_t size)> process)
+{
+  if(size == 0)
+    return;
+
+  const uint64_t numChunks = (size + chunkSize - 1) / chunkSize;
+  const uint64_t numBufs = RDCMIN(numChunks, StreamReadAheadDepth);
+  const uint64_t bufSize = RDCMIN(chunkSize, size);
+
+  byte *bufs = new byte[(size_t)(bufSize * numBufs)];
+
+  // not worth a thread for a single chunk
+  if(numChunks == 1)
+  {
+    reader->Read(bufs, size);
+    process(bufs, size);
+    delete[] bufs;
+    return;
+  }
+
+  // the reader waits on freeBufs before filling the next buffer, and the caller waits on
+  // filledBufs before processing it. Buffers are used in order so no other bookkeeping is needed.
+  Threading::Semaphore *freeBufs = Threading::Semaphore::Create();
+  Threading::Semaphore *filledBufs = Threading::Semaphore::Create();
+
+  freeBufs->Wake((uint32_t)numBufs);
+
+  Threading::ThreadHandle readThread = Threading::CreateThread([=]() {
+    uint64_t remaining = size;
+    for(uint64_t i = 0; i < numChunks; i++)
+    {
+      uint64_t len = RDCMIN(chunkSize, remaining);
+
+      freeBufs->WaitForWake();
+      // on error this reads 0s, the same as a synchronous read, and the caller checks the error
+      // on the reader once we're done
+      reader->Read(bufs + (i % numBufs) * bufSize, len);
+      filledBufs->Wake(1);
+
+      remaining -= len;
+    }
+  });
+
+  uint64_t remaining = size;
+  for(uint64_t i = 0; i < numChunks; i++)
+  {
+    uint64_t len = RDCMIN(chunkSize, remaining);
+
+    filledBufs->WaitForWake();
+    process(bufs + (i % numBufs) * bufSize, len);
+    freeBufs->Wake(1);
+
+    remaining -= len;
+  }
+
+  Threading::JoinThread(readThread);
+  Threading::CloseThread(readThread);
+
+  freeBufs->Destroy();
+  filledBufs->Destroy();
+
+  delete[] bufs;
+}
+
 void StreamTransfer(StreamWriter *writer, StreamReader *reader, RENDERDOC_ProgressCallback progress)
 {
   uint64_t totalSize = reader->GetSize();
@@ -629,31 +779,25 @@ void StreamTransfer(StreamWriter *writer, StreamReader *reader, RENDERDOC_Progre
   // copy 1MB at a time
   const uint64_t StreamIOChunkSize = 1024 * 1024;
 
-  const uint64_t bufSize = RDCMIN(StreamIOChunkSize, totalSize);
-  uint64_t numBufs = totalSize / bufSize;
+  uint64_t numBufs = totalSize / StreamIOChunkSize;
   // last remaining partial buffer
-  if(totalSize % (uint64_t)bufSize > 0)
+  if(totalSize % StreamIOChunkSize > 0)
     numBufs++;
 
-  byte *buf = new byte[(size_t)bufSize];
-
   if(progress)
     progress(0.0001f);
 
-  for(uint64_t i = 0; i < numBufs; i++)
-  {
-    uint64_t payloadLength = RDCMIN(bufSize, totalSize);
-
-    reader->Read(buf, payloadLength);
-    writer->Write(buf, payloadLength);
+  // the next chunks are read while each one is written, so e.g. reading from disk and any
+  // decompression overlaps with compression and writing to disk or a socket.
+  uint64_t i = 0;
+  StreamReadAhead(reader, totalSize, StreamIOChunkSize, [&](const byte *data, uint64_t size) {
+    writer->Write(data, size);
 
-    totalSize -= payloadLength;
+    i++;
     if(progress)
-      progress(float(i + 1) / float(numBufs));
-  }
+      progress(float(i) / float(numBufs));
+  });
 
   if(progress)
     progress(1.0f);
-
-  delete[] buf;
 }
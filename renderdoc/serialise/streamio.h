@@ -42,6 +42,15 @@ class StreamReader;
 
 typedef std::function<void()> StreamCloseCallback;
 
+// the location of each block in a compressed stream. Every block decompresses to blockSize bytes
+// except the last which may be smaller, so the block containing any uncompressed offset can be
+// found directly.
+struct CompressedBlockIndex
+{
+  uint64_t blockSize = 0;
+  rdcarray<uint64_t> offsets;
+};
+
 class Compressor
 {
 public:
@@ -51,10 +60,13 @@ public:
   virtual bool Write(const void *data, uint64_t numBytes) = 0;
   virtual bool Finish() = 0;
 
+  // the offset of each block written so far, relative to the start of the compressed stream
+  const CompressedBlockIndex &GetBlockIndex() const { return m_BlockIndex; }
 protected:
   StreamWriter *m_Write;
   Ownership m_Ownership;
   RDResult m_Error;
+  CompressedBlockIndex m_BlockIndex;
 };
 
 class Decompressor
@@ -66,10 +78,18 @@ public:
   virtual bool Recompress(Compressor *comp) = 0;
   virtual bool Read(void *data, uint64_t numBytes) = 0;
 
+  // provide an index previously recorded by the matching compressor, to allow seeking. The
+  // underlying stream must support seeking too.
+  void SetBlockIndex(const CompressedBlockIndex &index) { m_BlockIndex = index; }
+  // seek so that the next read returns data from the given uncompressed offset. Returns false with
+  // no error set if seeking isn't possible, e.g. if there's no block index.
+  virtual bool Seek(uint64_t offset) = 0;
+
 protected:
   StreamReader *m_Read;
   Ownership m_Ownership;
   RDResult m_Error;
+  CompressedBlockIndex m_BlockIndex;
 };
 
 class StreamReader
@@ -83,11 +103,18 @@ public:
   {
     DummyStream
   };
+  enum StreamBorrowType
+  {
+    BorrowedMemory
+  };
 
   StreamReader(StreamInvalidType, RDResult res);
   StreamReader(StreamDummyType);
   StreamReader(const byte *buffer, uint64_t bufferSize);
   StreamReader(const bytebuf &buffer);
+  // reads directly from memory owned by someone else without copying it first, e.g. a file
+  // mapping. The memory must stay valid until the reader is destroyed.
+  StreamReader(StreamBorrowType, const byte *buffer, uint64_t bufferSize);
 
   StreamReader(Network::Socket *sock, Ownership own);
   StreamReader(FILE *file, uint64_t fileSize, Ownership own);
@@ -212,6 +239,30 @@ public:
     return true;
   }
 
+  // returns a pointer to the next numBytes in the stream and advances past them, without copying.
+  // This is only possible when the whole stream is in memory and remains valid for the lifetime of
+  // the reader. Otherwise NULL is returned, nothing is read, and Read() should be used instead.
+  const byte *ReadView(uint64_t numBytes)
+  {
+    if(numBytes == 0 || m_Dummy || !m_BufferBase || IsErrored())
+      return NULL;
+
+    if(m_File || m_Sock || m_Decompressor)
+      return NULL;
+
+    if(GetOffset() + numBytes > GetSize())
+      return NULL;
+
+    const byte *ret = m_BufferHead;
+    m_BufferHead += numBytes;
+    return ret;
+  }
+
+  // reads numBytes at an absolute offset in the stream without moving the current position, and
+  // without modifying any state - so it can be called from several threads at once. This is only
+  // possible for streams from memory or files, for others false is returned and nothing is read.
+  bool ReadAt(uint64_t offs, void *data, uint64_t numBytes);
+
   bool SkipBytes(uint64_t numBytes)
   {
     // fast path for file skipping
@@ -268,6 +319,9 @@ private:
   // file pointer, if we're reading from a file
   FILE *m_File = NULL;
 
+  // the position in the file that corresponds to offset 0 in this stream
+  uint64_t m_FileStart = 0;
+
   // socket, if we're reading from a socket
   Network::Socket *m_Sock = NULL;
 
@@ -281,6 +335,9 @@ private:
   // of what happened
   RDResult m_Error;
 
+  // flag indicating that m_BufferBase is not ours, so it must not be freed
+  bool m_BorrowedBuffer = false;
+
   // flag indicating this reader is a dummy and doesn't read anything or clear inputs. Used with a
   // structured serialiser to 'read' pre-existing data.
   bool m_Dummy = false;
@@ -589,4 +646,10 @@ private:
   rdcarray<StreamCloseCallback> m_Callbacks;
 };
 
+// reads size bytes from the reader in consecutive chunks of up to chunkSize and passes each one in
+// order to process on the calling thread. The following chunks are read ahead on a separate thread
+// so that reading overlaps with whatever process does.
+void StreamReadAhead(StreamReader *reader, uint64_t size, uint64_t chunkSize,
+                     std::function<void(const byte *data, uint64_t size)> process);
+
 void StreamTransfer(StreamWriter *writer, StreamReader *reader, RENDERDOC_ProgressCallback progress);
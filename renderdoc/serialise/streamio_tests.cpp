@@ -94,6 +94,159 @@ TEST_CASE("Test basic stream I/O operations", "[streamio]")
   CHECK(reader.IsErrored());
 };
 
+TEST_CASE("Test positional reads don't change the stream position", "[streamio]")
+{
+  rdcstr filename = FileIO::GetTempFolderFilename() + "/renderdoc_readat_test.bin";
+
+  bytebuf data;
+  data.resize(300 * 1024);
+  for(size_t i = 0; i < data.size(); i++)
+    data[i] = byte((i * 13) ^ (i >> 8));
+
+  REQUIRE(FileIO::WriteAll(filename, data));
+
+  {
+    FILE *f = FileIO::fopen(filename, FileIO::ReadBinary);
+    REQUIRE(f);
+
+    StreamReader reader(f, data.size(), Ownership::Stream);
+
+    uint32_t val = 0;
+    reader.Read(val);
+    CHECK(val == *(uint32_t *)data.data());
+
+    // read from all over the file, including past the reader's buffered window
+    bytebuf readBack;
+    readBack.resize(64 * 1024);
+    for(uint64_t offs : {uint64_t(100), uint64_t(200 * 1024), uint64_t(1)})
+    {
+      CHECK(reader.ReadAt(offs, readBack.data(), readBack.size()));
+      CHECK(memcmp(readBack.data(), data.data() + offs, readBack.size()) == 0);
+    }
+
+    CHECK(reader.GetOffset() == sizeof(uint32_t));
+
+    // both a relative skip and a following read continue from where the reader was
+    reader.SkipBytes(150 * 1024);
+    reader.Read(val);
+    CHECK(val == *(uint32_t *)(data.data() + sizeof(uint32_t) + 150 * 1024));
+
+    CHECK_FALSE(reader.IsErrored());
+  }
+
+  FileIO::Delete(filename);
+};
+
+TEST_CASE("Test memory mapped stream reading", "[streamio]")
+{
+  rdcstr filename = FileIO::GetTempFolderFilename() + "/renderdoc_mmap_test.bin";
+
+  bytebuf data;
+  data.resize(300 * 1024);
+  for(size_t i = 0; i < data.size(); i++)
+    data[i] = byte((i * 7) ^ (i >> 8));
+
+  REQUIRE(FileIO::WriteAll(filename, data));
+
+  FILE *f = FileIO::fopen(filename, FileIO::ReadBinary);
+  REQUIRE(f);
+
+  // map from a non page-aligned offset
+  const uint64_t offset = 12345;
+  const uint64_t length = data.size() - offset - 100;
+
+  const byte *mapped = NULL;
+  FileIO::FileMapping *mapping = FileIO::fmap(f, offset, length, &mapped);
+
+  // the mapping should remain valid after the file is closed
+  FileIO::fclose(f);
+
+  REQUIRE(mapping);
+  REQUIRE(mapped);
+
+  {
+    StreamReader reader(StreamReader::BorrowedMemory, mapped, length);
+    reader.AddCloseCallback([mapping]() { FileIO::funmap(mapping); });
+
+    CHECK(reader.GetSize() == length);
+
+    uint32_t val = 0;
+    reader.Read(val);
+    CHECK(val == *(uint32_t *)(data.data() + offset));
+
+    const byte *view = reader.ReadView(1000);
+    CHECK(view == mapped + sizeof(uint32_t));
+    CHECK_FALSE(memcmp(view, data.data() + offset + sizeof(uint32_t), 1000));
+
+    // views past the end fail without reading anything
+    CHECK(reader.ReadView(length) == NULL);
+    CHECK(reader.GetOffset() == sizeof(uint32_t) + 1000);
+
+    reader.SetOffset(length - 8);
+    uint64_t val64 = 0;
+    reader.Read(val64);
+    CHECK(val64 == *(uint64_t *)(data.data() + offset + length - 8));
+
+    CHECK(reader.AtEnd());
+    CHECK_FALSE(reader.IsErrored());
+  }
+
+  FileIO::Delete(filename);
+};
+
+TEST_CASE("Test pipelined stream transfer", "[streamio]")
+{
+  rdcstr filename = FileIO::GetTempFolderFilename() + "/renderdoc_transfer_test.bin";
+
+  // several chunks, more than are read ahead at once, plus a partial chunk at the end
+  bytebuf data;
+  data.resize(9 * 1024 * 1024 + 4321);
+  for(size_t i = 0; i < data.size(); i++)
+    data[i] = byte((i * 7) ^ (i >> 8));
+
+  REQUIRE(FileIO::WriteAll(filename, data));
+
+  SECTION("Transfer from file to memory")
+  {
+    StreamReader reader(FileIO::fopen(filename, FileIO::ReadBinary));
+    StreamWriter writer(StreamWriter::DefaultScratchSize);
+
+    float lastProgress = 0.0f;
+    bool progressIncreasing = true;
+    StreamTransfer(&writer, &reader, [&](float p) {
+      progressIncreasing &= (p >= lastProgress);
+      lastProgress = p;
+    });
+
+    CHECK(progressIncreasing);
+    CHECK(lastProgress == 1.0f);
+    CHECK_FALSE(reader.IsErrored());
+    CHECK_FALSE(writer.IsErrored());
+    REQUIRE(writer.GetOffset() == data.size());
+    CHECK_FALSE(memcmp(writer.GetData(), data.data(), data.size()));
+  }
+
+  SECTION("Chunks are processed in order")
+  {
+    StreamReader reader(data);
+
+    const uint64_t chunkSize = 1000 * 1000;
+    uint64_t offs = 0;
+    bool matches = true;
+
+    StreamReadAhead(&reader, data.size(), chunkSize, [&](const byte *chunk, uint64_t size) {
+      matches &= (size == RDCMIN(chunkSize, data.size() - offs));
+      matches &= (memcmp(chunk, data.data() + offs, (size_t)size) == 0);
+      offs += size;
+    });
+
+    CHECK(matches);
+    CHECK(offs == data.size());
+  }
+
+  FileIO::Delete(filename);
+};
+
 TEST_CASE("Test stream I/O operations over the network", "[streamio][network]")
 {
   uint16_t port = 8235;
@@ -25,31 +25,114 @@
 #define ZSTD_STATIC_LINKING_ONLY
 #include "zstdio.h"
 
+// by default every block is compressed as its own frame, rather than as one stream with long
+// distance matching. Independent frames are what lets sections be decompressed in parallel and
+// seeked with the block index, and they're the format older builds can read. The cost is ratio: on
+// a 41MB binary one level 7 stream is ~8% smaller than 128KB frames, and long distance matching
+// only helps much more when identical multi-megabyte data repeats (e.g. re-uploaded buffers), where
+// it can be several times smaller. Archive mode makes the opposite trade for captures that are
+// being stored rather than replayed.
 static const uint64_t zstdBlockSize = 128 * 1024;
 static const uint64_t compressBlockSize = ZSTD_compressBound(zstdBlockSize);
 
-ZSTDCompressor::ZSTDCompressor(StreamWriter *write, Ownership own) : Compressor(write, own)
+// the window for archive mode. This is the largest window a decoder accepts without raising its
+// limit, and is how much memory decompressing needs on top of the usual buffers.
+static const unsigned zstdArchiveWindowLog = 27;
+
+ZSTDCompressor::ZSTDCompressor(StreamWriter *write, Ownership own, int level, bool parallel,
+                               bool archive)
+    : Compressor(write, own)
 {
-  m_Page = AllocAlignedBuffer(zstdBlockSize);
-  m_CompressBuffer = AllocAlignedBuffer(compressBlockSize);
+  m_BlockIndex.blockSize = zstdBlockSize;
+
+  m_Level = RDCCLAMP(level, 1, ZSTD_maxCLevel());
 
   m_PageOffset = 0;
 
+  if(archive)
+  {
+    m_Archive = true;
+
+    m_Page = AllocAlignedBuffer(zstdBlockSize);
+    m_CompressBuffer = AllocAlignedBuffer(compressBlockSize);
+
+    // the stream is a single frame for the whole section, so the parameters are set once here
+    m_Stream = ZSTD_createCCtx();
+
+    size_t err = ZSTD_CCtx_setParameter(m_Stream, ZSTD_p_compressionLevel, (unsigned)m_Level);
+    if(!ZSTD_isError(err))
+      err = ZSTD_CCtx_setParameter(m_Stream, ZSTD_p_enableLongDistanceMatching, 1);
+    if(!ZSTD_isError(err))
+      err = ZSTD_CCtx_setParameter(m_Stream, ZSTD_p_windowLog, zstdArchiveWindowLog);
+
+    if(ZSTD_isError(err))
+    {
+      FreeBuffers();
+      SET_ERROR_RESULT(m_Error, ResultCode::CompressionFailed, "ZSTD compression failed: %s",
+                       ZSTD_getErrorName(err));
+    }
+
+    return;
+  }
+
+  if(parallel)
+  {
+    // enough blocks in flight to keep every worker busy while the previous results are written
+    m_Blocks.resize(RDCCLAMP(Threading::JobSystem::GetWorkerCount() * 2, 2U, 64U));
+    for(ZSTDParallelBlock &block : m_Blocks)
+    {
+      block.page = AllocAlignedBuffer(zstdBlockSize);
+      block.compressed = AllocAlignedBuffer(compressBlockSize);
+      block.ctx = ZSTD_createCCtx();
+    }
+
+    m_Page = m_Blocks[0].page;
+    m_CompressBuffer = NULL;
+
+    m_Stream = NULL;
+
+    return;
+  }
+
+  m_Page = AllocAlignedBuffer(zstdBlockSize);
+  m_CompressBuffer = AllocAlignedBuffer(compressBlockSize);
+
   m_Stream = ZSTD_createCStream();
 }
 
 ZSTDCompressor::~ZSTDCompressor()
 {
+  FreeBuffers();
   ZSTD_freeCStream(m_Stream);
+}
 
-  FreeAlignedBuffer(m_Page);
-  FreeAlignedBuffer(m_CompressBuffer);
+void ZSTDCompressor::FreeBuffers()
+{
+  if(m_Blocks.empty())
+  {
+    FreeAlignedBuffer(m_Page);
+    FreeAlignedBuffer(m_CompressBuffer);
+  }
+  else
+  {
+    // jobs may still be compressing from these pages, wait for them before freeing anything
+    for(ZSTDParallelBlock &block : m_Blocks)
+    {
+      Threading::JobSystem::SyncJob(block.job);
+      FreeAlignedBuffer(block.page);
+      FreeAlignedBuffer(block.compressed);
+      ZSTD_freeCCtx(block.ctx);
+    }
+    m_Blocks.clear();
+  }
+
+  m_Page = m_CompressBuffer = NULL;
 }
 
 bool ZSTDCompressor::Write(const void *data, uint64_t numBytes)
 {
   // if we encountered a stream error this will be NULL
-  if(!m_CompressBuffer)
+  if(!m_Page)
     return false;
 
   if(numBytes == 0)
@@ -112,15 +195,52 @@ bool ZSTDCompressor::Finish()
   // only the last one can be smaller, so we only write a partial page when finishing.
   // Calling Write() after Finish() is illegal
 
-  return FlushPage();
+  // the archive stream's single frame is ended along with the last page
+  if(m_Archive)
+    return CompressArchive(true);
+
+  bool success = FlushPage();
+
+  // in parallel mode, write out any blocks that are still in flight. The current block was just
+  // written by the flush so the oldest in-flight block is the one after it.
+  for(size_t i = 1; success && i < m_Blocks.size(); i++)
+    success &= WriteBlock(m_Blocks[(m_CurBlock + i) % m_Blocks.size()]);
+
+  return success;
 }
 
 bool ZSTDCompressor::FlushPage()
 {
   // if we encountered a stream error this will be NULL
-  if(!m_CompressBuffer)
+  if(!m_Page)
     return false;
 
+  if(m_Archive)
+    return CompressArchive(false);
+
+  if(!m_Blocks.empty())
+  {
+    ZSTDParallelBlock &block = m_Blocks[m_CurBlock];
+    block.uncompSize = (size_t)m_PageOffset;
+    int level = m_Level;
+    block.job = Threading::JobSystem::AddJob([&block, level]() {
+      block.compSize = ZSTD_compressCCtx(block.ctx, block.compressed, compressBlockSize, block.page,
+                                         block.uncompSize, level);
+    });
+
+    // move to the next block. If it's still in flight it's the oldest block, so wait for it and
+    // write it out - this keeps the blocks in order on disk.
+    m_CurBlock = (m_CurBlock + 1) % m_Blocks.size();
+
+    if(!WriteBlock(m_Blocks[m_CurBlock]))
+      return false;
+
+    m_Page = m_Blocks[m_CurBlock].page;
+    m_PageOffset = 0;
+
+    return true;
+  }
+
   ZSTD_inBuffer in = {m_Page, (size_t)m_PageOffset, 0};
   ZSTD_outBuffer out = {m_CompressBuffer, ZSTD_CStreamOutSize(), 0};
 
@@ -132,10 +252,17 @@ bool ZSTDCompressor::FlushPage()
   if(!m_CompressBuffer)
     return false;
 
+  // each page is a separate frame so it can be decompressed independently
+  m_BlockIndex.offsets.push_back(m_Write->GetOffset());
+
   // a bit redundant to write this but it means we can read the entire frame without
   // doing multiple reads
   success &= m_Write->Write((uint32_t)out.pos);
+  if(!success)
+    m_Error = m_Write->GetError();
   success &= m_Write->Write(m_CompressBuffer, out.pos);
+  if(!success)
+    m_Error = m_Write->GetError();
 
   // start writing to the start of the page again
   m_PageOffset = 0;
@@ -143,9 +270,95 @@ bool ZSTDCompressor::FlushPage()
   return success;
 }
 
+bool ZSTDCompressor::WriteBlock(ZSTDParallelBlock &block)
+{
+  // nothing to do if this block isn't in use
+  if(!block.job)
+    return true;
+
+  Threading::JobSystem::SyncJob(block.job);
+  block.job = NULL;
+
+  size_t compSize = block.compSize;
+
+  if(ZSTD_isError(compSize))
+  {
+    FreeBuffers();
+    SET_ERROR_RESULT(m_Error, ResultCode::CompressionFailed, "ZSTD compression failed: %s",
+                     ZSTD_getErrorName(compSize));
+    return false;
+  }
+
+  m_BlockIndex.offsets.push_back(m_Write->GetOffset());
+
+  bool success = true;
+
+  success &= m_Write->Write((uint32_t)compSize);
+  if(!success)
+    m_Error = m_Write->GetError();
+  success &= m_Write->Write(block.compressed, compSize);
+  if(!success)
+    m_Error = m_Write->GetError();
+
+  // like a compression failure, a write failure ends the stream. Release the blocks now, waiting
+  // for any still compressing, rather than holding them until the compressor is destroyed.
+  if(!success)
+    FreeBuffers();
+
+  return success;
+}
+
+bool ZSTDCompressor::CompressArchive(bool endFrame)
+{
+  // if we encountered a stream error this will be NULL
+  if(!m_Page)
+    return false;
+
+  ZSTD_inBuffer in = {m_Page, (size_t)m_PageOffset, 0};
+  ZSTD_EndDirective mode = endFrame ? ZSTD_e_end : ZSTD_e_continue;
+
+  for(;;)
+  {
+    ZSTD_outBuffer out = {m_CompressBuffer, compressBlockSize, 0};
+
+    size_t remaining = ZSTD_compress_generic(m_Stream, &out, &in, mode);
+
+    if(ZSTD_isError(remaining))
+    {
+      FreeBuffers();
+      SET_ERROR_RESULT(m_Error, ResultCode::CompressionFailed, "ZSTD compression failed: %s",
+                       ZSTD_getErrorName(remaining));
+      return false;
+    }
+
+    // the output is written in pieces with the same size prefix as independent frames, but
+    // they're all part of one frame and can only be decompressed in order.
+    if(out.pos > 0)
+    {
+      bool success = m_Write->Write((uint32_t)out.pos);
+      success &= m_Write->Write(m_CompressBuffer, out.pos);
+
+      if(!success)
+      {
+        m_Error = m_Write->GetError();
+        FreeBuffers();
+        return false;
+      }
+    }
+
+    // ending the frame also needs everything zstd has buffered to be flushed
+    if(in.pos == in.size && (!endFrame || remaining == 0))
+      break;
+  }
+
+  m_PageOffset = 0;
+
+  return true;
+}
+
 bool ZSTDCompressor::CompressZSTDFrame(ZSTD_inBuffer &in, ZSTD_outBuffer &out)
 {
-  size_t err = ZSTD_initCStream(m_Stream, 7);
+  size_t err = ZSTD_initCStream(m_Stream, m_Level);
 
   if(ZSTD_isError(err))
   {
@@ -199,7 +412,8 @@ bool ZSTDCompressor::CompressZSTDFrame(ZSTD_inBuffer &in, ZSTD_outBuffer &out)
   return true;
 }
 
-ZSTDDecompressor::ZSTDDecompressor(StreamReader *read, Ownership own) : Decompressor(read, own)
+ZSTDDecompressor::ZSTDDecompressor(StreamReader *read, Ownership own, bool archive)
+    : Decompressor(read, own)
 {
   m_Page = AllocAlignedBuffer(zstdBlockSize);
   m_CompressBuffer = AllocAlignedBuffer(compressBlockSize);
@@ -208,22 +422,46 @@ ZSTDDecompressor::ZSTDDecompressor(StreamReader *read, Ownership own) : Decompre
   m_PageLength = 0;
 
   m_Stream = ZSTD_createDStream();
+
+  if(archive)
+  {
+    m_Archive = true;
+
+    // the whole stream is one frame, so it's only initialised once
+    size_t err = ZSTD_initDStream(m_Stream);
+
+    if(ZSTD_isError(err))
+    {
+      SET_ERROR_RESULT(m_Error, ResultCode::CompressionFailed, "ZSTD decompression failed: %s",
+                       ZSTD_getErrorName(err));
+      FreeBuffers();
+    }
+  }
 }
 
 ZSTDDecompressor::~ZSTDDecompressor()
 {
   ZSTD_freeDStream(m_Stream);
+  FreeBuffers();
+}
+
+void ZSTDDecompressor::FreeBuffers()
+{
   FreeAlignedBuffer(m_Page);
   FreeAlignedBuffer(m_CompressBuffer);
+  m_Page = m_CompressBuffer = NULL;
 }
 
 bool ZSTDDecompressor::Recompress(Compressor *comp)
 {
   bool success = true;
 
-  while(success && !m_Read->AtEnd())
+  // the end of an archive stream is only known once nothing more comes out of it
+  while(success && (m_Archive || !m_Read->AtEnd()))
   {
     success &= FillPage();
+    if(success && m_Archive && m_PageLength == 0)
+      break;
     if(success)
     {
       success &= comp->Write(m_Page, m_PageLength);
@@ -237,6 +475,37 @@ bool ZSTDDecompressor::Recompress(Compressor *comp)
   return success;
 }
 
+bool ZSTDDecompressor::Seek(uint64_t offset)
+{
+  // an archive stream has no independent blocks to seek to
+  if(m_Archive || m_BlockIndex.offsets.empty() || m_BlockIndex.blockSize != zstdBlockSize)
+    return false;
+
+  // if we encountered a stream error this will be NULL
+  if(!m_CompressBuffer)
+    return false;
+
+  size_t block = (size_t)RDCMIN(offset / zstdBlockSize, uint64_t(m_BlockIndex.offsets.size() - 1));
+
+  m_Read->SetOffset(m_BlockIndex.offsets[block]);
+
+  if(m_Read->IsErrored())
+  {
+    m_Error = m_Read->GetError();
+    FreeAlignedBuffer(m_Page);
+    FreeAlignedBuffer(m_CompressBuffer);
+    m_Page = m_CompressBuffer = NULL;
+    return false;
+  }
+
+  if(!FillPage())
+    return false;
+
+  m_PageOffset = RDCMIN(offset - block * zstdBlockSize, m_PageLength);
+
+  return true;
+}
+
 bool ZSTDDecompressor::Read(void *data, uint64_t numBytes)
 {
   // if we encountered a stream error this will be NULL
@@ -279,6 +548,13 @@ bool ZSTDDecompressor::Read(void *data, uint64_t numBytes)
     if(!success)
       return success;
 
+    if(m_PageLength == 0)
+    {
+      SET_ERROR_RESULT(m_Error, ResultCode::FileIOFailed, "Reading past the end of ZSTD stream");
+      FreeBuffers();
+      return false;
+    }
+
     // if we can now satisfy the remainder of the read, do so and return
     if(numBytes <= m_PageLength)
     {
@@ -298,19 +574,28 @@ bool ZSTDDecompressor::Read(void *data, uint64_t numBytes)
 
 bool ZSTDDecompressor::FillPage()
 {
+  if(m_Archive)
+    return FillArchivePage();
+
   uint32_t compSize = 0;
 
   bool success = true;
 
   success &= m_Read->Read(compSize);
+
+  if(success && compSize > compressBlockSize)
+  {
+    SET_ERROR_RESULT(m_Error, ResultCode::FileIOFailed, "Invalid ZSTD frame size %u", compSize);
+    FreeBuffers();
+    return false;
+  }
+
   success &= m_Read->Read(m_CompressBuffer, compSize);
 
   if(!success)
   {
     m_Error = m_Read->GetError();
-    FreeAlignedBuffer(m_Page);
-    FreeAlignedBuffer(m_CompressBuffer);
-    m_Page = m_CompressBuffer = NULL;
+    FreeBuffers();
     return false;
   }
 
@@ -357,3 +642,64 @@ bool ZSTDDecompressor::FillPage()
 
   return success;
 }
+
+bool ZSTDDecompressor::FillArchivePage()
+{
+  // if we encountered a stream error this will be NULL
+  if(!m_CompressBuffer)
+    return false;
+
+  ZSTD_outBuffer out = {m_Page, zstdBlockSize, 0};
+
+  while(out.pos < out.size)
+  {
+    // read the next piece of the frame once the last one has been consumed
+    if(m_ArchiveIn.pos == m_ArchiveIn.size && !m_Read->AtEnd())
+    {
+      uint32_t compSize = 0;
+
+      bool success = m_Read->Read(compSize);
+
+      if(success && compSize > compressBlockSize)
+      {
+        SET_ERROR_RESULT(m_Error, ResultCode::FileIOFailed, "Invalid ZSTD archive piece size %u",
+                         compSize);
+        FreeBuffers();
+        return false;
+      }
+
+      success &= m_Read->Read(m_CompressBuffer, compSize);
+
+      if(!success)
+      {
+        m_Error = m_Read->GetError();
+        FreeBuffers();
+        return false;
+      }
+
+      m_ArchiveIn = {m_CompressBuffer, compSize, 0};
+    }
+
+    size_t inpos = m_ArchiveIn.pos;
+    size_t outpos = out.pos;
+
+    size_t err = ZSTD_decompressStream(m_Stream, &out, &m_ArchiveIn);
+
+    if(ZSTD_isError(err))
+    {
+      SET_ERROR_RESULT(m_Error, ResultCode::CompressionFailed, "ZSTD decompression failed: %s",
+                       ZSTD_getErrorName(err));
+      FreeBuffers();
+      return false;
+    }
+
+    // once everything has been read and nothing more comes out, the stream is finished
+    if(inpos == m_ArchiveIn.pos && outpos == out.pos && m_Read->AtEnd())
+      break;
+  }
+
+  m_PageOffset = 0;
+  m_PageLength = out.pos;
+
+  return true;
+}
@@ -24,13 +24,33 @@
 
 #pragma once
 
+#include "common/threading.h"
 #include "zstd/zstd.h"
 #include "streamio.h"
 
+// each page is always compressed as a separate frame, so in parallel mode several pages are
+// compressed at once on the job system each with their own context, and written out in order. The
+// output is identical in format to the serial compressor.
+struct ZSTDParallelBlock
+{
+  byte *page = NULL;
+  byte *compressed = NULL;
+  size_t uncompSize = 0;
+  size_t compSize = 0;
+  ZSTD_CCtx *ctx = NULL;
+  Threading::JobSystem::Job *job = NULL;
+};
+
 class ZSTDCompressor : public Compressor
 {
 public:
-  ZSTDCompressor(StreamWriter *write, Ownership own);
+  static const int DefaultLevel = 7;
+
+  // in archive mode the whole stream is one zstd frame with long distance matching, instead of an
+  // independent frame per block. It compresses repeated data much better but can only be
+  // compressed on one thread, and only decompressed in order from the start.
+  ZSTDCompressor(StreamWriter *write, Ownership own, int level = DefaultLevel,
+                 bool parallel = false, bool archive = false);
   ~ZSTDCompressor();
 
   bool Write(const void *data, uint64_t numBytes);
@@ -38,32 +58,50 @@ public:
 
 private:
   bool FlushPage();
+  bool WriteBlock(ZSTDParallelBlock &block);
+  void FreeBuffers();
 
   bool CompressZSTDFrame(ZSTD_inBuffer &in, ZSTD_outBuffer &out);
+  bool CompressArchive(bool endFrame);
 
   byte *m_Page;
   byte *m_CompressBuffer;
   uint64_t m_PageOffset;
 
+  int m_Level;
+  bool m_Archive = false;
+
   ZSTD_CStream *m_Stream;
+
+  // only used in parallel mode, a ring of blocks in flight. m_Page points to the page of the block
+  // currently being filled
+  rdcarray<ZSTDParallelBlock> m_Blocks;
+  size_t m_CurBlock = 0;
 };
 
 class ZSTDDecompressor : public Decompressor
 {
 public:
-  ZSTDDecompressor(StreamReader *read, Ownership own);
+  ZSTDDecompressor(StreamReader *read, Ownership own, bool archive = false);
   ~ZSTDDecompressor();
 
   bool Recompress(Compressor *comp);
   bool Read(void *data, uint64_t numBytes);
+  bool Seek(uint64_t offset);
 
 private:
   bool FillPage();
+  bool FillArchivePage();
+  void FreeBuffers();
 
   byte *m_Page;
   byte *m_CompressBuffer;
   uint64_t m_PageOffset;
   uint64_t m_PageLength;
 
+  // in archive mode, the compressed data read so far that hasn't been decompressed yet
+  bool m_Archive = false;
+  ZSTD_inBuffer m_ArchiveIn = {};
+
   ZSTD_DStream *m_Stream;
 };
@@ -694,6 +694,9 @@ private:
   std::string outfile;
   std::string infmt;
   std::string outfmt;
+  uint32_t zstd_level = 0;
+  bool serial_compression = false;
+  bool zstd_archive = false;
 
 public:
   ConvertCommand() : Command() {}
@@ -706,6 +709,14 @@ public:
     parser.add<std::string>("convert-format", 'c', "The format of the output file.", false, "",
                             formats_reader(false));
     parser.add("list-formats", '\0', "Print a list of target formats.");
+    parser.add<uint32_t>("zstd-level", '\0',
+                         "The zstd compression level (1-22) to use when writing a capture.", false,
+                         0);
+    parser.add("serial-compression", '\0',
+               "Compress on a single thread when writing a capture, instead of in parallel.");
+    parser.add("zstd-archive", '\0',
+               "Compress a capture as one zstd frame with long distance matching for archiving. "
+               "Smaller, but slower to open and not readable by older versions.");
     parser.stop_at_rest(true);
   }
   virtual const char *Description() { return "Convert between capture formats."; }
@@ -738,6 +749,17 @@ public:
     infmt = parser.get<std::string>("input-format");
     outfmt = parser.get<std::string>("convert-format");
 
+    zstd_level = parser.get<uint32_t>("zstd-level");
+    serial_compression = parser.exist("serial-compression");
+    zstd_archive = parser.exist("zstd-archive");
+
+    if(zstd_level > 22)
+    {
+      std::cerr << "zstd compression level must be between 1 and 22." << std::endl << std::endl;
+      std::cerr << parser.usage() << std::endl;
+      return false;
+    }
+
     return true;
   }
 
@@ -817,6 +839,14 @@ public:
       return 1;
     }
 
+    // these only apply to this process, they aren't saved to the config file
+    if(zstd_level > 0)
+      RENDERDOC_SetConfigSetting("Capture.ZstdLevel")->data.basic.u = zstd_level;
+    if(serial_compression)
+      RENDERDOC_SetConfigSetting("Capture.ParallelCompression")->data.basic.b = false;
+    if(zstd_archive)
+      RENDERDOC_SetConfigSetting("Capture.ZstdArchive")->data.basic.b = true;
+
     st = file->Convert(conv(outfile), conv(outfmt), NULL, NULL);
 
     if(st.code != ResultCode::Succeeded)
@@ -216,6 +216,9 @@ class Texture_Zoo():
         if test_mode == Texture_Zoo.TEST_PNG:
             eps = max(eps, (2.5 / 255.0))
 
+        if test_mode == Texture_Zoo.TEST_CAPTURE:
+            self.check_cpu_stats(tex_id, bound_res.typeCast, testCompType, eps)
+
         for mp in range(tex.mips):
             for sl in range(max(tex.arraysize, max(1, tex.depth >> mp))):
                 z = 0
@@ -403,6 +406,52 @@ class Texture_Zoo():
                 raise rdtest.TestFailureException(
                     "In {} {} Top-left pixel as rendered is {}. Expected {}".format(name, fmt_name, picked, value0))
 
+    def check_cpu_stats(self, tex_id: rd.ResourceId, type_cast: rd.CompType, comp_type: rd.CompType, eps: float):
+        # Min/max and histograms are calculated on the CPU where the format allows it, check that they match what the
+        # replay driver calculates on the GPU
+        cur_sub = self.sub(0, 0, 0)
+
+        hist_min, hist_max = 0.0, 1.0
+        if comp_type == rd.CompType.UInt:
+            hist_min, hist_max = 0.0, 255.0
+        elif comp_type == rd.CompType.SInt:
+            hist_min, hist_max = -255.0, 0.0
+        elif comp_type == rd.CompType.SNorm:
+            hist_min, hist_max = -1.0, 0.0
+
+        setting = rd.SetConfigSetting('Replay_CPUTextureStats')
+        prev_cpu = setting.data.basic.b
+
+        results = []
+        for cpu in [True, False]:
+            setting.data.basic.b = cpu
+            mn, mx = self.controller.GetMinMax(tex_id, cur_sub, type_cast)
+            hist = self.controller.GetHistogram(tex_id, cur_sub, type_cast, hist_min, hist_max,
+                                                (True, True, True, True))
+            results.append((mn, mx, list(hist)))
+
+        setting.data.basic.b = prev_cpu
+
+        (cpu_min, cpu_max, cpu_hist), (gpu_min, gpu_max, gpu_hist) = results
+
+        # integer formats return their min/max as integers
+        if comp_type == rd.CompType.UInt or comp_type == rd.CompType.SInt:
+            minmax_match = (list(cpu_min.intValue) == list(gpu_min.intValue) and
+                            list(cpu_max.intValue) == list(gpu_max.intValue))
+        else:
+            minmax_match = (rdtest.value_compare(cpu_min.floatValue, gpu_min.floatValue, eps) and
+                            rdtest.value_compare(cpu_max.floatValue, gpu_max.floatValue, eps))
+
+        if not minmax_match:
+            raise rdtest.TestFailureException(
+                "CPU min/max {} - {} doesn't match GPU min/max {} - {}".format(
+                    cpu_min.floatValue, cpu_max.floatValue, gpu_min.floatValue, gpu_max.floatValue))
+
+        # values exactly on a bucket boundary may land either side depending on conversion precision, so only require
+        # nearly the same distribution
+        if sum([abs(a - b) for a, b in zip(cpu_hist, gpu_hist)]) > sum(gpu_hist) // 100:
+            raise rdtest.TestFailureException("CPU histogram doesn't match GPU histogram")
+
     def get_expected_value(self, comp_count: int, comp_type: rd.CompType, cur_sub: rd.Subresource, test_mode: int,
                            tex: rd.TextureDescription, x: int, y: int, z: int):
         mp, sl, sm = cur_sub.mip, cur_sub.slice, cur_sub.sample
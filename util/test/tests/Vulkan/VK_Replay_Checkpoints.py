@@ -0,0 +1,66 @@
+import renderdoc as rd
+import rdtest
+
+
+class VK_Replay_Checkpoints(rdtest.TestCase):
+    demos_test_name = 'VK_Read_Before_Overwrite'
+
+    def get_actions(self, actions):
+        ret = []
+        for action in actions:
+            ret += self.get_actions(action.children)
+            if action.flags & (rd.ActionFlags.Drawcall | rd.ActionFlags.Dispatch | rd.ActionFlags.Clear |
+                               rd.ActionFlags.Copy | rd.ActionFlags.Present):
+                ret.append(action)
+        return ret
+
+    def get_contents(self, action: rd.ActionDescription):
+        # force a full replay so that a checkpoint can be created or restored
+        self.controller.SetFrameEvent(action.eventId, True)
+
+        contents = [self.controller.GetBufferData(self.outbuf, 0, 0)]
+
+        for out in action.outputs:
+            if out != rd.ResourceId.Null():
+                contents.append(self.controller.GetTextureData(out, rd.Subresource()))
+
+        return contents
+
+    def check_capture(self):
+        self.outbuf = self.get_resource_by_name("outbuf").resourceId
+
+        actions = self.get_actions(self.controller.GetRootActions())
+
+        budget = rd.SetConfigSetting('Vulkan_ReplayCheckpointBudgetMB')
+        interval = rd.SetConfigSetting('Vulkan_ReplayCheckpointIntervalMS')
+
+        prev_budget = budget.data.basic.u
+        prev_interval = interval.data.basic.u
+
+        try:
+            budget.data.basic.u = 0
+
+            # replay a few times first to ensure we are definitely in a stable point
+            for i in range(3):
+                self.controller.SetFrameEvent(actions[-1].eventId, True)
+
+            reference = [self.get_contents(a) for a in actions]
+
+            # allow a checkpoint at every queue submit, and do a full replay of the frame to create them
+            budget.data.basic.u = 256
+            interval.data.basic.u = 0
+            self.controller.SetFrameEvent(actions[-1].eventId, True)
+
+            # replay each action in reverse order so that each starts from the closest checkpoint before it, then
+            # check the results are identical to replaying from the start of the frame
+            for i in reversed(range(len(actions))):
+                contents = self.get_contents(actions[i])
+
+                if contents != reference[i]:
+                    raise rdtest.TestFailureException("Contents at event {} differ when replayed from a checkpoint"
+                                                      .format(actions[i].eventId))
+
+            rdtest.log.success('Replaying from checkpoints matches replaying from the start of the frame')
+        finally:
+            budget.data.basic.u = prev_budget
+            interval.data.basic.u = prev_interval
@@ -0,0 +1,58 @@
+import renderdoc as rd
+import rdtest
+
+
+class VK_Replay_Command_Skipping(rdtest.TestCase):
+    demos_test_name = 'VK_Read_Before_Overwrite'
+
+    def get_actions(self, actions):
+        ret = []
+        for action in actions:
+            ret += self.get_actions(action.children)
+            if action.flags & (rd.ActionFlags.Drawcall | rd.ActionFlags.Dispatch | rd.ActionFlags.Clear |
+                               rd.ActionFlags.Copy | rd.ActionFlags.Present):
+                ret.append(action)
+        return ret
+
+    def get_contents(self, action: rd.ActionDescription):
+        # force a replay from the start of the frame, which is when command chunks can be skipped
+        self.controller.SetFrameEvent(action.eventId, True)
+
+        contents = [self.controller.GetBufferData(self.outbuf, 0, 0)]
+
+        for out in list(action.outputs) + [action.depthOut, action.copyDestination]:
+            if out != rd.ResourceId.Null() and self.get_texture(out) is not None:
+                contents.append(self.controller.GetTextureData(out, rd.Subresource()))
+
+        return contents
+
+    def check_capture(self):
+        self.outbuf = self.get_resource_by_name("outbuf").resourceId
+
+        actions = self.get_actions(self.controller.GetRootActions())
+
+        # this is a debug setting, so it can't be changed in stable builds
+        replay_all = rd.SetConfigSetting('Vulkan_Debug_ReplayAllCommandChunks')
+
+        prev_replay_all = replay_all.data.basic.b
+
+        try:
+            # deserialise every command of every command buffer to get the reference results
+            replay_all.data.basic.b = True
+
+            reference = [self.get_contents(a) for a in actions]
+
+            # skip the commands of command buffers that are submitted as-is, in reverse order so that
+            # a different set of command buffers is re-recorded each time
+            replay_all.data.basic.b = False
+
+            for i in reversed(range(len(actions))):
+                contents = self.get_contents(actions[i])
+
+                if contents != reference[i]:
+                    raise rdtest.TestFailureException("Contents at event {} differ when skipping command chunks"
+                                                      .format(actions[i].eventId))
+
+            rdtest.log.success('Skipping command chunks matches replaying every command chunk')
+        finally:
+            replay_all.data.basic.b = prev_replay_all